@@ -0,0 +1,199 @@
+// Throughput of the inbound parsers, and a check that they stay linear on
+// long malformed input. Links the fuzz targets themselves (built without
+// sanitizers, each entry point renamed), so it measures what is fuzzed.
+//
+//   bench [--corpus <dir>] [--max-growth <x>]
+//
+// Each case is timed at four input lengths, up to its own maximum; the
+// growth column is ns/byte at the longest over ns/byte at the shortest.
+// Linear code stays near 1 (or below: fixed costs spread out); quadratic
+// code grows with the length ratio, 64. Exit status 1 if any case grows
+// past --max-growth (default 4). With --corpus, every file in
+// <dir>/<target>/ is also run through its target for MB/s.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+extern "C" int fuzz_mesh(const uint8_t *data, size_t size);
+extern "C" int fuzz_serial(const uint8_t *data, size_t size);
+extern "C" int fuzz_portal(const uint8_t *data, size_t size);
+extern "C" int fuzz_dns(const uint8_t *data, size_t size);
+extern "C" int fuzz_gps(const uint8_t *data, size_t size);
+
+typedef int (*Target)(const uint8_t *, size_t);
+typedef std::string Bytes;
+
+struct TargetName
+{
+  const char *name;
+  Target fn;
+};
+static const TargetName TARGETS[] = {
+    {"mesh", fuzz_mesh}, {"serial", fuzz_serial}, {"portal", fuzz_portal}, {"dns", fuzz_dns}, {"gps", fuzz_gps},
+};
+
+static Bytes repeat(const char *s, size_t n)
+{
+  Bytes b;
+  while (b.size() < n)
+    b += s;
+  b.resize(n);
+  return b;
+}
+
+static const Bytes FROM("\x01\x00\x00\x01", 4); // sender id for fuzz_mesh
+
+// Malformed input of length about n
+struct Case
+{
+  const char *name;
+  Target fn;
+  size_t maxLen;
+  Bytes (*make)(size_t n);
+};
+static const Case CASES[] = {
+    {"mesh: MASTER:<digits>", fuzz_mesh, 65536, [](size_t n) { return FROM + "MASTER:" + repeat("9", n); }},
+    {"mesh: MSG:<hex>", fuzz_mesh, 65536, [](size_t n) { return FROM + "MSG:" + repeat("f", n); }},
+    {"mesh: ALERT: polygon", fuzz_mesh, 65536,
+     [](size_t n) { return FROM + "ALERT:1:1:60:0:P" + repeat("1,", n) + ":x"; }},
+    {"mesh: FRG: long fragment", fuzz_mesh, 65536, [](size_t n) { return FROM + "FRG:1:0:2:65535:" + repeat("x", n); }},
+    {"mesh: Z: packed report", fuzz_mesh, 65536, [](size_t n) { return FROM + "Z:0:16384:" + repeat("A", n); }},
+    {"mesh: Z: copies", fuzz_mesh, 65536, [](size_t n) { return FROM + "Z:0:16384:/" + repeat("AAB", n); }},
+    {"mesh: AGG: many entries", fuzz_mesh, 65536, [](size_t n) { return FROM + "AGG:100:" + repeat("1:1:{", n); }},
+    {"mesh: AGG: long entry", fuzz_mesh, 65536, [](size_t n) { return FROM + "AGG:100:1:1024:{" + repeat("x", n); }},
+    {"mesh: CFG: long key", fuzz_mesh, 65536, [](size_t n) { return FROM + "CFG:" + repeat("k", n) + "=1"; }},
+    {"mesh: report, long string", fuzz_mesh, 65536,
+     [](size_t n) { return FROM + "{\"device_id\":\"" + repeat("a", n) + "\"}"; }},
+    {"mesh: report, many keys", fuzz_mesh, 65536, [](size_t n) { return FROM + "{" + repeat("\"k\":1,", n) + "}"; }},
+    {"mesh: report, nesting", fuzz_mesh, 65536, [](size_t n) { return FROM + repeat("[", n); }},
+    {"mesh: packet, newlines", fuzz_mesh, 65536, [](size_t n) { return FROM + repeat("x\n", n); }},
+    {"serial: no newline", fuzz_serial, 65536, [](size_t n) { return repeat("A", n); }},
+    {"serial: short lines", fuzz_serial, 65536, [](size_t n) { return repeat("TO:1:u:hi\n", n); }},
+    {"serial: alert lines", fuzz_serial, 65536,
+     [](size_t n) { return repeat("ALERT:1:2:60:P1,1,2,2,3,1,4,4,5,5,6,6,7,7,8,8:x\n", n); }},
+    {"serial: !cfg lines", fuzz_serial, 65536, [](size_t n) { return repeat("!cfg mesh sendPeriodMs 2000\n", n); }},
+    {"portal: submit <<<", fuzz_portal, 65536, [](size_t n) { return Bytes(1, 0) + repeat("<", n); }},
+    {"portal: userid", fuzz_portal, 65536, [](size_t n) { return Bytes(1, 1) + repeat("u", n); }},
+    {"portal: config value", fuzz_portal, 65536,
+     [](size_t n) { return Bytes(1, 2) + Bytes("meshPrefix\0", 11) + repeat("x", n); }},
+    {"portal: provision json", fuzz_portal, 1024,
+     [](size_t n) { return Bytes(1, 3) + "{\"userid\":\"u\",\"messages\":[" + repeat("\"m\",", n > 32 ? n - 32 : 0) + "\"m\"]}"; }},
+    {"portal: provision tlv", fuzz_portal, 1024, [](size_t n) { return Bytes(1, 4) + repeat("\x05\x01m", n); }},
+    {"dns: long name", fuzz_dns, 512,
+     [](size_t n) { return Bytes("\x12\x34\x01\x00\x00\x01\x00\x00\x00\x00\x00\x00", 12) + repeat("\x01" "a", n > 17 ? n - 17 : 0) +
+                           Bytes("\x00\x00\x01\x00\x01", 5); }},
+    {"gps: UBX sync noise", fuzz_gps, 65536, [](size_t n) { return repeat("\xB5\x62", n); }},
+    {"gps: NMEA noise", fuzz_gps, 65536, [](size_t n) { return repeat("$GPGGA,,,,,,,,,*", n); }},
+};
+
+typedef std::chrono::steady_clock Clock;
+
+// ns per call, repeated for at least 20 ms
+static double timeCall(Target fn, const Bytes &b)
+{
+  uint64_t calls = 0;
+  Clock::time_point start = Clock::now(), now;
+  do
+  {
+    fn((const uint8_t *)b.data(), b.size());
+    calls++;
+    now = Clock::now();
+  } while (now - start < std::chrono::milliseconds(20));
+  return std::chrono::duration<double, std::nano>(now - start).count() / calls;
+}
+
+static bool readFile(const std::string &path, Bytes &out)
+{
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+  char buf[65536];
+  size_t n;
+  out.clear();
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    out.append(buf, n);
+  fclose(f);
+  return true;
+}
+
+static void corpusThroughput(const char *dir)
+{
+  printf("corpus             inputs      bytes     MB/s  ns/input\n");
+  for (const TargetName &t : TARGETS)
+  {
+    std::string sub = std::string(dir) + "/" + t.name;
+    DIR *d = opendir(sub.c_str());
+    if (!d)
+      continue;
+    std::vector<Bytes> inputs;
+    size_t bytes = 0;
+    while (struct dirent *e = readdir(d))
+    {
+      Bytes b;
+      if (e->d_name[0] != '.' && readFile(sub + "/" + e->d_name, b))
+      {
+        bytes += b.size();
+        inputs.push_back(b);
+      }
+    }
+    closedir(d);
+    if (inputs.empty())
+      continue;
+    uint64_t rounds = 0;
+    Clock::time_point start = Clock::now(), now;
+    do
+    {
+      for (const Bytes &b : inputs)
+        t.fn((const uint8_t *)b.data(), b.size());
+      rounds++;
+      now = Clock::now();
+    } while (now - start < std::chrono::milliseconds(200));
+    double s = std::chrono::duration<double>(now - start).count();
+    printf("%-16s %8zu %10zu %8.1f %9.0f\n", t.name, inputs.size(), bytes, bytes * rounds / s / 1e6,
+           s * 1e9 / (rounds * inputs.size()));
+  }
+  printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+  const char *corpus = nullptr;
+  double maxGrowth = 4;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--corpus") && i + 1 < argc)
+      corpus = argv[++i];
+    else if (!strcmp(argv[i], "--max-growth") && i + 1 < argc)
+      maxGrowth = atof(argv[++i]);
+    else
+    {
+      fprintf(stderr, "usage: bench [--corpus <dir>] [--max-growth <x>]\n");
+      return 2;
+    }
+  }
+  if (corpus)
+    corpusThroughput(corpus);
+
+  int failed = 0;
+  printf("case                          ns/byte at 1/64 .. 1/1 of max len    growth\n");
+  for (const Case &c : CASES)
+  {
+    double perByte[4];
+    for (uint8_t i = 0; i < 4; i++)
+    {
+      Bytes b = c.make(c.maxLen >> (6 - 2 * i));
+      perByte[i] = timeCall(c.fn, b) / b.size();
+    }
+    double growth = perByte[3] / perByte[0];
+    bool bad = growth > maxGrowth;
+    failed += bad;
+    printf("%-28s %8.2f %8.2f %8.2f %8.2f  (%5zu) %6.2f%s\n", c.name, perByte[0], perByte[1], perByte[2], perByte[3],
+           c.maxLen, growth, bad ? "  SUPERLINEAR" : "");
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+// libFuzzer's entry point, one per target; standalone.cpp drives it when
+// libFuzzer is not there (plain runs, AFL)
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// Something the firmware relies on; abort() so every engine reports it
+#define FUZZ_CHECK(cond)                                                       \
+  do                                                                           \
+  {                                                                            \
+    if (!(cond))                                                               \
+    {                                                                          \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      abort();                                                                 \
+    }                                                                          \
+  } while (0)
+
+// The bytes as the firmware's C string would have them: up to the first
+// NUL, like String::c_str()
+inline std::string cString(const uint8_t *data, size_t size)
+{
+  return std::string((const char *)data, strnlen((const char *)data, size));
+}
+
+inline uint32_t le32(const uint8_t *p)
+{
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
@@ -0,0 +1,16 @@
+// The portal's captive DNS: any UDP packet sent to port 53 on the AP
+#include "fuzz.h"
+#include "captive_dns.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  static const uint8_t ip[4] = {192, 168, 4, 1};
+  static uint8_t out[512]; // as in startAP()
+  DnsReply kind;
+  size_t n = captiveDnsReply(data, size, ip, out, sizeof(out), &kind);
+  FUZZ_CHECK(n <= size + 16 && n <= sizeof(out));
+  FUZZ_CHECK((n == 0) == (kind == DNS_IGNORED));
+  if (n)
+    FUZZ_CHECK(out[0] == data[0] && out[1] == data[1] && (out[2] & 0x80)); // same id, a response
+  return 0;
+}
@@ -0,0 +1,40 @@
+// The GPS UART: NMEA for TinyGPSPlus (pumpGPS) with UBX replies mixed in
+// (gps_config.cpp). Input: the byte stream. TinyGPSPlus is built in when
+// the Makefile finds its sources (FUZZ_TINYGPS); the UBX scanner and the
+// fix conversion are always.
+#include "fuzz.h"
+#include "inbound.h"
+#ifdef FUZZ_TINYGPS
+#include <TinyGPSPlus.h>
+#endif
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  UbxScanner ubx;
+  uint8_t buf[40]; // the largest reply gps_config.cpp reads (MON-VER)
+#ifdef FUZZ_TINYGPS
+  TinyGPSPlus gps;
+#endif
+  for (size_t i = 0; i < size; i++)
+  {
+    if (ubx.push(data[i], buf, sizeof(buf)))
+      FUZZ_CHECK(ubx.len <= UBX_FRAME_MAX && i + 1 >= 8u + ubx.len); // sync, header, payload, checksum
+#ifdef FUZZ_TINYGPS
+    gps.encode(data[i]);
+    int32_t latE7, lonE7;
+    if (gps.location.isUpdated() && fixToE7(gps.location.lat(), gps.location.lng(), latE7, lonE7))
+      FUZZ_CHECK(latE7 >= -900000000 && latE7 <= 900000000 && lonE7 >= -1800000000 && lonE7 <= 1800000000);
+#endif
+  }
+  // Whatever degrees a sentence claims
+  if (size >= 16)
+  {
+    double lat, lng;
+    memcpy(&lat, data, 8);
+    memcpy(&lng, data + 8, 8);
+    int32_t latE7, lonE7;
+    if (fixToE7(lat, lng, latE7, lonE7))
+      FUZZ_CHECK(latE7 >= -900000000 && latE7 <= 900000000 && lonE7 >= -1800000000 && lonE7 <= 1800000000);
+  }
+  return 0;
+}
@@ -0,0 +1,264 @@
+// meshReceived(): any packet a node can get over the mesh, as the client
+// and the master take it apart. Input: the sender's node id (4 bytes,
+// little-endian), then the packet.
+#include "fuzz.h"
+#include "inbound.h"
+#include "alert.h"
+#include "runtime_config.h"
+#include "master_ingest.h"
+#include "fragment.h"
+#include "compress.h"
+#include "compress_dict.h"
+#include "aggregate.h"
+
+// A report the client would fragment: split at an MTU taken from the
+// sender id, reassembled in a scrambled order, must come back unchanged
+static void fragmentRoundtrip(uint32_t from, const char *s, size_t len)
+{
+  static FragSender<1, MESH_JSON_MAX> tx;
+  static FragReassembler<1, MESH_JSON_MAX> rx;
+  static FixedString<FRAG_MTU_MAX + 1> lines[FRAG_COUNT_MAX];
+  uint16_t mtu = FRAG_MTU_MIN + from % (FRAG_MTU_MAX - FRAG_MTU_MIN + 1);
+  if (!len || len > MESH_JSON_MAX || !tx.send(from, s, len, mtu, false))
+    return;
+  uint32_t to;
+  uint8_t n = 0;
+  while (n < FRAG_COUNT_MAX && tx.next(0, to, lines[n]))
+  {
+    FUZZ_CHECK(to == from && lines[n].length() <= mtu && !lines[n].truncated());
+    n++;
+  }
+  FUZZ_CHECK(n && !tx.next(0, to, lines[0]));
+  bool done = false;
+  for (uint8_t k = 0; k < n; k++)
+  {
+    uint8_t i = n - 1 - k; // last first: the receiver must cope with any order
+    auto r = rx.push(from, lines[i].c_str() + 4, lines[i].length() - 4, 0);
+    FUZZ_CHECK(r != rx.FRAG_BAD && r != rx.FRAG_BUSY && !done);
+    done = r == rx.FRAG_COMPLETE;
+  }
+  FUZZ_CHECK(done && rx.payloadLength() == len && !memcmp(rx.payload(), s, len));
+  FixedString<32> ack;
+  rx.ack(ack);
+  uint32_t xfer;
+  FUZZ_CHECK(ack.startsWith("FACK:") && parseFragAck(ack.c_str() + 5, xfer));
+  tx.acked(from, xfer);
+  FUZZ_CHECK(tx.idle() && rx.idle());
+}
+
+// A report the client would pack: with and without the dictionary, the
+// Z: line must parse and unpack to the report again
+static void packRoundtrip(const char *s, size_t len)
+{
+  static ZEncoder enc;
+  static FixedString<MESH_JSON_MAX> line;
+  static char text[MESH_JSON_MAX];
+  const ZDict *dicts[] = {&Z_NO_DICT, &ZDICT_REPORTS};
+  if (len > MESH_JSON_MAX)
+    return;
+  for (const ZDict *dict : dicts)
+  {
+    if (!zPackLine(enc, s, len, *dict, line))
+      continue;
+    FUZZ_CHECK(line.length() < len && !line.truncated() && line.startsWith("Z:"));
+    ZLine z = {};
+    FUZZ_CHECK(parseZLine(line.c_str() + 2, line.length() - 2, z) && z.dictId == dict->id);
+    size_t n = zUnpackLine(z, text, sizeof(text), *dict);
+    FUZZ_CHECK(n == len && !memcmp(text, s, len));
+  }
+}
+
+// A report a relay would merge: held with another, the line must parse
+// back to both, in order
+static void aggregateRoundtrip(uint32_t from, const char *s, size_t len)
+{
+  static AggBatch<AGG_LINE_MAX> batch;
+  static FixedString<AGG_LINE_MAX + 1> line;
+  if (!aggIsReport(s, len) || !batch.fits(from, len))
+    return;
+  uint16_t budgetMs = from % (AGG_BUDGET_MAX_MS + 1);
+  uint8_t hops = from % 8;
+  FUZZ_CHECK(batch.add(from, s, len, from, budgetMs, hops));
+  bool both = batch.add(1, "{}", 2, from, 0, 1); // held no longer than its own budget: due at once
+  FUZZ_CHECK(batch.due(from) == (both || budgetMs / (hops ? hops : 1) == 0));
+  batch.take(from + 1, line);
+  FUZZ_CHECK(batch.empty() && !line.truncated() && line.length() <= AGG_LINE_MAX);
+  AggReader r;
+  AggEntry e;
+  uint16_t budget;
+  FUZZ_CHECK(r.begin(line.c_str() + 4, line.length() - 4, budget) && budget <= AGG_BUDGET_MAX_MS);
+  FUZZ_CHECK(r.next(e) && e.from == from && e.len == len && !memcmp(e.data, s, len));
+  if (both)
+    FUZZ_CHECK(r.next(e) && e.from == 1 && e.len == 2 && !memcmp(e.data, "{}", 2));
+  FUZZ_CHECK(!r.next(e) && !r.bad());
+}
+
+// Master: roster, duplicate filter and latency keep their state across
+// inputs, as they would across packets
+static void ingest(uint32_t from, const char *s, size_t len)
+{
+  static uint32_t nowMs;
+  nowMs += 100;
+  RosterEntry &node = ingestTouch(from, nowMs, len, 0);
+  if (ingestReport(node, s, len, nowMs * 1000))
+  {
+    static FixedString<UPLINK_LINE_MAX> line;
+    formatUplink(line, from, s, len);
+    // exactly one line on the uplink, whatever the packet held
+    FUZZ_CHECK(!line.truncated() && line.length() && line.c_str()[line.length() - 1] == '\n');
+    FUZZ_CHECK(!memchr(line.c_str(), '\n', line.length() - 1) && !memchr(line.c_str(), '\r', line.length()));
+  }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  if (size < 4)
+    return 0;
+  uint32_t from = le32(data);
+  std::string msg = cString(data + 4, size - 4);
+  const char *s = msg.c_str();
+  size_t len = msg.size();
+  uint32_t id;
+  const char *text;
+  bool report = false; // falls through to the master's ingest
+  switch (classifyMsg(s))
+  {
+  case MK_MASTER:
+    if (parseMasterAnnounce(s, from, id))
+      FUZZ_CHECK(id && id == from);
+    break;
+  case MK_ALERT:
+  {
+    Alert alert;
+    if (alert.parse(s, true))
+    {
+      FUZZ_CHECK(alert.id && alert.severity <= 3 && alert.ttlS && alert.ttlS <= ALERT_TTL_MAX_S);
+      FUZZ_CHECK(alert.text > s && alert.text <= s + len);
+      const GeoTarget &t = alert.target;
+      FUZZ_CHECK(t.kind != GEO_POLYGON || (t.n >= 3 && t.n <= ALERT_MAX_VERTICES));
+      t.contains(0, 0);
+      t.contains(t.lat[0], t.lon[0]);
+      t.contains(900000000, -1800000000);
+      alert.expired(from);
+    }
+    break;
+  }
+  case MK_ACK:
+  {
+    char state;
+    if (!strncmp(s, "AACK:", 5) && parseAlertAck(s + 5, id, state))
+      FUZZ_CHECK(id);
+    else if (!strncmp(s, "MACK:", 5) && parseDirectAck(s + 5, id))
+      FUZZ_CHECK(id);
+    report = !strncmp(s, "ACK:", 4);
+    break;
+  }
+  case MK_DIRECT:
+    if (parseDirect(s, id, text))
+      FUZZ_CHECK(id && text > s && text <= s + len);
+    break;
+  case MK_FRAG:
+  {
+    // Master: fragments from many senders share the slots, across inputs;
+    // a completed payload goes on as a report
+    static FragReassembler<4, MESH_JSON_MAX> rx;
+    static uint32_t fragMs;
+    uint32_t missing;
+    if (!strncmp(s, "FRG:", 4))
+    {
+      auto r = rx.push(from, s + 4, len - 4, fragMs += 50);
+      if (r == rx.FRAG_COMPLETE)
+      {
+        FUZZ_CHECK(rx.payloadLength() <= MESH_JSON_MAX && strlen(rx.payload()) <= rx.payloadLength());
+        msg.assign(rx.payload(), strnlen(rx.payload(), rx.payloadLength()));
+        s = msg.c_str();
+        len = msg.size();
+        report = true;
+      }
+      FixedString<32> line;
+      if (r == rx.FRAG_NAK || rx.poll(fragMs))
+      {
+        rx.nak(line);
+        FUZZ_CHECK(!line.truncated() && parseFragNak(line.c_str() + 5, id, missing) && missing);
+      }
+    }
+    else if (!strncmp(s, "FNAK:", 5))
+      parseFragNak(s + 5, id, missing);
+    else
+      parseFragAck(s + 5, id);
+    break;
+  }
+  case MK_ZIP:
+  {
+    // Master: a packed report unpacks and goes on; clients: the answer
+    uint16_t dictId;
+    if (!strncmp(s, "ZCAP:", 5))
+      parseZCap(s + 5, dictId);
+    else if (!strncmp(s, "Z:", 2))
+    {
+      size_t n = len;
+      const char *unpacked = ingestUnpack(s, n);
+      if (!unpacked)
+        break;
+      FUZZ_CHECK(n <= MESH_JSON_MAX);
+      msg.assign(unpacked, n);
+      s = msg.c_str();
+      len = msg.size();
+      report = true;
+    }
+    break;
+  }
+  case MK_AGG:
+  {
+    // Relays and the master: every entry lies inside the line and is a
+    // report, which the master takes in as if it had come alone
+    AggReader r;
+    AggEntry e;
+    uint16_t budget;
+    bool valid = len > 4 && !strncmp(s, "AGG:", 4) && aggValid(s + 4, len - 4);
+    if (!valid || !r.begin(s + 4, len - 4, budget))
+      break;
+    FUZZ_CHECK(budget <= AGG_BUDGET_MAX_MS);
+    uint8_t n = 0;
+    while (r.next(e))
+    {
+      FUZZ_CHECK(e.from && e.len && e.data > s && e.data + e.len <= s + len && ++n <= AGG_ENTRIES_MAX);
+      MsgKind kind = classifyMsg(std::string(e.data, e.len).c_str());
+      FUZZ_CHECK(kind == MK_DATA || (kind == MK_ZIP && !strncmp(e.data, "Z:", 2)));
+      size_t n = e.len;
+      const char *report = ingestUnpack(e.data, n);
+      if (report)
+        ingest(e.from, report, n);
+    }
+    FUZZ_CHECK(n && !r.bad());
+    break;
+  }
+  case MK_DATA:
+    if (strncmp(s, "CFG:", 4))
+    {
+      report = true;
+      break;
+    }
+    {
+      // Clients: "CFG:<key>=<value>" from the master
+      char key[24];
+      const char *value = splitKeyValue(s + 4, '=', key, sizeof(key));
+      const ConfigField *f = value ? configFind(key) : nullptr;
+      static RuntimeConfig next;
+      configDefaults(next);
+      static char json[CONFIG_JSON_MAX];
+      if (f && configParse(next, *f, value))
+        FUZZ_CHECK(configWriteJson(next, json, sizeof(json))); // "!cfg" must still print it
+    }
+    break;
+  default:
+    break;
+  }
+  if (!report)
+    return 0;
+  fragmentRoundtrip(from, s, len);
+  packRoundtrip(s, len);
+  aggregateRoundtrip(from, s, len);
+  ingest(from, s, len);
+  return 0;
+}
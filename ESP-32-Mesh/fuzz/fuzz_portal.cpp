@@ -0,0 +1,90 @@
+// The portal's handlers: query args and the /provision body, as a phone
+// on the AP can send them. Input: one selector byte, then the arg or body;
+// POST /config takes "<key>\0<value>".
+#include "fuzz.h"
+#include "inbound.h"
+#include "mesh_msg.h"
+#include "profile.h"
+#include "runtime_config.h"
+
+enum PortalTarget : uint8_t
+{
+  PT_SUBMIT,    // /submit?msg=
+  PT_USERID,    // /setup?userid=
+  PT_CONFIG,    // POST /config, key=&value=
+  PT_PROVISION, // POST /provision, JSON
+  PT_PROVISION_TLV,
+  PT_COUNT
+};
+
+static void submit(const char *s, size_t len)
+{
+  if (!portalMessageValid(s, len, USER_MSG_MAX))
+    return;
+  static FixedString<6 * USER_MSG_MAX + 96> page; // as handleSubmit builds it
+  page = "<p>";
+  FUZZ_CHECK(appendHtml(page, s, len));
+  // the echo is text: no markup from the message survives
+  FUZZ_CHECK(!strpbrk(page.c_str() + 3, "<>\"'"));
+}
+
+static void provision(const uint8_t *data, size_t size, bool binary)
+{
+  if (size > PROVISION_BODY_MAX)
+    return; // the handler refuses longer bodies before parsing
+  static char body[PROVISION_BODY_MAX + 1];
+  memcpy(body, data, size);
+  body[size] = 0;
+  Profile base;
+  ProvisionRequest req;
+  const char *err;
+  if (!parseProvision(body, size, binary, base, req, err))
+  {
+    FUZZ_CHECK(err && *err);
+    return;
+  }
+  FUZZ_CHECK(profileValidUserId(req.profile.userId, strlen(req.profile.userId)));
+  FUZZ_CHECK(req.messages <= PROVISION_MSGS_MAX);
+  for (uint8_t i = 0; i < req.messages; i++)
+    FUZZ_CHECK(req.msgLen[i] && req.msgLen[i] <= PROVISION_MSG_MAX);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  if (!size)
+    return 0;
+  uint8_t target = data[0] % PT_COUNT;
+  data++;
+  size--;
+  std::string arg = cString(data, size);
+  switch (target)
+  {
+  case PT_SUBMIT:
+    submit(arg.c_str(), arg.size());
+    break;
+  case PT_USERID:
+    if (profileValidUserId(arg.c_str(), arg.size()))
+      FUZZ_CHECK(arg.size() <= PROFILE_USERID_MAX && !strchr(arg.c_str(), ':'));
+    break;
+  case PT_CONFIG:
+  {
+    size_t k = arg.size();
+    std::string value = k < size ? cString(data + k + 1, size - k - 1) : std::string();
+    const ConfigField *f = configFind(arg.c_str());
+    if (f && (f->flags & CFG_REBOOT))
+      break; // credentials and pins: serial only
+    FUZZ_CHECK(!f || !(f->flags & CFG_SECRET));
+    static RuntimeConfig next;
+    configDefaults(next);
+    static char json[CONFIG_JSON_MAX];
+    if (f && configParse(next, *f, value.c_str()))
+      FUZZ_CHECK(configWriteJson(next, json, sizeof(json)));
+    break;
+  }
+  case PT_PROVISION:
+  case PT_PROVISION_TLV:
+    provision(data, size, target == PT_PROVISION_TLV);
+    break;
+  }
+  return 0;
+}
@@ -0,0 +1,93 @@
+// pollSerialBridge(): the gateway's side of the master's UART. Input: raw
+// bytes as they arrive, cut into lines and dispatched like the firmware
+// does, minus the sends.
+#include "fuzz.h"
+#include "inbound.h"
+#include "alert.h"
+#include "mesh_msg.h"
+#include "profile.h"
+#include "runtime_config.h"
+
+// "!cfg set|mesh <key> <value>"
+static void configCommand(const char *args)
+{
+  while (*args == ' ')
+    args++;
+  bool mesh = !strncmp(args, "mesh ", 5);
+  if (!mesh && strncmp(args, "set ", 4))
+    return;
+  args += mesh ? 5 : 4;
+  char key[24];
+  const char *value = splitKeyValue(args, ' ', key, sizeof(key));
+  const ConfigField *f = value ? configFind(key) : nullptr;
+  static RuntimeConfig next;
+  configDefaults(next);
+  if (f && configParse(next, *f, value) && mesh)
+  {
+    // what the master forwards must come back out of the client's "CFG:" split
+    FixedString<MESH_MSG_TEXT_MAX> out;
+    out.appendf("CFG:%s=%s", key, value);
+    char key2[24];
+    const char *value2 = out.truncated() ? nullptr : splitKeyValue(out.c_str() + 4, '=', key2, sizeof(key2));
+    FUZZ_CHECK(out.truncated() || (value2 && !strcmp(key, key2) && !strcmp(value, value2)));
+  }
+}
+
+// "ALERT:..." from the gateway: the master stamps it and broadcasts it;
+// every client must read the same alert back
+static void alertLine(const char *line)
+{
+  Alert alert;
+  if (!alert.parse(line, false))
+    return;
+  FixedString<SERIAL_LINE_MAX + 16> out;
+  out.append(line, alert.targetStart - line);
+  out.appendf("%u:", 123456789u);
+  out.append(alert.targetStart);
+  FUZZ_CHECK(!out.truncated());
+  Alert back;
+  FUZZ_CHECK(back.parse(out.c_str(), true));
+  FUZZ_CHECK(back.id == alert.id && back.severity == alert.severity && back.ttlS == alert.ttlS);
+  FUZZ_CHECK(back.issuedUs == 123456789u && !strcmp(back.text, alert.text));
+}
+
+// "TO:<id>:<userid>:<text>"
+static void directLine(const char *line)
+{
+  uint32_t id;
+  char userId[PROFILE_USERID_MAX + 1];
+  const char *text;
+  if (!parseDirectRequest(line, id, userId, PROFILE_USERID_MAX, text))
+    return;
+  FUZZ_CHECK(id && strlen(userId) <= PROFILE_USERID_MAX && !strchr(userId, ':'));
+  if (!profileValidUserId(userId, strlen(userId)))
+    return;
+  FixedString<MESH_MSG_TEXT_MAX + 16> msg; // as DirectPending holds it
+  msg.appendf("MSG:%x:", id);
+  msg.append(text);
+  uint32_t back;
+  const char *body;
+  FUZZ_CHECK(parseDirect(msg.c_str(), back, body) && back == id);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  LineAssembler<SERIAL_LINE_MAX> lines;
+  for (size_t i = 0; i < size; i++)
+  {
+    if (!lines.push(data[i]))
+      continue;
+    const FixedString<SERIAL_LINE_MAX> &line = lines.line();
+    for (size_t k = 0; k < line.length(); k++)
+      FUZZ_CHECK(line.c_str()[k] >= 32 && line.c_str()[k] <= 126);
+    if (line.startsWith("!cfg"))
+      configCommand(line.c_str() + 4);
+    else if (line.startsWith("ALERT:"))
+      alertLine(line.c_str());
+    else if (line.startsWith("TO:"))
+      directLine(line.c_str());
+    else
+      classifyMsg(line.c_str());
+  }
+  return 0;
+}
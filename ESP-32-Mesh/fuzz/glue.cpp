@@ -0,0 +1,6 @@
+// Firmware symbols the linked sources expect from main_testing.cpp
+#include "metrics.h"
+#include "log.h"
+
+Counter dedupeDropped, zRefused;
+void logCommit(LogRecord &) {} // no log sink on the host
@@ -0,0 +1,68 @@
+#pragma once
+// Just enough of the Arduino core for the firmware sources the fuzz
+// targets link (profile.cpp, runtime_config.cpp), for TinyGPSPlus and for
+// gps_config.cpp in test_gps
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+
+typedef uint8_t byte;
+
+#define TWO_PI 6.283185307179586476925286766559
+#define radians(deg) ((deg) * (M_PI / 180))
+#define degrees(rad) ((rad) * (180 / M_PI))
+#define sq(x) ((x) * (x))
+
+// Fixed, so every run of an input takes the same path. Only test_gps
+// moves it, through vTaskDelay().
+inline unsigned long hostMillis = 0;
+inline unsigned long millis() { return hostMillis; }
+#define portTICK_PERIOD_MS 1
+inline void vTaskDelay(uint32_t ticks) { hostMillis += ticks * portTICK_PERIOD_MS; }
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t *buf, size_t n)
+  {
+    size_t w = 0;
+    while (n--)
+      w += write(*buf++);
+    return w;
+  }
+};
+
+// Virtual here, unlike on the ESP32, so a test can stand a module behind it
+#define SERIAL_8N1 0x800001c
+class HardwareSerial : public Print
+{
+public:
+  virtual void begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin) = 0;
+  virtual void updateBaudRate(unsigned long baud) = 0;
+  virtual uint32_t baudRate() = 0;
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual void flush() {}
+  using Print::write;
+};
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+inline size_t strlcpy(char *dst, const char *src, size_t size)
+{
+  size_t n = strlen(src);
+  if (size)
+  {
+    size_t k = n < size - 1 ? n : size - 1;
+    memcpy(dst, src, k);
+    dst[k] = 0;
+  }
+  return n;
+}
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+#include <Arduino.h>
+
+// Stand-in for when the Makefile does not find TinyGPSPlus: what
+// gps_config.cpp calls, never holding a fix, so test_gps still links
+struct TinyGPSLocation
+{
+  bool isValid() const { return false; }
+  uint32_t age() const { return 0; }
+  double lat() { return 0; }
+  double lng() { return 0; }
+};
+struct TinyGPSDate
+{
+  bool isValid() const { return false; }
+  uint16_t year() { return 0; }
+  uint8_t month() { return 0; }
+  uint8_t day() { return 0; }
+};
+struct TinyGPSTime
+{
+  bool isValid() const { return false; }
+  uint8_t hour() { return 0; }
+  uint8_t minute() { return 0; }
+  uint8_t second() { return 0; }
+};
+struct TinyGPSAltitude
+{
+  bool isValid() const { return false; }
+  double meters() { return 0; }
+};
+class TinyGPSPlus
+{
+public:
+  TinyGPSLocation location;
+  TinyGPSDate date;
+  TinyGPSTime time;
+  TinyGPSAltitude altitude;
+};
@@ -0,0 +1,190 @@
+"""Seed corpora for the fuzz targets: one directory per target, one file
+per input, named by content hash (the libFuzzer convention).
+
+    seed_corpus.py <out dir> [capture...]
+
+Captures are what the master printed on its uplink, in any form the
+replay tool reads: "[MASTER] RX from <id>: <packet>" lines, bare client
+reports (serial_python/data.json), or raw dumps with binary frames mixed
+in. Each packet becomes a mesh input from its sender. Hand-written inputs
+cover every line format the other targets take.
+"""
+import hashlib
+import os
+import re
+import struct
+import sys
+
+RX_LINE = re.compile(rb"^\[MASTER\] RX from (\d+): (.*)$")
+MAC = re.compile(rb'"(?:device_id|mac)":"([0-9A-Fa-f]{2}(?::[0-9A-Fa-f]{2}){5})"')
+
+NODE = 0x5934AC01
+MASTER = 0x58DCE401
+REPORT = (b'{"device_id":"04:83:08:59:34:AC","status":"active","userid":"USER_001","sensors":{"gps":'
+          b'{"latitude":42.3806473,"longitude":-71.1249041}},"message":"help","boot":12345,"seq":7,'
+          b'"ts":[1000000,1200000,1300000],"sos":true}')
+
+
+def z_line(text):
+    """A Z: line without a dictionary (include/compress.h): literals, and
+    copies of 3 to 18 bytes from up to 512 back, greedily"""
+    bits, i = "", 0
+    while i < len(text):
+        best, dist = 0, 0
+        for j in range(max(0, i - 512), i):
+            n = 0
+            while n < 18 and i + n < len(text) and text[j + n] == text[i + n]:
+                n += 1
+            if n > best:
+                best, dist = n, i - j
+        if best >= 3:
+            bits += "0" + format(dist - 1, "09b") + format(best - 3, "04b")
+            i += best
+        else:
+            bits += "1" + format(text[i], "08b")
+            i += 1
+    bits += "0" * (-len(bits) % 6)
+    digits = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"
+    data = "".join(digits[int(bits[k:k + 6], 2)] for k in range(0, len(bits), 6))
+    return b"Z:0:%d:%s" % (len(text), data.encode())
+
+
+MESH = [
+    b"WHO_IS_MASTER?",
+    b"MASTER:%d" % MASTER,
+    b"ALERT:1a2b:2:600:123456789:*:Evacuate now",
+    b"ALERT:1a2b:3:600:123456789:C423806473,-711249041,500:Flood at the river",
+    b"ALERT:7:1:60:5:P423800000,-711300000,423900000,-711300000,423900000,-711200000:Zone",
+    b"ALERT:legacy text",
+    b"AACK:1a2b:c",
+    b"MACK:3f",
+    b"MSG:3f:Stay where you are",
+    b"CFG:sendPeriodMs=3000",
+    b"CFG:meshPrefix=ResQMe_Net",
+    b"ACK:{}",
+    b"FRG:1f:0:2:9:hello",
+    b"FRG:1f:1:2:9: you",
+    b"FRG:20:2:3:7:x",
+    b"FACK:1f",
+    b"FNAK:20:3",
+    b"ZCAP?",
+    b"ZCAP:7fe2",
+    z_line(REPORT),
+    z_line(b"help help help help"),
+    b"AGG?",
+    b"AGG!",
+    b"AGG:150:%x:%d:%s%x:9:ALERT:bad" % (NODE + 1, len(REPORT), REPORT, NODE + 2),
+    b"AGG:0:%x:%d:%s" % (NODE + 3, len(z_line(REPORT)), z_line(REPORT)),
+    REPORT,
+]
+SERIAL = [
+    b"ALERT:1a2b:2:600:*:Evacuate now\n",
+    b"ALERT:1a2b:3:600:C423806473,-711249041,500:Flood at the river\n",
+    b"ALERT:7:1:60:P423800000,-711300000,423900000,-711300000,423900000,-711200000:Zone\n",
+    b"TO:3f:USER_001:Stay where you are\n",
+    b"!cfg\n!cfg set sendPeriodMs 3000\n!cfg mesh alertDisplayMs 20000\n",
+    b"!metrics\n!roster\n!latency\n!health\n!trace\n",
+    b"WHO_IS_MASTER?\nplain text for every node\n",
+]
+PORTAL = [
+    b"\x00I need help at the north gate",
+    b"\x01USER_001",
+    b"\x01123e4567-e89b-12d3-a456-426614174000",
+    b"\x02sendPeriodMs\x002000",
+    b"\x02apPass\x0012345678",
+    b'\x03{"userid":"USER_001","contact":{"name":"Ana","phone":"+1 555-0100"},"medical":5,'
+    b'"messages":["on my way","ok"]}',
+    b"\x04\x01\x08USER_001\x02\x03Ana\x03\x0b+1 555-0100\x04\x02\x05\x00\x05\x02ok",
+]
+
+
+def dns_query(name, qtype, edns=False):
+    q = struct.pack(">HHHHHH", 0x1234, 0x0100, 1, 0, 0, 1 if edns else 0)
+    for label in name.split("."):
+        q += bytes([len(label)]) + label.encode()
+    q += b"\x00" + struct.pack(">HH", qtype, 1)
+    if edns:
+        q += b"\x00" + struct.pack(">HHIH", 41, 1232, 0, 0)
+    return q
+
+
+DNS = [
+    dns_query("connectivitycheck.gstatic.com", 1),
+    dns_query("captive.apple.com", 28),
+    dns_query("www.msftconnecttest.com", 255, edns=True),
+]
+
+
+def ubx(cls, msg_id, payload):
+    body = bytes([cls, msg_id]) + struct.pack("<H", len(payload)) + payload
+    ck_a = ck_b = 0
+    for c in body:
+        ck_a = (ck_a + c) & 0xFF
+        ck_b = (ck_b + ck_a) & 0xFF
+    return b"\xb5\x62" + body + bytes([ck_a, ck_b])
+
+
+def nmea(sentence):
+    ck = 0
+    for c in sentence.encode():
+        ck ^= c
+    return b"$%s*%02X\r\n" % (sentence.encode(), ck)
+
+
+GPS = [
+    nmea("GPGGA,123519,4222.8388,N,07107.4943,W,1,06,1.42,12.0,M,-33.0,M,,")
+    + nmea("GPRMC,123519,A,4222.8388,N,07107.4943,W,0.5,54.7,191026,,,A"),
+    ubx(0x05, 0x01, b"\x06\x08") + nmea("GPGGA,,,,,,0,00,99.99,,,,,,"),
+    ubx(0x0A, 0x04, b"ROM CORE 3.01 (107888)\x00\x00\x00\x00\x00\x00\x00\x0000080000\x00\x00"),
+]
+
+
+def mesh_input(node, packet):
+    return struct.pack("<I", node & 0xFFFFFFFF) + packet
+
+
+def capture_packets(path):
+    """(node id, packet) for each packet line in a capture"""
+    with open(path, "rb") as f:
+        data = f.read()
+    for line in data.split(b"\n"):
+        line = line.rstrip(b"\r ")
+        m = RX_LINE.match(line)
+        if m:
+            yield int(m.group(1)), m.group(2)
+            continue
+        m = MAC.search(line) if line.startswith(b"{") else None
+        if m:
+            mac = bytes.fromhex(m.group(1).decode().replace(":", ""))
+            yield int.from_bytes(mac[2:], "big"), line  # painlessMesh: the last four bytes
+
+
+def write(out_dir, target, inputs):
+    path = os.path.join(out_dir, target)
+    os.makedirs(path, exist_ok=True)
+    names = set()
+    for data in inputs:
+        name = hashlib.sha1(data).hexdigest()
+        names.add(name)
+        with open(os.path.join(path, name), "wb") as f:
+            f.write(data)
+    print(f"{target}: {len(names)} inputs")
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("usage: seed_corpus.py <out dir> [capture...]")
+        sys.exit(2)
+    out_dir = sys.argv[1]
+    mesh = [mesh_input(MASTER if p.startswith(b"MASTER:") else NODE, p) for p in MESH]
+    for path in sys.argv[2:]:
+        mesh += [mesh_input(node, packet) for node, packet in capture_packets(path)]
+    write(out_dir, "mesh", mesh)
+    write(out_dir, "serial", SERIAL)
+    write(out_dir, "portal", PORTAL)
+    write(out_dir, "dns", DNS)
+    write(out_dir, "gps", GPS)
+
+
+if __name__ == "__main__":
+    main()
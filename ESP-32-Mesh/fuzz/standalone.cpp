@@ -0,0 +1,229 @@
+// Runs a fuzz target where libFuzzer is not available:
+//
+//   fuzz_x <file|dir>...              every input once (a corpus, a crash file)
+//   fuzz_x                            one input from stdin, for AFL:
+//                                       afl-fuzz -i corpus/x -o out -- ./fuzz_x
+//   fuzz_x -runs=N [-max_len=L] [-seed=S] <dir>...
+//                                     N random mutations of the inputs in <dir>
+//
+// The flags are spelled as libFuzzer's. On a crash or failed check the
+// input is written to crash-<target>, for a rerun under a debugger.
+#include "fuzz.h"
+#include <dirent.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+typedef std::vector<uint8_t> Bytes;
+
+static const Bytes *current;
+static char crashPath[256] = "crash-input";
+
+// Async-signal-safe: open/write/close only
+static void saveCurrent()
+{
+  if (!current)
+    return;
+  int fd = open(crashPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return;
+  bool ok = write(fd, current->data(), current->size()) == (ssize_t)current->size();
+  close(fd);
+  static const char msg[] = "standalone: input saved to the crash file\n";
+  if (ok)
+    (void)!write(2, msg, sizeof(msg) - 1);
+}
+
+static void onSignal(int sig)
+{
+  saveCurrent();
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+// Sanitizers report through this before they exit
+extern "C" void __sanitizer_set_death_callback(void (*)(void)) __attribute__((weak));
+
+static bool readFile(const char *path, Bytes &out)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+  uint8_t buf[65536];
+  size_t n;
+  out.clear();
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    out.insert(out.end(), buf, buf + n);
+  bool ok = !ferror(f);
+  fclose(f);
+  return ok;
+}
+
+// Files under `path`, one level deep, as a corpus directory is
+static void collect(const char *path, std::vector<Bytes> &inputs)
+{
+  struct stat st;
+  if (stat(path, &st))
+  {
+    fprintf(stderr, "standalone: cannot read %s\n", path);
+    exit(2);
+  }
+  if (!S_ISDIR(st.st_mode))
+  {
+    inputs.emplace_back();
+    if (!readFile(path, inputs.back()))
+      exit(2);
+    return;
+  }
+  DIR *d = opendir(path);
+  while (struct dirent *e = d ? readdir(d) : nullptr)
+  {
+    if (e->d_name[0] == '.')
+      continue;
+    std::string file = std::string(path) + "/" + e->d_name;
+    inputs.emplace_back();
+    if (!readFile(file.c_str(), inputs.back()))
+      inputs.pop_back();
+  }
+  if (d)
+    closedir(d);
+}
+
+// Bytes the parsers branch on
+static const uint8_t DICT[] = {':', ',', '\n', '\r', '\0', '=', ' ', '"', '{', '}', '[', ']', '-', '0', '9',
+                               'f', 'x', '*', '$', '<', '&', 0x7F, 0xB5, 0x62, 0xFF};
+
+static void mutate(Bytes &b, const std::vector<Bytes> &corpus, std::mt19937 &rng, size_t maxLen)
+{
+  uint32_t ops = 1 + rng() % 8;
+  for (uint32_t i = 0; i < ops; i++)
+  {
+    size_t at = b.empty() ? 0 : rng() % (b.size() + 1);
+    switch (rng() % 7)
+    {
+    case 0: // flip a bit
+      if (!b.empty())
+        b[at % b.size()] ^= 1 << rng() % 8;
+      break;
+    case 1: // any byte
+      if (!b.empty())
+        b[at % b.size()] = rng();
+      break;
+    case 2: // an interesting byte
+      b.insert(b.begin() + at, DICT[rng() % sizeof(DICT)]);
+      break;
+    case 3: // drop a run
+      if (!b.empty())
+      {
+        size_t from = at % b.size(), n = 1 + rng() % (b.size() - from);
+        b.erase(b.begin() + from, b.begin() + from + n);
+      }
+      break;
+    case 4: // repeat a run: long fields, long lines
+      if (!b.empty())
+      {
+        size_t from = at % b.size(), n = 1 + rng() % std::min<size_t>(b.size() - from, 16);
+        Bytes run(b.begin() + from, b.begin() + from + n);
+        for (uint32_t k = rng() % 64; k; k--)
+          b.insert(b.begin() + from, run.begin(), run.end());
+      }
+      break;
+    case 5: // splice in part of another input
+      if (!corpus.empty())
+      {
+        const Bytes &o = corpus[rng() % corpus.size()];
+        if (!o.empty())
+        {
+          size_t from = rng() % o.size(), n = 1 + rng() % (o.size() - from);
+          b.insert(b.begin() + at, o.begin() + from, o.begin() + from + n);
+        }
+      }
+      break;
+    default: // a number at its limits
+    {
+      static const char *const NUMS[] = {"0", "4294967295", "4294967296", "-1", "2147483648", "99999999999999999999"};
+      const char *n = NUMS[rng() % 6];
+      b.insert(b.begin() + at, n, n + strlen(n));
+    }
+    }
+  }
+  if (b.size() > maxLen)
+    b.resize(maxLen);
+}
+
+static void run(const Bytes &b)
+{
+  current = &b;
+  LLVMFuzzerTestOneInput(b.data(), b.size());
+  current = nullptr;
+}
+
+int main(int argc, char **argv)
+{
+  const char *name = strrchr(argv[0], '/');
+  snprintf(crashPath, sizeof(crashPath), "crash-%s", name ? name + 1 : argv[0]);
+  signal(SIGABRT, onSignal); // failed FUZZ_CHECKs
+  if (__sanitizer_set_death_callback)
+    __sanitizer_set_death_callback(saveCurrent); // the sanitizer keeps its own crash handlers
+  else
+  {
+    signal(SIGSEGV, onSignal);
+    signal(SIGBUS, onSignal);
+    signal(SIGFPE, onSignal);
+  }
+
+  uint64_t runs = 0;
+  size_t maxLen = 4096;
+  uint32_t seed = 1;
+  std::vector<Bytes> inputs;
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    if (!strncmp(a, "-runs=", 6))
+      runs = strtoull(a + 6, nullptr, 10);
+    else if (!strncmp(a, "-max_len=", 9))
+      maxLen = strtoul(a + 9, nullptr, 10);
+    else if (!strncmp(a, "-seed=", 6))
+      seed = strtoul(a + 6, nullptr, 10);
+    else if (a[0] == '-')
+    {
+      fprintf(stderr, "usage: %s [-runs=N] [-max_len=L] [-seed=S] [file|dir]...\n", argv[0]);
+      return 2;
+    }
+    else
+      collect(a, inputs);
+  }
+  if (argc == 1)
+  {
+    inputs.emplace_back();
+    uint8_t buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), stdin)) > 0)
+      inputs.back().insert(inputs.back().end(), buf, buf + n);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  uint64_t bytes = 0;
+  for (const Bytes &b : inputs)
+  {
+    run(b);
+    bytes += b.size();
+  }
+  std::mt19937 rng(seed);
+  Bytes b;
+  for (uint64_t i = 0; i < runs; i++)
+  {
+    b = inputs.empty() ? Bytes() : inputs[rng() % inputs.size()];
+    mutate(b, inputs, rng, maxLen);
+    run(b);
+    bytes += b.size();
+  }
+  double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("%s: %zu inputs, %llu mutations, %llu bytes in %.2f s\n", name ? name + 1 : argv[0], inputs.size(),
+         (unsigned long long)runs, (unsigned long long)bytes, s);
+  return 0;
+}
@@ -0,0 +1,250 @@
+// configureGPS() (gps_config.cpp) against a simulated module behind the
+// host HardwareSerial: a u-blox 6 from power-up, an M8 left at the fast
+// baud by an ESP-only reset, and a plain NMEA module. Checks every frame
+// the firmware writes byte for byte (checksums included) against frames
+// worked out by hand, the order and baud rate they go at, what the module
+// ends up configured to, and prints the NMEA bytes per second the UART
+// and TinyGPSPlus take before and after.
+//
+//   make test && ./test_gps
+#include "fuzz.h"
+#include "gps_config.h"
+#include <deque>
+#include <set>
+#include <vector>
+
+// UBX frames as configureGPS must send them (u-blox 6/M8 receiver
+// description: sync B5 62, class, id, length LE, payload, Fletcher-8)
+static const std::vector<uint8_t> MON_VER_POLL = {0xB5, 0x62, 0x0A, 0x04, 0x00, 0x00, 0x0E, 0x34};
+static const std::vector<uint8_t> CFG_PRT_38400 = {0xB5, 0x62, 0x06, 0x00, 0x14, 0x00, 0x01, 0x00, 0x00, 0x00,
+                                                   0xD0, 0x08, 0x00, 0x00, 0x00, 0x96, 0x00, 0x00, 0x03, 0x00,
+                                                   0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x8F, 0x70};
+static const std::vector<uint8_t> CFG_RATE_500 = {0xB5, 0x62, 0x06, 0x08, 0x06, 0x00, 0xF4,
+                                                  0x01, 0x01, 0x00, 0x01, 0x00, 0x0B, 0x77};
+static const std::vector<uint8_t> CFG_MSG_OFF[] = {
+    {0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0xF0, 0x01, 0x00, 0xFB, 0x11}, // GLL
+    {0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0xF0, 0x02, 0x00, 0xFC, 0x13}, // GSA
+    {0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0xF0, 0x03, 0x00, 0xFD, 0x15}, // GSV
+    {0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0xF0, 0x05, 0x00, 0xFF, 0x19}, // VTG
+};
+
+// One second of a default u-blox 6 at 1 Hz, by NMEA id (class 0xF0)
+struct Sentence
+{
+  uint8_t id;
+  const char *text;
+};
+static const Sentence NMEA[] = {
+    {0x00, "$GPGGA,092725.00,4717.11399,N,00833.91590,E,1,08,1.01,499.6,M,48.0,M,,*5B\r\n"},
+    {0x01, "$GPGLL,4717.11364,N,00833.91565,E,092321.00,A,A*60\r\n"},
+    {0x02, "$GPGSA,A,3,23,29,07,08,09,18,26,28,,,,,1.94,1.18,1.54*0D\r\n"},
+    {0x03, "$GPGSV,3,1,10,23,38,230,44,29,71,156,47,07,29,116,41,08,09,081,36*7F\r\n"},
+    {0x03, "$GPGSV,3,2,10,10,07,189,,05,05,220,,09,34,274,42,18,25,309,44*72\r\n"},
+    {0x03, "$GPGSV,3,3,10,26,82,187,47,28,43,056,46*77\r\n"},
+    {0x04, "$GPRMC,083559.00,A,4717.11437,N,00833.91522,E,0.004,77.52,091202,,,A*57\r\n"},
+    {0x05, "$GPVTG,77.52,T,,M,0.004,N,0.008,K,A*06\r\n"},
+};
+
+class Module : public HardwareSerial
+{
+public:
+  enum Kind
+  {
+    NMEA_ONLY,
+    UBLOX6,
+    UBLOX8
+  };
+  struct Frame
+  {
+    std::vector<uint8_t> bytes;
+    uint32_t baud; // the port's when it was written
+  };
+
+  Module(Kind kind, uint32_t baud) : kind_(kind), baud_(baud) {}
+
+  void begin(unsigned long baud, uint32_t, int8_t, int8_t) override { portBaud_ = baud; }
+  void updateBaudRate(unsigned long baud) override { portBaud_ = baud; }
+  uint32_t baudRate() override { return portBaud_; }
+  int available() override { return rx_.size(); }
+  int read() override
+  {
+    if (rx_.empty())
+      return -1;
+    uint8_t b = rx_.front();
+    rx_.pop_front();
+    return b;
+  }
+  size_t write(uint8_t b) override
+  {
+    tx_.push_back(b);
+    if (tx_.size() == 1 && b != 0xB5)
+      FUZZ_CHECK(!"stray byte between frames");
+    if (tx_.size() < 6 || tx_.size() < 8u + (tx_[4] | tx_[5] << 8))
+      return 1;
+    frames.push_back({tx_, portBaud_});
+    received(tx_);
+    tx_.clear();
+    return 1;
+  }
+  using Print::write;
+
+  uint32_t baud() const { return baud_; }
+  uint16_t rateMs() const { return rateMs_; }
+  // NMEA bytes per second the module sends as configured
+  uint32_t nmeaBytesPerS() const
+  {
+    uint32_t n = 0;
+    for (const Sentence &s : NMEA)
+      n += off_.count(s.id) ? 0 : strlen(s.text);
+    return n * 1000 / rateMs_;
+  }
+
+  std::vector<Frame> frames;
+
+private:
+  Kind kind_;
+  uint32_t baud_, portBaud_ = 0;
+  uint16_t rateMs_ = 1000;
+  std::set<uint8_t> off_;
+  std::vector<uint8_t> tx_;
+  std::deque<uint8_t> rx_;
+
+  // Fletcher-8 over class, id, length and payload, worked out apart from ubxSend
+  static bool checksumOk(const std::vector<uint8_t> &f)
+  {
+    uint8_t a = 0, b = 0;
+    for (size_t i = 2; i < f.size() - 2; i++)
+    {
+      a += f[i];
+      b += a;
+    }
+    return f[f.size() - 2] == a && f[f.size() - 1] == b;
+  }
+  void reply(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len)
+  {
+    // Replies arrive between NMEA sentences, as from a real module
+    for (const char *c = NMEA[0].text; *c; c++)
+      rx_.push_back(*c);
+    uint8_t a = 0, b = 0;
+    uint8_t head[4] = {cls, id, (uint8_t)len, (uint8_t)(len >> 8)};
+    rx_.push_back(0xB5);
+    rx_.push_back(0x62);
+    for (uint16_t i = 0; i < 4 + len; i++)
+    {
+      uint8_t v = i < 4 ? head[i] : payload[i - 4];
+      rx_.push_back(v);
+      a += v;
+      b += a;
+    }
+    rx_.push_back(a);
+    rx_.push_back(b);
+  }
+  void received(const std::vector<uint8_t> &f)
+  {
+    FUZZ_CHECK(checksumOk(f));
+    if (kind_ == NMEA_ONLY || portBaud_ != baud_)
+      return; // not understood, or line noise at the wrong baud
+    uint8_t cls = f[2], id = f[3];
+    const uint8_t *p = f.data() + 6;
+    uint16_t len = f[4] | f[5] << 8;
+    uint8_t ack[2] = {cls, id};
+    if (cls == 0x0A && id == 0x04 && !len)
+    {
+      uint8_t ver[40] = "7.03 (45969)";
+      memcpy(ver + 30, kind_ == UBLOX6 ? "00040007" : "00080000", 8);
+      reply(0x0A, 0x04, ver, sizeof(ver));
+    }
+    else if (cls == 0x06 && id == 0x00 && len == 20)
+      baud_ = p[8] | p[9] << 8 | p[10] << 16 | (uint32_t)p[11] << 24; // switches without an ACK at the old baud
+    else if (cls == 0x06 && id == 0x08 && len == 6)
+    {
+      rateMs_ = p[0] | p[1] << 8;
+      reply(0x05, 0x01, ack, 2);
+    }
+    else if (cls == 0x06 && id == 0x01 && len == 3 && p[0] == 0xF0)
+    {
+      if (p[2])
+        off_.erase(p[1]);
+      else
+        off_.insert(p[1]);
+      reply(0x05, 0x01, ack, 2);
+    }
+    else
+      reply(0x05, 0x00, ack, 2);
+  }
+};
+
+static void expectFrames(const Module &m, const std::vector<std::pair<std::vector<uint8_t>, uint32_t>> &want)
+{
+  FUZZ_CHECK(m.frames.size() == want.size());
+  for (size_t i = 0; i < want.size(); i++)
+  {
+    if (m.frames[i].bytes != want[i].first || m.frames[i].baud != want[i].second)
+    {
+      fprintf(stderr, "frame %zu differs:", i);
+      for (uint8_t b : m.frames[i].bytes)
+        fprintf(stderr, " %02X", b);
+      fprintf(stderr, " at %u baud\n", m.frames[i].baud);
+      abort();
+    }
+  }
+}
+
+static void report(const char *name, const Module &m, uint32_t beforeBytesPerS, uint32_t beforeBaud)
+{
+  uint32_t after = m.nmeaBytesPerS();
+  printf("%-30s %2zu frames, %5lu ms; NMEA %3u B/s (%4.1f%% of %5u baud) -> %3u B/s (%4.1f%% of %5u baud), "
+         "%3u -> %3u bytes per fix\n",
+         name, m.frames.size(), hostMillis, beforeBytesPerS, beforeBytesPerS * 10 * 100.0 / beforeBaud, beforeBaud,
+         after, after * 10 * 100.0 / m.baud(), m.baud(), beforeBytesPerS, after * m.rateMs() / 1000);
+}
+
+int main()
+{
+  std::vector<std::pair<std::vector<uint8_t>, uint32_t>> configured = {
+      {CFG_RATE_500, GPS_FAST_BAUD}, {CFG_MSG_OFF[0], GPS_FAST_BAUD}, {CFG_MSG_OFF[1], GPS_FAST_BAUD},
+      {CFG_MSG_OFF[2], GPS_FAST_BAUD}, {CFG_MSG_OFF[3], GPS_FAST_BAUD}};
+
+  // u-blox 6 at power-up: probe, switch baud, probe again, configure
+  {
+    Module m(Module::UBLOX6, GPS_BOOT_BAUD);
+    uint32_t before = m.nmeaBytesPerS();
+    hostMillis = 0;
+    GpsConfigResult r = configureGPS(m, 16, 17);
+    auto want = configured;
+    want.insert(want.begin(), {{MON_VER_POLL, GPS_BOOT_BAUD}, {CFG_PRT_38400, GPS_BOOT_BAUD}, {MON_VER_POLL, GPS_FAST_BAUD}});
+    expectFrames(m, want);
+    FUZZ_CHECK(r.chip == GPS_CHIP_UBX6 && r.baud == GPS_FAST_BAUD && m.baudRate() == GPS_FAST_BAUD);
+    FUZZ_CHECK(r.sent == 6 && r.acked == 6 && !r.hintSent); // no stored fix on the host
+    FUZZ_CHECK(m.baud() == GPS_FAST_BAUD && m.rateMs() == GPS_RATE_MS);
+    FUZZ_CHECK(m.nmeaBytesPerS() < before);
+    report("u-blox 6 from power-up", m, before, GPS_BOOT_BAUD);
+  }
+  // M8 still at the fast baud after an ESP-only reset: no CFG-PRT
+  {
+    Module m(Module::UBLOX8, GPS_FAST_BAUD);
+    uint32_t before = m.nmeaBytesPerS();
+    hostMillis = 0;
+    GpsConfigResult r = configureGPS(m, 16, 17);
+    auto want = configured;
+    want.insert(want.begin(), {{MON_VER_POLL, GPS_BOOT_BAUD}, {MON_VER_POLL, GPS_FAST_BAUD}});
+    expectFrames(m, want);
+    FUZZ_CHECK(r.chip == GPS_CHIP_UBX8 && r.baud == GPS_FAST_BAUD && m.baudRate() == GPS_FAST_BAUD);
+    FUZZ_CHECK(r.sent == 5 && r.acked == 5);
+    FUZZ_CHECK(hostMillis >= GPS_PROBE_TIMEOUT_MS); // the 9600 probe timed out
+    report("M8 left at 38400", m, before, GPS_FAST_BAUD);
+  }
+  // Plain NMEA module: probed at both rates, then left alone at 9600
+  {
+    Module m(Module::NMEA_ONLY, GPS_BOOT_BAUD);
+    uint32_t before = m.nmeaBytesPerS();
+    hostMillis = 0;
+    GpsConfigResult r = configureGPS(m, 16, 17);
+    expectFrames(m, {{MON_VER_POLL, GPS_BOOT_BAUD}, {MON_VER_POLL, GPS_FAST_BAUD}});
+    FUZZ_CHECK(r.chip == GPS_CHIP_UNKNOWN && r.baud == GPS_BOOT_BAUD && m.baudRate() == GPS_BOOT_BAUD);
+    FUZZ_CHECK(!r.sent && m.nmeaBytesPerS() == before);
+    report("NMEA only", m, before, GPS_BOOT_BAUD);
+  }
+  printf("ok\n");
+  return 0;
+}
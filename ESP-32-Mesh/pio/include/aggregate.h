@@ -0,0 +1,160 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "fixed_buffers.h"
+#include "inbound.h"
+#include "fragment.h"
+
+// Relays merge reports on their way to the master into one mesh line:
+//   AGG:<budget ms>:<from hex>:<length>:<bytes><from hex>:<length>:<bytes>...
+// Each entry is a report as its sender would have sent it alone (JSON or
+// a Z: line), and the master takes every entry in as if it had come from
+// `from` directly. The budget is how much longer the entries may be held
+// on the way: each sender sets it (cfg.aggHoldMs) and each relay that
+// holds them passes on what is left, so the latency aggregation adds is
+// bounded end to end, whatever the depth. SOS reports are never put in.
+// A node takes aggregates only after answering
+//   AGG?  ->  AGG!
+// The master always answers; a relay only once the master has answered it.
+#define AGG_LINE_MAX 1024      // whole line: several reports, so longer than cfg.fragMtu
+#define AGG_ENTRIES_MAX 16     // per line
+#define AGG_BUDGET_MAX_MS 2000 // longest hold a sender may ask for
+#define AGG_BUDGET_MIN_MS 100  // shortest: less merges too little to pay for its ACKs (sim/sim_agg)
+#define AGG_HEADER_MAX 9       // "AGG:2000:"
+
+// What an entry may carry: a report, JSON or packed. Anything else (a
+// control line, another AGG:) makes the whole line bad.
+inline bool aggIsReport(const char *data, size_t len)
+{
+  return len && (data[0] == '{' || (len >= 2 && data[0] == 'Z' && data[1] == ':'));
+}
+
+struct AggEntry
+{
+  uint32_t from;
+  const char *data;
+  uint16_t len;
+};
+
+// Walks the part after "AGG:" (s[0..len), NUL-terminated): the budget,
+// then one entry per next(). A line is good only if every entry parses,
+// is a report and they end exactly at the end, so callers check bad()
+// after the last.
+class AggReader
+{
+public:
+  bool begin(const char *s, size_t len, uint16_t &budgetMs)
+  {
+    uint32_t v;
+    end_ = s + len;
+    count_ = 0;
+    s = parseFragNumber(s, AGG_BUDGET_MAX_MS, v);
+    bad_ = !s || *s != ':' || s + 1 >= end_;
+    at_ = bad_ ? end_ : s + 1;
+    budgetMs = bad_ ? 0 : v;
+    return !bad_;
+  }
+  // False at the end, or at an entry that does not parse (bad() is then set)
+  bool next(AggEntry &e)
+  {
+    if (at_ >= end_)
+      return false;
+    uint32_t n;
+    const char *s = parseHexId(at_, e.from);
+    if (!s || *s != ':' || !(s = parseFragNumber(s + 1, FRAG_MTU_MAX, n)) || *s != ':' || !n ||
+        (size_t)(end_ - (s + 1)) < n || count_ >= AGG_ENTRIES_MAX || !aggIsReport(s + 1, n))
+    {
+      bad_ = true;
+      at_ = end_;
+      return false;
+    }
+    e.data = s + 1;
+    e.len = n;
+    at_ = e.data + n;
+    count_++;
+    return true;
+  }
+  bool bad() const { return bad_; }
+
+private:
+  const char *at_ = nullptr, *end_ = nullptr;
+  uint8_t count_ = 0;
+  bool bad_ = true;
+};
+
+// The part after "AGG:" parses to the end
+inline bool aggValid(const char *s, size_t len)
+{
+  AggReader r;
+  AggEntry e;
+  uint16_t budgetMs;
+  if (!r.begin(s, len, budgetMs))
+    return false;
+  while (r.next(e))
+    ;
+  return !r.bad();
+}
+
+// Bytes an entry of `len` from `from` takes in a line
+inline size_t aggEntrySize(uint32_t from, size_t len)
+{
+  size_t n = 2 + len; // the two ':'
+  do
+    n++;
+  while (from >>= 4);
+  do
+    n++;
+  while (len /= 10);
+  return n;
+}
+
+// Entries held by a relay until the first of their holds runs out, or the
+// next one would not fit in a line of LINE_MAX bytes. A relay `hops` from
+// the master holds an entry for budget / hops of what it has left, so the
+// relays further up keep a share, and the one next to the master, where
+// every subtree's reports meet, gets the most.
+template <uint16_t LINE_MAX>
+class AggBatch
+{
+public:
+  // False if it does not fit with what is held: take() first
+  bool add(uint32_t from, const char *data, size_t len, uint32_t nowMs, uint16_t budgetMs, uint8_t hops)
+  {
+    if (count_ >= AGG_ENTRIES_MAX || AGG_HEADER_MAX + body_.length() + aggEntrySize(from, len) > LINE_MAX)
+      return false;
+    body_.appendf("%x:%u:", (unsigned)from, (unsigned)len);
+    body_.append(data, len);
+    uint32_t flush = nowMs + budgetMs / (hops ? hops : 1), end = nowMs + budgetMs;
+    if (!count_ || (int32_t)(flush - flushMs_) < 0)
+      flushMs_ = flush;
+    if (!count_ || (int32_t)(end - endMs_) < 0)
+      endMs_ = end;
+    count_++;
+    return true;
+  }
+  // Whether an entry of `len` would fit on its own
+  static bool fits(uint32_t from, size_t len) { return AGG_HEADER_MAX + aggEntrySize(from, len) <= LINE_MAX; }
+  bool empty() const { return !count_; }
+  uint8_t count() const { return count_; }
+  bool due(uint32_t nowMs) const { return count_ && (int32_t)(nowMs - flushMs_) >= 0; }
+
+  // The held entries as one line, with the budget they have left; the
+  // batch is empty after
+  template <size_t N>
+  void take(uint32_t nowMs, FixedString<N> &line)
+  {
+    static_assert(N > LINE_MAX, "line shorter than a batch");
+    int32_t left = (int32_t)(endMs_ - nowMs);
+    line.clear();
+    line.appendf("AGG:%u:", (unsigned)(left > 0 ? left : 0));
+    line.append(body_.c_str(), body_.length());
+    body_.clear();
+    count_ = 0;
+  }
+
+private:
+  FixedString<LINE_MAX + 1> body_;
+  uint32_t flushMs_ = 0, endMs_ = 0; // the first hold to run out; the first budget
+  uint8_t count_ = 0;
+};
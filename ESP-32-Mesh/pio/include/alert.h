@@ -0,0 +1,218 @@
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Geo-targeted alerts. On the mesh an alert is one text line:
+//   ALERT:<id hex>:<severity 0-3>:<ttl s>:<issued us>:<target>:<text>
+// The gateway sends the same line without <issued>; the master stamps it
+// with mesh time (getNodeTime) before broadcasting, so every client can
+// age it against its own synced clock. That clock wraps after ~71 min,
+// hence ALERT_TTL_MAX_S.
+// <target> is one of
+//   *                          everyone
+//   C<lat>,<lon>,<radius m>    circle
+//   P<lat>,<lon>,<lat>,<lon>,...  polygon, 3..ALERT_MAX_VERTICES corners
+// with coordinates in 1e-7 degrees. Anything else after "ALERT:" is a
+// legacy alert: no id, everyone, severity 3.
+#define ALERT_MAX_VERTICES 8
+#define ALERT_TTL_MAX_S 3600
+#define ALERT_MAX_RADIUS_M 1000000 // keeps the squared distance inside 64 bits
+
+enum GeoKind : uint8_t
+{
+  GEO_ALL,
+  GEO_CIRCLE,
+  GEO_POLYGON
+};
+
+// Point tests use integers only; the one float (cos of the circle's
+// latitude) is taken when the alert is parsed.
+struct GeoTarget
+{
+  GeoKind kind;
+  uint8_t n;                                             // polygon corners
+  int32_t lat[ALERT_MAX_VERTICES], lon[ALERT_MAX_VERTICES]; // polygon, or [0] = circle centre
+  int32_t minLat, maxLat, minLon, maxLon;                // polygon bounding box
+  int64_t radius;                                        // circle, in 1e-7 degrees of latitude
+  int32_t cosQ16;                                        // circle: cos(centre latitude) * 65536
+
+  bool contains(int32_t pLat, int32_t pLon) const
+  {
+    if (kind == GEO_ALL)
+      return true;
+    if (kind == GEO_CIRCLE)
+    {
+      int64_t dy = (int64_t)pLat - lat[0];
+      if (dy > radius || -dy > radius)
+        return false;
+      int64_t dx = ((int64_t)pLon - lon[0]) * cosQ16 >> 16; // east-west shrinks with latitude
+      if (dx > radius || -dx > radius)
+        return false;
+      return (uint64_t)(dx * dx) + (uint64_t)(dy * dy) <= (uint64_t)(radius * radius);
+    }
+    if (pLat < minLat || pLat > maxLat || pLon < minLon || pLon > maxLon)
+      return false;
+    // Crossing number: count edges crossing the ray east of the point.
+    // The intersection test is cross-multiplied so nothing is divided.
+    bool inside = false;
+    for (uint8_t i = 0, j = n - 1; i < n; j = i++)
+    {
+      if ((lat[i] > pLat) == (lat[j] > pLat))
+        continue;
+      int64_t lhs = ((int64_t)pLon - lon[i]) * ((int64_t)lat[j] - lat[i]);
+      int64_t rhs = ((int64_t)pLat - lat[i]) * ((int64_t)lon[j] - lon[i]);
+      if (lat[j] > lat[i] ? lhs < rhs : lhs > rhs)
+        inside = !inside;
+    }
+    return inside;
+  }
+
+  // Parses <target> up to the next ':'; advances s past it
+  bool parse(const char *&s)
+  {
+    if (*s == '*')
+    {
+      kind = GEO_ALL;
+      return *++s == ':';
+    }
+    char k = *s;
+    if (k != 'C' && k != 'P')
+      return false; // also the end of the line: never step over the NUL
+    s++;
+    int32_t v[ALERT_MAX_VERTICES * 2];
+    uint8_t count = 0;
+    for (;;)
+    {
+      char *end;
+      long x = strtol(s, &end, 10);
+      if (end == s || count == ALERT_MAX_VERTICES * 2)
+        return false;
+      v[count++] = x;
+      s = end;
+      if (*s == ':')
+        break;
+      if (*s++ != ',')
+        return false;
+    }
+    if (k == 'C' && count == 3)
+    {
+      if (v[2] < 0 || v[2] > ALERT_MAX_RADIUS_M || !validLatLon(v[0], v[1]))
+        return false;
+      kind = GEO_CIRCLE;
+      lat[0] = v[0];
+      lon[0] = v[1];
+      radius = (int64_t)v[2] * 10000000 / 111320; // metres per degree of latitude
+      double c = cos(v[0] * (M_PI / 180e7));
+      cosQ16 = c > 0 ? (int32_t)(c * 65536) : 0;
+      return true;
+    }
+    if (k == 'P' && count >= 6 && count % 2 == 0)
+    {
+      kind = GEO_POLYGON;
+      n = count / 2;
+      minLat = minLon = INT32_MAX;
+      maxLat = maxLon = INT32_MIN;
+      for (uint8_t i = 0; i < n; i++)
+      {
+        if (!validLatLon(v[2 * i], v[2 * i + 1]))
+          return false;
+        lat[i] = v[2 * i];
+        lon[i] = v[2 * i + 1];
+        minLat = lat[i] < minLat ? lat[i] : minLat;
+        maxLat = lat[i] > maxLat ? lat[i] : maxLat;
+        minLon = lon[i] < minLon ? lon[i] : minLon;
+        maxLon = lon[i] > maxLon ? lon[i] : maxLon;
+      }
+      return true;
+    }
+    return false;
+  }
+
+  static bool validLatLon(int32_t la, int32_t lo)
+  {
+    return la >= -900000000 && la <= 900000000 && lo >= -1800000000 && lo <= 1800000000;
+  }
+};
+
+struct Alert
+{
+  uint32_t id; // 0: legacy alert
+  uint8_t severity;
+  uint16_t ttlS;
+  uint32_t issuedUs;
+  GeoTarget target;
+  const char *text; // points into the parsed line
+  const char *targetStart; // where <target> begins (the master splices <issued> in before it)
+
+  // `withIssued` false: the gateway form, without the <issued> field.
+  // Returns false for a legacy line; `text` then holds everything after "ALERT:".
+  bool parse(const char *line, bool withIssued)
+  {
+    id = 0;
+    severity = 3;
+    ttlS = 0;
+    issuedUs = 0;
+    target.kind = GEO_ALL;
+    text = line + 6;
+    targetStart = nullptr;
+    const char *s = line + 6;
+    uint32_t f[4];
+    uint8_t fields = withIssued ? 4 : 3;
+    for (uint8_t i = 0; i < fields; i++)
+    {
+      char *end;
+      f[i] = strtoul(s, &end, i == 0 ? 16 : 10);
+      if (end == s || *end != ':')
+        return false;
+      s = end + 1;
+    }
+    GeoTarget t;
+    targetStart = s;
+    if (f[0] == 0 || f[1] > 3 || f[2] == 0 || f[2] > ALERT_TTL_MAX_S || !t.parse(s))
+      return false;
+    id = f[0];
+    severity = f[1];
+    ttlS = f[2];
+    issuedUs = withIssued ? f[3] : 0;
+    target = t;
+    text = s + 1;
+    return true;
+  }
+
+  bool expired(uint32_t nowUs) const { return id && nowUs - issuedUs > (uint32_t)ttlS * 1000000UL; }
+};
+
+// Ids of recently handled alerts; repeats (relays, retries) are ignored
+template <uint8_t N>
+struct RecentIds
+{
+  uint32_t ids[N];
+  uint8_t next;
+
+  // Slot holding id, or -1
+  int8_t find(uint32_t id) const
+  {
+    for (uint8_t i = 0; i < N; i++)
+      if (ids[i] == id)
+        return i;
+    return -1;
+  }
+  // Adds id over the oldest entry; returns its slot
+  uint8_t add(uint32_t id)
+  {
+    uint8_t slot = next;
+    ids[slot] = id;
+    next = (next + 1) % N;
+    return slot;
+  }
+  // True if id was already in the list; otherwise adds it
+  bool checkAndAdd(uint32_t id)
+  {
+    if (find(id) >= 0)
+      return true;
+    add(id);
+    return false;
+  }
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Captive-portal DNS: every A (or ANY) query is answered with the AP's
+// address, so whatever host a phone probes lands on the portal. Other
+// types (AAAA, HTTPS, ...) get an empty NOERROR answer, which makes the
+// phone fall back to IPv4 at once instead of waiting for a timeout.
+// Malformed or non-query packets get no reply at all.
+#define CAPTIVE_DNS_PORT 53
+#define CAPTIVE_DNS_TTL_S 10 // short: the phone must not keep these after leaving the AP
+
+enum DnsReply : uint8_t
+{
+  DNS_ANSWERED, // A record with the AP address
+  DNS_EMPTY,    // NOERROR, no records
+  DNS_IGNORED   // nothing to send
+};
+
+// Builds the reply to `query` in `out` (at least len + 16 bytes).
+// Returns the reply length, 0 when nothing should be sent.
+inline size_t captiveDnsReply(const uint8_t *query, size_t len, const uint8_t ip[4], uint8_t *out, size_t outMax,
+                              DnsReply *kind = nullptr)
+{
+  if (kind)
+    *kind = DNS_IGNORED;
+  // Header: id(2) flags(2) qd(2) an(2) ns(2) ar(2); standard query, one question
+  if (len < 12 + 5 || (query[2] & 0xF8) != 0 || query[4] != 0 || query[5] != 1)
+    return 0;
+  size_t p = 12;
+  while (p < len && query[p]) // labels up to the root
+  {
+    if (query[p] & 0xC0) // no compression in a question
+      return 0;
+    p += query[p] + 1;
+  }
+  if (p + 5 > len)
+    return 0;
+  size_t qEnd = p + 5; // root byte, qtype, qclass
+  uint16_t qtype = query[p + 1] << 8 | query[p + 2];
+  uint16_t qclass = query[p + 3] << 8 | query[p + 4];
+  bool answer = (qtype == 1 || qtype == 255) && (qclass & 0x7FFF) == 1; // A or ANY, IN
+  size_t n = qEnd + (answer ? 16 : 0);
+  if (n > outMax)
+    return 0;
+  memcpy(out, query, qEnd); // additional records (EDNS) are dropped
+  out[2] = 0x84 | (query[2] & 0x01); // QR, AA, keep RD
+  out[3] = 0x80;                     // RA, NOERROR
+  out[6] = 0;
+  out[7] = answer;
+  memset(out + 8, 0, 4);
+  if (answer)
+  {
+    static const uint8_t rr[] = {0xC0, 0x0C, 0, 1, 0, 1, 0, 0, 0, CAPTIVE_DNS_TTL_S, 0, 4};
+    memcpy(out + qEnd, rr, sizeof(rr));
+    memcpy(out + qEnd + sizeof(rr), ip, 4);
+  }
+  if (kind)
+    *kind = answer ? DNS_ANSWERED : DNS_EMPTY;
+  return n;
+}
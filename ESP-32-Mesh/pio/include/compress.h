@@ -0,0 +1,372 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "fixed_buffers.h"
+
+// Small-window LZ codec, in the manner of heatshrink, for client reports
+// on the mesh and the master's binary serial frames. The stream is bits,
+// most significant first:
+//   1 <8-bit byte>                                a literal
+//   0 <Z_WINDOW_BITS: distance - 1> <Z_LENGTH_BITS: length - Z_MATCH_MIN>
+//                                                 a copy of earlier output
+// padded with 0 bits to a whole unit: a byte, or a base64 digit on the
+// mesh, where lines must stay text. Both sides may start from the same
+// static dictionary (ZDict, e.g. include/compress_dict.h): copies then
+// reach back into its last Z_WINDOW bytes, so even a first report shares
+// its keys and common phrases with something. Decoding needs no memory
+// beyond its output; ZEncoder keeps 1.5 KB of match index.
+#define Z_WINDOW_BITS 9
+#define Z_WINDOW (1 << Z_WINDOW_BITS) // also the most of a dictionary that is used
+#define Z_LENGTH_BITS 4
+#define Z_MATCH_MIN 3 // 14 bits against 27 as literals
+#define Z_MATCH_MAX (Z_MATCH_MIN + (1 << Z_LENGTH_BITS) - 1)
+#define Z_HASH_BITS 8
+#define Z_CHAIN 24            // earlier positions tried per match: time against ratio
+#define Z_INPUT_MAX 16384     // per call
+#define Z_BAD ((size_t)-1)    // zDecompress: not a valid stream, or too long
+#define Z_LINE_HEADER_MAX 16  // "Z:ffff:16384:"
+
+// cfg.compress bits
+#define Z_PACK_REPORTS 1 // client: reports to the master, once it answers ZCAP
+#define Z_PACK_FRAMES 2  // binary serial frames (serial_frame.h FRAME_PACKED)
+
+struct ZDict
+{
+  const uint8_t *data;
+  uint16_t len;
+  uint16_t id; // in each packed line, so a mismatched dictionary is refused, not misread; 0: none
+};
+static const ZDict Z_NO_DICT = {nullptr, 0, 0};
+
+// ======== Bit units ========
+// Base64 digits (RFC 4648 alphabet, no '=' padding), 6 bits each
+inline char zDigit(uint8_t v)
+{
+  return "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[v & 63];
+}
+inline uint8_t zDigitValue(char c)
+{
+  if (c >= 'A' && c <= 'Z')
+    return c - 'A';
+  if (c >= 'a' && c <= 'z')
+    return c - 'a' + 26;
+  if (c >= '0' && c <= '9')
+    return c - '0' + 52;
+  return c == '+' ? 62 : c == '/' ? 63 : 0xFF;
+}
+
+template <typename Unit, uint8_t UNIT_BITS>
+class ZBitWriter
+{
+public:
+  ZBitWriter(Unit *out, size_t max) : out_(out), max_(max) {}
+  // False once the output is full; later puts are dropped
+  bool put(uint32_t v, uint8_t bits)
+  {
+    acc_ = acc_ << bits | (v & ((1UL << bits) - 1));
+    n_ += bits;
+    while (n_ >= UNIT_BITS)
+    {
+      n_ -= UNIT_BITS;
+      if (!emit(acc_ >> n_))
+        return false;
+    }
+    acc_ &= (1UL << n_) - 1;
+    return true;
+  }
+  // Pads the last unit; the units written, or 0 if they did not fit
+  size_t finish()
+  {
+    if (n_ && !emit(acc_ << (UNIT_BITS - n_)))
+      return 0;
+    n_ = 0;
+    return full_ ? 0 : len_;
+  }
+
+private:
+  bool emit(uint32_t v)
+  {
+    if (len_ >= max_)
+      full_ = true;
+    if (full_)
+      return false;
+    out_[len_++] = UNIT_BITS == 8 ? (Unit)v : (Unit)zDigit(v);
+    return true;
+  }
+
+  Unit *out_;
+  size_t max_, len_ = 0;
+  uint32_t acc_ = 0;
+  uint8_t n_ = 0;
+  bool full_ = false;
+};
+
+template <typename Unit, uint8_t UNIT_BITS>
+class ZBitReader
+{
+public:
+  ZBitReader(const Unit *in, size_t len) : in_(in), len_(len) {}
+  // Bits not read yet
+  size_t left() const { return (len_ - pos_) * UNIT_BITS + n_; }
+  // False past the end or at a character that is no base64 digit
+  bool get(uint8_t bits, uint32_t &v)
+  {
+    while (n_ < bits)
+    {
+      if (pos_ >= len_)
+        return false;
+      uint8_t u = UNIT_BITS == 8 ? (uint8_t)in_[pos_++] : zDigitValue(in_[pos_++]);
+      if (u == 0xFF && UNIT_BITS != 8)
+        return false;
+      acc_ = acc_ << UNIT_BITS | u;
+      n_ += UNIT_BITS;
+    }
+    n_ -= bits;
+    v = acc_ >> n_ & ((1UL << bits) - 1);
+    return true;
+  }
+
+private:
+  const Unit *in_;
+  size_t len_, pos_ = 0;
+  uint32_t acc_ = 0;
+  uint8_t n_ = 0;
+};
+
+// ======== Encoder ========
+// Greedy: at each position the longest match among the last Z_CHAIN with
+// the same 3-byte hash in the window, else a literal. Positions run over
+// the dictionary's tail and then the input, as if they were one buffer.
+class ZEncoder
+{
+public:
+  // in[0..len) as bytes into out; the bytes written, or 0 if the result
+  // would take more than `max`
+  size_t compress(const uint8_t *in, size_t len, uint8_t *out, size_t max, const ZDict &dict = Z_NO_DICT)
+  {
+    ZBitWriter<uint8_t, 8> w(out, max);
+    return run(in, len, w, dict);
+  }
+  // The same as base64 digits, for a text line
+  size_t compressText(const uint8_t *in, size_t len, char *out, size_t max, const ZDict &dict = Z_NO_DICT)
+  {
+    ZBitWriter<char, 6> w(out, max);
+    return run(in, len, w, dict);
+  }
+
+private:
+  template <typename Writer>
+  size_t run(const uint8_t *in, size_t len, Writer &w, const ZDict &dict)
+  {
+    if (!len || len > Z_INPUT_MAX)
+      return 0;
+    dictLen_ = dict.len < Z_WINDOW ? dict.len : Z_WINDOW;
+    dict_ = dict.data + (dict.len - dictLen_);
+    in_ = in;
+    uint32_t end = dictLen_ + len;
+    memset(head_, 0, sizeof(head_));
+    for (uint32_t v = 0; v < dictLen_; v++)
+      insert(v, end);
+    for (uint32_t v = dictLen_; v < end;)
+    {
+      uint32_t best = 0, dist = 0;
+      if (v + Z_MATCH_MIN <= end)
+      {
+        uint32_t limit = end - v < Z_MATCH_MAX ? end - v : Z_MATCH_MAX;
+        uint8_t tries = Z_CHAIN;
+        for (uint16_t c = head_[hash(v)]; c && tries--; c = prev_[(c - 1) & (Z_WINDOW - 1)])
+        {
+          uint32_t p = c - 1;
+          if (v - p > Z_WINDOW)
+            break;
+          if (at(p + best) != at(v + best)) // cannot beat the best so far
+            continue;
+          uint32_t n = 0;
+          while (n < limit && at(p + n) == at(v + n))
+            n++;
+          if (n > best)
+          {
+            best = n;
+            dist = v - p;
+            if (n == limit)
+              break;
+          }
+        }
+      }
+      if (best >= Z_MATCH_MIN)
+      {
+        if (!w.put(0, 1) || !w.put(dist - 1, Z_WINDOW_BITS) || !w.put(best - Z_MATCH_MIN, Z_LENGTH_BITS))
+          return 0;
+      }
+      else
+      {
+        best = 1;
+        if (!w.put(0x100 | at(v), 9))
+          return 0;
+      }
+      for (uint32_t e = v + best; v < e; v++)
+        insert(v, end);
+    }
+    return w.finish();
+  }
+
+  uint8_t at(uint32_t v) const { return v < dictLen_ ? dict_[v] : in_[v - dictLen_]; }
+  uint8_t hash(uint32_t v) const { return (at(v) * 251 + at(v + 1) * 11 + at(v + 2)) & ((1 << Z_HASH_BITS) - 1); }
+  void insert(uint32_t v, uint32_t end)
+  {
+    if (v + Z_MATCH_MIN > end)
+      return;
+    uint8_t h = hash(v);
+    prev_[v & (Z_WINDOW - 1)] = head_[h];
+    head_[h] = v + 1;
+  }
+
+  uint16_t head_[1 << Z_HASH_BITS]; // newest position + 1 per hash, 0: none
+  uint16_t prev_[Z_WINDOW];         // the one before it, by position in the window
+  const uint8_t *dict_ = nullptr, *in_ = nullptr;
+  uint32_t dictLen_ = 0;
+};
+static_assert(Z_WINDOW + Z_INPUT_MAX < 65535, "ZEncoder positions are 16 bits");
+
+// ======== Decoder ========
+template <typename Unit, uint8_t UNIT_BITS>
+inline size_t zDecode(const Unit *in, size_t len, uint8_t *out, size_t max, const ZDict &dict)
+{
+  uint32_t dictLen = dict.len < Z_WINDOW ? dict.len : Z_WINDOW;
+  const uint8_t *d = dict.data + (dict.len - dictLen);
+  ZBitReader<Unit, UNIT_BITS> r(in, len);
+  size_t n = 0;
+  // Padding is less than one unit, so anything longer is a token
+  while (r.left() >= UNIT_BITS)
+  {
+    uint32_t tag, v, count;
+    if (!r.get(1, tag))
+      return Z_BAD;
+    if (tag)
+    {
+      if (!r.get(8, v) || n >= max)
+        return Z_BAD;
+      out[n++] = v;
+      continue;
+    }
+    if (!r.get(Z_WINDOW_BITS, v) || !r.get(Z_LENGTH_BITS, count))
+      return Z_BAD;
+    uint32_t dist = v + 1;
+    count += Z_MATCH_MIN;
+    if (dist > n + dictLen || count > max - n)
+      return Z_BAD;
+    for (; count; count--, n++) // byte by byte: a copy may overlap itself
+      out[n] = dist > n ? d[dictLen - (dist - n)] : out[n - dist];
+  }
+  uint32_t pad;
+  size_t left = r.left();
+  if (left && (!r.get(left, pad) || pad))
+    return Z_BAD;
+  return n;
+}
+
+// in[0..len) as written by ZEncoder::compress into out; the length, or Z_BAD
+inline size_t zDecompress(const uint8_t *in, size_t len, uint8_t *out, size_t max, const ZDict &dict = Z_NO_DICT)
+{
+  return zDecode<uint8_t, 8>(in, len, out, max, dict);
+}
+inline size_t zDecompressText(const char *in, size_t len, uint8_t *out, size_t max, const ZDict &dict = Z_NO_DICT)
+{
+  return zDecode<char, 6>(in, len, out, max, dict);
+}
+
+// ======== Mesh lines ========
+// A packed report is one line, so it fragments and ACKs like any other:
+//   Z:<dictionary id hex, 0: none>:<unpacked length>:<base64 stream>
+// Clients only send them to a master that asked for them: a client sends
+// "ZCAP?" once per master, a master that can unpack answers
+//   ZCAP:<its dictionary id hex, 0: none>
+// and an older one treats it as a report (ACK:ZCAP?), so the client never
+// packs for it.
+struct ZLine
+{
+  uint16_t dictId;
+  uint16_t length;
+  const char *data;
+  size_t dataLen;
+};
+
+// Hex (base 16) or decimal digits up to `max`, at least one; the first
+// character after them, or nullptr
+inline const char *parseZNumber(const char *s, const char *end, uint8_t base, uint32_t max, uint32_t &v)
+{
+  const char *start = s;
+  v = 0;
+  for (; s < end; s++)
+  {
+    char c = *s | (base == 16 ? 0x20 : 0);
+    uint8_t d;
+    if (*s >= '0' && *s <= '9')
+      d = *s - '0';
+    else if (base == 16 && c >= 'a' && c <= 'f')
+      d = c - 'a' + 10;
+    else
+      break;
+    v = v * base + d;
+    if (v > max)
+      return nullptr;
+  }
+  return s == start ? nullptr : s;
+}
+
+// s[0..len): the part after "Z:"
+inline bool parseZLine(const char *s, size_t len, ZLine &z)
+{
+  const char *end = s + len;
+  uint32_t id, n;
+  if (!(s = parseZNumber(s, end, 16, 0xFFFF, id)) || s == end || *s != ':' ||
+      !(s = parseZNumber(s + 1, end, 10, Z_INPUT_MAX, n)) || s == end || *s != ':' || !n)
+    return false;
+  z.dictId = id;
+  z.length = n;
+  z.data = s + 1;
+  z.dataLen = end - z.data;
+  return true;
+}
+
+// The part after "ZCAP:"
+inline bool parseZCap(const char *s, uint16_t &dictId)
+{
+  uint32_t id;
+  s = parseZNumber(s, s + strlen(s), 16, 0xFFFF, id);
+  dictId = id;
+  return s && !*s;
+}
+
+// msg as a Z: line with `dict` (Z_NO_DICT for none); false, leaving
+// `line` unspecified, if that would not be shorter than msg itself
+template <size_t N>
+inline bool zPackLine(ZEncoder &enc, const char *msg, size_t len, const ZDict &dict, FixedString<N> &line)
+{
+  line.clear();
+  line.appendf("Z:%x:%u:", (unsigned)dict.id, (unsigned)len);
+  size_t head = line.length();
+  if (head + 1 >= len || len > Z_INPUT_MAX)
+    return false;
+  size_t room = line.capacity() - head;
+  if (room > len - 1 - head)
+    room = len - 1 - head;
+  size_t n = enc.compressText((const uint8_t *)msg, len, line.data() + head, room, dict);
+  if (!n)
+    return false;
+  line.setLength(head + n);
+  return true;
+}
+
+// A parsed Z: line into out[0..max); the length, or Z_BAD if it names
+// another dictionary than `dict` or does not unpack to its length
+inline size_t zUnpackLine(const ZLine &z, char *out, size_t max, const ZDict &dict)
+{
+  if (z.dictId && z.dictId != dict.id)
+    return Z_BAD;
+  if (z.length > max)
+    return Z_BAD;
+  size_t n = zDecompressText(z.data, z.dataLen, (uint8_t *)out, z.length, z.dictId ? dict : Z_NO_DICT);
+  return n == z.length ? n : Z_BAD;
+}
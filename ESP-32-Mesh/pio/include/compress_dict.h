@@ -0,0 +1,15 @@
+// Generated by scripts/train_dict.py from ../serial_python/data.json; do not edit.
+#pragma once
+#include "compress.h"
+
+// 512 bytes from 42 reports
+static const char ZDICT_REPORTS_TEXT[] =
+    "56379,\":{\"gps\":{\"latitude\":85.\",\"sensors\":{\"gps\":{\"latitude\":42."
+    "3807435,\"longihelp\",\"be\":-143.8:CD\",\"s,\"ts\":[2,\"boot\":32685}},\"m"
+    "\":\"need ],\"sos5,\"lon\":-71.12505767}},\"messag\",\"sensors\":{\"gps\":{"
+    "\"latitude\":42.38074333,\"long83}},\"2.38071267,\"longitude\":-71.125"
+    "05,\"ts\":,\"boot\":2.3807\"ts\":[\"seq\":\",\"boot\",\"sos\":true}Connection"
+    "\"}}},\"mede\":-71.1250,\"longitude\"{\"device_id\":\"04:83:08:58:DC:E4\""
+    ",\"status\":\"activ\"message\":\"Establishing Connecti\":\"USER_001\",\"se"
+    "nsors\":{\"gps\":{\"latitude\":42.380\",\"status\":\"active\",\"userid\":\"US";
+static const ZDict ZDICT_REPORTS = {(const uint8_t *)ZDICT_REPORTS_TEXT, 512, 0x7fe2};
@@ -0,0 +1,145 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+// Duplicate suppression for numbered messages, keyed by (source, sequence).
+// Recent keys sit in a small 4-way set-associative LRU, which is exact.
+// Older ones fall back on two Bloom filter generations: inserts go to the
+// current one, lookups check both, and once the current one holds its
+// design capacity the older one is wiped and they swap. Memory is fixed
+// (LRU_ENTRIES * 8 + 2 * BLOOM_BITS / 8 bytes) and every call is O(1).
+//
+// A Bloom hit can be a false positive, i.e. a new message taken for a
+// copy. The constructor sizes the hash count and the rotation point so that
+// this happens with probability at most fpPpm per million lookups.
+template <uint16_t LRU_ENTRIES, uint32_t BLOOM_BITS>
+class DedupeFilter
+{
+  static_assert(LRU_ENTRIES >= 4 && (LRU_ENTRIES & (LRU_ENTRIES - 1)) == 0, "LRU_ENTRIES must be a power of two >= 4");
+  static_assert(BLOOM_BITS >= 64 && (BLOOM_BITS & (BLOOM_BITS - 1)) == 0, "BLOOM_BITS must be a power of two");
+  static const uint8_t WAYS = 4;
+  static const uint16_t SETS = LRU_ENTRIES / WAYS;
+  static const uint8_t MAX_HASHES = 32;
+
+public:
+  explicit DedupeFilter(uint32_t fpPpm)
+  {
+    // Both generations can answer, so each gets half the budget:
+    // k = log2(1/p) hashes, n = m ln2 / k keys per generation
+    double p = fpPpm / 2e6;
+    if (p <= 0)
+      p = 1e-9;
+    double k = ceil(-log2(p));
+    hashes_ = k < 1 ? 1 : k > MAX_HASHES ? MAX_HASHES : (uint8_t)k;
+    rotateAt_ = (uint32_t)(BLOOM_BITS * 0.6931 / hashes_);
+    if (rotateAt_ < 1)
+      rotateAt_ = 1;
+    clear();
+  }
+
+  void clear()
+  {
+    memset(lru_, 0, sizeof(lru_));
+    memset(bloom_, 0, sizeof(bloom_));
+    current_ = 0;
+    inserted_ = 0;
+    lruHits_ = bloomHits_ = rotations_ = 0;
+  }
+
+  static uint64_t key(uint32_t source, uint32_t seq) { return ((uint64_t)source << 32) | seq; }
+
+  // True if `k` was seen before (possibly a Bloom false positive); either
+  // way it is remembered as the most recent key.
+  bool seen(uint64_t k)
+  {
+    uint64_t h = mix(k);
+    if (lruTouch(h))
+    {
+      lruHits_++;
+      return true;
+    }
+    uint32_t idx[MAX_HASHES];
+    bloomIndices(h, idx);
+    if (bloomTest(current_, idx) || bloomTest(current_ ^ 1, idx))
+    {
+      bloomHits_++;
+      return true;
+    }
+    if (++inserted_ > rotateAt_)
+    {
+      current_ ^= 1;
+      memset(bloom_[current_], 0, sizeof(bloom_[current_]));
+      inserted_ = 1;
+      rotations_++;
+    }
+    bloomSet(current_, idx);
+    return false;
+  }
+
+  uint8_t hashes() const { return hashes_; }
+  uint32_t capacity() const { return rotateAt_; } // keys per generation
+  uint32_t lruHits() const { return lruHits_; }
+  uint32_t bloomHits() const { return bloomHits_; }
+  uint32_t rotations() const { return rotations_; }
+  static size_t memoryBytes() { return sizeof(uint64_t) * LRU_ENTRIES + BLOOM_BITS / 4; }
+
+private:
+  uint64_t lru_[SETS][WAYS]; // mixed keys, most recent first; 0 = empty
+  uint32_t bloom_[2][BLOOM_BITS / 32];
+  uint8_t current_;
+  uint8_t hashes_;
+  uint32_t rotateAt_, inserted_;
+  uint32_t lruHits_, bloomHits_, rotations_;
+
+  // splitmix64 finaliser; never returns 0 for the keys we build
+  static uint64_t mix(uint64_t x)
+  {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x ? x : 1;
+  }
+
+  // Looks up h in its set, moving it (or inserting it) to the front
+  bool lruTouch(uint64_t h)
+  {
+    uint64_t *set = lru_[(h >> 48) & (SETS - 1)];
+    uint8_t i = 0;
+    while (i < WAYS - 1 && set[i] != h)
+      i++;
+    bool hit = set[i] == h;
+    for (; i > 0; i--)
+      set[i] = set[i - 1];
+    set[0] = h;
+    return hit;
+  }
+
+  // Independent bit positions, two per splitmix step. (Plain double
+  // hashing h1 + i*h2 is cheaper, but at these table sizes keys sharing
+  // h1 and h2 put a floor of several ppm under the false positive rate.)
+  void bloomIndices(uint64_t h, uint32_t *idx) const
+  {
+    uint64_t x = h;
+    for (uint8_t i = 0; i < hashes_; i++)
+    {
+      if (!(i & 1))
+        x = mix(x + 0x9E3779B97F4A7C15ULL);
+      idx[i] = (uint32_t)(i & 1 ? x >> 32 : x) & (BLOOM_BITS - 1);
+    }
+  }
+  bool bloomTest(uint8_t gen, const uint32_t *idx) const
+  {
+    for (uint8_t i = 0; i < hashes_; i++)
+      if (!(bloom_[gen][idx[i] >> 5] & (1UL << (idx[i] & 31))))
+        return false;
+    return true;
+  }
+  void bloomSet(uint8_t gen, const uint32_t *idx)
+  {
+    for (uint8_t i = 0; i < hashes_; i++)
+      bloom_[gen][idx[i] >> 5] |= 1UL << (idx[i] & 31);
+  }
+};
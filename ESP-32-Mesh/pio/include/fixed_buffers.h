@@ -0,0 +1,182 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <atomic>
+
+// Heap-free building blocks for strings and message buffers. Everything is
+// sized at compile time so days of uptime cannot fragment the heap.
+
+// Read-only view of bytes owned by someone else.
+struct Span
+{
+  const char *data;
+  size_t len;
+
+  Span() : data(""), len(0) {}
+  Span(const char *d, size_t n) : data(d), len(n) {}
+  explicit Span(const char *s) : data(s), len(strlen(s)) {}
+
+  bool startsWith(const char *prefix) const
+  {
+    size_t n = strlen(prefix);
+    return n <= len && memcmp(data, prefix, n) == 0;
+  }
+  bool equals(const char *s) const
+  {
+    return strlen(s) == len && memcmp(data, s, len) == 0;
+  }
+  Span sub(size_t from) const
+  {
+    return from >= len ? Span(data + len, 0) : Span(data + from, len - from);
+  }
+};
+
+// NUL-terminated string with N-1 characters of inline storage. Appends that
+// do not fit are cut off and set truncated().
+template <size_t N>
+class FixedString
+{
+  static_assert(N > 1 && N <= 65535, "FixedString size out of range");
+
+public:
+  FixedString() { clear(); }
+  FixedString(const char *s)
+  {
+    clear();
+    append(s);
+  }
+
+  FixedString &operator=(const char *s)
+  {
+    clear();
+    append(s);
+    return *this;
+  }
+
+  void clear()
+  {
+    len_ = 0;
+    truncated_ = false;
+    buf_[0] = 0;
+  }
+
+  bool append(const char *s, size_t n)
+  {
+    size_t room = N - 1 - len_;
+    bool fits = n <= room;
+    if (!fits)
+    {
+      n = room;
+      truncated_ = true;
+    }
+    memcpy(buf_ + len_, s, n);
+    len_ += n;
+    buf_[len_] = 0;
+    return fits;
+  }
+  bool append(const char *s) { return append(s, strlen(s)); }
+  bool append(Span s) { return append(s.data, s.len); }
+  bool append(char c) { return append(&c, 1); }
+
+  bool appendf(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
+  {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf_ + len_, N - len_, fmt, ap);
+    va_end(ap);
+    if (n < 0)
+      return false;
+    if ((size_t)n >= N - len_)
+    {
+      len_ = N - 1;
+      truncated_ = true;
+      return false;
+    }
+    len_ += n;
+    return true;
+  }
+
+  const char *c_str() const { return buf_; }
+  char *data() { return buf_; }
+  size_t length() const { return len_; }
+  static size_t capacity() { return N - 1; }
+  bool empty() const { return len_ == 0; }
+  bool full() const { return len_ == N - 1; }
+  bool truncated() const { return truncated_; }
+  Span span() const { return Span(buf_, len_); }
+
+  bool startsWith(const char *prefix) const { return span().startsWith(prefix); }
+  bool operator==(const char *s) const { return span().equals(s); }
+  bool operator!=(const char *s) const { return !span().equals(s); }
+
+  // For writers that fill data() directly (e.g. serializers)
+  void setLength(size_t n)
+  {
+    len_ = n < N ? n : N - 1;
+    buf_[len_] = 0;
+  }
+
+private:
+  char buf_[N];
+  uint16_t len_;
+  bool truncated_;
+};
+
+// Fixed pool of COUNT buffers of SIZE bytes. alloc/release are lock-free and
+// may be called from different tasks/cores (one bit per buffer, CAS updates).
+template <uint8_t COUNT, uint16_t SIZE>
+class BufferPool
+{
+  static_assert(COUNT > 0 && COUNT <= 32, "BufferPool holds at most 32 buffers");
+
+public:
+  static const int8_t NONE = -1;
+
+  int8_t alloc()
+  {
+    uint32_t used = used_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      uint32_t freeBits = ~used & ALL;
+      if (!freeBits)
+      {
+        failures_.fetch_add(1, std::memory_order_relaxed);
+        return NONE;
+      }
+      int8_t h = __builtin_ctz(freeBits);
+      if (used_.compare_exchange_weak(used, used | (1UL << h), std::memory_order_acquire,
+                                      std::memory_order_relaxed))
+      {
+        uint8_t n = __builtin_popcount(used) + 1;
+        uint8_t hw = highWater_.load(std::memory_order_relaxed);
+        while (n > hw && !highWater_.compare_exchange_weak(hw, n, std::memory_order_relaxed))
+        {
+        }
+        return h;
+      }
+    }
+  }
+
+  void release(int8_t h)
+  {
+    if (h >= 0 && h < COUNT)
+      used_.fetch_and(~(1UL << h), std::memory_order_release);
+  }
+
+  char *data(int8_t h) { return (h >= 0 && h < COUNT) ? bufs_[h] : nullptr; }
+  static uint16_t size() { return SIZE; }
+
+  uint8_t inUse() const { return __builtin_popcount(used_.load(std::memory_order_relaxed)); }
+  uint8_t highWater() const { return highWater_.load(std::memory_order_relaxed); }
+  uint32_t failures() const { return failures_.load(std::memory_order_relaxed); }
+
+private:
+  static const uint32_t ALL = COUNT == 32 ? 0xFFFFFFFFUL : ((1UL << COUNT) - 1);
+  char bufs_[COUNT][SIZE];
+  std::atomic<uint32_t> used_{0};
+  std::atomic<uint8_t> highWater_{0};
+  std::atomic<uint32_t> failures_{0};
+};
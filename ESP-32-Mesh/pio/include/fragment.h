@@ -0,0 +1,445 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "fixed_buffers.h"
+#include "inbound.h"
+
+// Payloads longer than the mesh MTU (cfg.fragMtu) travel as numbered
+// fragments, one mesh line each:
+//   FRG:<xfer hex>:<index>:<count>:<total>:<bytes>
+// Every fragment but the last carries ceil(total / count) bytes, so the
+// receiver places it without knowing the sender's MTU. The receiver answers
+//   FACK:<xfer hex>                 the payload is complete
+//   FNAK:<xfer hex>:<missing hex>   bit i set: fragment i is still missing
+// and the sender resends only the fragments a FNAK names. A sender that
+// hears nothing resends the last fragment alone, as a probe, which the
+// receiver answers with a FACK or a FNAK. Either side holds a fixed number
+// of transfers, and nothing is allocated.
+#define FRAG_COUNT_MAX 32  // fragments per payload: one FNAK bitmap
+#define FRAG_HEADER_MAX 25 // "FRG:ffffffff:31:32:65535:"
+#define FRAG_ACK_MS 1500   // sender: no FACK/FNAK this long after its last fragment -> probe
+#define FRAG_TRIES 4       // sender: rounds (first send, FNAKs, timeouts) before giving up
+#define FRAG_GAP_MS 400    // receiver: no fragment this long with gaps -> FNAK
+#define FRAG_NAKS 3        // receiver: FNAKs without progress before the transfer is dropped
+#define FRAG_RECENT 32     // receiver: completed transfers re-ACKed, not delivered again
+#define FRAG_MTU_MIN 96    // FRAG_COUNT_MAX fragments still carry 2 KB
+#define FRAG_MTU_MAX 1024
+
+struct FragHeader
+{
+  uint32_t xfer;
+  uint8_t index, count;
+  uint16_t total;
+  const char *data; // this fragment's bytes, up to the end of the line
+};
+
+// Decimal 0..max, at least one digit; the first character after it, or nullptr
+inline const char *parseFragNumber(const char *s, uint32_t max, uint32_t &v)
+{
+  const char *start = s;
+  v = 0;
+  for (; *s >= '0' && *s <= '9'; s++)
+  {
+    v = v * 10 + (*s - '0');
+    if (v > max)
+      return nullptr;
+  }
+  return s == start ? nullptr : s;
+}
+
+// The part after "FRG:"
+inline bool parseFragment(const char *s, FragHeader &h)
+{
+  uint32_t index, count, total;
+  s = parseHexId(s, h.xfer);
+  if (!s || *s != ':' || !(s = parseFragNumber(s + 1, FRAG_COUNT_MAX - 1, index)) || *s != ':' ||
+      !(s = parseFragNumber(s + 1, FRAG_COUNT_MAX, count)) || *s != ':' ||
+      !(s = parseFragNumber(s + 1, 65535, total)) || *s != ':')
+    return false;
+  if (index >= count || total < count)
+    return false;
+  h.index = index;
+  h.count = count;
+  h.total = total;
+  h.data = s + 1;
+  return true;
+}
+
+// The part after "FACK:"
+inline bool parseFragAck(const char *s, uint32_t &xfer)
+{
+  s = parseHexId(s, xfer);
+  return s && !*s;
+}
+
+// The part after "FNAK:"
+inline bool parseFragNak(const char *s, uint32_t &xfer, uint32_t &missing)
+{
+  s = parseHexId(s, xfer);
+  if (!s || *s != ':')
+    return false;
+  s = parseHexId(s + 1, missing);
+  return s && !*s;
+}
+
+inline uint16_t fragChunk(uint16_t total, uint8_t count) { return (total + count - 1) / count; }
+inline uint32_t fragAll(uint8_t count) { return count == 32 ? 0xFFFFFFFFUL : (1UL << count) - 1; }
+
+// ======== Sender ========
+// Holds SLOTS payloads until the receiver has them all. next() hands out
+// one fragment per call, urgent (SOS) transfers first; the caller paces
+// the calls, so anything it sends directly goes out between fragments.
+template <uint8_t SLOTS, uint16_t PAYLOAD_MAX>
+class FragSender
+{
+public:
+  struct Stats
+  {
+    uint32_t started, delivered, failed, busy; // busy: every slot taken
+    uint32_t fragments, resent;
+  };
+
+  // Transfer ids count up from here. Seeded at random per boot, so a
+  // restarted sender's ids do not match transfers the receiver completed.
+  void seed(uint32_t first) { nextXfer_ = first; }
+
+  // Starts a transfer of data[0..len) to `to` in lines of at most `mtu`
+  // bytes; its id, or 0 if every slot is taken or it needs more than
+  // FRAG_COUNT_MAX fragments
+  uint32_t send(uint32_t to, const char *data, size_t len, uint16_t mtu, bool urgent)
+  {
+    if (!len || len > PAYLOAD_MAX || mtu <= FRAG_HEADER_MAX)
+      return 0;
+    size_t room = mtu - FRAG_HEADER_MAX, count = (len + room - 1) / room;
+    if (count > FRAG_COUNT_MAX)
+      return 0;
+    Slot *s = nullptr;
+    for (Slot &c : slots_)
+      if (!c.xfer)
+      {
+        s = &c;
+        break;
+      }
+    if (!s)
+    {
+      stats.busy++;
+      return 0;
+    }
+    if (!++nextXfer_)
+      nextXfer_ = 1;
+    s->xfer = nextXfer_;
+    s->to = to;
+    s->total = len;
+    s->count = count;
+    s->pending = fragAll(count);
+    s->tries = 1;
+    s->urgent = urgent;
+    memcpy(s->buf, data, len);
+    stats.started++;
+    return s->xfer;
+  }
+
+  // The next fragment to send, written to `line`; false if none is due.
+  // Also where unanswered transfers time out.
+  template <size_t N>
+  bool next(uint32_t nowMs, uint32_t &to, FixedString<N> &line)
+  {
+    static_assert(N > FRAG_HEADER_MAX, "line too short for a fragment");
+    Slot *pick = nullptr;
+    for (Slot &s : slots_)
+    {
+      if (!s.xfer)
+        continue;
+      if (!s.pending && (int32_t)(nowMs - s.dueMs) >= 0)
+      {
+        if (s.tries >= FRAG_TRIES)
+        {
+          stats.failed++;
+          s.xfer = 0;
+          continue;
+        }
+        s.tries++;
+        s.pending = 1UL << (s.count - 1); // the probe
+      }
+      if (s.pending && (!pick || (s.urgent && !pick->urgent)))
+        pick = &s;
+    }
+    if (!pick)
+      return false;
+    uint8_t i = __builtin_ctz(pick->pending);
+    pick->pending &= ~(1UL << i);
+    uint16_t chunk = fragChunk(pick->total, pick->count), at = i * chunk;
+    uint16_t n = i + 1 == pick->count ? pick->total - at : chunk;
+    line.clear();
+    line.appendf("FRG:%x:%u:%u:%u:", pick->xfer, i, pick->count, pick->total);
+    line.append(pick->buf + at, n);
+    if (!pick->pending)
+      pick->dueMs = nowMs + FRAG_ACK_MS;
+    to = pick->to;
+    stats.fragments++;
+    if (pick->tries > 1)
+      stats.resent++;
+    return true;
+  }
+
+  // "FACK:<xfer>" from `from`
+  void acked(uint32_t from, uint32_t xfer)
+  {
+    Slot *s = find(from, xfer);
+    if (!s)
+      return;
+    s->xfer = 0;
+    stats.delivered++;
+  }
+
+  // "FNAK:<xfer>:<missing>" from `from`
+  void nacked(uint32_t from, uint32_t xfer, uint32_t missing)
+  {
+    Slot *s = find(from, xfer);
+    if (!s || s->pending) // still sending a round: the answer to it comes later
+      return;
+    missing &= fragAll(s->count);
+    if (!missing)
+      return;
+    if (s->tries >= FRAG_TRIES)
+    {
+      stats.failed++;
+      s->xfer = 0;
+      return;
+    }
+    s->tries++;
+    s->pending = missing;
+  }
+
+  bool idle() const
+  {
+    for (const Slot &s : slots_)
+      if (s.xfer)
+        return false;
+    return true;
+  }
+  uint8_t inUse() const
+  {
+    uint8_t n = 0;
+    for (const Slot &s : slots_)
+      n += s.xfer != 0;
+    return n;
+  }
+
+  Stats stats = {};
+
+private:
+  struct Slot
+  {
+    uint32_t xfer = 0; // 0: free
+    uint32_t to;
+    uint32_t pending; // fragments still to send this round
+    uint32_t dueMs;   // once pending is empty: when the round times out
+    uint16_t total;
+    uint8_t count, tries;
+    bool urgent;
+    char buf[PAYLOAD_MAX];
+  };
+  Slot slots_[SLOTS];
+  uint32_t nextXfer_ = 0;
+
+  Slot *find(uint32_t from, uint32_t xfer)
+  {
+    for (Slot &s : slots_)
+      if (s.xfer && s.xfer == xfer && s.to == from)
+        return &s;
+    return nullptr;
+  }
+};
+
+// ======== Receiver ========
+// Reassembles up to SLOTS transfers at once, keyed by (sender, xfer). A
+// transfer that stalls with gaps is FNAKed every FRAG_GAP_MS and dropped
+// after FRAG_NAKS of them; one that cannot get a slot is ignored, and its
+// sender's timeout brings it back later.
+template <uint8_t SLOTS, uint16_t PAYLOAD_MAX>
+class FragReassembler
+{
+public:
+  enum Result : uint8_t
+  {
+    FRAG_PARTIAL,   // taken; more to come
+    FRAG_COMPLETE,  // payload() holds it: FACK it
+    FRAG_DUPLICATE, // of a transfer completed already: FACK it again
+    FRAG_NAK,       // taken, and gaps are known: send nak()
+    FRAG_BAD,       // malformed, or disagrees with the fragments before it
+    FRAG_BUSY       // every slot taken
+  };
+  struct Stats
+  {
+    uint32_t fragments, completed, duplicates, bad, busy, naks, dropped;
+  };
+
+  // One fragment (the line after "FRG:", `len` bytes) from `from`
+  Result push(uint32_t from, const char *s, size_t len, uint32_t nowMs)
+  {
+    stats.fragments++;
+    const char *end = s + len;
+    FragHeader &h = last_;
+    h.xfer = 0;
+    if (!parseFragment(s, h) || h.total > PAYLOAD_MAX)
+      return bad();
+    uint16_t chunk = fragChunk(h.total, h.count), at = h.index * chunk;
+    size_t n = end - h.data;
+    if (at >= h.total || n != (h.index + 1u == h.count ? (size_t)(h.total - at) : chunk))
+      return bad();
+    if (recentDone(from, h.xfer))
+    {
+      stats.duplicates++;
+      return FRAG_DUPLICATE;
+    }
+    Slot *sl = find(from, h.xfer);
+    if (!sl)
+    {
+      for (Slot &c : slots_)
+        if (!c.xfer)
+        {
+          sl = &c;
+          break;
+        }
+      if (!sl)
+      {
+        stats.busy++;
+        return FRAG_BUSY;
+      }
+      sl->xfer = h.xfer;
+      sl->from = from;
+      sl->count = h.count;
+      sl->total = h.total;
+      sl->got = 0;
+      sl->naks = 0;
+    }
+    else if (sl->count != h.count || sl->total != h.total)
+      return bad();
+    uint32_t bit = 1UL << h.index;
+    if (!(sl->got & bit))
+      sl->naks = 0; // progress
+    sl->got |= bit;
+    sl->lastMs = nowMs;
+    memcpy(sl->buf + at, h.data, n);
+    if (sl->got == fragAll(sl->count))
+    {
+      complete_ = sl;
+      sl->buf[sl->total] = 0;
+      remember(from, sl->xfer);
+      sl->xfer = 0; // payload() stays valid until the next push
+      stats.completed++;
+      return FRAG_COMPLETE;
+    }
+    if (h.index + 1u == h.count) // the last one (or a probe): whatever is missing was lost
+    {
+      nak_ = sl;
+      return FRAG_NAK;
+    }
+    return FRAG_PARTIAL;
+  }
+
+  // After FRAG_COMPLETE: the payload, NUL-terminated
+  const char *payload() const { return complete_->buf; }
+  uint16_t payloadLength() const { return complete_->total; }
+
+  // After FRAG_COMPLETE or FRAG_DUPLICATE: the FACK line
+  template <size_t N>
+  void ack(FixedString<N> &line) const
+  {
+    line.clear();
+    line.appendf("FACK:%x", last_.xfer);
+  }
+
+  // After FRAG_NAK, or poll() returning true: the FNAK line and its target
+  template <size_t N>
+  uint32_t nak(FixedString<N> &line)
+  {
+    stats.naks++;
+    line.clear();
+    line.appendf("FNAK:%x:%x", nak_->xfer, fragAll(nak_->count) & ~nak_->got);
+    return nak_->from;
+  }
+
+  // Times out stalled transfers, one per call; true if it left a FNAK to send
+  bool poll(uint32_t nowMs)
+  {
+    for (Slot &s : slots_)
+    {
+      if (!s.xfer || (int32_t)(nowMs - s.lastMs) < FRAG_GAP_MS)
+        continue;
+      if (s.naks >= FRAG_NAKS)
+      {
+        stats.dropped++;
+        s.xfer = 0;
+        continue;
+      }
+      s.naks++;
+      s.lastMs = nowMs;
+      nak_ = &s;
+      return true;
+    }
+    return false;
+  }
+
+  bool idle() const
+  {
+    for (const Slot &s : slots_)
+      if (s.xfer)
+        return false;
+    return true;
+  }
+  uint8_t inUse() const
+  {
+    uint8_t n = 0;
+    for (const Slot &s : slots_)
+      n += s.xfer != 0;
+    return n;
+  }
+
+  Stats stats = {};
+
+private:
+  struct Slot
+  {
+    uint32_t xfer = 0; // 0: free
+    uint32_t from;
+    uint32_t got; // fragments received
+    uint32_t lastMs;
+    uint16_t total;
+    uint8_t count, naks;
+    char buf[PAYLOAD_MAX + 1];
+  };
+  Slot slots_[SLOTS];
+  Slot *complete_ = slots_, *nak_ = slots_;
+  FragHeader last_ = {};
+  uint64_t done_[FRAG_RECENT] = {};
+  uint8_t doneNext_ = 0;
+
+  static uint64_t key(uint32_t from, uint32_t xfer) { return (uint64_t)from << 32 | xfer; }
+  Result bad()
+  {
+    stats.bad++;
+    return FRAG_BAD;
+  }
+  Slot *find(uint32_t from, uint32_t xfer)
+  {
+    for (Slot &s : slots_)
+      if (s.xfer == xfer && s.from == from)
+        return &s;
+    return nullptr;
+  }
+  void remember(uint32_t from, uint32_t xfer)
+  {
+    done_[doneNext_] = key(from, xfer);
+    doneNext_ = (doneNext_ + 1) % FRAG_RECENT;
+  }
+  bool recentDone(uint32_t from, uint32_t xfer) const
+  {
+    for (uint64_t k : done_)
+      if (k == key(from, xfer))
+        return true;
+    return false;
+  }
+};
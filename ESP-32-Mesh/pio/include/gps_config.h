@@ -0,0 +1,56 @@
+#pragma once
+#include <Arduino.h>
+#include <TinyGPSPlus.h>
+
+// ================== GPS CONFIG ==================
+// Baud the module powers up at, and the one we switch it to.
+#define GPS_BOOT_BAUD 9600
+#define GPS_FAST_BAUD 38400
+// Navigation solution period (500 ms = 2 Hz)
+#define GPS_RATE_MS 500
+// How long to wait for a UBX reply before giving up on a baud rate
+#define GPS_PROBE_TIMEOUT_MS 300
+#define GPS_ACK_TIMEOUT_MS 150
+// Persist last fix at most this often (NVS wear)
+#define GPS_SAVE_PERIOD_MS (10UL * 60UL * 1000UL)
+// Accuracy we claim for a stored position hint (the node may have moved)
+#define GPS_HINT_POS_ACC_M 5000
+// ================== END GPS CONFIG ==============
+
+enum GpsChip
+{
+  GPS_CHIP_UNKNOWN, // nothing answered UBX, plain NMEA module
+  GPS_CHIP_UBX6,    // u-blox 6/7: aiding via AID-INI
+  GPS_CHIP_UBX8     // u-blox M8 and newer: aiding via MGA-INI
+};
+
+struct GpsConfigResult
+{
+  GpsChip chip = GPS_CHIP_UNKNOWN;
+  uint32_t baud = GPS_BOOT_BAUD;
+  uint8_t acked = 0;      // config commands the module acknowledged
+  uint8_t sent = 0;       // config commands sent
+  bool hintSent = false;  // position (and maybe time) aiding was sent
+};
+
+// Last known fix, stored in NVS and replayed as an aiding hint at boot.
+struct GpsFixHint
+{
+  int32_t latE7 = 0;
+  int32_t lonE7 = 0;
+  int32_t altCm = 0;
+  uint32_t unixTime = 0;
+};
+
+// Probes the module on `port`, reconfigures it (baud, rate, sentences) and
+// replays the last stored fix. Leaves `port` open at the baud in the result.
+GpsConfigResult configureGPS(HardwareSerial &port, int8_t rxPin, int8_t txPin);
+
+// Writes one UBX frame (sync, header, payload, checksum) to `out`.
+size_t ubxSend(Print &out, uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len);
+
+// Call periodically with the parser; saves the fix to NVS every GPS_SAVE_PERIOD_MS.
+void gpsMaybeSaveHint(TinyGPSPlus &gps);
+
+bool gpsLoadHint(GpsFixHint &hint);
+uint32_t gpsUnixTime(TinyGPSPlus &gps); // 0 if date/time not valid
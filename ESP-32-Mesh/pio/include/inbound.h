@@ -0,0 +1,318 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "fixed_buffers.h"
+
+// Parsers for what reaches a node from outside: mesh packets, the serial
+// bridge, portal query args and the GPS UART. They take any bytes, never
+// read past the end of the input and cost linear time in its length.
+#define SERIAL_LINE_MAX 384 // serial -> mesh bridge line (an 8-corner alert polygon is ~200)
+#define UBX_FRAME_MAX 1024 // longer UBX "frames" are line noise at a wrong baud rate
+
+// ======== Mesh control lines ========
+enum MsgKind
+{
+  MK_WHO,
+  MK_MASTER,
+  MK_ALERT,
+  MK_ACK,
+  MK_DATA,
+  MK_DIRECT,
+  MK_FRAG,
+  MK_ZIP,
+  MK_AGG,
+  MK_COUNT
+};
+
+inline MsgKind classifyMsg(const char *msg)
+{
+  if (!strcmp(msg, "WHO_IS_MASTER?"))
+    return MK_WHO;
+  if (!strncmp(msg, "MASTER:", 7))
+    return MK_MASTER;
+  if (!strncmp(msg, "ALERT:", 6))
+    return MK_ALERT;
+  if (!strncmp(msg, "ACK:", 4) || !strncmp(msg, "MACK:", 5) || !strncmp(msg, "AACK:", 5))
+    return MK_ACK;
+  if (!strncmp(msg, "MSG:", 4))
+    return MK_DIRECT;
+  if (!strncmp(msg, "FRG:", 4) || !strncmp(msg, "FACK:", 5) || !strncmp(msg, "FNAK:", 5))
+    return MK_FRAG;
+  if (!strncmp(msg, "Z:", 2) || !strncmp(msg, "ZCAP", 4))
+    return MK_ZIP;
+  if (!strncmp(msg, "AGG", 3))
+    return MK_AGG;
+  return MK_DATA;
+}
+
+// 1..8 hex digits, not 0. Unlike strtoul: no sign, spaces or "0x", and no
+// wrapping. Returns the first character after the digits, or nullptr.
+inline const char *parseHexId(const char *s, uint32_t &id)
+{
+  id = 0;
+  uint8_t n = 0;
+  for (;; s++, n++)
+  {
+    char c = *s;
+    uint8_t d;
+    if (c >= '0' && c <= '9')
+      d = c - '0';
+    else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+      d = (c | 0x20) - 'a' + 10;
+    else
+      break;
+    if (n == 8)
+      return nullptr;
+    id = id << 4 | d;
+  }
+  return n && id ? s : nullptr;
+}
+
+// "MASTER:<node id>": decimal, whole line. Only the master announces
+// itself, so a line naming any node but its sender is ignored.
+inline bool parseMasterAnnounce(const char *msg, uint32_t from, uint32_t &id)
+{
+  if (strncmp(msg, "MASTER:", 7))
+    return false;
+  uint64_t v = 0;
+  const char *s = msg + 7;
+  for (; *s >= '0' && *s <= '9'; s++)
+  {
+    v = v * 10 + (*s - '0');
+    if (v > UINT32_MAX)
+      return false;
+  }
+  if (s == msg + 7 || *s || !v || v != from)
+    return false;
+  id = v;
+  return true;
+}
+
+// "<id hex>:<state>" after "AACK:"
+inline bool parseAlertAck(const char *ack, uint32_t &id, char &state)
+{
+  const char *s = parseHexId(ack, id);
+  if (!s || s[0] != ':' || !s[1] || s[2])
+    return false;
+  state = s[1];
+  return true;
+}
+
+// "<id hex>" after "MACK:"
+inline bool parseDirectAck(const char *ack, uint32_t &id)
+{
+  const char *s = parseHexId(ack, id);
+  return s && !*s;
+}
+
+// "MSG:<id hex>:<text>"; `text` points into msg
+inline bool parseDirect(const char *msg, uint32_t &id, const char *&text)
+{
+  if (strncmp(msg, "MSG:", 4))
+    return false;
+  const char *s = parseHexId(msg + 4, id);
+  if (!s || *s != ':')
+    return false;
+  text = s + 1;
+  return true;
+}
+
+// The gateway's "TO:<id hex>:<userid>:<text>". `id` is set whenever it
+// parsed, so a bad request can still be answered by id. The user id is
+// only cut out here; the caller checks it like any other.
+inline bool parseDirectRequest(const char *line, uint32_t &id, char *userId, size_t userIdMax, const char *&text)
+{
+  id = 0;
+  if (strncmp(line, "TO:", 3))
+    return false;
+  const char *s = parseHexId(line + 3, id);
+  if (!s || *s != ':')
+    return false;
+  const char *uid = s + 1, *colon = strchr(uid, ':');
+  if (!colon || colon == uid || (size_t)(colon - uid) > userIdMax)
+    return false;
+  memcpy(userId, uid, colon - uid);
+  userId[colon - uid] = 0;
+  text = colon + 1;
+  return true;
+}
+
+// "<key><sep><value>", as in "CFG:<key>=<value>" and "!cfg set <key> <value>".
+// Copies the key to `key` (`keySize` bytes with the NUL); returns the
+// value, or nullptr if there is no separator or the key does not fit.
+inline const char *splitKeyValue(const char *s, char sep, char *key, size_t keySize)
+{
+  const char *p = strchr(s, sep);
+  if (!p || (size_t)(p - s) >= keySize)
+    return nullptr;
+  memcpy(key, s, p - s);
+  key[p - s] = 0;
+  return p + 1;
+}
+
+// ======== Serial bridge ========
+// Splits the UART into '\n'-terminated lines of printable ASCII; other
+// bytes are left out. A line longer than N-1 characters is dropped whole
+// rather than acted on in part.
+template <size_t N>
+class LineAssembler
+{
+public:
+  // Feeds one byte; true when it completed a line, which line() holds
+  // until the next call
+  bool push(char c)
+  {
+    if (done_)
+    {
+      line_.clear();
+      done_ = false;
+    }
+    if (c == '\n')
+    {
+      done_ = true;
+      if (line_.truncated())
+        dropped_++;
+      return line_.length() && !line_.truncated();
+    }
+    if (c >= 32 && c <= 126)
+      line_.append(c);
+    return false;
+  }
+  const FixedString<N> &line() const { return line_; }
+  uint32_t dropped() const { return dropped_; } // overlong lines
+
+private:
+  FixedString<N> line_;
+  bool done_ = false;
+  uint32_t dropped_ = 0;
+};
+
+// ======== Portal ========
+// A message typed on the portal: fits a mesh message whole, and carries
+// no control characters (UTF-8 is fine)
+inline bool portalMessageValid(const char *s, size_t len, size_t max)
+{
+  if (!len || len > max)
+    return false;
+  for (size_t i = 0; i < len; i++)
+    if ((uint8_t)s[i] < 32 || s[i] == 127)
+      return false;
+  return true;
+}
+
+// `s` as HTML text; false if it did not fit
+template <size_t N>
+bool appendHtml(FixedString<N> &out, const char *s, size_t len)
+{
+  bool fits = true;
+  for (size_t i = 0; i < len; i++)
+  {
+    switch (s[i])
+    {
+    case '<':
+      fits &= out.append("&lt;");
+      break;
+    case '>':
+      fits &= out.append("&gt;");
+      break;
+    case '&':
+      fits &= out.append("&amp;");
+      break;
+    case '"':
+      fits &= out.append("&quot;");
+      break;
+    case '\'':
+      fits &= out.append("&#39;");
+      break;
+    default:
+      fits &= out.append(s[i]);
+    }
+  }
+  return fits;
+}
+
+// ======== GPS ========
+inline bool validLatLng(double lat, double lng)
+{
+  return lat >= -90 && lat <= 90 && lng >= -180 && lng <= 180; // false for NaN too
+}
+
+// A fix in degrees as 1e-7 degree integers. TinyGPSPlus keeps whatever
+// degrees the sentence had (up to 65535), which would overflow int32.
+inline bool fixToE7(double lat, double lng, int32_t &latE7, int32_t &lonE7)
+{
+  if (!validLatLng(lat, lng))
+    return false;
+  latE7 = (int32_t)(lat * 1e7);
+  lonE7 = (int32_t)(lng * 1e7);
+  return true;
+}
+
+// Picks UBX frames out of the GPS UART stream, which is mostly NMEA text.
+// Frames with a bad checksum are skipped.
+struct UbxScanner
+{
+  uint8_t cls = 0, id = 0;
+  uint16_t len = 0; // payload length of the frame just completed
+
+  // Feeds one byte, copying up to `cap` payload bytes to `buf`. True when
+  // it completed a frame.
+  bool push(uint8_t c, uint8_t *buf, uint16_t cap)
+  {
+    switch (state_)
+    {
+    case 0:
+      state_ = c == 0xB5;
+      return false;
+    case 1:
+      state_ = c == 0x62 ? 2 : c == 0xB5; // "\xB5\xB5b" still syncs
+      ckA_ = ckB_ = 0;
+      return false;
+    case 2:
+    case 3:
+    case 4:
+    case 5:
+      hdr_[state_ - 2] = c;
+      sum(c);
+      if (++state_ == 6)
+      {
+        pos_ = 0;
+        uint16_t n = hdr_[2] | hdr_[3] << 8;
+        if (n > UBX_FRAME_MAX)
+          state_ = 0;
+        else if (!n)
+          state_ = 7;
+      }
+      return false;
+    case 6:
+      if (pos_ < cap && buf)
+        buf[pos_] = c;
+      sum(c);
+      if (++pos_ == (hdr_[2] | hdr_[3] << 8))
+        state_ = 7;
+      return false;
+    case 7:
+      state_ = c == ckA_ ? 8 : 0;
+      return false;
+    default: // CK_B
+      state_ = 0;
+      if (c != ckB_)
+        return false;
+      cls = hdr_[0];
+      id = hdr_[1];
+      len = hdr_[2] | hdr_[3] << 8;
+      return true;
+    }
+  }
+
+private:
+  uint8_t state_ = 0, hdr_[4] = {0}, ckA_ = 0, ckB_ = 0;
+  uint16_t pos_ = 0;
+
+  void sum(uint8_t c)
+  {
+    ckA_ += c;
+    ckB_ += ckA_;
+  }
+};
@@ -0,0 +1,174 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include "fixed_buffers.h"
+
+// End-to-end latency on the master. Clients stamp each report with
+// mesh-synchronised times (created, handed to the net core, sent) and the
+// master adds the arrival time against the same clock.
+#define LATENCY_SOURCES 8  // per-node histograms; further nodes share "other"
+#define LATENCY_MAX_HOPS 6 // hop histograms 1..5, and 6 for anything deeper
+
+// Log-linear millisecond histogram: exact below 16 ms, then 8 buckets per
+// power of two (at most ~12% error) up to ~17 minutes. Percentiles report
+// the bucket's upper edge.
+struct LatencyHistogram
+{
+  static const uint8_t LINEAR = 16;
+  static const uint8_t SUB_BITS = 3;
+  static const uint8_t MAX_EXP = 19;
+  static const uint16_t BUCKETS = LINEAR + (MAX_EXP - 3) * (1 << SUB_BITS);
+
+  uint32_t counts[BUCKETS];
+  uint32_t total;
+  uint32_t maxMs;
+
+  void clear()
+  {
+    memset(counts, 0, sizeof(counts));
+    total = maxMs = 0;
+  }
+
+  static uint16_t bucketFor(uint32_t ms)
+  {
+    if (ms < LINEAR)
+      return ms;
+    uint8_t e = 31 - __builtin_clz(ms); // 4..31
+    if (e > MAX_EXP)
+      return BUCKETS - 1;
+    return LINEAR + (e - 4) * (1 << SUB_BITS) + ((ms >> (e - SUB_BITS)) & ((1 << SUB_BITS) - 1));
+  }
+  static uint32_t upperEdge(uint16_t b)
+  {
+    if (b < LINEAR)
+      return b;
+    uint8_t e = 4 + (b - LINEAR) / (1 << SUB_BITS);
+    uint32_t sub = (b - LINEAR) % (1 << SUB_BITS);
+    return (1UL << e) + ((sub + 1) << (e - SUB_BITS)) - 1;
+  }
+
+  void observe(uint32_t ms)
+  {
+    counts[bucketFor(ms)]++;
+    total++;
+    if (ms > maxMs)
+      maxMs = ms;
+  }
+
+  // pct in 1..100
+  uint32_t percentile(uint8_t pct) const
+  {
+    if (total == 0)
+      return 0;
+    uint32_t rank = ((uint64_t)total * pct + 99) / 100, seen = 0;
+    for (uint16_t b = 0; b < BUCKETS; b++)
+    {
+      seen += counts[b];
+      if (seen >= rank)
+      {
+        uint32_t edge = upperEdge(b);
+        return edge < maxMs ? edge : maxMs;
+      }
+    }
+    return maxMs;
+  }
+
+  template <size_t N>
+  void appendJson(FixedString<N> &out) const
+  {
+    out.appendf("{\"n\":%u,\"p50\":%u,\"p95\":%u,\"p99\":%u,\"max\":%u}", total, percentile(50), percentile(95),
+                percentile(99), maxMs);
+  }
+};
+
+enum LatencyClass : uint8_t
+{
+  LAT_ROUTINE,
+  LAT_SOS,
+  LAT_CLASSES
+};
+
+class LatencyStats
+{
+public:
+  LatencyStats() { clear(); }
+
+  void clear()
+  {
+    for (uint8_t i = 0; i < LAT_CLASSES; i++)
+      byClass_[i].clear();
+    for (uint8_t i = 0; i < LATENCY_MAX_HOPS; i++)
+      byHops_[i].clear();
+    for (uint8_t i = 0; i <= LATENCY_SOURCES; i++)
+    {
+      bySource_[i].clear();
+      sourceIds_[i] = 0;
+    }
+  }
+
+  uint32_t samples() const { return byClass_[LAT_ROUTINE].total + byClass_[LAT_SOS].total; }
+
+  // hops == 0 when the route is unknown (left out of the hop histograms)
+  void record(uint32_t source, uint8_t hops, LatencyClass cls, uint32_t ms)
+  {
+    byClass_[cls].observe(ms);
+    if (hops > 0)
+      byHops_[(hops < LATENCY_MAX_HOPS ? hops : LATENCY_MAX_HOPS) - 1].observe(ms);
+    bySource_[sourceSlot(source)].observe(ms);
+  }
+
+  // {"latency_ms":{"sos":{..},"routine":{..},"hops":{"1":{..}},"sources":{"id":{..},"other":{..}}}}
+  template <size_t N>
+  void appendJson(FixedString<N> &out) const
+  {
+    out.append("{\"latency_ms\":{\"sos\":");
+    byClass_[LAT_SOS].appendJson(out);
+    out.append(",\"routine\":");
+    byClass_[LAT_ROUTINE].appendJson(out);
+    out.append(",\"hops\":{");
+    bool first = true;
+    for (uint8_t h = 0; h < LATENCY_MAX_HOPS; h++)
+    {
+      if (!byHops_[h].total)
+        continue;
+      out.appendf("%s\"%u%s\":", first ? "" : ",", h + 1, h + 1 == LATENCY_MAX_HOPS ? "+" : "");
+      byHops_[h].appendJson(out);
+      first = false;
+    }
+    out.append("},\"sources\":{");
+    first = true;
+    for (uint8_t i = 0; i <= LATENCY_SOURCES; i++)
+    {
+      if (!bySource_[i].total)
+        continue;
+      if (i < LATENCY_SOURCES)
+        out.appendf("%s\"%u\":", first ? "" : ",", sourceIds_[i]);
+      else
+        out.appendf("%s\"other\":", first ? "" : ",");
+      bySource_[i].appendJson(out);
+      first = false;
+    }
+    out.append("}}}");
+  }
+
+private:
+  LatencyHistogram byClass_[LAT_CLASSES];
+  LatencyHistogram byHops_[LATENCY_MAX_HOPS];
+  LatencyHistogram bySource_[LATENCY_SOURCES + 1]; // last slot: "other"
+  uint32_t sourceIds_[LATENCY_SOURCES + 1];
+
+  uint8_t sourceSlot(uint32_t id)
+  {
+    for (uint8_t i = 0; i < LATENCY_SOURCES; i++)
+    {
+      if (sourceIds_[i] == id)
+        return i;
+      if (sourceIds_[i] == 0)
+      {
+        sourceIds_[i] = id;
+        return i;
+      }
+    }
+    return LATENCY_SOURCES;
+  }
+};
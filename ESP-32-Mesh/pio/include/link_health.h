@@ -0,0 +1,122 @@
+#pragma once
+#include <stdint.h>
+
+// Delivery accounting from per-node report sequence numbers (master side).
+// A 64-bit window remembers which of the latest sequence numbers arrived;
+// bit i stands for highest - i. A number counts as lost only once it
+// leaves the window unreceived, so late arrivals within 64 reports are
+// reordered, not lost. Until then it is "pending". Reports also carry a
+// random per-boot id, so a rebooted sender starting again at 1 is not
+// mistaken for a burst of duplicates.
+#define SEQ_WINDOW 64
+
+struct SeqWindow
+{
+  uint32_t boot; // sender's random per-boot id
+  uint32_t highest;
+  uint64_t bits;
+  uint32_t received; // distinct sequence numbers
+  uint32_t duplicates;
+  uint32_t reordered; // arrived after a higher number
+  uint32_t stale;     // arrived after already being counted lost
+  uint32_t lost;      // left the window unreceived
+  uint32_t bursts;    // finished runs of consecutive losses
+  uint16_t maxBurst;
+  uint16_t curBurst;
+  uint16_t restarts; // sender rebooted
+  bool started;
+
+  enum Result : uint8_t
+  {
+    SEQ_NEW,
+    SEQ_LATE,
+    SEQ_DUPLICATE,
+    SEQ_STALE
+  };
+
+  Result observe(uint32_t bootId, uint32_t seq)
+  {
+    if (started && bootId != boot)
+    {
+      // Whatever the old boot had not delivered is lost; counters carry on
+      retire(SEQ_WINDOW);
+      endBurst();
+      restarts++;
+      started = false;
+    }
+    if (!started)
+    {
+      started = true;
+      boot = bootId;
+      highest = seq;
+      bits = ~0ULL; // nothing before the first number counts as missing
+      received++;
+      return SEQ_NEW;
+    }
+    int32_t ahead = seq - highest;
+    if (ahead > 0)
+    {
+      retire(ahead);
+      highest = seq;
+      bits |= 1;
+      received++;
+      return SEQ_NEW;
+    }
+    if (-ahead >= SEQ_WINDOW)
+    {
+      stale++;
+      return SEQ_STALE;
+    }
+    uint64_t mask = 1ULL << -ahead;
+    if (bits & mask)
+    {
+      duplicates++;
+      return SEQ_DUPLICATE;
+    }
+    bits |= mask;
+    received++;
+    reordered++;
+    return SEQ_LATE;
+  }
+
+  // Numbers still inside the window and not (yet) received
+  uint32_t pending() const { return __builtin_popcountll(~bits); }
+  uint32_t expected() const { return received + lost + pending(); }
+  // Delivery ratio in 1/10000 (10000 when nothing was expected yet)
+  uint16_t deliveryBp() const
+  {
+    uint32_t e = expected();
+    return e ? (uint64_t)received * 10000 / e : 10000;
+  }
+
+private:
+  // Slides the window forward by n, oldest bits first
+  void retire(uint32_t n)
+  {
+    uint32_t inWindow = n < SEQ_WINDOW ? n : SEQ_WINDOW;
+    for (uint32_t i = 0; i < inWindow; i++)
+    {
+      if (bits & (1ULL << (SEQ_WINDOW - 1 - i)))
+        endBurst();
+      else
+        addLost(1);
+    }
+    if (n > SEQ_WINDOW) // skipped numbers that never entered the window
+      addLost(n - SEQ_WINDOW);
+    bits = n >= SEQ_WINDOW ? 0 : bits << n;
+  }
+  void addLost(uint32_t n)
+  {
+    lost += n;
+    curBurst = curBurst + n > 0xFFFF ? 0xFFFF : curBurst + n;
+  }
+  void endBurst()
+  {
+    if (!curBurst)
+      return;
+    bursts++;
+    if (curBurst > maxBurst)
+      maxBurst = curBurst;
+    curBurst = 0;
+  }
+};
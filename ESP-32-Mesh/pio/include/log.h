@@ -0,0 +1,145 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+
+// Deferred binary logging. LOG_x(MODULE, fmt, args...) compiles to nothing
+// when level x is above LOG_LEVEL_<MODULE>. Otherwise it stores a 32-bit
+// hash of the format string, a millisecond stamp and the raw arguments in
+// a ring that logTask drains to the serial port as FRAME_LOG frames, so
+// callers never format text or wait on the UART.
+//
+// The format strings themselves stay on the host: scripts/log_table.py
+// (a pre-build step) collects them into log_formats.json and
+// serial_python/log_decode.py turns the frames back into text. Formats
+// must therefore be string literals. Do not log from ISRs.
+enum LogLevel : uint8_t
+{
+  LL_NONE,
+  LL_ERROR,
+  LL_WARN,
+  LL_INFO,
+  LL_DEBUG
+};
+
+// Per-module levels; override with -D build flags
+#ifndef LOG_LEVEL_SYS
+#define LOG_LEVEL_SYS LL_WARN // boot, heap, idle and task reports
+#endif
+#ifndef LOG_LEVEL_MESH
+#define LOG_LEVEL_MESH LL_WARN // painlessMesh, master discovery, ACKs
+#endif
+#ifndef LOG_LEVEL_PORTAL
+#define LOG_LEVEL_PORTAL LL_WARN // softAP and web handlers
+#endif
+#ifndef LOG_LEVEL_GPS
+#define LOG_LEVEL_GPS LL_WARN
+#endif
+
+#define LOG_RING_SIZE 4096 // bytes, power of two
+#define LOG_RECORD_MAX 96  // one record: header + arguments
+#define LOG_STR_MAX 48     // longer %s arguments are cut
+#define LOG_FRAME_MAX 512  // records per FRAME_LOG payload
+#define LOG_TASK_STACK 2048
+#define LOG_TASK_PRIO 1
+
+// FNV-1a, evaluated at compile time for the literal format strings
+constexpr uint32_t logHash(const char *s, uint32_t h = 2166136261UL)
+{
+  return *s ? logHash(s + 1, (uint32_t)((h ^ (uint8_t)*s) * 16777619UL)) : h;
+}
+
+// Record layout: u8 length, u32 format id, u32 millis, arguments.
+// Arguments follow the C++ type: integers as u32 (u64 for 64-bit types),
+// floating point as double, strings as u8 length + bytes.
+struct LogRecord
+{
+  static const uint8_t HEADER = 9;
+  uint8_t buf[LOG_RECORD_MAX];
+  uint8_t len;
+
+  void put(const void *p, size_t n)
+  {
+    if (len + n > LOG_RECORD_MAX)
+      n = LOG_RECORD_MAX - len; // the decoder stops at the end of the record
+    memcpy(buf + len, p, n);
+    len += n;
+  }
+};
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type logPut(LogRecord &r, T v)
+{
+  if (sizeof(T) > 4)
+  {
+    uint64_t x = (uint64_t)v;
+    r.put(&x, 8);
+  }
+  else
+  {
+    uint32_t x = (uint32_t)v;
+    r.put(&x, 4);
+  }
+}
+inline void logPut(LogRecord &r, double v) { r.put(&v, 8); }
+inline void logPut(LogRecord &r, const void *p)
+{
+  uint32_t x = (uint32_t)(uintptr_t)p;
+  r.put(&x, 4);
+}
+inline void logPut(LogRecord &r, const char *s)
+{
+  size_t n = s ? strlen(s) : 0;
+  if (n > LOG_STR_MAX)
+    n = LOG_STR_MAX;
+  if (r.len + 1 + n > LOG_RECORD_MAX)
+    n = r.len + 1 < LOG_RECORD_MAX ? LOG_RECORD_MAX - r.len - 1 : 0;
+  uint8_t len8 = n;
+  r.put(&len8, 1);
+  r.put(s, n);
+}
+
+inline void logPutAll(LogRecord &) {}
+template <typename T, typename... Rest>
+void logPutAll(LogRecord &r, T v, Rest... rest)
+{
+  logPut(r, v);
+  logPutAll(r, rest...);
+}
+
+void logBegin();
+void logCommit(LogRecord &r); // stamps and queues; drops (and counts) when full
+uint32_t logDropped();
+
+template <typename... Args>
+void logWrite(uint32_t id, Args... args)
+{
+  LogRecord r;
+  r.len = 1;
+  r.put(&id, 4);
+  r.len = LogRecord::HEADER; // millis filled in by logCommit
+  logPutAll(r, args...);
+  r.buf[0] = r.len;
+  logCommit(r);
+}
+
+// Never called; lets the compiler check arguments against the format
+inline void logCheckFormat(const char *, ...) __attribute__((format(printf, 1, 2)));
+inline void logCheckFormat(const char *, ...) {}
+
+#define LOG_AT(level, mod, fmt, ...)                                                   \
+  do                                                                                   \
+  {                                                                                    \
+    if ((level) <= LOG_LEVEL_##mod)                                                    \
+    {                                                                                  \
+      if (false)                                                                       \
+        logCheckFormat(fmt, ##__VA_ARGS__);                                            \
+      logWrite(std::integral_constant<uint32_t, logHash(fmt)>::value, ##__VA_ARGS__); \
+    }                                                                                  \
+  } while (0)
+
+#define LOG_ERROR(mod, fmt, ...) LOG_AT(LL_ERROR, mod, fmt, ##__VA_ARGS__)
+#define LOG_WARN(mod, fmt, ...) LOG_AT(LL_WARN, mod, fmt, ##__VA_ARGS__)
+#define LOG_INFO(mod, fmt, ...) LOG_AT(LL_INFO, mod, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(mod, fmt, ...) LOG_AT(LL_DEBUG, mod, fmt, ##__VA_ARGS__)
@@ -0,0 +1,43 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "fixed_buffers.h"
+#include "mesh_msg.h"
+#include "metrics.h"
+#include "roster.h"
+#include "dedupe.h"
+#include "latency.h"
+
+// ================== MASTER INGEST CONFIG ==================
+#define ROSTER_CAPACITY 64 // nodes the master tracks; least recently seen is evicted
+// Duplicate reports: exact LRU, then 2 Bloom generations
+#define DEDUPE_LRU 256          // recent keys, 8 bytes each
+#define DEDUPE_BLOOM_BITS 32768 // per generation (2 x 4 KB); more bits remember further back
+#define DEDUPE_FP_PPM 10        // chance per million that a new report is taken for a copy
+#define UPLINK_LINE_MAX (MESH_JSON_MAX + 32) // "[MASTER] RX from <id>: " + a report + '\n'
+// ================== END MASTER INGEST CONFIG ==============
+
+// The master's path for a packet from a client, up to the uplink line the
+// gateway parses. It uses neither painlessMesh nor Serial, so the host
+// replay tool (ESP-32-Mesh/replay) runs this same code. Master image only.
+extern Roster<ROSTER_CAPACITY> roster;
+extern DedupeFilter<DEDUPE_LRU, DEDUPE_BLOOM_BITS> dedupe;
+extern LatencyStats latency;
+extern Counter dedupeDropped; // defined with the other metrics
+extern Counter zRefused;      // Z: lines that did not unpack
+
+// Counts any packet from `from` (reports, ACKs, ...) against its roster entry
+RosterEntry &ingestTouch(uint32_t from, uint32_t nowMs, size_t len, uint8_t hops);
+// A client's packet as text: a packed report ("Z:...", compress.h) is
+// unpacked into a buffer of its own, anything else returned as it is.
+// nullptr if it does not unpack; `len` is updated.
+const char *ingestUnpack(const char *msg, size_t &len);
+// Client JSON reports: roster fields and latency stamps, `arrival` in mesh
+// time (us). Returns false for a copy of a report already taken in, which
+// must not reach the uplink and leaves the roster alone. Position and SOS
+// come only from the newest report, not one that arrives after it.
+bool ingestReport(RosterEntry &node, const char *msg, size_t len, uint32_t arrival);
+// "[MASTER] RX from <from>: <msg>\n", for serial_python/read_serial.py.
+// Always one whole line: control characters become spaces, and a packet
+// too long for the line is cut.
+void formatUplink(FixedString<UPLINK_LINE_MAX> &line, uint32_t from, const char *msg, size_t len);
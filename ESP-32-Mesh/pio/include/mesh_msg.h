@@ -0,0 +1,136 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include "fixed_buffers.h"
+#include "role.h"
+
+// Descriptors passed between the app core (button, GPS, UI, outbox) and the
+// net core (painlessMesh, serial bridge) through SpscRing; the portal's
+// handlers reach the net core the same way.
+// Text payloads live in msgPool; the descriptor only carries the handle, and
+// whoever consumes the descriptor releases it.
+#define MESH_MSG_TEXT_MAX 192
+// Portal messages may be longer; those take one of a few longMsgPool
+// buffers instead (see setLongText)
+#define USER_MSG_MAX 480
+// A client report as serialized for the master: ~300 bytes of fields and
+// the message, every quote or backslash in it escaped to two bytes
+#define MESH_JSON_MAX (320 + 2 * USER_MSG_MAX)
+// Clients hold up to OUTBOX_CAPACITY of these waiting for the master; the
+// master has no outbox to fill
+#if RESQME_ROLE_MASTER
+#define MSG_POOL_COUNT 24
+#define LONG_MSG_POOL_COUNT 2
+#else
+#define MSG_POOL_COUNT 32
+#define LONG_MSG_POOL_COUNT 4
+#endif
+
+enum MeshMsgType : uint8_t
+{
+  // app -> net
+  CMD_SEND,       // text: message for the master; a/b: micros() when created / queued
+  CMD_POSITION,   // a/b: last fix, 1e-7 degrees
+  CMD_ENTER_AP,   // tear down the mesh and open the pairing portal
+  CMD_ENTER_MESH, // close the portal and rejoin the mesh
+  CMD_PING,       // stress mode: echo back as EVT_PONG
+  CMD_ALERT_CONFIRM, // a: id of the alert the user confirmed
+  CMD_SET_USERID, // text: user id entered on the portal
+  CMD_SET_CONFIG, // text: "key=value" from the portal, live fields only
+  // net -> app
+  EVT_ALERT,      // text: alert to show; a: severity 0-3 (sets the buzz length); b: alert id
+  EVT_MASTER,     // node: master id, 0 when lost
+  EVT_NODES,      // a: nodes in the mesh
+  EVT_PORTAL_MSG, // text: message submitted on the portal
+  EVT_PORTAL_DONE, // provisioning finished: close the portal
+  EVT_CONFIG,     // a live config field changed
+  EVT_PONG,
+};
+
+static_assert(USER_MSG_MAX >= MESH_MSG_TEXT_MAX, "long messages are the longer ones");
+
+enum MeshMsgFlags : uint8_t
+{
+  MSG_FLAG_SOS = 1 << 0,  // CMD_SEND from the SOS button (latency class)
+  MSG_FLAG_LONG = 1 << 1, // buf is a longMsgPool handle
+};
+
+typedef BufferPool<MSG_POOL_COUNT, MESH_MSG_TEXT_MAX> MsgPool;
+typedef BufferPool<LONG_MSG_POOL_COUNT, USER_MSG_MAX + 1> LongMsgPool;
+extern MsgPool msgPool;
+extern LongMsgPool longMsgPool;
+
+struct MeshMsg
+{
+  MeshMsgType type;
+  int8_t buf;    // msgPool (or longMsgPool) handle, MsgPool::NONE when there is no text
+  uint8_t flags; // MeshMsgFlags
+  uint16_t len;  // text bytes (not counting the terminator)
+  uint32_t node; // node id argument, if any
+  int32_t a, b;  // type-specific numbers
+
+  void init(MeshMsgType t)
+  {
+    type = t;
+    buf = MsgPool::NONE;
+    len = 0;
+    flags = 0;
+    node = 0;
+    a = b = 0;
+  }
+
+  // Copies text into a pool buffer; false (and no text) if the pool is empty
+  bool setText(const char *s, size_t n)
+  {
+    if (n == 0)
+      return true;
+    buf = msgPool.alloc();
+    if (buf == MsgPool::NONE)
+      return false;
+    if (n >= MESH_MSG_TEXT_MAX)
+      n = MESH_MSG_TEXT_MAX - 1;
+    char *d = msgPool.data(buf);
+    memcpy(d, s, n);
+    d[n] = 0;
+    len = n;
+    return true;
+  }
+
+  // Like setText, but up to USER_MSG_MAX bytes; text that does not fit a
+  // msgPool buffer goes to longMsgPool
+  bool setLongText(const char *s, size_t n)
+  {
+    if (n < MESH_MSG_TEXT_MAX)
+      return setText(s, n);
+    buf = longMsgPool.alloc();
+    if (buf == LongMsgPool::NONE)
+      return false;
+    flags |= MSG_FLAG_LONG;
+    if (n > USER_MSG_MAX)
+      n = USER_MSG_MAX;
+    char *d = longMsgPool.data(buf);
+    memcpy(d, s, n);
+    d[n] = 0;
+    len = n;
+    return true;
+  }
+
+  const char *text() const
+  {
+    if (buf == MsgPool::NONE)
+      return "";
+    return flags & MSG_FLAG_LONG ? longMsgPool.data(buf) : msgPool.data(buf);
+  }
+  Span span() const { return Span(text(), len); }
+
+  void release()
+  {
+    if (flags & MSG_FLAG_LONG)
+      longMsgPool.release(buf);
+    else
+      msgPool.release(buf);
+    flags &= ~MSG_FLAG_LONG;
+    buf = MsgPool::NONE;
+    len = 0;
+  }
+};
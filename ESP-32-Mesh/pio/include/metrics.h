@@ -0,0 +1,185 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+// Counters, gauges and fixed-bucket histograms that can be updated from any
+// task with a single relaxed atomic op and no allocation. A registry keeps
+// name -> metric pointers for the text (/metrics) and binary exporters.
+
+struct Counter
+{
+  std::atomic<uint32_t> value{0};
+  void inc(uint32_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+  uint32_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+struct Gauge
+{
+  std::atomic<int32_t> value{0};
+  void set(int32_t v) { value.store(v, std::memory_order_relaxed); }
+  int32_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+// Power-of-two buckets: bucket i counts values < 2^i, the last is +Inf.
+struct Histogram
+{
+  static const uint8_t BUCKETS = 16;
+  std::atomic<uint32_t> counts[BUCKETS];
+  std::atomic<uint32_t> sum{0};
+  std::atomic<uint32_t> count{0};
+
+  Histogram()
+  {
+    for (uint8_t i = 0; i < BUCKETS; i++)
+      counts[i].store(0, std::memory_order_relaxed);
+  }
+
+  static uint8_t bucketFor(uint32_t v)
+  {
+    uint8_t b = v ? 32 - __builtin_clz(v) : 0; // bit width: v < 2^b
+    return b < BUCKETS ? b : BUCKETS - 1;
+  }
+  static uint32_t upperBound(uint8_t i) { return 1UL << i; } // exclusive
+
+  void observe(uint32_t v)
+  {
+    counts[bucketFor(v)].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(v, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+  }
+};
+
+enum MetricKind : uint8_t
+{
+  METRIC_COUNTER,
+  METRIC_GAUGE,
+  METRIC_HISTOGRAM
+};
+
+struct MetricDesc
+{
+  const char *name; // Prometheus style, labels allowed: rx_total{type="alert"}
+  MetricKind kind;
+  const void *metric;
+};
+
+template <uint8_t CAPACITY>
+class MetricsRegistry
+{
+public:
+  bool add(const char *name, const Counter &c) { return add(name, METRIC_COUNTER, &c); }
+  bool add(const char *name, const Gauge &g) { return add(name, METRIC_GAUGE, &g); }
+  bool add(const char *name, const Histogram &h) { return add(name, METRIC_HISTOGRAM, &h); }
+
+  uint8_t size() const { return count_; }
+  const MetricDesc &at(uint8_t i) const { return descs_[i]; }
+
+  // Prometheus text format, one line at a time into `emit(line, len)`.
+  template <typename Emit>
+  void writeText(Emit emit) const
+  {
+    char line[128];
+    for (uint8_t i = 0; i < count_; i++)
+    {
+      const MetricDesc &d = descs_[i];
+      int n;
+      switch (d.kind)
+      {
+      case METRIC_COUNTER:
+        n = snprintf(line, sizeof(line), "%s %u\n", d.name, ((const Counter *)d.metric)->get());
+        emit(line, n);
+        break;
+      case METRIC_GAUGE:
+        n = snprintf(line, sizeof(line), "%s %d\n", d.name, ((const Gauge *)d.metric)->get());
+        emit(line, n);
+        break;
+      case METRIC_HISTOGRAM:
+      {
+        const Histogram *h = (const Histogram *)d.metric;
+        uint32_t cumulative = 0;
+        for (uint8_t b = 0; b < Histogram::BUCKETS; b++)
+        {
+          cumulative += h->counts[b].load(std::memory_order_relaxed);
+          if (b + 1 < Histogram::BUCKETS)
+            n = snprintf(line, sizeof(line), "%s_bucket{le=\"%u\"} %u\n", d.name, Histogram::upperBound(b), cumulative);
+          else
+            n = snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %u\n", d.name, cumulative);
+          emit(line, n);
+        }
+        n = snprintf(line, sizeof(line), "%s_sum %u\n%s_count %u\n", d.name,
+                     h->sum.load(std::memory_order_relaxed), d.name, h->count.load(std::memory_order_relaxed));
+        emit(line, n);
+        break;
+      }
+      }
+    }
+  }
+
+  // Compact binary snapshot:
+  //   u8 version, u8 metric count, then per metric
+  //   u8 kind, u8 name length, name bytes, value(s) as little-endian u32
+  //   (counter/gauge: 1, histogram: BUCKETS counts + sum + count).
+  // Returns bytes written, 0 if `cap` is too small.
+  size_t writeBinary(uint8_t *out, size_t cap) const
+  {
+    size_t pos = 0;
+    if (cap < 2)
+      return 0;
+    out[pos++] = 1;
+    out[pos++] = count_;
+    for (uint8_t i = 0; i < count_; i++)
+    {
+      const MetricDesc &d = descs_[i];
+      size_t nameLen = strlen(d.name);
+      if (nameLen > 255)
+        nameLen = 255;
+      size_t values = d.kind == METRIC_HISTOGRAM ? Histogram::BUCKETS + 2 : 1;
+      if (pos + 2 + nameLen + 4 * values > cap)
+        return 0;
+      out[pos++] = d.kind;
+      out[pos++] = nameLen;
+      memcpy(out + pos, d.name, nameLen);
+      pos += nameLen;
+      if (d.kind == METRIC_COUNTER)
+        pos += put32(out + pos, ((const Counter *)d.metric)->get());
+      else if (d.kind == METRIC_GAUGE)
+        pos += put32(out + pos, (uint32_t)((const Gauge *)d.metric)->get());
+      else
+      {
+        const Histogram *h = (const Histogram *)d.metric;
+        for (uint8_t b = 0; b < Histogram::BUCKETS; b++)
+          pos += put32(out + pos, h->counts[b].load(std::memory_order_relaxed));
+        pos += put32(out + pos, h->sum.load(std::memory_order_relaxed));
+        pos += put32(out + pos, h->count.load(std::memory_order_relaxed));
+      }
+    }
+    return pos;
+  }
+
+private:
+  MetricDesc descs_[CAPACITY];
+  uint8_t count_ = 0;
+
+  bool add(const char *name, MetricKind kind, const void *metric)
+  {
+    if (count_ >= CAPACITY)
+      return false;
+    descs_[count_].name = name;
+    descs_[count_].kind = kind;
+    descs_[count_].metric = metric;
+    count_++;
+    return true;
+  }
+
+  static size_t put32(uint8_t *p, uint32_t v)
+  {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+    return 4;
+  }
+};
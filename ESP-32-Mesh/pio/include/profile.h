@@ -0,0 +1,59 @@
+#pragma once
+#include <Arduino.h>
+
+// ================== PROFILE CONFIG ==================
+#define PROFILE_USERID_MAX 40 // UUIDs are 36 chars
+#define PROFILE_NAME_MAX 32   // emergency contact name
+#define PROFILE_PHONE_MAX 20  // emergency contact number: digits, '+', ' ', '-'
+#define PROVISION_MSGS_MAX 4  // queued messages accepted by one /provision
+#define PROVISION_MSG_MAX 191 // same as a mesh message (MESH_MSG_TEXT_MAX - 1)
+#define PROVISION_BODY_MAX 1024
+// ================== END PROFILE CONFIG ==============
+
+// Medical flags, for responders
+enum MedicalFlag : uint16_t
+{
+  MED_DIABETES = 1 << 0,
+  MED_CARDIAC = 1 << 1,
+  MED_ASTHMA = 1 << 2,
+  MED_EPILEPSY = 1 << 3,
+  MED_ALLERGY = 1 << 4,
+  MED_PREGNANT = 1 << 5,
+  MED_MOBILITY = 1 << 6, // needs help to move
+  MED_MEDICATION = 1 << 7, // depends on regular medication
+};
+
+// What the node knows about its user. Stored in NVS as one blob with a
+// version and CRC, so a commit either fully lands or the old profile stays.
+struct Profile
+{
+  char userId[PROFILE_USERID_MAX + 1] = "";
+  char contactName[PROFILE_NAME_MAX + 1] = "";
+  char contactPhone[PROFILE_PHONE_MAX + 1] = "";
+  uint16_t medical = 0; // MedicalFlag bits
+};
+
+// A parsed /provision body. Fields the body leaves out keep the values
+// from `base`; text pointers point into the body buffer.
+struct ProvisionRequest
+{
+  Profile profile;
+  uint8_t messages = 0;
+  const char *msg[PROVISION_MSGS_MAX];
+  uint16_t msgLen[PROVISION_MSGS_MAX];
+};
+
+// Parses and validates a /provision body, either JSON
+//   {"userid":"..","contact":{"name":"..","phone":".."},"medical":5,"messages":[".."]}
+// or, when `binary`, TLV records (tag u8, len u8, value):
+//   1 user id, 2 contact name, 3 contact phone, 4 medical (u16 LE), 5 message.
+// `body` is modified (JSON strings are unescaped in place). On failure
+// returns false with `err` set to a short reason for the 400 reply.
+bool parseProvision(char *body, size_t len, bool binary, const Profile &base, ProvisionRequest &out, const char *&err);
+
+// False when nothing valid is stored (first boot, or a newer/corrupt blob)
+bool profileLoad(Profile &p);
+// One NVS blob write; false if it did not commit
+bool profileSave(const Profile &p);
+
+bool profileValidUserId(const char *s, size_t len);
@@ -0,0 +1,10 @@
+#pragma once
+
+// Build role, set per PlatformIO environment: esp32dev-master builds with
+// -DRESQME_ROLE_MASTER=1, esp32dev-client without. Each image carries only
+// its own role's code; see "Role" in main_testing.cpp.
+#ifndef RESQME_ROLE_MASTER
+#define RESQME_ROLE_MASTER 0
+#endif
+
+constexpr bool IS_MASTER = RESQME_ROLE_MASTER;
@@ -0,0 +1,391 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "link_health.h"
+
+// Master-side roster of every node heard from. Entries live in a fixed
+// pool; three open-addressing indices (linear probing, load <= 1/2) map
+// node id, MAC and user id to a pool slot. Probes only touch the packed key arrays, and
+// deletes use backward shift, so there are no tombstones to clean up.
+// Nothing allocates after construction.
+#define ROSTER_USERID_MAX 40
+
+struct RosterEntry
+{
+  uint32_t nodeId; // 0: free slot
+  uint8_t mac[6];  // all zero until a report names it
+  uint8_t hops;    // 0: unknown
+  uint8_t flags;   // RosterFlags
+  int32_t latE7, lonE7;
+  uint32_t lastSeenMs;
+  SeqWindow seq; // report delivery accounting
+  uint32_t packets; // link stats: everything received from the node
+  uint32_t bytes;
+  uint32_t lastLatencyMs;
+  char userId[ROSTER_USERID_MAX + 1];
+};
+
+enum RosterFlags : uint8_t
+{
+  ROSTER_HAS_FIX = 1 << 0,
+  ROSTER_SOS = 1 << 1, // last report was an SOS
+};
+
+template <uint16_t CAPACITY>
+class Roster
+{
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0 && CAPACITY <= 16384, "Roster capacity must be a power of two");
+  static const uint16_t INDEX = CAPACITY * 2;
+
+public:
+  static const uint16_t NONE = 0xFFFF;
+
+  Roster() { clear(); }
+
+  void clear()
+  {
+    memset(entries_, 0, sizeof(entries_));
+    for (uint16_t i = 0; i < INDEX; i++)
+      idSlot_[i] = macSlot_[i] = userSlot_[i] = NONE;
+    for (uint16_t i = 0; i < CAPACITY; i++)
+      free_[i] = CAPACITY - 1 - i;
+    freeCount_ = CAPACITY;
+    evictions_ = 0;
+  }
+
+  RosterEntry *find(uint32_t nodeId)
+  {
+    uint16_t pos = idProbe(nodeId);
+    return idSlot_[pos] == NONE ? nullptr : &entries_[idSlot_[pos]];
+  }
+
+  RosterEntry *findByMac(const uint8_t *mac)
+  {
+    uint16_t pos = macProbe(mac, macHash(mac));
+    return macSlot_[pos] == NONE ? nullptr : &entries_[macSlot_[pos]];
+  }
+
+  // The directory for messages addressed to a person
+  RosterEntry *findByUser(const char *userId)
+  {
+    uint16_t pos = userProbe(userId, userHash(userId));
+    return userSlot_[pos] == NONE ? nullptr : &entries_[userSlot_[pos]];
+  }
+
+  // Finds or inserts `nodeId` and marks it seen. When the pool is full the
+  // least recently seen node is evicted (a linear scan, only on that path).
+  RosterEntry &touch(uint32_t nodeId, uint32_t nowMs)
+  {
+    uint16_t pos = idProbe(nodeId);
+    if (idSlot_[pos] == NONE)
+    {
+      if (freeCount_ == 0)
+      {
+        evictOldest(nowMs);
+        pos = idProbe(nodeId); // the shift may have moved the hole
+      }
+      uint16_t slot = free_[--freeCount_];
+      memset(&entries_[slot], 0, sizeof(RosterEntry));
+      entries_[slot].nodeId = nodeId;
+      idKey_[pos] = nodeId;
+      idSlot_[pos] = slot;
+    }
+    RosterEntry &e = entries_[idSlot_[pos]];
+    e.lastSeenMs = nowMs;
+    return e;
+  }
+
+  // Moves `e` to a new MAC key (reports carry the MAC as device_id)
+  void setMac(RosterEntry &e, const uint8_t *mac)
+  {
+    if (memcmp(e.mac, mac, 6) == 0)
+      return;
+    if (!isZeroMac(e.mac))
+      macErase(e.mac);
+    RosterEntry *other = findByMac(mac);
+    if (other) // the MAC moved to a new node id (e.g. after a reflash)
+    {
+      macErase(mac);
+      memset(other->mac, 0, 6);
+    }
+    memcpy(e.mac, mac, 6);
+    uint32_t h = macHash(mac);
+    uint16_t pos = macProbe(mac, h);
+    macKey_[pos] = h;
+    macSlot_[pos] = &e - entries_;
+  }
+
+  // Moves `e` to a new user id; a user re-paired to another device is
+  // taken off the old one
+  void setUserId(RosterEntry &e, const char *userId)
+  {
+    if (!strncmp(e.userId, userId, ROSTER_USERID_MAX))
+      return;
+    if (e.userId[0])
+      userErase(e.userId);
+    e.userId[0] = 0;
+    if (!userId[0])
+      return;
+    RosterEntry *other = findByUser(userId);
+    if (other)
+    {
+      userErase(userId);
+      other->userId[0] = 0;
+    }
+    size_t n = strnlen(userId, ROSTER_USERID_MAX);
+    memcpy(e.userId, userId, n);
+    e.userId[n] = 0;
+    uint32_t h = userHash(e.userId);
+    uint16_t pos = userProbe(e.userId, h);
+    userKey_[pos] = h;
+    userSlot_[pos] = &e - entries_;
+  }
+
+  void erase(uint32_t nodeId)
+  {
+    uint16_t pos = idProbe(nodeId);
+    if (idSlot_[pos] == NONE)
+      return;
+    uint16_t slot = idSlot_[pos];
+    if (!isZeroMac(entries_[slot].mac))
+      macErase(entries_[slot].mac);
+    if (entries_[slot].userId[0])
+      userErase(entries_[slot].userId);
+    idShiftDelete(pos);
+    entries_[slot].nodeId = 0;
+    free_[freeCount_++] = slot;
+  }
+
+  // Pool slots are stable for as long as a node stays in the roster, so
+  // per-node bitmaps can be indexed by them
+  uint16_t slotOf(const RosterEntry &e) const { return &e - entries_; }
+  const RosterEntry &atSlot(uint16_t slot) const { return entries_[slot]; }
+
+  uint16_t size() const { return CAPACITY - freeCount_; }
+  static uint16_t capacity() { return CAPACITY; }
+  uint32_t evictions() const { return evictions_; }
+
+  // Calls fn(const RosterEntry&) for every node, in pool order
+  template <typename Fn>
+  void forEach(Fn fn) const
+  {
+    for (uint16_t i = 0; i < CAPACITY; i++)
+      if (entries_[i].nodeId)
+        fn(entries_[i]);
+  }
+
+  // Snapshot: u8 version, u16 count, then per node
+  //   u32 id, 6 MAC bytes, u8 hops, u8 flags, i32 lat e7, i32 lon e7,
+  //   u32 ms since seen, u32 last seq, u32 packets, u32 bytes,
+  //   u32 last latency ms, u8 user id length, user id
+  // all little-endian. Returns bytes written, 0 if `cap` is too small.
+  size_t writeBinary(uint8_t *out, size_t cap, uint32_t nowMs) const
+  {
+    if (cap < 3)
+      return 0;
+    size_t pos = 3;
+    uint16_t count = 0;
+    for (uint16_t i = 0; i < CAPACITY; i++)
+    {
+      const RosterEntry &e = entries_[i];
+      if (!e.nodeId)
+        continue;
+      uint8_t uidLen = strnlen(e.userId, ROSTER_USERID_MAX);
+      if (pos + 43 + uidLen > cap)
+        return 0;
+      pos += put32(out + pos, e.nodeId);
+      memcpy(out + pos, e.mac, 6);
+      pos += 6;
+      out[pos++] = e.hops;
+      out[pos++] = e.flags;
+      pos += put32(out + pos, e.latE7);
+      pos += put32(out + pos, e.lonE7);
+      pos += put32(out + pos, nowMs - e.lastSeenMs);
+      pos += put32(out + pos, e.seq.highest);
+      pos += put32(out + pos, e.packets);
+      pos += put32(out + pos, e.bytes);
+      pos += put32(out + pos, e.lastLatencyMs);
+      out[pos++] = uidLen;
+      memcpy(out + pos, e.userId, uidLen);
+      pos += uidLen;
+      count++;
+    }
+    out[0] = 1;
+    out[1] = count;
+    out[2] = count >> 8;
+    return pos;
+  }
+
+  // Link health: u8 version, u16 count, then per node
+  //   u32 id, u32 boot id, u32 highest seq, u32 received, u32 lost,
+  //   u32 pending, u32 duplicates, u32 reordered, u32 stale, u32 bursts,
+  //   u16 longest burst, u16 open burst, u16 restarts, u16 delivery (1/10000)
+  // all little-endian. Nodes that never sent a numbered report are left out.
+  static const uint8_t HEALTH_RECORD = 48;
+  size_t writeHealth(uint8_t *out, size_t cap) const
+  {
+    if (cap < 3)
+      return 0;
+    size_t pos = 3;
+    uint16_t count = 0;
+    for (uint16_t i = 0; i < CAPACITY; i++)
+    {
+      const SeqWindow &w = entries_[i].seq;
+      if (!entries_[i].nodeId || !w.started)
+        continue;
+      if (pos + HEALTH_RECORD > cap)
+        return 0;
+      pos += put32(out + pos, entries_[i].nodeId);
+      pos += put32(out + pos, w.boot);
+      pos += put32(out + pos, w.highest);
+      pos += put32(out + pos, w.received);
+      pos += put32(out + pos, w.lost);
+      pos += put32(out + pos, w.pending());
+      pos += put32(out + pos, w.duplicates);
+      pos += put32(out + pos, w.reordered);
+      pos += put32(out + pos, w.stale);
+      pos += put32(out + pos, w.bursts);
+      pos += put16(out + pos, w.maxBurst);
+      pos += put16(out + pos, w.curBurst);
+      pos += put16(out + pos, w.restarts);
+      pos += put16(out + pos, w.deliveryBp());
+      count++;
+    }
+    out[0] = 1;
+    out[1] = count;
+    out[2] = count >> 8;
+    return pos;
+  }
+
+private:
+  RosterEntry entries_[CAPACITY];
+  uint32_t idKey_[INDEX];
+  uint16_t idSlot_[INDEX];
+  uint32_t macKey_[INDEX]; // MAC hash; the full MAC is checked in the entry
+  uint16_t macSlot_[INDEX];
+  uint32_t userKey_[INDEX]; // user id hash, likewise
+  uint16_t userSlot_[INDEX];
+  uint16_t free_[CAPACITY];
+  uint16_t freeCount_;
+  uint32_t evictions_;
+
+  static uint16_t home(uint32_t h) { return (uint32_t)(h * 2654435769UL) >> (32 - log2(INDEX)); }
+  static constexpr uint8_t log2(uint32_t n) { return n <= 1 ? 0 : 1 + log2(n >> 1); }
+  static uint16_t next(uint16_t pos) { return (pos + 1) & (INDEX - 1); }
+
+  static bool isZeroMac(const uint8_t *mac)
+  {
+    static const uint8_t zero[6] = {0};
+    return memcmp(mac, zero, 6) == 0;
+  }
+  static uint32_t macHash(const uint8_t *mac)
+  {
+    uint32_t h = 2166136261UL;
+    for (uint8_t i = 0; i < 6; i++)
+      h = (h ^ mac[i]) * 16777619UL;
+    return h;
+  }
+
+  static uint32_t userHash(const char *s)
+  {
+    uint32_t h = 2166136261UL;
+    for (uint8_t i = 0; i < ROSTER_USERID_MAX && s[i]; i++)
+      h = (h ^ (uint8_t)s[i]) * 16777619UL;
+    return h;
+  }
+
+  // Position of the key, or of the empty cell where it would go
+  uint16_t idProbe(uint32_t nodeId) const
+  {
+    uint16_t pos = home(nodeId);
+    while (idSlot_[pos] != NONE && idKey_[pos] != nodeId)
+      pos = next(pos);
+    return pos;
+  }
+  uint16_t macProbe(const uint8_t *mac, uint32_t h) const
+  {
+    uint16_t pos = home(h);
+    while (macSlot_[pos] != NONE && !(macKey_[pos] == h && memcmp(entries_[macSlot_[pos]].mac, mac, 6) == 0))
+      pos = next(pos);
+    return pos;
+  }
+
+  uint16_t userProbe(const char *userId, uint32_t h) const
+  {
+    uint16_t pos = home(h);
+    while (userSlot_[pos] != NONE &&
+           !(userKey_[pos] == h && strncmp(entries_[userSlot_[pos]].userId, userId, ROSTER_USERID_MAX) == 0))
+      pos = next(pos);
+    return pos;
+  }
+
+  // Backward-shift delete: pull later members of the cluster into the hole
+  // unless that would move them before their home position.
+  template <typename Key>
+  static void shiftDelete(Key *keys, uint16_t *slots, uint16_t hole)
+  {
+    uint16_t pos = hole;
+    for (;;)
+    {
+      pos = next(pos);
+      if (slots[pos] == NONE)
+        break;
+      uint16_t h = home(keys[pos]);
+      bool movable = hole <= pos ? (h <= hole || h > pos) : (h <= hole && h > pos);
+      if (movable)
+      {
+        keys[hole] = keys[pos];
+        slots[hole] = slots[pos];
+        hole = pos;
+      }
+    }
+    slots[hole] = NONE;
+  }
+  void idShiftDelete(uint16_t pos) { shiftDelete(idKey_, idSlot_, pos); }
+  void macErase(const uint8_t *mac)
+  {
+    uint16_t pos = macProbe(mac, macHash(mac));
+    if (macSlot_[pos] != NONE)
+      shiftDelete(macKey_, macSlot_, pos);
+  }
+
+  void userErase(const char *userId)
+  {
+    uint16_t pos = userProbe(userId, userHash(userId));
+    if (userSlot_[pos] != NONE)
+      shiftDelete(userKey_, userSlot_, pos);
+  }
+
+  static size_t put16(uint8_t *p, uint16_t v)
+  {
+    p[0] = v;
+    p[1] = v >> 8;
+    return 2;
+  }
+  static size_t put32(uint8_t *p, uint32_t v)
+  {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+    return 4;
+  }
+
+  void evictOldest(uint32_t nowMs)
+  {
+    uint16_t oldest = 0;
+    uint32_t oldestAge = 0;
+    for (uint16_t i = 0; i < CAPACITY; i++)
+    {
+      uint32_t age = nowMs - entries_[i].lastSeenMs;
+      if (entries_[i].nodeId && age >= oldestAge)
+      {
+        oldest = i;
+        oldestAge = age;
+      }
+    }
+    erase(entries_[oldest].nodeId);
+    evictions_++;
+  }
+};
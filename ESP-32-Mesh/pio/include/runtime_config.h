@@ -0,0 +1,115 @@
+#pragma once
+#include <Arduino.h>
+
+// ================== RUNTIME CONFIG DEFAULTS ==================
+// Used on first boot and for fields an older stored config lacks.
+// Change them at runtime with "!cfg set <key> <value>" on serial, or for
+// live fields with POST /config (key=..&value=.. form body) on the portal.
+// Fields marked CFG_REBOOT (credentials, pins) are serial only and take
+// effect at the next boot; see CONFIG_FIELDS for the keys.
+#define CFG_MESH_PREFIX "ResQMe_Net"
+#define CFG_MESH_PASSWORD "mesh-password5"
+#define CFG_MESH_PORT 5555
+#define CFG_AP_SSID "ResQMe_Node"
+#define CFG_AP_PASS "12345678"
+// Pins
+#define CFG_PIN_GPS_RX 16
+#define CFG_PIN_GPS_TX 17
+#define CFG_PIN_LED_BLUE 26
+#define CFG_PIN_LED_RED 27
+#define CFG_PIN_BUTTON 14
+#define CFG_PIN_BUZZER 25
+// Timings (ms)
+#define CFG_SEND_PERIOD_MS 2000
+#define CFG_ALERT_DISPLAY_MS 30000 // how long an alert's text stays up
+#define CFG_DEBOUNCE_MS 35
+#define CFG_MULTICLICK_GAP_MS 450
+#define CFG_LONGPRESS_MS 3000
+// Mesh
+#define CFG_FRAG_MTU 256    // longer reports go out in fragments (include/fragment.h)
+#define CFG_COMPRESS 1      // Z_PACK_* bits (include/compress.h): reports packed for a master that unpacks them
+#define CFG_AGG_HOLD_MS 200 // most a report may wait in relays' aggregates (include/aggregate.h); 0: never, else at least AGG_BUDGET_MIN_MS
+// ================== END RUNTIME CONFIG DEFAULTS ==============
+
+#define CFG_STR_MAX 63 // WPA2 passphrases
+#define CONFIG_JSON_MAX 512 // configWriteJson with every field at its longest is 387
+
+// The running configuration: read into this plain struct once at boot,
+// then used directly (cfg.sendPeriodMs), never looked up by key.
+// New fields go at the end only: an older stored blob is then a prefix
+// of the current layout and loads with defaults for the rest.
+struct RuntimeConfig
+{
+  char meshPrefix[32 + 1];
+  char meshPassword[CFG_STR_MAX + 1];
+  uint16_t meshPort;
+  char apSsid[32 + 1];
+  char apPass[CFG_STR_MAX + 1];
+  int8_t pinGpsRx, pinGpsTx, pinLedBlue, pinLedRed, pinButton, pinBuzzer;
+  uint32_t sendPeriodMs;
+  uint32_t alertDisplayMs;
+  uint16_t debounceMs;
+  uint16_t multiclickGapMs;
+  uint16_t longpressMs;
+  uint16_t fragMtu;
+  uint16_t compress;
+  uint16_t aggHoldMs;
+};
+
+extern RuntimeConfig cfg;
+
+enum ConfigType : uint8_t
+{
+  CFG_STR,
+  CFG_U16,
+  CFG_U32,
+  CFG_PIN // int8 GPIO number
+};
+
+enum ConfigFlags : uint8_t
+{
+  CFG_REBOOT = 1 << 0,   // stored, takes effect at the next boot
+  CFG_SECRET = 1 << 1,   // never printed
+  CFG_OUTPUT = 1 << 2,   // pin must be able to drive (not GPIO 34-39)
+  CFG_ZERO_OFF = 1 << 3, // 0 (off) is allowed below min
+};
+
+struct ConfigField
+{
+  const char *key;
+  ConfigType type;
+  uint8_t flags;
+  uint16_t offset;
+  uint32_t min, max; // value range, or string length range
+};
+
+enum ConfigSetResult : uint8_t
+{
+  CFG_SET_LIVE,   // applied now
+  CFG_SET_STORED, // applied at the next boot
+  CFG_SET_UNKNOWN_KEY,
+  CFG_SET_BAD_VALUE,
+  CFG_SET_NOT_SAVED // NVS write failed
+};
+
+enum ConfigLoadResult : uint8_t
+{
+  CFG_LOAD_DEFAULTS, // nothing (valid) stored
+  CFG_LOAD_OK,
+  CFG_LOAD_UPGRADED // stored by an older firmware; new fields defaulted
+};
+
+extern const ConfigField CONFIG_FIELDS[];
+extern const uint8_t CONFIG_FIELD_COUNT;
+
+void configDefaults(RuntimeConfig &c);
+ConfigLoadResult configLoad(RuntimeConfig &c);
+bool configSave(const RuntimeConfig &c);
+const ConfigField *configFind(const char *key);
+// Parses and range-checks `value` into field f of c; false if invalid
+bool configParse(RuntimeConfig &c, const ConfigField &f, const char *value);
+// Copies one field's value from src to dst
+void configCopyField(RuntimeConfig &dst, const RuntimeConfig &src, const ConfigField &f);
+// {"key":value,...}, secrets as "***"; returns the length (0 if it did not fit)
+size_t configWriteJson(const RuntimeConfig &c, char *out, size_t max);
+const char *configResultName(ConfigSetResult r);
@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary frames on the master's serial uplink, interleaved with the JSON
+// text lines the gateway already parses:
+//   0xA5 0x5A | type u8 | length u16 LE | payload | CRC-16/CCITT u16 LE
+// The CRC covers type, length and payload. The sync bytes never appear in
+// the printable text lines, so readers can resynchronise on them.
+#define FRAME_SYNC0 0xA5
+#define FRAME_SYNC1 0x5A
+#define FRAME_HEADER 5   // sync, type, length
+#define FRAME_OVERHEAD 7 // header + CRC
+
+enum FrameType : uint8_t
+{
+  FRAME_METRICS = 0x01,
+  FRAME_TRACE = 0x02,
+  FRAME_LOG = 0x03,
+  FRAME_ROSTER = 0x04,
+  FRAME_HEALTH = 0x05,
+};
+// Set in the type when the payload is packed: u16 LE unpacked length,
+// then a compress.h stream without dictionary
+#define FRAME_PACKED 0x80
+
+inline uint16_t crc16Ccitt(const uint8_t *data, size_t len, uint16_t crc = 0xFFFF)
+{
+  while (len--)
+  {
+    crc ^= (uint16_t)(*data++) << 8;
+    for (uint8_t i = 0; i < 8; i++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+// Completes a frame in place: the caller has written `len` payload bytes
+// at buf + FRAME_HEADER, and buf has room for FRAME_OVERHEAD more. Returns
+// the frame length, so the whole frame goes out in one write and cannot
+// interleave with output from other tasks.
+inline size_t sealFrame(uint8_t *buf, FrameType type, uint16_t len)
+{
+  buf[0] = FRAME_SYNC0;
+  buf[1] = FRAME_SYNC1;
+  buf[2] = type;
+  buf[3] = (uint8_t)len;
+  buf[4] = (uint8_t)(len >> 8);
+  uint16_t crc = crc16Ccitt(buf + 2, 3 + len);
+  buf[FRAME_HEADER + len] = (uint8_t)crc;
+  buf[FRAME_HEADER + len + 1] = (uint8_t)(crc >> 8);
+  return FRAME_OVERHEAD + len;
+}
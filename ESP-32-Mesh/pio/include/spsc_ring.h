@@ -0,0 +1,55 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// Lock-free single-producer / single-consumer ring of fixed-size items.
+// One task may push and one (other) task may pop; nothing else may touch it.
+// N must be a power of two. Items are copied in and out, so keep them POD.
+template <typename T, uint32_t N>
+class SpscRing
+{
+  static_assert((N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+  bool push(const T &item)
+  {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= N)
+    {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    items_[head & (N - 1)] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T &item)
+  {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire))
+      return false;
+    item = items_[tail & (N - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const
+  {
+    return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+  }
+
+  uint32_t size() const
+  {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  uint32_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+  T items_[N];
+  std::atomic<uint32_t> head_{0}; // written by the producer only
+  std::atomic<uint32_t> tail_{0}; // written by the consumer only
+  std::atomic<uint32_t> dropped_{0};
+};
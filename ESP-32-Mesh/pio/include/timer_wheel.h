@@ -0,0 +1,260 @@
+#pragma once
+#include <stdint.h>
+
+// Hierarchical timer wheel with a fixed pool of timers and 1 ms ticks.
+// Three levels of 64 slots cover 64 ms, 4.1 s and 262 s; longer timers park
+// in the last level-2 slot and cascade down again. start/stop are O(1),
+// advance() only visits ticks that have work, and msUntilNext() is O(1)
+// so the caller knows how long it may sleep.
+//
+// Timers are created once (usually in setup) and then started/stopped by id.
+// Not thread safe: create, start, stop and advance from the same task.
+
+typedef void (*TimerCallback)(void *arg);
+typedef int16_t TimerId;
+static const TimerId TIMER_INVALID = -1;
+
+template <uint16_t CAPACITY>
+class TimerWheel
+{
+public:
+  static const uint32_t NONE = 0xFFFFFFFFUL;
+
+  void begin(uint32_t nowMs)
+  {
+    now_ = nowMs;
+  }
+
+  TimerId create(TimerCallback cb, void *arg = nullptr)
+  {
+    if (count_ >= CAPACITY)
+      return TIMER_INVALID;
+    Timer &t = timers_[count_];
+    t.cb = cb;
+    t.arg = arg;
+    t.slot = -1;
+    return count_++;
+  }
+
+  // (Re)arms a timer `delayMs` from the wheel's current time. A non-zero
+  // period makes it periodic, counted from the previous deadline.
+  void start(TimerId id, uint32_t delayMs, uint32_t periodMs = 0)
+  {
+    if (id < 0 || id >= count_)
+      return;
+    Timer &t = timers_[id];
+    if (t.slot >= 0)
+      unlink(id);
+    t.expiry = now_ + (delayMs ? delayMs : 1);
+    t.period = periodMs;
+    insert(id);
+  }
+
+  void stop(TimerId id)
+  {
+    if (id >= 0 && id < count_ && timers_[id].slot >= 0)
+      unlink(id);
+  }
+
+  bool pending(TimerId id) const
+  {
+    return id >= 0 && id < count_ && timers_[id].slot >= 0;
+  }
+
+  // Runs every callback due at or before `nowMs`, in deadline order.
+  void advance(uint32_t nowMs)
+  {
+    while ((int32_t)(nowMs - now_) > 0)
+    {
+      uint32_t d = nextEventDelta();
+      if (d == 0 || d > nowMs - now_)
+      {
+        now_ = nowMs;
+        return;
+      }
+      now_ += d;
+      if ((now_ & LEVEL_MASK) == 0)
+      {
+        if (((now_ >> LEVEL_BITS) & LEVEL_MASK) == 0)
+          cascade(2, (now_ >> (2 * LEVEL_BITS)) & LEVEL_MASK);
+        cascade(1, (now_ >> LEVEL_BITS) & LEVEL_MASK);
+      }
+      runSlot(now_ & LEVEL_MASK);
+    }
+  }
+
+  // Milliseconds until advance() may have work to do; never late, may be
+  // early when the next event is a cascade. NONE if no timer is armed.
+  uint32_t msUntilNext(uint32_t nowMs) const
+  {
+    uint32_t d = nextEventDelta();
+    if (d == 0)
+      return NONE;
+    int32_t left = (int32_t)(now_ + d - nowMs);
+    return left > 0 ? (uint32_t)left : 0;
+  }
+
+  uint16_t armed() const
+  {
+    uint16_t n = 0;
+    for (uint16_t i = 0; i < count_; i++)
+      n += timers_[i].slot >= 0;
+    return n;
+  }
+
+private:
+  static const uint8_t LEVEL_BITS = 6;
+  static const uint32_t LEVEL_SLOTS = 1UL << LEVEL_BITS;
+  static const uint32_t LEVEL_MASK = LEVEL_SLOTS - 1;
+  static const uint8_t LEVELS = 3;
+
+  struct Timer
+  {
+    TimerCallback cb;
+    void *arg;
+    uint32_t expiry;
+    uint32_t period;
+    int16_t slot; // level * 64 + index, -1 when idle
+    int16_t prev;
+    int16_t next;
+  };
+
+  Timer timers_[CAPACITY];
+  int16_t heads_[LEVELS * LEVEL_SLOTS] = {};
+  int16_t tails_[LEVELS * LEVEL_SLOTS] = {};
+  uint64_t occupied_[LEVELS] = {};
+  uint16_t count_ = 0;
+  uint32_t now_ = 0;
+  bool headsInit_ = false;
+
+  void initHeads()
+  {
+    for (uint32_t i = 0; i < LEVELS * LEVEL_SLOTS; i++)
+      heads_[i] = tails_[i] = -1;
+    headsInit_ = true;
+  }
+
+  static inline uint64_t rotr(uint64_t v, uint8_t n)
+  {
+    n &= 63;
+    return n ? (v >> n) | (v << (64 - n)) : v;
+  }
+
+  void insert(TimerId id)
+  {
+    if (!headsInit_)
+      initHeads();
+    Timer &t = timers_[id];
+    uint32_t delta = t.expiry - now_;
+    if ((int32_t)delta < 0)
+      delta = 0;
+    uint8_t level;
+    uint32_t index;
+    if (delta < LEVEL_SLOTS)
+    {
+      level = 0;
+      index = t.expiry & LEVEL_MASK;
+    }
+    else if (delta < (1UL << (2 * LEVEL_BITS)))
+    {
+      level = 1;
+      index = (t.expiry >> LEVEL_BITS) & LEVEL_MASK;
+    }
+    else if (delta < (1UL << (3 * LEVEL_BITS)))
+    {
+      level = 2;
+      index = (t.expiry >> (2 * LEVEL_BITS)) & LEVEL_MASK;
+    }
+    else
+    {
+      level = 2; // beyond range: park in the furthest slot and re-cascade
+      index = ((now_ >> (2 * LEVEL_BITS)) + LEVEL_MASK) & LEVEL_MASK;
+    }
+    int16_t s = level * LEVEL_SLOTS + index;
+    t.slot = s;
+    t.next = -1;
+    t.prev = tails_[s];
+    if (tails_[s] >= 0)
+      timers_[tails_[s]].next = id;
+    else
+      heads_[s] = id;
+    tails_[s] = id;
+    occupied_[level] |= 1ULL << index;
+  }
+
+  void unlink(TimerId id)
+  {
+    Timer &t = timers_[id];
+    int16_t s = t.slot;
+    if (t.prev >= 0)
+      timers_[t.prev].next = t.next;
+    else
+      heads_[s] = t.next;
+    if (t.next >= 0)
+      timers_[t.next].prev = t.prev;
+    else
+      tails_[s] = t.prev;
+    if (heads_[s] < 0)
+      occupied_[s / LEVEL_SLOTS] &= ~(1ULL << (s % LEVEL_SLOTS));
+    t.slot = -1;
+  }
+
+  void cascade(uint8_t level, uint32_t index)
+  {
+    if (!headsInit_)
+      return;
+    int16_t s = level * LEVEL_SLOTS + index;
+    int16_t id = heads_[s];
+    heads_[s] = tails_[s] = -1;
+    occupied_[level] &= ~(1ULL << index);
+    while (id >= 0)
+    {
+      int16_t next = timers_[id].next;
+      insert(id);
+      id = next;
+    }
+  }
+
+  void runSlot(uint32_t index)
+  {
+    if (!headsInit_)
+      return;
+    // Callbacks may start/stop timers, including ones in this slot, so
+    // pop one due timer at a time instead of walking a detached list.
+    int16_t id;
+    while ((id = heads_[index]) >= 0 && timers_[id].expiry == now_)
+    {
+      Timer &t = timers_[id];
+      unlink(id);
+      if (t.period)
+      {
+        t.expiry += t.period;
+        insert(id);
+      }
+      t.cb(t.arg);
+    }
+  }
+
+  // Ticks from now_ to the next level-0 slot or cascade with work; 0 if none.
+  uint32_t nextEventDelta() const
+  {
+    uint32_t best = 0;
+    if (occupied_[0])
+    {
+      uint64_t r = rotr(occupied_[0], (now_ + 1) & LEVEL_MASK);
+      best = __builtin_ctzll(r) + 1;
+    }
+    for (uint8_t level = 1; level < LEVELS; level++)
+    {
+      if (!occupied_[level])
+        continue;
+      uint8_t shift = level * LEVEL_BITS;
+      uint32_t block = now_ >> shift;
+      uint64_t r = rotr(occupied_[level], (block + 1) & LEVEL_MASK);
+      uint32_t d = ((block + 1 + __builtin_ctzll(r)) << shift) - now_;
+      if (best == 0 || d < best)
+        best = d;
+    }
+    return best;
+  }
+};
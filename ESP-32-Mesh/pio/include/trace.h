@@ -0,0 +1,155 @@
+#pragma once
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <atomic>
+
+// Phase tracer: scoped trace points record (start, duration) in CPU cycles
+// into a preallocated ring that keeps the newest CAPACITY spans. Both cores
+// may record; each slot is claimed with one atomic add. Dumps go out as a
+// FRAME_TRACE frame (serial) or /trace (portal), and
+// serial_python/trace_to_chrome.py turns them into Chrome trace JSON.
+//
+// Cycle counters are per core and wrap every ~18 s at 240 MHz, so each core
+// also keeps an anchor (cycles, esp_timer us) refreshed once per loop; the
+// converter places every span relative to its core's newest anchor.
+#define TRACE_CORES 2
+
+struct TraceEvent
+{
+  uint32_t start;  // CCOUNT at scope entry
+  uint32_t cycles; // scope duration
+  uint8_t id;      // trace point, index into the name table
+  uint8_t core;
+};
+
+struct TraceAnchor
+{
+  uint32_t cycles;
+  uint64_t us;
+};
+
+template <uint16_t CAPACITY>
+class TraceRing
+{
+public:
+  void record(uint8_t id, uint32_t start, uint32_t end)
+  {
+    if (paused_.load(std::memory_order_relaxed))
+      return;
+    uint32_t slot = head_.fetch_add(1, std::memory_order_relaxed) % CAPACITY;
+    TraceEvent &e = events_[slot];
+    e.start = start;
+    e.cycles = end - start;
+    e.id = id;
+    e.core = xPortGetCoreID();
+  }
+
+  // Called by each core once per loop, outside any traced scope
+  void anchor()
+  {
+    if (paused_.load(std::memory_order_relaxed))
+      return;
+    TraceAnchor &a = anchors_[xPortGetCoreID()];
+    a.cycles = ESP.getCycleCount();
+    a.us = micros64();
+  }
+
+  // Snapshot: u8 version, u16 cpu MHz, per core {u32 cycles, u32 us lo,
+  // u32 us hi}, u8 name count, names as (u8 len, bytes), u16 event count,
+  // events as {u32 start, u32 cycles, u8 id, u8 core}, oldest first.
+  // Recording pauses while it runs; a span already being written on the
+  // other core at that instant may come out torn. Returns 0 if `cap` is too
+  // small.
+  size_t writeBinary(uint8_t *out, size_t cap, const char *const *names, uint8_t nameCount)
+  {
+    paused_.store(true, std::memory_order_relaxed);
+    size_t pos = 0;
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint16_t count = head < CAPACITY ? head : CAPACITY;
+    size_t need = 3 + TRACE_CORES * 12 + 1 + 2 + (size_t)count * 10;
+    for (uint8_t i = 0; i < nameCount; i++)
+      need += 1 + strlen(names[i]);
+    if (need <= cap)
+    {
+      out[pos++] = 1;
+      pos += put16(out + pos, getCpuFrequencyMhz());
+      for (uint8_t c = 0; c < TRACE_CORES; c++)
+      {
+        pos += put32(out + pos, anchors_[c].cycles);
+        pos += put32(out + pos, (uint32_t)anchors_[c].us);
+        pos += put32(out + pos, (uint32_t)(anchors_[c].us >> 32));
+      }
+      out[pos++] = nameCount;
+      for (uint8_t i = 0; i < nameCount; i++)
+      {
+        uint8_t n = strlen(names[i]);
+        out[pos++] = n;
+        memcpy(out + pos, names[i], n);
+        pos += n;
+      }
+      pos += put16(out + pos, count);
+      for (uint32_t i = head - count; i != head; i++)
+      {
+        const TraceEvent &e = events_[i % CAPACITY];
+        pos += put32(out + pos, e.start);
+        pos += put32(out + pos, e.cycles);
+        out[pos++] = e.id;
+        out[pos++] = e.core;
+      }
+    }
+    paused_.store(false, std::memory_order_relaxed);
+    return pos;
+  }
+
+private:
+  TraceEvent events_[CAPACITY];
+  TraceAnchor anchors_[TRACE_CORES] = {};
+  std::atomic<uint32_t> head_{0};
+  std::atomic<bool> paused_{false};
+
+  static uint64_t micros64() { return (uint64_t)esp_timer_get_time(); }
+  static size_t put16(uint8_t *p, uint16_t v)
+  {
+    p[0] = v;
+    p[1] = v >> 8;
+    return 2;
+  }
+  static size_t put32(uint8_t *p, uint32_t v)
+  {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+    return 4;
+  }
+};
+
+template <typename Ring>
+class TraceScope
+{
+public:
+  TraceScope(Ring &ring, uint8_t id) : ring_(ring), id_(id), start_(ESP.getCycleCount()) {}
+  ~TraceScope() { ring_.record(id_, start_, ESP.getCycleCount()); }
+
+private:
+  Ring &ring_;
+  uint8_t id_;
+  uint32_t start_;
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#if TRACE_ENABLED
+// Records the enclosing scope as trace point `id`
+#define TRACE_SCOPE(id) TraceScope<decltype(traceRing)> TRACE_CONCAT(traceScope_, __LINE__)(traceRing, id)
+#define TRACE_ANCHOR() traceRing.anchor()
+#else
+#define TRACE_SCOPE(id) \
+  do                    \
+  {                     \
+  } while (0)
+#define TRACE_ANCHOR() \
+  do                   \
+  {                    \
+  } while (0)
+#endif
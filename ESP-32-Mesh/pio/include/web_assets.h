@@ -0,0 +1,48 @@
+// Generated by scripts/embed_web.py from web/; do not edit.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <pgmspace.h>
+
+struct WebAsset
+{
+  const char *path;
+  const char *type;
+  const uint8_t *gz; // gzip body, in flash
+  size_t len;
+  const char *etag; // quoted, as sent
+};
+
+// index.html: 607 bytes, 396 gzipped
+static const uint8_t WEB_INDEX_HTML[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x7d, 0x92, 0x4d, 0x8f, 0xd3, 0x30,
+    0x10, 0x86, 0xef, 0xfb, 0x2b, 0x06, 0x4b, 0xdc, 0x36, 0xca, 0xb6, 0x02, 0x69, 0x95, 0x3a, 0x91,
+    0xd0, 0x52, 0x71, 0x42, 0x2c, 0x50, 0x0e, 0x9c, 0x90, 0x1b, 0x4f, 0x93, 0x91, 0xfc, 0xb5, 0xf6,
+    0x64, 0xb7, 0x05, 0xf1, 0xdf, 0xb1, 0xe3, 0xc2, 0x91, 0x83, 0xbf, 0xe4, 0x77, 0x1e, 0xbd, 0xf3,
+    0xda, 0xf2, 0xd5, 0xfb, 0x4f, 0x0f, 0x87, 0xef, 0x8f, 0x7b, 0x98, 0xd9, 0x9a, 0xe1, 0x46, 0xfe,
+    0x5d, 0x50, 0xe9, 0xe1, 0x06, 0x40, 0x32, 0xb1, 0xc1, 0xe1, 0x0b, 0xa6, 0xcf, 0x1f, 0x11, 0xbe,
+    0x25, 0x8c, 0xf0, 0xe0, 0x1d, 0x47, 0x6f, 0xe0, 0x51, 0x39, 0x34, 0xb2, 0xad, 0x82, 0x22, 0xb5,
+    0xc8, 0x0a, 0x9c, 0xb2, 0xd8, 0x8b, 0x67, 0xc2, 0x97, 0xe0, 0x23, 0x0b, 0x18, 0xb3, 0x1a, 0x1d,
+    0xf7, 0xe2, 0x85, 0x34, 0xcf, 0xbd, 0xc6, 0x67, 0x1a, 0xb1, 0x59, 0x0f, 0xb7, 0x40, 0x8e, 0x98,
+    0x94, 0x69, 0xd2, 0xa8, 0x0c, 0xf6, 0x1b, 0xb1, 0x62, 0x12, 0x5f, 0x2a, 0x10, 0xe0, 0xe8, 0xf5,
+    0x05, 0x7e, 0xc1, 0x29, 0x33, 0x9a, 0x93, 0xb2, 0x64, 0x2e, 0x1d, 0xbc, 0x8b, 0xb9, 0x62, 0x07,
+    0x8c, 0x67, 0x6e, 0x94, 0xa1, 0xc9, 0x75, 0x63, 0xe6, 0x63, 0xdc, 0x81, 0x55, 0x71, 0x22, 0xd7,
+    0xb0, 0x0f, 0xdd, 0xf6, 0xee, 0xf5, 0x0e, 0x7e, 0xaf, 0x0c, 0x72, 0x61, 0xe1, 0x5b, 0x38, 0x2e,
+    0xcc, 0xde, 0x65, 0x58, 0x50, 0x5a, 0x93, 0x9b, 0xba, 0xcd, 0x36, 0x9c, 0x77, 0x15, 0x9d, 0xe8,
+    0x27, 0x76, 0x9b, 0xfb, 0x72, 0xae, 0x8c, 0xee, 0x6d, 0xd9, 0x97, 0x7a, 0xd9, 0x5e, 0xed, 0xc8,
+    0xb6, 0x46, 0x22, 0x8b, 0xa7, 0xd5, 0xe7, 0xbc, 0xfd, 0x5f, 0x2c, 0xf9, 0xb6, 0x88, 0xc2, 0xb0,
+    0x2f, 0xe6, 0x40, 0x81, 0xc5, 0x94, 0xd4, 0x84, 0xa0, 0x9c, 0x86, 0x84, 0x79, 0x22, 0x06, 0xf6,
+    0xc0, 0x33, 0xc2, 0x21, 0x8f, 0x8c, 0x7a, 0x5a, 0x30, 0xb7, 0xa5, 0xac, 0x6c, 0xc3, 0x5a, 0x7b,
+    0xf2, 0xd1, 0x82, 0x1a, 0x99, 0xbc, 0xeb, 0x45, 0x9b, 0x96, 0xa3, 0x25, 0xfe, 0x91, 0x7c, 0x12,
+    0x99, 0xc5, 0xb3, 0xd7, 0xbd, 0xf8, 0xb0, 0x3f, 0x88, 0x9a, 0x94, 0x5c, 0xdb, 0x04, 0xbe, 0x84,
+    0x9c, 0x7e, 0xc9, 0x46, 0x5c, 0x5f, 0xc2, 0xa6, 0x29, 0xeb, 0xd5, 0xd9, 0xa0, 0x9b, 0x72, 0xfe,
+    0xe2, 0xcd, 0xfd, 0x9d, 0x80, 0x60, 0xd4, 0x88, 0xb3, 0x37, 0x1a, 0x63, 0x2f, 0xbe, 0x16, 0x33,
+    0xff, 0xfc, 0x09, 0x88, 0xf8, 0xb4, 0x50, 0x44, 0x7d, 0x05, 0x5f, 0x83, 0xab, 0xe4, 0x6a, 0x42,
+    0x0c, 0xa5, 0x46, 0xb6, 0xf5, 0x6a, 0xf5, 0xda, 0x16, 0xb3, 0x25, 0xa5, 0x1a, 0x4f, 0xee, 0x7f,
+    0xfd, 0x47, 0x7f, 0x00, 0x2f, 0xee, 0xbc, 0xab, 0x5f, 0x02, 0x00, 0x00,
+};
+
+static const WebAsset WEB_ASSETS[] = {
+    {"/", "text/html", WEB_INDEX_HTML, sizeof(WEB_INDEX_HTML), "\"d2e1bfeecff233e4\""},
+};
+static const size_t WEB_ASSET_COUNT = sizeof(WEB_ASSETS) / sizeof(WEB_ASSETS[0]);
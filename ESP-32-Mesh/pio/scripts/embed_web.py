@@ -0,0 +1,83 @@
+"""Gzips the portal's static files (web/) into include/web_assets.h.
+
+Runs as a PlatformIO pre-build script (see extra_scripts in platformio.ini)
+and can be run by hand:  python scripts/embed_web.py
+The header only changes when a file does, so it does not force rebuilds.
+Each file gets a strong ETag from its content; web/index.html is served
+at "/", everything else at "/<name>".
+"""
+import gzip
+import hashlib
+import mimetypes
+import os
+import sys
+
+TYPES = {".html": "text/html", ".css": "text/css", ".js": "application/javascript", ".svg": "image/svg+xml",
+         ".json": "application/json", ".ico": "image/x-icon"}
+
+
+def ident(name):
+    return "WEB_" + "".join(c.upper() if c.isalnum() else "_" for c in name)
+
+
+def render(web_dir):
+    out = ["// Generated by scripts/embed_web.py from web/; do not edit.",
+           "#pragma once",
+           "#include <stdint.h>",
+           "#include <stddef.h>",
+           "#include <pgmspace.h>",
+           "",
+           "struct WebAsset",
+           "{",
+           "  const char *path;",
+           "  const char *type;",
+           "  const uint8_t *gz; // gzip body, in flash",
+           "  size_t len;",
+           "  const char *etag; // quoted, as sent",
+           "};",
+           ""]
+    assets = []
+    for name in sorted(os.listdir(web_dir)):
+        path = os.path.join(web_dir, name)
+        if not os.path.isfile(path):
+            continue
+        with open(path, "rb") as f:
+            raw = f.read()
+        body = gzip.compress(raw, compresslevel=9, mtime=0)
+        etag = '\\"' + hashlib.sha1(raw).hexdigest()[:16] + '\\"'
+        ext = os.path.splitext(name)[1]
+        ctype = TYPES.get(ext) or mimetypes.guess_type(name)[0] or "application/octet-stream"
+        url = "/" if name == "index.html" else "/" + name
+        sym = ident(name)
+        out.append(f"// {name}: {len(raw)} bytes, {len(body)} gzipped")
+        out.append(f"static const uint8_t {sym}[] PROGMEM = {{")
+        for i in range(0, len(body), 16):
+            out.append("    " + ", ".join(f"0x{b:02x}" for b in body[i:i + 16]) + ",")
+        out.append("};")
+        assets.append(f'    {{"{url}", "{ctype}", {sym}, sizeof({sym}), "{etag}"}},')
+    out.append("")
+    out.append("static const WebAsset WEB_ASSETS[] = {")
+    out.extend(assets)
+    out.append("};")
+    out.append("static const size_t WEB_ASSET_COUNT = sizeof(WEB_ASSETS) / sizeof(WEB_ASSETS[0]);")
+    return "\n".join(out) + "\n"
+
+
+def write_assets(project_dir):
+    text = render(os.path.join(project_dir, "web"))
+    out_path = os.path.join(project_dir, "include", "web_assets.h")
+    if os.path.exists(out_path):
+        with open(out_path) as f:
+            if f.read() == text:
+                return
+    with open(out_path, "w") as f:
+        f.write(text)
+    print(f"embed_web: wrote {out_path}")
+
+
+try:
+    Import("env")  # noqa: F821 (provided by PlatformIO/SCons)
+    write_assets(env["PROJECT_DIR"])  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        write_assets(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
@@ -0,0 +1,87 @@
+"""Collects LOG_x(MODULE, "format", ...) call sites into log_formats.json.
+
+Runs as a PlatformIO pre-build script (see extra_scripts in platformio.ini)
+and writes the table next to the firmware in the build directory. It can
+also be run by hand:  python scripts/log_table.py [out.json]
+
+Ids are the same FNV-1a hash of the format string that log.h computes at
+compile time, so the table never needs to be compiled into the firmware.
+"""
+import json
+import os
+import re
+import sys
+
+LEVELS = {"ERROR": "E", "WARN": "W", "INFO": "I", "DEBUG": "D"}
+CALL = re.compile(r'\bLOG_(ERROR|WARN|INFO|DEBUG)\(\s*(\w+)\s*,\s*((?:"(?:[^"\\]|\\.)*"\s*)+)')
+LITERAL = re.compile(r'"((?:[^"\\]|\\.)*)"')
+ESCAPES = {"n": "\n", "t": "\t", "r": "\r", '"': '"', "'": "'", "\\": "\\", "0": "\0"}
+
+
+def unescape(body):
+    out, i = [], 0
+    while i < len(body):
+        c = body[i]
+        if c == "\\" and i + 1 < len(body):
+            nxt = body[i + 1]
+            if nxt == "x":
+                m = re.match(r"[0-9a-fA-F]+", body[i + 2:])
+                out.append(chr(int(m.group(0), 16)))
+                i += 2 + len(m.group(0))
+                continue
+            out.append(ESCAPES.get(nxt, nxt))
+            i += 2
+            continue
+        out.append(c)
+        i += 1
+    return "".join(out)
+
+
+def fnv1a(text):
+    h = 2166136261
+    for b in text.encode("latin-1"):
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def collect(project_dir):
+    table = {}
+    for sub in ("src", "include"):
+        root = os.path.join(project_dir, sub)
+        for dirpath, _, files in os.walk(root):
+            for name in sorted(files):
+                if not name.endswith((".cpp", ".h", ".hpp", ".c")):
+                    continue
+                path = os.path.join(dirpath, name)
+                with open(path, encoding="utf-8", errors="replace") as f:
+                    text = f.read()
+                for m in CALL.finditer(text):
+                    level, module, literals = m.groups()
+                    fmt = "".join(unescape(s) for s in LITERAL.findall(literals))
+                    key = f"{fnv1a(fmt):08x}"
+                    line = text.count("\n", 0, m.start()) + 1
+                    entry = {"fmt": fmt, "level": LEVELS[level], "module": module,
+                             "where": f"{os.path.relpath(path, project_dir)}:{line}"}
+                    old = table.get(key)
+                    if old and old["fmt"] != fmt:
+                        raise SystemExit(f"log_table: id {key} collides: {old['where']} vs {entry['where']}")
+                    if not old:
+                        table[key] = entry
+    return table
+
+
+def write_table(project_dir, out_path):
+    table = collect(project_dir)
+    os.makedirs(os.path.dirname(out_path) or ".", exist_ok=True)
+    with open(out_path, "w") as f:
+        json.dump(table, f, indent=1, sort_keys=True)
+    print(f"log_table: {len(table)} formats -> {out_path}")
+
+
+try:
+    Import("env")  # noqa: F821 (provided by PlatformIO/SCons)
+    write_table(env["PROJECT_DIR"], os.path.join(env.subst("$BUILD_DIR"), "log_formats.json"))  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        here = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        write_table(here, sys.argv[1] if len(sys.argv) > 1 else "log_formats.json")
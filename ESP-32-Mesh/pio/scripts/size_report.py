@@ -0,0 +1,59 @@
+"""Reports flash and static RAM of each role's image after linking.
+
+Runs as a PlatformIO post-build script (see extra_scripts in platformio.ini)
+and can be run by hand:  python scripts/size_report.py <firmware.elf> [name]
+Each build updates its own line in .pio/build/size_report.txt, so after
+building both esp32dev-master and esp32dev-client the file compares them.
+Sections are counted the way PlatformIO's own size check counts them.
+"""
+import os
+import subprocess
+import sys
+
+FLASH = (".iram0.vectors", ".iram0.text", ".dram0.data", ".flash.text", ".flash.rodata", ".flash.appdesc")
+RAM = (".dram0.data", ".dram0.bss", ".noinit")
+
+
+def sections(size_tool, elf):
+    out = subprocess.check_output([size_tool, "-A", elf], text=True)
+    sizes = {}
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) >= 2 and parts[1].isdigit():
+            sizes[parts[0]] = int(parts[1])
+    return sizes
+
+
+def update_report(path, name, line):
+    lines = []
+    if os.path.exists(path):
+        with open(path) as f:
+            lines = [l for l in f.read().splitlines() if l and not l.startswith(name + " ")]
+    lines.append(line)
+    with open(path, "w") as f:
+        f.write("\n".join(sorted(lines)) + "\n")
+
+
+def report(size_tool, elf, name, out_path=None):
+    sizes = sections(size_tool, elf)
+    flash = sum(sizes.get(s, 0) for s in FLASH)
+    ram = sum(sizes.get(s, 0) for s in RAM)
+    line = f"{name:<20} flash {flash:>8} B   ram {ram:>7} B (data {sizes.get('.dram0.data', 0)}, bss {sizes.get('.dram0.bss', 0)})"
+    print(f"size_report: {line}")
+    if out_path:
+        update_report(out_path, name, line)
+
+
+try:
+    Import("env")  # noqa: F821 (provided by PlatformIO/SCons)
+
+    def after_link(source, target, env):
+        report(env.subst("$SIZETOOL"), str(target[0]), env["PIOENV"],
+               os.path.join(env.subst("$PROJECT_BUILD_DIR"), "size_report.txt"))
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", after_link)  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        if len(sys.argv) < 2:
+            sys.exit("usage: size_report.py <firmware.elf> [name]")
+        report("xtensa-esp32-elf-size", sys.argv[1], sys.argv[2] if len(sys.argv) > 2 else os.path.basename(sys.argv[1]))
@@ -0,0 +1,149 @@
+"""Trains the static dictionary for packed mesh reports (include/compress.h)
+and writes it to include/compress_dict.h.
+
+    python scripts/train_dict.py [capture ...]
+
+Captures are what the master's serial port produced, as the replay tool
+reads them: "[MASTER] RX from <id>: {...}" lines, or bare JSON reports as
+in serial_python/data.json; only reports in the mesh format ("device_id")
+count. To these it adds SEED: one report laid out as
+sendToMaster() writes it, and the phrases people type into the portal in
+an emergency, so a dictionary trained on few captures still covers both.
+
+The dictionary is the substrings worth most by (reports containing them)
+x (bytes the dictionary does not have yet), the most valuable last: the
+encoder's window slides off the front of the dictionary first. Its id is
+a CRC of the content. A master and a client only use the dictionary when
+their ids match (ZCAP), so retraining is safe, but until both images are
+rebuilt the client sends plain reports. Not a build step for that
+reason: run it by hand.
+"""
+import heapq
+import os
+import random
+import sys
+
+WINDOW = 512  # Z_WINDOW in compress.h
+MAX_REPORTS = 3000
+LENGTHS = (48, 32, 24, 16, 12, 8, 6)
+MIN_REPORTS = 2  # substrings in fewer are not worth a place
+GRAM = 4
+PREFIX = b"[MASTER] RX from "
+
+SEED_REPORT = ('{"device_id":"04:83:08:%02X:%02X:%02X","status":"active","userid":"USER_%03d",'
+               '"sensors":{"gps":{"latitude":%.8f,"longitude":%.8f}},"message":"%s",'
+               '"boot":%d,"seq":%d,"ts":[%d,%d,%d]%s}')
+SEED_MESSAGES = ["help", "Help! We are trapped", "injured, need medical help", "trapped under rubble",
+                 "need water and food", "two people injured", "we are safe", "need evacuation",
+                 "bleeding badly, please hurry", "fire near the building", "water is rising", "SOS",
+                 "cannot move, broken leg", "children with us", "on the roof", "road is blocked"]
+
+
+def reports_in(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    for line in data.split(b"\n"):
+        at = line.rfind(PREFIX)
+        if at >= 0:
+            colon = line.find(b": ", at + len(PREFIX))
+            if colon > 0:
+                report = line[colon + 2:].rstrip(b"\r")
+                if report.startswith(b'{"device_id"'):
+                    yield report
+            continue
+        at = line.rfind(b'{"device_id"')
+        if at >= 0:
+            yield line[at:].rstrip(b"\r")
+
+
+def seed():
+    # Only the layout and the phrases repeat: the values are random
+    out = []
+    for m in SEED_MESSAGES:
+        r = random.getrandbits
+        ts = r(32)
+        out.append((SEED_REPORT % (r(8), r(8), r(8), r(10), random.uniform(-90, 90), random.uniform(-180, 180), m,
+                                   r(32), r(16), ts, ts + r(20), ts + r(22), ',"sos":true' if r(1) else "")).encode())
+    return out
+
+
+def train(reports, size=WINDOW):
+    counts = {}
+    for r in reports:
+        seen = set()
+        for n in LENGTHS:
+            for i in range(len(r) - n + 1):
+                seen.add(r[i:i + n])
+        for s in seen:
+            counts[s] = counts.get(s, 0) + 1
+    # Lazy greedy: a substring is worth (reports containing it) x (its
+    # bytes not yet covered by what was picked, in GRAM-byte steps)
+    picked, covered, total = [], set(), 0
+
+    def gain(s):
+        return counts[s] * sum(s[i:i + GRAM] not in covered for i in range(len(s) - GRAM + 1))
+
+    heap = [(-gain(s), s) for s, c in counts.items() if c >= MIN_REPORTS]
+    heapq.heapify(heap)
+    while heap and total < size:
+        _, s = heapq.heappop(heap)
+        g = gain(s)
+        if not g:
+            continue
+        if heap and g < -heap[0][0]:
+            heapq.heappush(heap, (-g, s))
+            continue
+        if total + len(s) > size:
+            continue
+        picked.append(s)
+        total += len(s)
+        covered.update(s[i:i + GRAM] for i in range(len(s) - GRAM + 1))
+    # Picked first is worth most: it goes last
+    return b"".join(reversed(picked))
+
+
+def crc16_ccitt(data, crc=0xFFFF):
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def render(dictionary, sources, n_reports):
+    ident = crc16_ccitt(dictionary) or 1
+    out = [f"// Generated by scripts/train_dict.py from {', '.join(sources) or 'its seed only'}; do not edit.",
+           "#pragma once",
+           '#include "compress.h"',
+           "",
+           f"// {len(dictionary)} bytes from {n_reports} reports",
+           "static const char ZDICT_REPORTS_TEXT[] ="]
+    for i in range(0, len(dictionary), 64):
+        chunk = dictionary[i:i + 64].decode("latin-1")
+        chunk = "".join(("\\" + c if c in '"\\' else c) if 32 <= ord(c) < 127 else f"\\{ord(c):03o}" for c in chunk)
+        out.append(f'    "{chunk}"')
+    out[-1] += ";"
+    out.append(f"static const ZDict ZDICT_REPORTS = {{(const uint8_t *)ZDICT_REPORTS_TEXT, {len(dictionary)}, 0x{ident:04x}}};")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    project = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    reports = []
+    for path in sys.argv[1:]:
+        reports.extend(reports_in(path))
+    random.seed(1)
+    if len(reports) > MAX_REPORTS:
+        reports = random.sample(reports, MAX_REPORTS)
+    reports.extend(seed())
+    dictionary = train(reports)
+    sources = [os.path.relpath(p, project) for p in sys.argv[1:]]
+    out_path = os.path.join(project, "include", "compress_dict.h")
+    with open(out_path, "w") as f:
+        f.write(render(dictionary, sources, len(reports)))
+    print(f"train_dict: {len(dictionary)} bytes from {len(reports)} reports -> {out_path}")
+
+
+if __name__ == "__main__":
+    main()
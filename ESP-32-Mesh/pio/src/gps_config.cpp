@@ -0,0 +1,295 @@
+#include "gps_config.h"
+#include "inbound.h"
+#include <Preferences.h>
+#include <sys/time.h>
+
+// UBX message ids we use
+#define UBX_CLS_NAV_NMEA 0xF0
+#define UBX_CLS_ACK 0x05
+#define UBX_CLS_CFG 0x06
+#define UBX_CLS_MON 0x0A
+#define UBX_CLS_AID 0x0B
+#define UBX_CLS_MGA 0x13
+#define UBX_CFG_PRT 0x00
+#define UBX_CFG_MSG 0x01
+#define UBX_CFG_RATE 0x08
+#define UBX_MON_VER 0x04
+#define UBX_AID_INI 0x01
+#define UBX_MGA_INI 0x40
+
+// NMEA sentence ids (class 0xF0). TinyGPSPlus only needs GGA and RMC.
+static const uint8_t NMEA_UNUSED[] = {0x01 /*GLL*/, 0x02 /*GSA*/, 0x03 /*GSV*/, 0x05 /*VTG*/};
+
+static const char *NVS_NS = "gps";
+static const char *NVS_KEY_FIX = "fix";
+static const uint32_t GPS_EPOCH_UNIX = 315964800UL; // 1980-01-06
+static const uint32_t GPS_LEAP_SECONDS = 18;
+
+static inline void put16(uint8_t *p, uint16_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+}
+static inline void put32(uint8_t *p, uint32_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+size_t ubxSend(Print &out, uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len)
+{
+  uint8_t hdr[6] = {0xB5, 0x62, cls, id, (uint8_t)len, (uint8_t)(len >> 8)};
+  uint8_t ckA = 0, ckB = 0;
+  for (int i = 2; i < 6; i++)
+  {
+    ckA += hdr[i];
+    ckB += ckA;
+  }
+  for (uint16_t i = 0; i < len; i++)
+  {
+    ckA += payload[i];
+    ckB += ckA;
+  }
+  uint8_t ck[2] = {ckA, ckB};
+  size_t n = out.write(hdr, sizeof(hdr));
+  if (len)
+    n += out.write(payload, len);
+  n += out.write(ck, sizeof(ck));
+  return n;
+}
+
+// Scans the incoming stream for a UBX frame of (cls, id); NMEA text around it is
+// skipped. Copies up to `cap` payload bytes into `buf`. Returns payload length or -1.
+static int ubxWaitFor(HardwareSerial &port, uint8_t cls, uint8_t id, uint8_t *buf, uint16_t cap, uint32_t timeoutMs)
+{
+  UbxScanner ubx;
+  uint32_t start = millis();
+  while (millis() - start < timeoutMs)
+  {
+    if (!port.available())
+    {
+      vTaskDelay(1);
+      continue;
+    }
+    if (ubx.push(port.read(), buf, cap) && ubx.cls == cls && ubx.id == id)
+      return ubx.len;
+  }
+  return -1;
+}
+
+// Sends a CFG command and waits for ACK-ACK. Returns true if acknowledged.
+static bool ubxCommand(HardwareSerial &port, GpsConfigResult &res, uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len)
+{
+  ubxSend(port, cls, id, payload, len);
+  res.sent++;
+  uint8_t ack[2];
+  uint32_t start = millis();
+  while (millis() - start < GPS_ACK_TIMEOUT_MS)
+  {
+    int n = ubxWaitFor(port, UBX_CLS_ACK, 0x01, ack, sizeof(ack), GPS_ACK_TIMEOUT_MS);
+    if (n < 0)
+      break;
+    if (n == 2 && ack[0] == cls && ack[1] == id)
+    {
+      res.acked++;
+      return true;
+    }
+  }
+  return false;
+}
+
+static GpsChip probeChip(HardwareSerial &port)
+{
+  uint8_t ver[40];
+  while (port.available())
+    port.read();
+  ubxSend(port, UBX_CLS_MON, UBX_MON_VER, nullptr, 0);
+  int n = ubxWaitFor(port, UBX_CLS_MON, UBX_MON_VER, ver, sizeof(ver), GPS_PROBE_TIMEOUT_MS);
+  if (n < 40)
+    return GPS_CHIP_UNKNOWN;
+  // hwVersion is 10 chars at offset 30, e.g. "00040007" (u-blox 6), "00080000" (M8)
+  if (ver[30] == '0' && ver[31] == '0' && ver[32] == '0' && (ver[33] == '4' || ver[33] == '7'))
+    return GPS_CHIP_UBX6;
+  return GPS_CHIP_UBX8;
+}
+
+static void sendHint(HardwareSerial &port, GpsConfigResult &res, GpsChip chip)
+{
+  GpsFixHint hint;
+  if (!gpsLoadHint(hint))
+    return;
+  // Only trust the clock if it survived a soft reset (set from an earlier fix)
+  time_t now = time(nullptr);
+  bool timeValid = hint.unixTime && (uint32_t)now >= hint.unixTime;
+
+  if (chip == GPS_CHIP_UBX6)
+  {
+    uint8_t p[48] = {0};
+    put32(p + 0, hint.latE7);
+    put32(p + 4, hint.lonE7);
+    put32(p + 8, hint.altCm);
+    put32(p + 12, GPS_HINT_POS_ACC_M * 100UL);
+    uint32_t flags = 0x01 | 0x20; // pos valid, LLA
+    if (timeValid)
+    {
+      uint32_t gpsSec = (uint32_t)now - GPS_EPOCH_UNIX + GPS_LEAP_SECONDS;
+      put16(p + 18, gpsSec / 604800UL);
+      put32(p + 20, (gpsSec % 604800UL) * 1000UL);
+      put32(p + 28, 2000); // tAccMs
+      flags |= 0x02;
+    }
+    put32(p + 44, flags);
+    ubxCommand(port, res, UBX_CLS_AID, UBX_AID_INI, p, sizeof(p));
+  }
+  else
+  {
+    uint8_t pos[20] = {0x01, 0x00};
+    put32(pos + 4, hint.latE7);
+    put32(pos + 8, hint.lonE7);
+    put32(pos + 12, hint.altCm);
+    put32(pos + 16, GPS_HINT_POS_ACC_M * 100UL);
+    ubxCommand(port, res, UBX_CLS_MGA, UBX_MGA_INI, pos, sizeof(pos));
+    if (timeValid)
+    {
+      struct tm t;
+      gmtime_r(&now, &t);
+      uint8_t tp[24] = {0x10, 0x00, 0x00, (uint8_t)(int8_t)-128};
+      put16(tp + 4, t.tm_year + 1900);
+      tp[6] = t.tm_mon + 1;
+      tp[7] = t.tm_mday;
+      tp[8] = t.tm_hour;
+      tp[9] = t.tm_min;
+      tp[10] = t.tm_sec;
+      put16(tp + 16, 2); // tAccS
+      ubxCommand(port, res, UBX_CLS_MGA, UBX_MGA_INI, tp, sizeof(tp));
+    }
+  }
+  res.hintSent = true;
+}
+
+GpsConfigResult configureGPS(HardwareSerial &port, int8_t rxPin, int8_t txPin)
+{
+  GpsConfigResult res;
+  port.begin(GPS_BOOT_BAUD, SERIAL_8N1, rxPin, txPin);
+  GpsChip chip = probeChip(port);
+  if (chip == GPS_CHIP_UNKNOWN)
+  {
+    // Module may still be at the fast baud from before an ESP-only reset
+    port.updateBaudRate(GPS_FAST_BAUD);
+    chip = probeChip(port);
+    if (chip == GPS_CHIP_UNKNOWN)
+    {
+      port.updateBaudRate(GPS_BOOT_BAUD);
+      return res; // plain NMEA module: leave it alone
+    }
+  }
+  res.chip = chip;
+
+  if (port.baudRate() != GPS_FAST_BAUD)
+  {
+    uint8_t prt[20] = {0x01}; // UART1
+    put32(prt + 4, 0x000008D0); // 8N1
+    put32(prt + 8, GPS_FAST_BAUD);
+    put16(prt + 12, 0x0003); // in: UBX + NMEA
+    put16(prt + 14, 0x0003); // out: UBX + NMEA
+    ubxSend(port, UBX_CLS_CFG, UBX_CFG_PRT, prt, sizeof(prt));
+    res.sent++;
+    port.flush();
+    vTaskDelay(50 / portTICK_PERIOD_MS); // module switches after the frame
+    port.updateBaudRate(GPS_FAST_BAUD);
+    if (probeChip(port) == GPS_CHIP_UNKNOWN)
+    {
+      port.updateBaudRate(GPS_BOOT_BAUD);
+      res.baud = GPS_BOOT_BAUD;
+    }
+    else
+    {
+      res.acked++;
+      res.baud = GPS_FAST_BAUD;
+    }
+  }
+  else
+  {
+    res.baud = GPS_FAST_BAUD;
+  }
+
+  uint8_t rate[6];
+  put16(rate + 0, GPS_RATE_MS);
+  put16(rate + 2, 1); // one measurement per solution
+  put16(rate + 4, 1); // align to GPS time
+  ubxCommand(port, res, UBX_CLS_CFG, UBX_CFG_RATE, rate, sizeof(rate));
+
+  for (uint8_t id : NMEA_UNUSED)
+  {
+    uint8_t msg[3] = {UBX_CLS_NAV_NMEA, id, 0};
+    ubxCommand(port, res, UBX_CLS_CFG, UBX_CFG_MSG, msg, sizeof(msg));
+  }
+
+  sendHint(port, res, chip);
+  return res;
+}
+
+bool gpsLoadHint(GpsFixHint &hint)
+{
+  Preferences prefs;
+  if (!prefs.begin(NVS_NS, true))
+    return false;
+  bool ok = prefs.getBytes(NVS_KEY_FIX, &hint, sizeof(hint)) == sizeof(hint);
+  prefs.end();
+  return ok && (hint.latE7 || hint.lonE7);
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static int32_t daysFromCivil(int32_t y, uint32_t m, uint32_t d)
+{
+  y -= m <= 2;
+  int32_t era = (y >= 0 ? y : y - 399) / 400;
+  uint32_t yoe = (uint32_t)(y - era * 400);
+  uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int32_t)doe - 719468;
+}
+
+uint32_t gpsUnixTime(TinyGPSPlus &gps)
+{
+  if (!gps.date.isValid() || !gps.time.isValid() || gps.date.year() < 2020)
+    return 0;
+  int32_t days = daysFromCivil(gps.date.year(), gps.date.month(), gps.date.day());
+  return (uint32_t)days * 86400UL + gps.time.hour() * 3600UL + gps.time.minute() * 60UL + gps.time.second();
+}
+
+void gpsMaybeSaveHint(TinyGPSPlus &gps)
+{
+  static uint32_t lastSave = 0;
+  static bool saved = false;
+  static bool clockSet = false;
+  if (!gps.location.isValid() || gps.location.age() > 2000)
+    return;
+
+  uint32_t unixTime = gpsUnixTime(gps);
+  if (unixTime && !clockSet)
+  {
+    // Keep wall time across soft resets so the next boot can send a time hint
+    struct timeval tv = {(time_t)unixTime, 0};
+    settimeofday(&tv, nullptr);
+    clockSet = true;
+  }
+  if (saved && millis() - lastSave < GPS_SAVE_PERIOD_MS)
+    return;
+
+  GpsFixHint hint;
+  if (!fixToE7(gps.location.lat(), gps.location.lng(), hint.latE7, hint.lonE7))
+    return;
+  hint.altCm = gps.altitude.isValid() ? (int32_t)(gps.altitude.meters() * 100) : 0;
+  hint.unixTime = unixTime;
+  Preferences prefs;
+  if (prefs.begin(NVS_NS, false))
+  {
+    prefs.putBytes(NVS_KEY_FIX, &hint, sizeof(hint));
+    prefs.end();
+  }
+  lastSave = millis();
+  saved = true;
+}
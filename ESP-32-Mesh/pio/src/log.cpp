@@ -0,0 +1,85 @@
+#include <Arduino.h>
+#include "log.h"
+#include "serial_frame.h"
+
+static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of two");
+
+// Byte ring of whole records. Any task on either core may commit, so the
+// copy runs under a spinlock; it is a few dozen bytes and never waits on I/O.
+static uint8_t ring[LOG_RING_SIZE];
+static uint32_t head = 0, tail = 0;
+static uint32_t dropped = 0;
+static portMUX_TYPE logMux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t logTaskHandle = nullptr;
+
+void logCommit(LogRecord &r)
+{
+  uint32_t ms = millis();
+  memcpy(r.buf + 5, &ms, 4);
+  bool fits, wasEmpty;
+  portENTER_CRITICAL(&logMux);
+  fits = LOG_RING_SIZE - (head - tail) >= r.len;
+  wasEmpty = head == tail;
+  if (fits)
+  {
+    for (uint8_t i = 0; i < r.len; i++)
+      ring[(head + i) & (LOG_RING_SIZE - 1)] = r.buf[i];
+    head += r.len;
+  }
+  else
+    dropped++;
+  portEXIT_CRITICAL(&logMux);
+  if (fits && wasEmpty && logTaskHandle)
+    xTaskNotifyGive(logTaskHandle); // the drain task sleeps while the ring is empty
+}
+
+uint32_t logDropped()
+{
+  return dropped;
+}
+
+// Moves whole records into `out`, up to `cap` bytes
+static size_t popRecords(uint8_t *out, size_t cap)
+{
+  size_t n = 0;
+  portENTER_CRITICAL(&logMux);
+  while (tail != head)
+  {
+    uint8_t len = ring[tail & (LOG_RING_SIZE - 1)];
+    if (n + len > cap)
+      break;
+    for (uint8_t i = 0; i < len; i++)
+      out[n + i] = ring[(tail + i) & (LOG_RING_SIZE - 1)];
+    n += len;
+    tail += len;
+  }
+  portEXIT_CRITICAL(&logMux);
+  return n;
+}
+
+// FRAME_LOG payload: u32 records dropped so far, then records back to back
+static void logTask(void *)
+{
+  static uint8_t frame[LOG_FRAME_MAX + FRAME_OVERHEAD];
+  uint8_t *payload = frame + FRAME_HEADER;
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    for (;;)
+    {
+      uint32_t lost = dropped;
+      memcpy(payload, &lost, 4);
+      size_t n = popRecords(payload + 4, LOG_FRAME_MAX - 4);
+      if (n == 0)
+        break;
+      Serial.write(frame, sealFrame(frame, FRAME_LOG, 4 + n)); // blocks this task only
+    }
+  }
+}
+
+void logBegin()
+{
+  xTaskCreate(logTask, "log", LOG_TASK_STACK, nullptr, LOG_TASK_PRIO, &logTaskHandle);
+  if (head != tail)
+    xTaskNotifyGive(logTaskHandle); // records from before the task existed
+}
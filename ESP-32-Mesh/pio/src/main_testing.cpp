@@ -7,55 +7,64 @@
 // #include "esp_bt_main.h"
 // #include "esp_bt_device.h"
 #include <painlessMesh.h>
-#include <WebServer.h>
-#include <DNSServer.h>
+#include <ESPAsyncWebServer.h>
+#include <AsyncUDP.h>
 #include <ArduinoJson.h>
 #include <AsyncTCP.h>
+#include <esp_wifi.h>
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#endif
+#include "gps_config.h"
+#include "timer_wheel.h"
+#include "spsc_ring.h"
+#include "mesh_msg.h"
+#include "fixed_buffers.h"
+#include "metrics.h"
+#include "serial_frame.h"
+#include "log.h"
+#include "latency.h"
+#include "roster.h"
+#include "dedupe.h"
+#include "alert.h"
+#include "web_assets.h"
+#include "captive_dns.h"
+#include "profile.h"
+#include "runtime_config.h"
+#include "role.h"
+#include "master_ingest.h"
+#include "inbound.h"
+#include "fragment.h"
+#include "compress.h"
+#include "compress_dict.h"
+#include "aggregate.h"
 
-#define MESH_PREFIX "ResQMe_Net"
-#define MESH_PASSWORD "mesh-password5"
-#define MESH_PORT 5555
-
-const char *AP_SSID = "ResQMe_Node";
-const char *AP_PASS = "12345678";
-
-const bool IS_MASTER = false; // <-- change to false on client boards
 Scheduler userScheduler;
 painlessMesh mesh;
 uint32_t masterId = 0; // learned by children at runtime (0 = unknown)
-const bool DEBUG_SERIAL = false;
 
 IPAddress local_IP(192, 168, 4, 1);      // desired IP
 IPAddress gateway(192, 168, 4, 1);       // usually same as local_IP for AP
 IPAddress subnet(255, 255, 255, 0);      // standard subnet mask
-const uint32_t ALERT_DISPLAY_MS = 30000; // show alerts for 30s (match your buzz)
 
 enum Mode
 {
   MODE_MESH,
   MODE_AP
 };
-Mode currentMode = MODE_MESH;
-bool wantAPShutdown = false;
-unsigned long apShutdownAt = 0;
-String storedValue = "";
+Mode currentMode = MODE_MESH; // app core's view; the net core follows via CMD_ENTER_*
+Mode netMode = MODE_MESH;     // what the net core is actually running
 
 // --- AP wait-for-login blink state (non-blocking) ---
-bool apHasClient = false; // becomes true when a station connects
-bool blinkActive = false; // blinking only while waiting for first client
-unsigned long nextBlinkAt = 0;
-bool ledState = false; // current LED state during blink
+volatile bool apHasClient = false; // set from the WiFi event task when a station connects
+std::atomic<uint32_t> staJoinedMs{0}; // millis() | 1 at the first unserved station join, 0 = none
+bool ledState = false;             // current LED state during blink
 
 // ================== USER CONFIG ==================
 static const char *USER_ID = "USER_001";
 uint8_t MASTER_MAC[6] = {0x24, 0x6F, 0x28, 0xAA, 0xBB, 0xCC};
-// Pins
-#define PIN_GPS_RX 16
-#define PIN_GPS_TX 17
-#define PIN_LED_BLUE 26
-#define PIN_LED_RED 27
-#define PIN_BUTTON 14
-#define PIN_BUZZER 25
+// Mesh/AP credentials, pins, button timings, send period and alert display
+// time are runtime config: defaults in runtime_config.h, "!cfg" to change
 // Buzzer Properties
 #define BUZZER_CHANNEL 0
 #define BUZZER_FREQ 2000 // 2 kHz tone
@@ -65,29 +74,89 @@ uint8_t MASTER_MAC[6] = {0x24, 0x6F, 0x28, 0xAA, 0xBB, 0xCC};
 #define OLED_HEIGHT 32
 #define OLED_ADDR 0x3C
 #define OLED_RESET -1
-// Button timing (ms)
-#define DEBOUNCE_MS 35
-#define MULTICLICK_GAP 450
-#define LONGPRESS_MS 3000
-// Send period
-#define SEND_PERIOD_MS 1000
+// Display refresh / AP timings
+#define DRAW_PERIOD_MS 200
+#define BLINK_PERIOD_MS 300
+#define AP_SHUTDOWN_DELAY_MS 1500
+#define TIMER_CAPACITY 16
+// Idle: longest loop() may block before servicing mesh / serial polling
+#define MESH_IDLE_MAX_MS 20
+#define APP_IDLE_MAX_MS 1000
+#define CPU_MAX_MHZ 240
+#define CPU_MIN_MHZ 80
+// Cores: painlessMesh + serial bridge on the protocol core (the async web
+// server runs on the AsyncTCP task, pinned there too), the rest on the app core
+#define NET_CORE 0
+#define NET_TASK_STACK 8192
+#define NET_TASK_PRIO 1
+#define RING_SIZE 32 // descriptors per direction (text lives in msgPool)
+#define WEB_RING_SIZE 8 // portal handlers (AsyncTCP task) -> netTask
+#if RESQME_ROLE_MASTER
+#define OUTBOX_CAPACITY 8
+#else
+#define OUTBOX_CAPACITY 16 // portal messages held while the master is unknown
+#endif
+// Set to 1 to run the cross-core ring stress test at the end of setup()
+#define CORE_STRESS_TEST 0
+#define STRESS_MESSAGES 20000
+// Fixed buffer sizes
+#define USERID_MAX PROFILE_USERID_MAX
+#define EVENT_TEXT_MAX 96    // what fits on the 128x32 OLED
+static_assert(MESH_JSON_MAX + 32 <= UPLINK_LINE_MAX, "UPLINK_LINE_MAX too small for a report");
+#define SERIAL_TX_BUFFER 1024
+// End-to-end latency (master)
+#define LATENCY_REPORT_S 60 // periodic JSON line on the uplink
+#define HOP_TABLE_SIZE 32   // nodes whose hop distance is tracked
+#define LATENCY_JSON_MAX 1536
+#define HEALTH_REPORT_S 60  // periodic FRAME_HEALTH (report delivery per node)
+// Roster and duplicate filter sizes: include/master_ingest.h
+// Serial bridge line: include/inbound.h
+// Alerts (clients): buzz length per severity 0-3; the text shows cfg.alertDisplayMs
+const uint16_t ALERT_BUZZ_MS[4] = {0, 5000, 15000, 30000};
+#define ALERT_RECENT_IDS 16 // repeats of these alert ids are ignored
+// Alert delivery (master): ACKs per node, unicast retries to silent ones
+#define ALERT_TRACKED 4     // alerts followed at once; a new one ends the oldest
+#define ALERT_RETRY_MS 5000 // first retry round; doubles each round
+#define ALERT_RETRIES 4
+#define ALERT_SUMMARY_S 60 // delivery line while counts change, until the alert expires
+// Messages to one user (master): "TO:" lines from the gateway
+#define DIRECT_PENDING 8    // awaiting an ACK at once
+#define DIRECT_ACK_MS 3000  // first ACK timeout; doubles per retry
+#define DIRECT_TRIES 3
+// Reports longer than cfg.fragMtu travel in fragments (include/fragment.h)
+#define FRAG_TX_SLOTS 2  // client: long reports in flight at once
+#define FRAG_RX_SLOTS 8  // master: transfers reassembled at once, MESH_JSON_MAX bytes each
+#define FRAG_PACE_MS 20  // client: one fragment per tick; other sends go out in between
+// Packing (include/compress.h), switched by cfg.compress
+#define Z_ASK_EVERY 16           // client: reports sent plain between ZCAP? questions, until one is answered
+#define SERIAL_FRAME_PACKED_MAX 2048 // binary dumps that do not pack this small go out as they are
+// Relays merge routine reports for the master (include/aggregate.h), held up to cfg.aggHoldMs
+#define AGG_TICK_MS 10   // relay: how often held reports are checked
+#define AGG_ASK_EVERY 16 // client: reports sent plain between AGG? questions, until one is answered
+#define METRICS_CAPACITY 48
+#define SERIAL_FRAME_MAX 5632 // largest binary dump (metrics, roster, trace) with framing
+// Phase tracer (pins the CPU clock and disables light sleep while enabled)
+#define TRACE_ENABLED 0
+#define TRACE_CAPACITY 512 // newest spans kept
 // Bluetooth
 // ================== END USER CONFIG ==============
+#include "trace.h" // after USER CONFIG: TRACE_ENABLED selects the macros
 
 IPAddress apIP(192, 168, 4, 1);
 
 // ======== Global objects ========
-WebServer server(80);
-DNSServer dnsServer;
-
-// ======== HTML Page ========
+AsyncWebServer server(80); // handlers run on the AsyncTCP task, not netTask
+AsyncUDP dnsUdp;           // captive DNS, answered on the async_udp task
 
 // ======== Handlers ========
 
-String USERID = "";
+FixedString<USERID_MAX + 1> USERID;
+char macStr[18]; // this node's MAC, formatted once at boot
 // GPS
 HardwareSerial GPS(1);
 TinyGPSPlus gps;
+GpsConfigResult gpsConfig;
+uint32_t gpsBytes = 0; // raw UART bytes from the GPS, for rate reporting
 
 // OLED
 Adafruit_SSD1306 display(OLED_WIDTH, OLED_HEIGHT, &Wire, OLED_RESET);
@@ -96,540 +165,2028 @@ void stopMesh();
 void startAP();
 void stopAP();
 void startMesh();
-// State
-String modeText = "Mode: Safe mode";
-String lastEventText = "";
-unsigned long eventTextUntil = 0;
+// State (app core only)
+FixedString<32> modeText = "Mode: Safe mode";
+FixedString<EVENT_TEXT_MAX> lastEventText;
+bool eventTextActive = false;
+uint32_t alertToConfirm = 0; // id of the last alert shown, until double-clicked
+bool screenDirty = true;    // redraw on the next draw tick
+uint32_t meshNodeCount = 0; // mirrored from EVT_NODES
+bool masterKnown = false;   // mirrored from EVT_MASTER
+
+// Outbox (app core only): portal messages waiting for a known master.
+// Entries hold msgPool buffers until the net core has sent them.
+MeshMsg outbox[OUTBOX_CAPACITY];
+uint8_t outboxHead = 0, outboxCount = 0;
+
+// ======== Cross-core rings ========
+SpscRing<MeshMsg, RING_SIZE> toNet; // app -> net
+SpscRing<MeshMsg, RING_SIZE> toApp; // net -> app
+SpscRing<MeshMsg, WEB_RING_SIZE> fromWeb; // portal -> net
+MsgPool msgPool;
+LongMsgPool longMsgPool;
+
+// ======== Metrics ========
+// Updated from both cores with relaxed atomics; exported on /metrics (AP
+// portal) and as a FRAME_METRICS snapshot on the master's serial link.
+Counter meshRx[MK_COUNT], meshTx[MK_COUNT];
+Counter meshSendFailures, dedupeDropped;
+Counter zSavedBytes, zRefused; // bytes packing kept off the mesh and serial link; Z: lines that did not unpack
+Counter aggHeld, aggRefused;   // reports this relay merged into aggregates; AGG: lines that did not parse
+enum AlertOutcome
+{
+  ALERT_RAISED,
+  ALERT_OUTSIDE, // fix outside the alert's target area
+  ALERT_REPEAT,
+  ALERT_EXPIRED,
+  ALERT_OUTCOMES
+};
+Counter alertOutcomes[ALERT_OUTCOMES];
+Histogram appLoopUs, meshUpdateUs;
+Counter dnsQueries, portalProbes;
+Histogram portalFirstPageMs; // station joined the AP -> first page served
+Gauge heapFree, heapMinFree, heapLargestBlock, heapMinLargestBlock;
+Gauge meshNodes, ringDrops, msgPoolHighWater, rosterNodes;
+MetricsRegistry<METRICS_CAPACITY> metrics;
+
+// ======== Tracing ========
+// TRACE_SCOPE(TP_x) spans around loop phases and callbacks; dumped with
+// "!trace" (master serial) or /trace (portal).
+enum TracePoint : uint8_t
+{
+  TP_APP_LOOP,
+  TP_APP_EVENTS,
+  TP_BUTTON,
+  TP_GPS,
+  TP_TIMERS,
+  TP_DRAW,
+  TP_NET_LOOP,
+  TP_NET_COMMANDS,
+  TP_MESH_UPDATE,
+  TP_WEB_EVENTS,
+  TP_SERIAL_BRIDGE,
+  TP_MESH_RECEIVED,
+  TP_SEND_TO_MASTER,
+  TP_HTTP_ROOT,
+  TP_HTTP_SUBMIT,
+  TP_HTTP_USERID,
+  TP_HTTP_PROVISION,
+  TP_HTTP_CONFIG,
+  TP_HTTP_CONFIG_SET,
+  TP_HTTP_METRICS,
+  TP_HTTP_NOT_FOUND,
+  TP_COUNT
+};
+static const char *const TRACE_NAMES[TP_COUNT] = {
+    "loop", "toApp events", "pollButton", "pumpGPS", "timers", "drawScreen",
+    "netLoop", "toNet commands", "mesh.update", "portal events", "serial bridge",
+    "meshReceived", "sendToMaster", "GET /", "GET /submit_sos", "GET /set_user_id",
+    "POST /provision", "GET /config", "POST /config",
+    "GET /metrics", "notFound"};
+#if TRACE_ENABLED
+TraceRing<TRACE_CAPACITY> traceRing;
+#endif
+TaskHandle_t netTaskHandle = nullptr;
+
+// ======== Idle accounting ========
+TaskHandle_t loopTaskHandle = nullptr; // woken by button, UART, timers and toApp
+struct IdleStats
+{
+  uint64_t idleUs = 0;  // time blocked waiting for an event
+  uint64_t busyUs = 0;  // time spent running the loop body
+  uint32_t wakeups = 0; // waits ended by a notification rather than a timeout
+};
+IdleStats appIdle, netIdle;
+
+// ======== Timers ========
+// Every deadline in the firmware lives in this wheel; loop() advances it and
+// can ask how long until the next one is due.
+TimerWheel<TIMER_CAPACITY> timers;
+TimerId buzzTimer, eventTimer, apShutdownTimer, blinkTimer, drawTimer;
+TimerId btnLongTimer, btnGapTimer, sendTimer, reportTimer;
 // Button handling
 enum ButtonEvent
 {
   BTN_NONE,
   BTN_SINGLE,
   BTN_LONG,
+  BTN_DOUBLE,
   BTN_TRIPLE
 };
 struct ButtonState
 {
   bool lastLevel = HIGH;
   unsigned long lastChange = 0;
-  unsigned long pressStart = 0;
   int clickCount = 0;
   bool longReported = false;
+  ButtonEvent pending = BTN_NONE; // set by the long-press / multi-click timers
+  uint32_t pressedUs = 0;         // micros() at the last press, for SOS latency
 } btn;
 void buzz(uint16_t ms, uint32_t freq = BUZZER_FREQ);
-volatile bool buzzing = false;
-uint32_t buzzOffAt = 0;
 
 void startBuzz(uint32_t ms, uint32_t freq = BUZZER_FREQ)
 {
   ledcWriteTone(BUZZER_CHANNEL, freq); // start tone immediately
-  buzzing = true;
-  buzzOffAt = millis() + ms;
+  timers.start(buzzTimer, ms);
+}
+void showEventText(uint32_t ms)
+{
+  eventTextActive = true;
+  screenDirty = true;
+  timers.start(eventTimer, ms);
 }
-inline void showAlertOnScreen(const String &msg)
+inline void showAlertOnScreen(const char *msg)
 {
   lastEventText = msg;
-  eventTextUntil = millis() + ALERT_DISPLAY_MS;
+  showEventText(cfg.alertDisplayMs);
 }
 
-void serviceBuzz()
+// Counting wrappers around painlessMesh sends
+bool meshSendSingle(uint32_t to, const String &msg, MsgKind kind)
 {
-  if (buzzing && (int32_t)(millis() - buzzOffAt) >= 0)
-  {
-    ledcWriteTone(BUZZER_CHANNEL, 0); // stop tone
-    buzzing = false;
-  }
+  meshTx[kind].inc();
+  bool ok = mesh.sendSingle(to, msg);
+  if (!ok)
+    meshSendFailures.inc();
+  return ok;
 }
-void announceMaster()
+bool meshSendBroadcast(const String &msg, MsgKind kind)
 {
-  if (IS_MASTER)
+  meshTx[kind].inc();
+  bool ok = mesh.sendBroadcast(msg);
+  if (!ok)
+    meshSendFailures.inc();
+  return ok;
+}
+
+// Queue a descriptor for the other core and wake it. Each ring has exactly
+// one producer: toNet is only pushed from loop(), toApp only from netTask,
+// fromWeb only from the portal handlers (the one AsyncTCP task).
+bool postToNet(MeshMsg &m)
+{
+  if (!toNet.push(m))
   {
-    String msg = "MASTER:" + String(mesh.getNodeId());
-    mesh.sendBroadcast(msg);
-    if (DEBUG_SERIAL)
-      Serial.printf("[MASTER] Announced: %s\n", msg.c_str());
+    m.release();
+    return false;
   }
+  xTaskNotifyGive(netTaskHandle);
+  return true;
 }
-void sendToMaster(const String &payload)
+bool postFromWeb(MeshMsg &m)
 {
-  if (IS_MASTER)
+  if (!fromWeb.push(m))
   {
-    if (DEBUG_SERIAL)
-      Serial.println("[MASTER] sendToMaster() called on master; ignoring");
-    return;
+    m.release();
+    return false;
   }
-  if (masterId == 0)
+  xTaskNotifyGive(netTaskHandle);
+  return true;
+}
+bool postToApp(MeshMsg &m)
+{
+  if (!toApp.push(m))
   {
-    if (DEBUG_SERIAL)
-      Serial.println("[CLIENT] Master unknown; will retry later");
-    return;
+    m.release();
+    return false;
   }
-
-  StaticJsonDocument<256> doc;
-  doc["device_id"] = WiFi.macAddress();
-  doc["status"] = "active";
-  doc["userid"] = USERID;
-  JsonObject sensors = doc.createNestedObject("sensors");
-  JsonObject gps_data = sensors.createNestedObject("gps");
-  gps_data["latitude"] = gps.location.lat();
-  gps_data["longitude"] = gps.location.lng();
-  doc["message"] = payload;
-  String doc_string;
-  serializeJson(doc, doc_string);
-  mesh.sendSingle(masterId, doc_string);
-  if (DEBUG_SERIAL)
-    Serial.printf("[CLIENT] -> master(%u): %s\n", masterId, doc_string.c_str());
+  xTaskNotifyGive(loopTaskHandle);
+  return true;
 }
-void askWhoIsMaster()
+void postCommand(MeshMsgType type, const char *text = nullptr)
+{
+  MeshMsg m;
+  m.init(type);
+  if (text)
+    m.setText(text, strlen(text));
+  postToNet(m);
+}
+void postEvent(MeshMsgType type, uint32_t node, int32_t a, const char *text, size_t len)
 {
-  mesh.sendBroadcast("WHO_IS_MASTER?");
-  if (DEBUG_SERIAL)
-    Serial.println("[CLIENT] Asked: WHO_IS_MASTER?");
+  MeshMsg m;
+  m.init(type);
+  m.node = node;
+  m.a = a;
+  m.setText(text, len);
+  postToApp(m);
 }
 
-void meshReceived(uint32_t from, String &msg)
+// ======== Net core state ========
+// Only touched from netTask (and the mesh/web callbacks it runs).
+struct NetPosition
 {
-  if (msg == "WHO_IS_MASTER?")
+  int32_t latE7 = 0;
+  int32_t lonE7 = 0;
+} netPosition;
+uint32_t txSeq = 0;  // numbered reports to the master, from 1
+ZEncoder zEncoder;   // packs reports (client) and serial frames
+#if !RESQME_ROLE_MASTER
+RecentIds<ALERT_RECENT_IDS> recentAlerts;
+char alertAckState[ALERT_RECENT_IDS]; // AlertAck last sent for each recentAlerts slot
+RecentIds<DIRECT_PENDING> recentDirect; // retried messages are ACKed again, shown once
+uint32_t bootId = 0; // random per boot; tells the master our numbering restarted
+struct PackingPeer
+{
+  uint32_t master = 0; // the master the rest is about
+  bool accepts = false; // it answered ZCAP
+  uint16_t dictId = 0;  // with this dictionary
+  uint8_t askIn = 0;    // reports until the next ZCAP?
+} zPeer;
+struct AggregationPeers
+{
+  uint32_t master = 0;        // masterAccepts is about this master
+  bool masterAccepts = false; // it answered AGG?: we may relay aggregates
+  uint32_t uplink = 0;        // our neighbour towards the master
+  bool uplinkAccepts = false; // it answered AGG?: it merges our reports
+  uint8_t hops = 0;           // to the master
+  bool relay = false;         // other nodes reach the master through us
+  uint8_t askIn = 0;          // reports until the next AGG?
+} aggPeers;
+#endif
+
+// ======== Role ========
+// Each image defines only its own role's functions and state, inside
+// #if RESQME_ROLE_MASTER blocks. Shared code calls the other role's
+// functions from `if constexpr (IS_MASTER)` branches, which are discarded
+// at compile time, so a declaration is all they need there.
+// Master (and the ingest path in master_ingest.h)
+void announceMaster();
+void updateHopTable();
+uint8_t hopsTo(uint32_t node);
+void alertAcked(uint32_t from, const char *ack);
+void directAcked(uint32_t from, uint32_t id);
+void broadcastAlert(const char *line);
+void sendDirect(const char *line);
+void reportReceived(RosterEntry &node, uint32_t from, const char *msg, size_t len, uint32_t arrival);
+void reportAndAck(RosterEntry &node, uint32_t from, const char *msg, size_t len, uint32_t arrival);
+void fragmentReceived(RosterEntry &node, uint32_t from, const String &msg, uint32_t arrival);
+void packingAsked(uint32_t from);
+// Client
+void sendToMaster(const MeshMsg &m);
+void fragmentAnswered(uint32_t from, const String &msg);
+void packingAnswered(uint32_t from, const String &msg);
+void updateUplink();
+bool relayAccepts();
+void aggregationAnswered(uint32_t from);
+void aggregateRelayed(uint32_t from, const String &msg);
+void askWhoIsMaster();
+void handleAlert(uint32_t from, const String &msg);
+void handleDirect(uint32_t from, const String &msg);
+void confirmAlert(uint32_t id);
+
+#if RESQME_ROLE_MASTER
+void announceMaster()
+{
+  char msg[20];
+  snprintf(msg, sizeof(msg), "MASTER:%u", mesh.getNodeId());
+  meshSendBroadcast(msg, MK_MASTER);
+  LOG_DEBUG(MESH, "Announced: %s", msg);
+}
+#else
+// Long reports go out one fragment per FRAG_PACE_MS tick. Everything else
+// (short reports, alert ACKs, ...) is sent at once, so it passes them.
+FragSender<FRAG_TX_SLOTS, MESH_JSON_MAX> fragOut;
+Task taskFragSend(TASK_MILLISECOND * FRAG_PACE_MS, TASK_FOREVER, []()
+                  {
+  static FixedString<FRAG_MTU_MAX + 1> line; // netTask only
+  uint32_t to;
+  if (fragOut.next(millis(), to, line))
+    meshSendSingle(to, line.c_str(), MK_FRAG);
+  else if (fragOut.idle())
+    taskFragSend.disable(); });
+
+// "FACK:<xfer>" / "FNAK:<xfer>:<missing>" from the master
+void fragmentAnswered(uint32_t from, const String &msg)
+{
+  uint32_t xfer, missing;
+  if (msg.startsWith("FACK:") && parseFragAck(msg.c_str() + 5, xfer))
+    fragOut.acked(from, xfer);
+  else if (msg.startsWith("FNAK:") && parseFragNak(msg.c_str() + 5, xfer, missing))
   {
-    if (IS_MASTER)
-      announceMaster();
-    return;
+    fragOut.nacked(from, xfer, missing);
+    taskFragSend.enableIfNot();
   }
-  if (msg.startsWith("MASTER:"))
+}
+
+// Reports go out packed (include/compress.h) once the master has answered
+// ZCAP, with the dictionary if it has the same one. Until then every
+// Z_ASK_EVERY-th report asks again, and all go out plain.
+bool packReport(const char *msg, size_t len, FixedString<MESH_JSON_MAX> &line)
+{
+  if (!(cfg.compress & Z_PACK_REPORTS))
+    return false;
+  if (zPeer.master != masterId)
+    zPeer = PackingPeer{masterId, false, 0, 0};
+  if (!zPeer.accepts)
   {
-    masterId = msg.substring(7).toInt();
-    if (DEBUG_SERIAL)
-      Serial.printf("[RX] Learned masterId=%u from %u\n", masterId, from);
-    // lastEventText=msg;
-    return;
+    if (!zPeer.askIn--)
+    {
+      zPeer.askIn = Z_ASK_EVERY - 1;
+      meshSendSingle(masterId, "ZCAP?", MK_ZIP);
+    }
+    return false;
   }
+  const ZDict &dict = zPeer.dictId == ZDICT_REPORTS.id ? ZDICT_REPORTS : Z_NO_DICT;
+  if (!zPackLine(zEncoder, msg, len, dict, line))
+    return false;
+  zSavedBytes.inc(len - line.length());
+  return true;
+}
 
-  if (msg.startsWith("ALERT:"))
-  {
-    // do something
+// "ZCAP:<dictionary id>" from the master
+void packingAnswered(uint32_t from, const String &msg)
+{
+  uint16_t id;
+  if (from != masterId || !parseZCap(msg.c_str() + 5, id))
+    return;
+  zPeer = PackingPeer{masterId, true, id, 0};
+  LOG_INFO(MESH, "Master %u unpacks reports (dictionary %x, ours %x)", from, id, ZDICT_REPORTS.id);
+}
 
-    lastEventText = msg;
+// ======== Aggregation (clients) ========
+// A node that others reach the master through (a relay) holds routine
+// reports, its own and theirs, and sends them on as one AGG: line
+// (include/aggregate.h). The line goes to our uplink if it merges too,
+// else to the master directly; painlessMesh routes both the same way.
+AggBatch<AGG_LINE_MAX> aggOut;
 
-    // display.print(msg);
-    // display.display();
-    showAlertOnScreen(msg); // or: lastEventText = msg; eventTextUntil = millis() + ALERT_DISPLAY_MS;
-    startBuzz(30000);
+void aggFlush()
+{
+  static FixedString<AGG_LINE_MAX + 1> line; // netTask only
+  if (aggOut.empty())
     return;
-  }
+  uint32_t to = aggPeers.uplinkAccepts && aggPeers.uplink != masterId ? aggPeers.uplink : masterId;
+  uint8_t n = aggOut.count();
+  aggOut.take(millis(), line);
+  if (to)
+    meshSendSingle(to, line.c_str(), MK_AGG);
+  else
+    LOG_WARN(MESH, "Master lost; %u held reports dropped", n);
+}
+Task taskAggFlush(TASK_MILLISECOND * AGG_TICK_MS, TASK_FOREVER, []()
+                  {
+  if (aggOut.due(millis()))
+    aggFlush();
+  if (aggOut.empty())
+    taskAggFlush.disable(); });
 
-  if (IS_MASTER)
+bool aggHold(uint32_t from, const char *data, size_t len, uint16_t budgetMs)
+{
+  uint32_t now = millis();
+  if (!aggOut.add(from, data, len, now, budgetMs, aggPeers.hops))
   {
-    Serial.printf("[MASTER] RX from %u: %s\n", from, msg.c_str());
-    mesh.sendSingle(from, String("ACK:") + msg);
-    return;
+    aggFlush();
+    if (!aggOut.add(from, data, len, now, budgetMs, aggPeers.hops))
+      return false;
   }
+  aggHeld.inc();
+  if (aggOut.due(now))
+    aggFlush();
   else
+    taskAggFlush.enableIfNot();
+  return true;
+}
+
+// Hops from `t` to `id` through t's subtree, 0 if it is not there
+uint8_t hopsVia(const painlessmesh::protocol::NodeTree &t, uint32_t id)
+{
+  if (t.nodeId == id)
+    return 1;
+  for (auto &sub : t.subs)
   {
-    if (msg.startsWith("ACK:"))
+    uint8_t h = hopsVia(sub, id);
+    if (h)
+      return h + 1;
+  }
+  return 0;
+}
+// Rebuilt on topology changes only; copying the tree allocates
+void updateUplink()
+{
+  uint32_t uplink = 0;
+  uint8_t hops = 0;
+  auto tree = mesh.asNodeTree();
+  for (auto &sub : tree.subs)
+    if (masterId && (hops = hopsVia(sub, masterId)))
     {
-      if (DEBUG_SERIAL)
-        Serial.printf("[CLIENT] %s\n", msg.c_str());
-      return;
+      uplink = sub.nodeId;
+      break;
     }
+  if (uplink != aggPeers.uplink)
+  {
+    aggFlush(); // held for the old route: sent now, to the master
+    aggPeers.uplink = uplink;
+    aggPeers.uplinkAccepts = false;
   }
-  if (DEBUG_SERIAL)
-    Serial.printf("[RX] from %u: %s\n", from, msg.c_str());
+  aggPeers.hops = hops;
+  aggPeers.relay = tree.subs.size() > (uplink ? 1u : 0u);
 }
-void buzz(uint16_t ms, uint32_t freq)
+
+// "AGG?" from a node below: we merge its reports once the master unpacks
+// aggregates, and while cfg.aggHoldMs allows holding any
+bool relayAccepts()
 {
-  ledcWriteTone(BUZZER_CHANNEL, freq); // start tone
-  vTaskDelay(ms / portTICK_PERIOD_MS);
-  ledcWriteTone(BUZZER_CHANNEL, 0); // stop tone
+  return cfg.aggHoldMs && aggPeers.master == masterId && aggPeers.masterAccepts;
 }
-// tasks
-Task taskAnnounce(TASK_SECOND * 5, TASK_FOREVER, []()
-                  { if (IS_MASTER) announceMaster(); });
-Task taskQueryMaster(TASK_SECOND * 3, TASK_FOREVER, []()
-                     { if (!IS_MASTER && masterId == 0) askWhoIsMaster(); });
-Task taskSendToMaster(TASK_SECOND * 2, TASK_FOREVER, []()
-                      {
-  if (!IS_MASTER && masterId != 0) {
-    String msg;
-    if(storedValue != ""){
-      msg = storedValue;
-      sendToMaster(msg);
-      storedValue = "";
-    }
-  } });
-Task taskReport(TASK_SECOND * 5, TASK_FOREVER, []()
-                {
-  auto nodes = mesh.getNodeList();
- if (DEBUG_SERIAL)  Serial.printf("[Node %u] neighbors (%u): ", mesh.getNodeId(), nodes.size());
-  // for (auto &n : nodes) Serial.printf("%u ", n);
- if (DEBUG_SERIAL)  Serial.println(); });
 
-void meshNewConnection(uint32_t nodeId)
+// "AGG!" from the master or our uplink
+void aggregationAnswered(uint32_t from)
 {
-  Serial.printf("[EVENT] New connection: %u\n", nodeId);
-  if (IS_MASTER)
-    announceMaster();
-  if (!IS_MASTER && masterId == 0)
-    askWhoIsMaster();
+  if (from == masterId)
+  {
+    aggPeers.master = masterId;
+    aggPeers.masterAccepts = true;
+  }
+  if (from == aggPeers.uplink)
+    aggPeers.uplinkAccepts = true;
+  LOG_INFO(MESH, "%u takes aggregates", from);
 }
 
-void meshChanged()
+// "AGG:" from a node below, which we answered AGG!
+void aggregateRelayed(uint32_t from, const String &msg)
 {
-  if (DEBUG_SERIAL)
-    Serial.println("[EVENT] Topology changed");
-  if (IS_MASTER)
+  AggReader r;
+  AggEntry e;
+  uint16_t budgetMs;
+  if (!aggValid(msg.c_str() + 4, msg.length() - 4))
   {
-    announceMaster();
+    aggRefused.inc();
+    LOG_WARN(MESH, "Bad aggregate from %u", from);
+    return;
   }
-  else if (masterId != 0)
+  if (!relayAccepts()) // no longer holding: on to the master as it is
   {
-    bool stillThere = false;
-    for (auto &n : mesh.getNodeList())
-      if (n == masterId)
-      {
-        stillThere = true;
-        break;
-      }
-    if (!stillThere)
-    {
-      if (DEBUG_SERIAL)
-        Serial.println("[CLIENT] Master lost; rediscovering");
-      masterId = 0;
-      askWhoIsMaster();
-    }
+    if (masterId)
+      meshSendSingle(masterId, msg, MK_AGG);
+    return;
   }
+  r.begin(msg.c_str() + 4, msg.length() - 4, budgetMs);
+  while (r.next(e))
+    aggHold(e.from, e.data, e.len, budgetMs);
 }
 
-// LEDs + buzzer helpers
-void setBlue(bool on) { digitalWrite(PIN_LED_BLUE, on); }
-void setRed(bool on) { digitalWrite(PIN_LED_RED, on); }
-
-// Draw UI
-void drawScreen()
+// A routine report, merged: held here if we relay, else sent to our uplink
+// to merge. False if it is to go to the master plain.
+bool aggregateReport(const char *msg, size_t len)
 {
+  if (!cfg.aggHoldMs || !masterId)
+    return false;
+  if (aggPeers.master != masterId)
+  {
+    aggPeers.master = masterId;
+    aggPeers.masterAccepts = false;
+  }
+  bool viaUplink = aggPeers.uplink && aggPeers.uplink != masterId;
+  if (!aggPeers.askIn--)
+  {
+    aggPeers.askIn = AGG_ASK_EVERY - 1;
+    if (aggPeers.relay && !aggPeers.masterAccepts)
+      meshSendSingle(masterId, "AGG?", MK_AGG);
+    if (viaUplink && !aggPeers.uplinkAccepts)
+      meshSendSingle(aggPeers.uplink, "AGG?", MK_AGG);
+  }
+  uint32_t self = mesh.getNodeId();
+  if (!AggBatch<AGG_LINE_MAX>::fits(self, len))
+    return false;
+  if (aggPeers.relay && aggPeers.masterAccepts)
+    return aggHold(self, msg, len, cfg.aggHoldMs);
+  if (!viaUplink || !aggPeers.uplinkAccepts)
+    return false;
+  static FixedString<AGG_LINE_MAX + 1> line; // netTask only
+  line.clear();
+  line.appendf("AGG:%u:%x:%u:", cfg.aggHoldMs, self, (unsigned)len);
+  line.append(msg, len);
+  return meshSendSingle(aggPeers.uplink, line.c_str(), MK_AGG);
+}
 
-  display.clearDisplay();
-  display.setTextColor(SSD1306_WHITE);
-  display.setTextSize(1);
-  display.setCursor(0, 0);
-  if (millis() < eventTextUntil && lastEventText.length())
+// Reports carry "ts":[created, queued, sent] in mesh time (getNodeTime, us).
+// The earlier stamps were taken with the local micros() (possibly before
+// this mesh session synced its clock) and are shifted onto mesh time here.
+void sendToMaster(const MeshMsg &m)
+{
+  TRACE_SCOPE(TP_SEND_TO_MASTER);
+  if (masterId == 0)
   {
-    display.print(lastEventText);
+    LOG_INFO(MESH, "Master unknown; will retry later");
+    return;
   }
-  else
+
+  uint32_t nowLocal = micros();
+  uint32_t sent = mesh.getNodeTime();
+  StaticJsonDocument<384> doc;
+  doc["device_id"] = (const char *)macStr;
+  doc["status"] = "active";
+  doc["userid"] = USERID.c_str();
+  JsonObject sensors = doc.createNestedObject("sensors");
+  JsonObject gps_data = sensors.createNestedObject("gps");
+  gps_data["latitude"] = netPosition.latE7 / 1e7;
+  gps_data["longitude"] = netPosition.lonE7 / 1e7;
+  doc["message"] = m.text();
+  if (!bootId)
+    bootId = esp_random() | 1;
+  doc["boot"] = bootId;
+  doc["seq"] = ++txSeq; // consumed even if the send fails: the master sees the gap
+  JsonArray ts = doc.createNestedArray("ts");
+  ts.add(sent - (nowLocal - (uint32_t)m.a));
+  ts.add(sent - (nowLocal - (uint32_t)m.b));
+  ts.add(sent);
+  bool sos = m.flags & MSG_FLAG_SOS;
+  if (sos)
+    doc["sos"] = true;
+  static FixedString<MESH_JSON_MAX> doc_string; // netTask only
+  size_t len = measureJson(doc);
+  if (len > doc_string.capacity())
   {
-    display.print(modeText);
+    LOG_WARN(MESH, "Report of %u bytes does not fit; not sent", (unsigned)len);
+    return;
   }
-  if (currentMode == MODE_MESH)
+  doc_string.setLength(serializeJson(doc, doc_string.data(), doc_string.capacity() + 1));
+  static FixedString<MESH_JSON_MAX> packed; // netTask only
+  const char *out = doc_string.c_str();
+  if (packReport(out, len, packed))
   {
-    auto nodes = mesh.getNodeList();
-    display.setCursor(0, 12);
-    display.printf("Connected to %u node", nodes.size());
-    // if (gps.location.isValid()) display.printf("Lat: %.5f", gps.location.lat());
-    // else display.print("Lat: ---");
-    // display.setCursor(0,22);
-    // if (gps.location.isValid()) display.printf("Lon: %.5f", gps.location.lng());
-    // else display.print("Lon: ---");
+    LOG_DEBUG(MESH, "report packed: %u -> %u bytes", (unsigned)len, (unsigned)packed.length());
+    out = packed.c_str();
+    len = packed.length();
   }
-  else
+  if (len > cfg.fragMtu)
   {
-    display.setCursor(0, 12);
-    display.print("Connect to ");
-    display.print(AP_SSID);
+    if (!fragOut.send(masterId, out, len, cfg.fragMtu, sos))
+      LOG_WARN(MESH, "No fragment slot free; report sent whole");
+    else
+    {
+      taskFragSend.enableIfNot();
+      LOG_DEBUG(MESH, "-> master(%u): %u bytes in fragments", masterId, (unsigned)len);
+      return;
+    }
   }
-  // something when eifi is active
-  static unsigned long lastDraw = 0;
-  if (millis() - lastDraw > 200)
+  if (!sos && aggregateReport(out, len))
   {
-    display.display();
-    lastDraw = millis();
+    LOG_DEBUG(MESH, "-> master(%u) in an aggregate: %u bytes", masterId, (unsigned)len);
+    return;
   }
+  meshSendSingle(masterId, out, out == doc_string.c_str() ? MK_DATA : MK_ZIP); // painlessMesh copies into its own String
+  LOG_DEBUG(MESH, "-> master(%u): %s", masterId, doc_string.c_str());
 }
+void askWhoIsMaster()
+{
+  meshSendBroadcast("WHO_IS_MASTER?", MK_WHO);
+  LOG_DEBUG(MESH, "Asked: WHO_IS_MASTER?");
+}
+#endif
 
-// Report event
-void reportEvent(ButtonEvent ev)
+#if RESQME_ROLE_MASTER
+// ======== Latency (master) ========
+// Recorded per report by ingestReport (master_ingest.cpp); hop counts come
+// from the mesh tree, which only the firmware has.
+struct HopEntry
 {
-  switch (ev)
+  uint32_t node;
+  uint8_t hops;
+};
+HopEntry hopTable[HOP_TABLE_SIZE];
+uint8_t hopCount = 0;
+
+void collectHops(const painlessmesh::protocol::NodeTree &t, uint8_t depth)
+{
+  if (depth > 0 && hopCount < HOP_TABLE_SIZE)
   {
-  case BTN_SINGLE: // show status
-    lastEventText = "SOS Help Sent";
-    sendToMaster("SOS Help Needed");
-    beepLED(PIN_LED_RED, 50, 3);
-    break;
-  case BTN_LONG: // start the wifi for connection
-    // Blue beeps until wifi connection is done and then turns off when wifi is off
-    lastEventText = "Wifi Pairing Mode On";
-    currentMode = MODE_AP;
-    stopMesh();
-    vTaskDelay(150 / portTICK_PERIOD_MS);
-    startAP();
-    break;
-  case BTN_TRIPLE:
-    // send SOS signal
-    setBlue(true);
-    vTaskDelay(60);
-    setBlue(false);
-    lastEventText = "ResQMe Node";
-    currentMode = MODE_MESH;
-    beepLED(PIN_LED_BLUE, 50, 3);
-    stopAP();
-    vTaskDelay(150 / portTICK_PERIOD_MS);
-    startMesh();
-    vTaskDelay(300 / portTICK_PERIOD_MS);
-    break;
-  default:
-    return;
+    hopTable[hopCount].node = t.nodeId;
+    hopTable[hopCount].hops = depth;
+    hopCount++;
   }
-  eventTextUntil = millis() + 2000;
+  for (auto &sub : t.subs)
+    collectHops(sub, depth + 1);
+}
+// Rebuilt on topology changes only; copying the tree allocates
+void updateHopTable()
+{
+  hopCount = 0;
+  collectHops(mesh.asNodeTree(), 0);
+}
+uint8_t hopsTo(uint32_t node)
+{
+  for (uint8_t i = 0; i < hopCount; i++)
+    if (hopTable[i].node == node)
+      return hopTable[i].hops;
+  return 0;
 }
 
-ButtonEvent pollButton()
+// One JSON line on the uplink; read_serial.py skips it (no device_id)
+void printLatencyReport()
 {
-  ButtonEvent ret = BTN_NONE;
-  bool level = digitalRead(PIN_BUTTON);
+  static FixedString<LATENCY_JSON_MAX> line;
+  line.clear();
+  latency.appendJson(line);
+  line.append('\n');
+  Serial.write((const uint8_t *)line.c_str(), line.length());
+}
+Task taskLatencyReport(TASK_SECOND * LATENCY_REPORT_S, TASK_FOREVER, []()
+                       { if (latency.samples()) printLatencyReport(); });
 
-  if (level != btn.lastLevel && (millis() - btn.lastChange) > DEBOUNCE_MS)
-  {
-    btn.lastLevel = level;
-    btn.lastChange = millis();
+#endif
 
-    if (level == LOW)
-    {
-      btn.pressStart = millis();
-      btn.longReported = false;
-    }
-    else
+// ======== Direct messages ========
+// The gateway's "TO:<id hex>:<userid>:<text>" goes to that user's node
+// alone as "MSG:<id hex>:<text>", found through the roster's user index.
+// The client answers "MACK:<id hex>"; unanswered messages are resent with
+// backoff. Each ends in one uplink line (read_serial.py skips it):
+//   {"direct":{"id":"<hex>","userid":"..","status":"delivered|timeout|unknown_user|busy|bad_request"}}
+#if RESQME_ROLE_MASTER
+struct DirectPending
+{
+  uint32_t id; // 0: free
+  uint32_t node;
+  uint32_t dueMs;
+  uint8_t tries;
+  char userId[USERID_MAX + 1];
+  FixedString<MESH_MSG_TEXT_MAX + 16> msg;
+};
+DirectPending directPending[DIRECT_PENDING];
+
+void printDirectStatus(uint32_t id, const char *userId, const char *status)
+{
+  FixedString<USERID_MAX + 96> line;
+  line.appendf("{\"direct\":{\"id\":\"%x\",\"userid\":\"%s\",\"status\":\"%s\"}}\n", id, userId, status);
+  Serial.write((const uint8_t *)line.c_str(), line.length());
+}
+
+// Sends (again), looking the user up each time in case they moved node
+bool directTry(DirectPending &p)
+{
+  RosterEntry *node = roster.findByUser(p.userId);
+  if (!node)
+    return false;
+  p.node = node->nodeId;
+  p.tries++;
+  p.dueMs = millis() + (DIRECT_ACK_MS << (p.tries - 1));
+  meshSendSingle(p.node, p.msg.c_str(), MK_DIRECT); // a failed send is retried like a lost one
+  return true;
+}
+
+Task taskDirectRetry(TASK_SECOND, TASK_FOREVER, []()
+                     {
+  bool any = false;
+  for (DirectPending &p : directPending)
+  {
+    if (!p.id)
+      continue;
+    if ((int32_t)(millis() - p.dueMs) >= 0)
     {
-      // release
-      unsigned long pressDur = millis() - btn.pressStart;
-      if (pressDur < LONGPRESS_MS && btn.clickCount < 3)
+      if (p.tries >= DIRECT_TRIES || !directTry(p))
       {
-        btn.clickCount++;
+        printDirectStatus(p.id, p.userId, "timeout");
+        p.id = 0;
+        continue;
       }
     }
+    any = true;
   }
+  if (!any)
+    taskDirectRetry.disable(); });
 
-  // Long press detect
-  if (btn.lastLevel == LOW && !btn.longReported &&
-      (millis() - btn.pressStart) >= LONGPRESS_MS)
+void sendDirect(const char *line)
+{
+  uint32_t id;
+  char userId[USERID_MAX + 1];
+  const char *text;
+  if (!parseDirectRequest(line, id, userId, USERID_MAX, text) || !profileValidUserId(userId, strlen(userId)))
   {
-    btn.longReported = true;
-    btn.clickCount = 0;
-    ret = BTN_LONG;
+    printDirectStatus(id, "", "bad_request");
+    return;
   }
-
-  // Multi-click detect
-  static unsigned long lastReleaseTime = 0;
-  if (btn.lastLevel == HIGH && btn.clickCount > 0)
+  // An id still in flight would take the other message's ACK as its own
+  DirectPending *p = nullptr;
+  bool inFlight = false;
+  for (DirectPending &d : directPending)
   {
-    if (lastReleaseTime == 0)
-      lastReleaseTime = btn.lastChange;
-    if ((millis() - lastReleaseTime) > MULTICLICK_GAP)
-    {
-      if (btn.clickCount >= 3)
-        ret = BTN_TRIPLE;
-      else if (btn.clickCount == 1)
-        ret = BTN_SINGLE;
-      btn.clickCount = 0;
-      lastReleaseTime = 0;
-    }
+    inFlight |= d.id == id;
+    if (!d.id && !p)
+      p = &d;
+  }
+  if (!p || inFlight)
+  {
+    printDirectStatus(id, userId, "busy");
+    return;
   }
-  else if (btn.lastLevel == LOW)
+  strcpy(p->userId, userId);
+  p->msg.clear();
+  p->msg.appendf("MSG:%x:", id);
+  p->msg.append(text);
+  p->tries = 0;
+  if (!directTry(*p))
   {
-    lastReleaseTime = 0;
+    printDirectStatus(id, userId, "unknown_user");
+    return;
   }
-  return ret;
+  p->id = id;
+  taskDirectRetry.enableIfNot();
 }
 
-void pumpGPS()
+void directAcked(uint32_t from, uint32_t id)
 {
-  while (GPS.available())
-    gps.encode(GPS.read());
+  for (DirectPending &p : directPending)
+    if (p.id == id && p.node == from)
+    {
+      printDirectStatus(id, p.userId, "delivered");
+      p.id = 0;
+    }
 }
+#else
+// Client side: ACK every copy (the previous ACK may be what got lost), show once
+void handleDirect(uint32_t from, const String &msg)
+{
+  uint32_t id;
+  const char *body;
+  if (!parseDirect(msg.c_str(), id, body))
+    return;
+  char ack[16];
+  snprintf(ack, sizeof(ack), "MACK:%x", id);
+  meshSendSingle(from, ack, MK_ACK);
+  if (recentDirect.checkAndAdd(id))
+    return;
+  FixedString<MESH_MSG_TEXT_MAX> text;
+  text.append("MSG:");
+  text.append(body);
+  postEvent(EVT_ALERT, from, 1, text.c_str(), text.length());
+}
+#endif
 
-// ================== SETUP/LOOP ==================
-unsigned long lastSend = 0;
-
-void handleNotFound()
+// Clients answer every copy of an alert with "AACK:<id hex>:<state>"
+enum AlertAck : char
+{
+  AACK_ALERTED = 'a',
+  AACK_OUTSIDE = 'o',
+  AACK_EXPIRED = 'x',
+  AACK_CONFIRMED = 'c', // the user double-clicked
+};
+#if !RESQME_ROLE_MASTER
+void sendAlertAck(uint32_t to, uint32_t id, char state)
 {
-  server.sendHeader("Location", String("http://") + apIP.toString(), true);
-  server.send(302, "text/plain", "");
+  char ack[24];
+  snprintf(ack, sizeof(ack), "AACK:%x:%c", id, state);
+  meshSendSingle(to, ack, MK_ACK);
 }
-void handleSubmit()
+
+// Decides on the net core, where the last fix lives, whether this node
+// should alert at all; the app core then shows and buzzes
+void handleAlert(uint32_t from, const String &msg)
 {
-  if (server.hasArg("msg"))
+  Alert alert;
+  if (!alert.parse(msg.c_str(), true))
   {
-    String msg = server.arg("msg");
-    storedValue = server.arg("msg");
-    Serial.print("Received input: ");
-    Serial.println(msg);
-    String response = "<html><body><h2>Message Received:</h2><p>" + msg + "</p><a href='/'>Go Back</a></body></html>";
-    server.send(200, "text/html", response);
-    wantAPShutdown = true;
-    apShutdownAt = millis() + 1500;
+    // legacy line: everyone, full severity, no ACK
+    alertOutcomes[ALERT_RAISED].inc();
+    postEvent(EVT_ALERT, from, alert.severity, msg.c_str(), msg.length());
+    return;
   }
-  else
+  int8_t seen = recentAlerts.find(alert.id);
+  if (seen >= 0)
   {
-    server.send(400, "text/plain", "Missing 'msg' parameter");
+    // a relayed copy or the master's retry: our ACK may have been lost
+    alertOutcomes[ALERT_REPEAT].inc();
+    sendAlertAck(from, alert.id, alertAckState[seen]);
+    return;
   }
+  uint8_t slot = recentAlerts.add(alert.id);
+  AlertOutcome outcome = ALERT_RAISED;
+  bool hasFix = netPosition.latE7 != 0 || netPosition.lonE7 != 0;
+  if (alert.expired(mesh.getNodeTime()))
+    outcome = ALERT_EXPIRED;
+  else if (hasFix && !alert.target.contains(netPosition.latE7, netPosition.lonE7))
+    outcome = ALERT_OUTSIDE; // without a fix we cannot rule the area out
+  alertOutcomes[outcome].inc();
+  alertAckState[slot] = outcome == ALERT_RAISED ? AACK_ALERTED : outcome == ALERT_OUTSIDE ? AACK_OUTSIDE : AACK_EXPIRED;
+  sendAlertAck(from, alert.id, alertAckState[slot]);
+  LOG_DEBUG(MESH, "alert %x sev %u from %u: outcome %u", alert.id, alert.severity, from, outcome);
+  if (outcome != ALERT_RAISED)
+    return;
+  FixedString<MESH_MSG_TEXT_MAX> text;
+  text.append("ALERT:");
+  text.append(alert.text);
+  MeshMsg m;
+  m.init(EVT_ALERT);
+  m.node = from;
+  m.a = alert.severity;
+  m.b = alert.id;
+  m.setText(text.c_str(), text.length());
+  postToApp(m);
 }
 
-void handleUserIdSetup()
+void confirmAlert(uint32_t id)
 {
-  if (server.hasArg("userid"))
-  {
-    String userid = server.arg("userid");
-    Serial.print("UserId: ");
-    Serial.println(userid);
-    USERID = userid;
-    uint8_t mac[6];
-    WiFi.macAddress(mac);
-    char macStr[18];
-    sprintf(macStr, "%02X:%02X:%02X:%02X:%02X:%02X",
-            mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-    String res = "{\"userid\":\"" + userid + "\",\"mac\":\"" + String(macStr) + "\"}";
-    server.send(200, "text/plain", res);
-    // wantAPShutdown = true; // ap shutdown
-    //  apShutdownAt = millis() + 500;
-  }
-  else
-  {
-    server.send(400, "text/plain", "Missing 'userid' parameter");
-  }
+  int8_t slot = recentAlerts.find(id);
+  if (slot >= 0)
+    alertAckState[slot] = AACK_CONFIRMED; // what later retries get back
+  if (masterId)
+    sendAlertAck(masterId, id, AACK_CONFIRMED);
 }
+#endif
 
-void startMesh()
+#if RESQME_ROLE_MASTER
+// ======== Alert delivery (master) ========
+// Each broadcast alert is followed per node in bitmaps over roster slots
+// (a slot reused by another node mid-alert is counted as that node). Nodes
+// that have not ACKed get the same line again by unicast, with backoff.
+// The uplink gets one aggregated line per retry round, then every
+// ALERT_SUMMARY_S while counts change, and a final one at expiry:
+//   {"alert_delivery":{"id":"<hex>","targets":..,"acked":..,"alerted":..,
+//    "outside":..,"confirmed":..,"round":..,"final":true|false}}
+static const uint8_t ROSTER_WORDS = (ROSTER_CAPACITY + 31) / 32;
+struct TrackedAlert
 {
-  if (DEBUG_SERIAL)
-    Serial.println("[MESH] init");
-  mesh.setDebugMsgTypes(ERROR | STARTUP | CONNECTION);
-  mesh.init(MESH_PREFIX, MESH_PASSWORD, &userScheduler, MESH_PORT);
-  mesh.onReceive(&meshReceived);
-  mesh.onNewConnection(&meshNewConnection);
-  mesh.onChangedConnections(&meshChanged);
+  uint32_t id; // 0: free
+  uint32_t issuedMs, ttlMs;
+  uint32_t dueMs;
+  uint8_t round;
+  bool changed; // counts moved since the last line
+  uint32_t targets[ROSTER_WORDS], acked[ROSTER_WORDS], alerted[ROSTER_WORDS], outside[ROSTER_WORDS],
+      confirmed[ROSTER_WORDS];
+  FixedString<SERIAL_LINE_MAX + 16> line; // as broadcast
+};
+TrackedAlert trackedAlerts[ALERT_TRACKED];
 
-  userScheduler.addTask(taskReport);
-  taskReport.enable();
-  userScheduler.addTask(taskAnnounce);
-  if (IS_MASTER)
-    taskAnnounce.enable();
-  userScheduler.addTask(taskQueryMaster);
-  if (!IS_MASTER)
-    taskQueryMaster.enable();
-  userScheduler.addTask(taskSendToMaster);
-  if (!IS_MASTER)
-    taskSendToMaster.enable();
+uint16_t countBits(const uint32_t *words)
+{
+  uint16_t n = 0;
+  for (uint8_t i = 0; i < ROSTER_WORDS; i++)
+    n += __builtin_popcount(words[i]);
+  return n;
+}
 
-  if (IS_MASTER)
-    announceMaster();
+void printAlertDelivery(TrackedAlert &t, bool final)
+{
+  FixedString<256> out;
+  out.appendf("{\"alert_delivery\":{\"id\":\"%x\",\"targets\":%u,\"acked\":%u,\"alerted\":%u,\"outside\":%u,"
+              "\"confirmed\":%u,\"round\":%u,\"final\":%s}}\n",
+              t.id, countBits(t.targets), countBits(t.acked), countBits(t.alerted), countBits(t.outside),
+              countBits(t.confirmed), t.round, final ? "true" : "false");
+  Serial.write((const uint8_t *)out.c_str(), out.length());
+  t.changed = false;
+}
+
+Task taskAlertDelivery(TASK_SECOND, TASK_FOREVER, []()
+                       {
+  bool any = false;
+  uint32_t now = millis();
+  for (TrackedAlert &t : trackedAlerts)
+  {
+    if (!t.id)
+      continue;
+    if (now - t.issuedMs >= t.ttlMs)
+    {
+      printAlertDelivery(t, true);
+      t.id = 0;
+      continue;
+    }
+    any = true;
+    if ((int32_t)(now - t.dueMs) < 0)
+      continue;
+    uint16_t sent = 0;
+    if (t.round < ALERT_RETRIES)
+    {
+      for (uint16_t i = 0; i < ROSTER_CAPACITY; i++)
+      {
+        uint32_t bit = 1UL << (i & 31);
+        uint32_t node = roster.atSlot(i).nodeId;
+        if ((t.targets[i / 32] & bit) && !(t.acked[i / 32] & bit) && node)
+        {
+          meshSendSingle(node, t.line.c_str(), MK_ALERT);
+          sent++;
+        }
+      }
+    }
+    if (sent)
+    {
+      t.round++;
+      t.changed = true;
+      t.dueMs = now + (ALERT_RETRY_MS << t.round);
+    }
+    else
+      t.dueMs = now + ALERT_SUMMARY_S * 1000UL;
+    if (t.changed)
+      printAlertDelivery(t, false);
+  }
+  if (!any)
+    taskAlertDelivery.disable(); });
+
+// Starts following an alert the master just broadcast
+void trackAlert(const Alert &alert, const char *line)
+{
+  TrackedAlert *t = &trackedAlerts[0];
+  for (TrackedAlert &c : trackedAlerts)
+  {
+    if (!c.id)
+    {
+      t = &c;
+      break;
+    }
+    if (millis() - c.issuedMs > millis() - t->issuedMs)
+      t = &c;
+  }
+  if (t->id)
+    printAlertDelivery(*t, true);
+  memset(t->targets, 0, sizeof(t->targets));
+  memset(t->acked, 0, sizeof(t->acked));
+  memset(t->alerted, 0, sizeof(t->alerted));
+  memset(t->outside, 0, sizeof(t->outside));
+  memset(t->confirmed, 0, sizeof(t->confirmed));
+  roster.forEach([t](const RosterEntry &e)
+                 { uint16_t i = roster.slotOf(e); t->targets[i / 32] |= 1UL << (i & 31); });
+  t->id = alert.id;
+  t->issuedMs = millis();
+  t->ttlMs = alert.ttlS * 1000UL;
+  t->dueMs = t->issuedMs + ALERT_RETRY_MS;
+  t->round = 0;
+  t->changed = false;
+  t->line = line;
+  taskAlertDelivery.enableIfNot();
+}
+
+void alertAcked(uint32_t from, const char *ack)
+{
+  uint32_t id;
+  char state;
+  RosterEntry *node = roster.find(from);
+  if (!parseAlertAck(ack, id, state) || !node)
+    return;
+  uint16_t i = roster.slotOf(*node);
+  uint32_t bit = 1UL << (i & 31);
+  for (TrackedAlert &t : trackedAlerts)
+  {
+    if (t.id != id || !t.id)
+      continue;
+    t.targets[i / 32] |= bit; // also counts nodes that joined after the broadcast
+    t.acked[i / 32] |= bit;
+    if (state == AACK_ALERTED || state == AACK_CONFIRMED)
+      t.alerted[i / 32] |= bit;
+    if (state == AACK_OUTSIDE)
+      t.outside[i / 32] |= bit;
+    if (state == AACK_CONFIRMED)
+      t.confirmed[i / 32] |= bit;
+    t.changed = true;
+  }
+}
+
+// ======== Reports (master) ========
+// A client report, sent whole or reassembled. Copies never reach the
+// uplink, where each line becomes a database row.
+void reportReceived(RosterEntry &node, uint32_t from, const char *msg, size_t len, uint32_t arrival)
+{
+  msg = ingestUnpack(msg, len);
+  if (!msg)
+  {
+    LOG_WARN(MESH, "Packed report from %u does not unpack", from);
+    return;
+  }
+  if (!ingestReport(node, msg, len, arrival))
+    return;
+  // Gateway uplink, parsed by serial_python/read_serial.py: stays text.
+  // One write per line so log frames cannot land in the middle of it.
+  static FixedString<UPLINK_LINE_MAX> line; // netTask only
+  formatUplink(line, from, msg, len);
+  Serial.write((const uint8_t *)line.c_str(), line.length());
+}
+
+// A report sent whole, alone or in an aggregate, echoed back as its ACK.
+// Copies are still ACKed: the sender may be retrying a lost ACK.
+void reportAndAck(RosterEntry &node, uint32_t from, const char *msg, size_t len, uint32_t arrival)
+{
+  reportReceived(node, from, msg, len, arrival);
+  String ack; // one exact-size allocation instead of concatenation
+  ack.reserve(4 + len);
+  ack += "ACK:";
+  ack.concat(msg, len);
+  meshSendSingle(from, ack, MK_ACK);
+}
+
+// "ZCAP?": this master unpacks Z: reports, with this dictionary
+void packingAsked(uint32_t from)
+{
+  char line[16];
+  snprintf(line, sizeof(line), "ZCAP:%x", ZDICT_REPORTS.id);
+  meshSendSingle(from, line, MK_ZIP);
+}
+
+// Long reports arrive as fragments (include/fragment.h). A complete one is
+// taken in like a report sent whole, and FACKed instead of echoed.
+typedef FragReassembler<FRAG_RX_SLOTS, MESH_JSON_MAX> Reassembler;
+Reassembler fragIn;
+
+// FNAKs for transfers that stalled with gaps; runs while any is open
+Task taskFragExpire(TASK_MILLISECOND * FRAG_GAP_MS / 4, TASK_FOREVER, []()
+                    {
+  FixedString<32> line;
+  if (fragIn.poll(millis()))
+  {
+    uint32_t to = fragIn.nak(line);
+    meshSendSingle(to, line.c_str(), MK_FRAG);
+  }
+  else if (fragIn.idle())
+    taskFragExpire.disable(); });
+
+void fragmentReceived(RosterEntry &node, uint32_t from, const String &msg, uint32_t arrival)
+{
+  FixedString<32> line;
+  Reassembler::Result r = fragIn.push(from, msg.c_str() + 4, msg.length() - 4, millis());
+  if (r == Reassembler::FRAG_COMPLETE || r == Reassembler::FRAG_DUPLICATE)
+  {
+    fragIn.ack(line);
+    meshSendSingle(from, line.c_str(), MK_FRAG);
+    if (r == Reassembler::FRAG_COMPLETE)
+      reportReceived(node, from, fragIn.payload(), fragIn.payloadLength(), arrival);
+  }
+  else if (r == Reassembler::FRAG_NAK)
+  {
+    uint32_t to = fragIn.nak(line);
+    meshSendSingle(to, line.c_str(), MK_FRAG);
+  }
+  else if (r == Reassembler::FRAG_BAD)
+    LOG_WARN(MESH, "Bad fragment from %u", from);
+  if (!fragIn.idle())
+    taskFragExpire.enableIfNot();
+}
+#endif
+
+// ======== Runtime config ========
+// `cfg` is what is running; storedCfg is what NVS holds, i.e. cfg plus
+// changes that wait for a reboot. Only the net core changes either. Live
+// fields are copied into cfg one aligned store at a time, so the app core
+// sees the old or the new value, never a mix.
+RuntimeConfig storedCfg;
+ConfigSetResult setConfig(const char *key, const char *value, bool liveOnly)
+{
+  const ConfigField *f = configFind(key);
+  if (!f || (liveOnly && (f->flags & CFG_REBOOT)))
+    return CFG_SET_UNKNOWN_KEY;
+  RuntimeConfig next = storedCfg;
+  if (!configParse(next, *f, value))
+    return CFG_SET_BAD_VALUE;
+  if (!configSave(next))
+    return CFG_SET_NOT_SAVED;
+  storedCfg = next;
+  if (f->flags & CFG_REBOOT)
+    return CFG_SET_STORED;
+  configCopyField(cfg, storedCfg, *f);
+  postEvent(EVT_CONFIG, 0, 0, "", 0); // app core re-arms timers
+  return CFG_SET_LIVE;
+}
+// "key=value" from the portal or the mesh
+ConfigSetResult setConfigLine(const char *line, bool liveOnly)
+{
+  char key[24];
+  const char *value = splitKeyValue(line, '=', key, sizeof(key));
+  return value ? setConfig(key, value, liveOnly) : CFG_SET_UNKNOWN_KEY;
+}
+void printConfigResult(const char *key, ConfigSetResult r)
+{
+  FixedString<96> line;
+  line.appendf("{\"config_set\":{\"key\":\"%.24s\",\"result\":\"%s\"}}\n", key, configResultName(r));
+  Serial.write((const uint8_t *)line.c_str(), line.length());
+}
+// !cfg                      {"config":{...},"stored":{...}} on one line
+// !cfg set <key> <value>    this node
+// !cfg mesh <key> <value>   master: this node and every node in the mesh
+//                           (live fields only; credentials and pins stay local)
+void handleConfigCommand(const char *args)
+{
+  while (*args == ' ')
+    args++;
+  if (!*args)
+  {
+    static char line[2 * CONFIG_JSON_MAX + 32]; // net core only
+    size_t n = snprintf(line, sizeof(line), "{\"config\":");
+    size_t w = configWriteJson(cfg, line + n, sizeof(line) - n);
+    n += w;
+    n += snprintf(line + n, sizeof(line) - n, ",\"stored\":");
+    w = w ? configWriteJson(storedCfg, line + n, sizeof(line) - n) : 0;
+    if (w && n + w + 3 <= sizeof(line))
+    {
+      n += w;
+      memcpy(line + n, "}\n", 3);
+      Serial.write((const uint8_t *)line, n + 2);
+    }
+    return;
+  }
+  bool mesh = !strncmp(args, "mesh ", 5);
+  if (!mesh && strncmp(args, "set ", 4))
+    return;
+  args += mesh ? 5 : 4;
+  char key[24];
+  const char *value = splitKeyValue(args, ' ', key, sizeof(key));
+  if (!value)
+    return;
+  ConfigSetResult r = setConfig(key, value, mesh);
+  printConfigResult(key, r);
+  if (mesh && IS_MASTER && r == CFG_SET_LIVE)
+  {
+    FixedString<MESH_MSG_TEXT_MAX> out;
+    out.appendf("CFG:%s=%s", key, value);
+    meshSendBroadcast(out.c_str(), MK_DATA);
+  }
+}
+
+void meshReceived(uint32_t from, String &msg)
+{
+  uint32_t arrival = mesh.getNodeTime();
+  TRACE_SCOPE(TP_MESH_RECEIVED);
+  meshRx[classifyMsg(msg.c_str())].inc();
+  RosterEntry *node = nullptr;
+  if constexpr (IS_MASTER)
+    node = &ingestTouch(from, millis(), msg.length(), hopsTo(from)); // the roster: "!roster" dumps it
+  if (msg == "WHO_IS_MASTER?")
+  {
+    if constexpr (IS_MASTER)
+      announceMaster();
+    return;
+  }
+  if (msg.startsWith("MASTER:"))
+  {
+    uint32_t id;
+    if (!parseMasterAnnounce(msg.c_str(), from, id))
+    {
+      LOG_WARN(MESH, "Bad master announce from %u", from);
+      return;
+    }
+    masterId = id;
+    if constexpr (!IS_MASTER)
+      updateUplink();
+    postEvent(EVT_MASTER, masterId, 0, "", 0);
+    LOG_INFO(MESH, "Learned masterId=%u from %u", masterId, from);
+    // lastEventText=msg;
+    return;
+  }
+
+  if (msg.startsWith("ALERT:"))
+  {
+    if constexpr (!IS_MASTER)
+      handleAlert(from, msg);
+    return;
+  }
+  if (msg.startsWith("MSG:"))
+  {
+    if constexpr (!IS_MASTER)
+      handleDirect(from, msg);
+    return;
+  }
+  if (msg.startsWith("AACK:"))
+  {
+    if constexpr (IS_MASTER)
+      alertAcked(from, msg.c_str() + 5);
+    return;
+  }
+  if (msg.startsWith("CFG:"))
+  {
+    if (!IS_MASTER && from == masterId)
+    {
+      ConfigSetResult r = setConfigLine(msg.c_str() + 4, true);
+      LOG_INFO(SYS, "config %s: %s", msg.c_str() + 4, configResultName(r));
+    }
+    return;
+  }
+  if (msg.startsWith("MACK:"))
+  {
+    if constexpr (IS_MASTER)
+    {
+      uint32_t id;
+      if (parseDirectAck(msg.c_str() + 5, id))
+        directAcked(from, id);
+    }
+    return;
+  }
+  if (msg.startsWith("FRG:"))
+  {
+    if constexpr (IS_MASTER)
+      fragmentReceived(*node, from, msg, arrival);
+    return;
+  }
+  if (msg.startsWith("FACK:") || msg.startsWith("FNAK:"))
+  {
+    if constexpr (!IS_MASTER)
+      fragmentAnswered(from, msg);
+    return;
+  }
+  if (msg.startsWith("ZCAP"))
+  {
+    if constexpr (IS_MASTER)
+    {
+      if (msg == "ZCAP?")
+        packingAsked(from);
+    }
+    else if (msg.startsWith("ZCAP:"))
+      packingAnswered(from, msg);
+    return;
+  }
+  if (msg == "AGG?")
+  {
+    if constexpr (IS_MASTER)
+      meshSendSingle(from, "AGG!", MK_AGG);
+    else if (relayAccepts())
+      meshSendSingle(from, "AGG!", MK_AGG);
+    return;
+  }
+  if (msg == "AGG!")
+  {
+    if constexpr (!IS_MASTER)
+      aggregationAnswered(from);
+    return;
+  }
+  if (msg.startsWith("AGG:"))
+  {
+    if constexpr (IS_MASTER)
+    {
+      // Reports merged by relays: each taken in as if it had come alone.
+      // Entries are reports only (aggValid), never control lines.
+      AggReader r;
+      AggEntry e;
+      uint16_t budgetMs;
+      if (!aggValid(msg.c_str() + 4, msg.length() - 4))
+      {
+        aggRefused.inc();
+        LOG_WARN(MESH, "Bad aggregate from %u", from);
+        return;
+      }
+      r.begin(msg.c_str() + 4, msg.length() - 4, budgetMs);
+      while (r.next(e))
+        reportAndAck(ingestTouch(e.from, millis(), e.len, hopsTo(e.from)), e.from, e.data, e.len, arrival);
+    }
+    else
+      aggregateRelayed(from, msg);
+    return;
+  }
+
+  if constexpr (IS_MASTER)
+  {
+    reportAndAck(*node, from, msg.c_str(), msg.length(), arrival);
+    return;
+  }
+  else
+  {
+    if (msg.startsWith("ACK:"))
+    {
+      LOG_DEBUG(MESH, "%s", msg.c_str());
+      return;
+    }
+  }
+  LOG_DEBUG(MESH, "RX from %u: %s", from, msg.c_str());
+}
+void buzz(uint16_t ms, uint32_t freq)
+{
+  ledcWriteTone(BUZZER_CHANNEL, freq); // start tone
+  vTaskDelay(ms / portTICK_PERIOD_MS);
+  ledcWriteTone(BUZZER_CHANNEL, 0); // stop tone
+}
+// tasks
+#if RESQME_ROLE_MASTER
+Task taskAnnounce(TASK_SECOND * 5, TASK_FOREVER, []()
+                  { announceMaster(); });
+#else
+Task taskQueryMaster(TASK_SECOND * 3, TASK_FOREVER, []()
+                     { if (masterId == 0) askWhoIsMaster(); });
+#endif
+Task taskReport(TASK_SECOND * 5, TASK_FOREVER, []()
+                {
+  auto nodes = mesh.getNodeList();
+  postEvent(EVT_NODES, 0, nodes.size(), "", 0);
+  if constexpr (IS_MASTER)
+    rosterNodes.set(roster.size());
+  LOG_DEBUG(MESH, "[Node %u] neighbors (%u)", mesh.getNodeId(), (unsigned)nodes.size());
+  uint64_t total = netIdle.idleUs + netIdle.busyUs;
+  if (total)
+    LOG_DEBUG(SYS, "[NET] %.1f%% idle, %u wakeups, ring drops %u/%u", 100.0 * netIdle.idleUs / total,
+              netIdle.wakeups, toNet.dropped(), toApp.dropped()); });
+
+void meshNewConnection(uint32_t nodeId)
+{
+  LOG_INFO(MESH, "New connection: %u", nodeId);
+  if constexpr (IS_MASTER)
+  {
+    updateHopTable();
+    announceMaster();
+  }
+  else
+  {
+    updateUplink();
+    if (masterId == 0)
+      askWhoIsMaster();
+  }
+}
+
+void meshChanged()
+{
+  LOG_DEBUG(MESH, "Topology changed");
+  postEvent(EVT_NODES, 0, mesh.getNodeList().size(), "", 0);
+  if constexpr (IS_MASTER)
+  {
+    updateHopTable();
+    announceMaster();
+  }
+  else if (masterId != 0)
+  {
+    bool stillThere = false;
+    for (auto &n : mesh.getNodeList())
+      if (n == masterId)
+      {
+        stillThere = true;
+        break;
+      }
+    if (!stillThere)
+    {
+      LOG_WARN(MESH, "Master lost; rediscovering");
+      masterId = 0;
+      postEvent(EVT_MASTER, 0, 0, "", 0);
+      askWhoIsMaster();
+    }
+  }
+  if constexpr (!IS_MASTER)
+    updateUplink();
+}
+
+// LEDs + buzzer helpers
+void setBlue(bool on) { digitalWrite(cfg.pinLedBlue, on); }
+void setRed(bool on) { digitalWrite(cfg.pinLedRed, on); }
+
+// Draw UI
+void drawScreen()
+{
+  TRACE_SCOPE(TP_DRAW);
+  display.clearDisplay();
+  display.setTextColor(SSD1306_WHITE);
+  display.setTextSize(1);
+  display.setCursor(0, 0);
+  if (eventTextActive && lastEventText.length())
+  {
+    display.print(lastEventText.c_str());
+  }
+  else
+  {
+    display.print(modeText.c_str());
+  }
+  if (currentMode == MODE_MESH)
+  {
+    display.setCursor(0, 12);
+    display.printf("Connected to %u node", meshNodeCount);
+    // if (gps.location.isValid()) display.printf("Lat: %.5f", gps.location.lat());
+    // else display.print("Lat: ---");
+    // display.setCursor(0,22);
+    // if (gps.location.isValid()) display.printf("Lon: %.5f", gps.location.lng());
+    // else display.print("Lon: ---");
+  }
+  else
+  {
+    display.setCursor(0, 12);
+    display.print("Connect to ");
+    display.print(cfg.apSsid);
+  }
+  // something when eifi is active
+  display.display();
+}
+
+// Mode changes: the app core switches its UI/LEDs, the net core the radio
+void enterAPMode()
+{
+  currentMode = MODE_AP;
+  apHasClient = false;
+  ledState = false;
+  timers.start(blinkTimer, 1, BLINK_PERIOD_MS); // start blink immediately
+  postCommand(CMD_ENTER_AP);
+}
+void enterMeshMode()
+{
+  currentMode = MODE_MESH;
+  // stop blinking and turn LED off
+  timers.stop(blinkTimer);
+  timers.stop(apShutdownTimer);
+  setBlue(false);
+  postCommand(CMD_ENTER_MESH);
+}
+
+// Report event
+void reportEvent(ButtonEvent ev)
+{
+  switch (ev)
+  {
+  case BTN_SINGLE: // show status
+    lastEventText = "SOS Help Sent";
+    {
+      MeshMsg m;
+      m.init(CMD_SEND);
+      m.flags = MSG_FLAG_SOS;
+      m.a = btn.pressedUs; // latency counts from the press, multi-click wait included
+      m.b = micros();
+      m.setText("SOS Help Needed", 15);
+      postToNet(m);
+    }
+    beepLED(cfg.pinLedRed, 50, 3);
+    break;
+  case BTN_LONG: // start the wifi for connection
+    // Blue beeps until wifi connection is done and then turns off when wifi is off
+    lastEventText = "Wifi Pairing Mode On";
+    enterAPMode();
+    break;
+  case BTN_DOUBLE: // confirm the alert on screen to the master
+    if (!alertToConfirm)
+      return;
+    {
+      MeshMsg m;
+      m.init(CMD_ALERT_CONFIRM);
+      m.a = alertToConfirm;
+      postToNet(m);
+    }
+    alertToConfirm = 0;
+    timers.stop(buzzTimer);
+    ledcWriteTone(BUZZER_CHANNEL, 0);
+    lastEventText = "Alert confirmed";
+    break;
+  case BTN_TRIPLE:
+    // send SOS signal
+    setBlue(true);
+    vTaskDelay(60);
+    setBlue(false);
+    lastEventText = "ResQMe Node";
+    beepLED(cfg.pinLedBlue, 50, 3);
+    enterMeshMode();
+    break;
+  default:
+    return;
+  }
+  showEventText(2000);
+}
+
+ButtonEvent pollButton()
+{
+  TRACE_SCOPE(TP_BUTTON);
+  ButtonEvent ret = BTN_NONE;
+  bool level = digitalRead(cfg.pinButton);
+
+  if (level != btn.lastLevel && (millis() - btn.lastChange) > cfg.debounceMs)
+  {
+    btn.lastLevel = level;
+    btn.lastChange = millis();
+
+    if (level == LOW)
+    {
+      btn.pressedUs = micros();
+      btn.longReported = false;
+      timers.stop(btnGapTimer);
+      timers.start(btnLongTimer, cfg.longpressMs);
+    }
+    else
+    {
+      // release
+      timers.stop(btnLongTimer);
+      if (!btn.longReported && btn.clickCount < 3)
+      {
+        btn.clickCount++;
+      }
+      if (btn.clickCount > 0)
+        timers.start(btnGapTimer, cfg.multiclickGapMs);
+    }
+  }
+
+  if (btn.pending != BTN_NONE)
+  {
+    ret = btn.pending;
+    btn.pending = BTN_NONE;
+  }
+  return ret;
+}
+
+// Long press detect
+void onButtonLong(void *)
+{
+  btn.longReported = true;
+  btn.clickCount = 0;
+  btn.pending = BTN_LONG;
+}
+
+// Multi-click detect: no new press within the multi-click gap of the last release
+void onButtonGap(void *)
+{
+  if (btn.clickCount >= 3)
+    btn.pending = BTN_TRIPLE;
+  else if (btn.clickCount == 2)
+    btn.pending = BTN_DOUBLE;
+  else if (btn.clickCount == 1)
+    btn.pending = BTN_SINGLE;
+  btn.clickCount = 0;
+}
+
+void pumpGPS()
+{
+  TRACE_SCOPE(TP_GPS);
+  while (GPS.available())
+  {
+    gps.encode(GPS.read());
+    gpsBytes++;
+  }
+  int32_t latE7, lonE7;
+  if (gps.location.isUpdated() && fixToE7(gps.location.lat(), gps.location.lng(), latE7, lonE7))
+  {
+    MeshMsg m;
+    m.init(CMD_POSITION);
+    m.a = latE7;
+    m.b = lonE7;
+    postToNet(m);
+  }
+  gpsMaybeSaveHint(gps);
+}
+
+// ================== SETUP/LOOP ==================
+
+// ======== Portal ========
+// Handlers run on the AsyncTCP task. They never touch net-core state
+// directly: anything that has to happen there goes through fromWeb.
+// Static pages are gzipped at build time (scripts/embed_web.py) and served
+// straight from flash; a browser revalidating with a matching ETag gets 304.
+void sendAsset(AsyncWebServerRequest *request, const WebAsset &asset)
+{
+  TRACE_SCOPE(TP_HTTP_ROOT);
+  AsyncWebHeader *match = request->getHeader("If-None-Match");
+  AsyncWebServerResponse *res;
+  if (match && match->value() == asset.etag)
+    res = request->beginResponse(304);
+  else
+  {
+    res = request->beginResponse_P(200, asset.type, asset.gz, asset.len);
+    res->addHeader("Content-Encoding", "gzip");
+  }
+  res->addHeader("ETag", asset.etag);
+  res->addHeader("Cache-Control", "no-cache"); // revalidate, but reuse the cached body
+  request->send(res);
+  uint32_t joined = staJoinedMs.exchange(0, std::memory_order_relaxed);
+  if (joined)
+    portalFirstPageMs.observe(millis() - joined);
+}
+
+// Every unknown URL, and the OSes' connectivity checks, redirect to the
+// portal. A check that gets anything but its expected answer makes the
+// phone open its captive-portal sheet on the page we redirect to.
+static char portalUrl[24]; // "http://<apIP>/", set by startAP
+static const char *const CONNECTIVITY_CHECKS[] = {
+    "/generate_204", "/gen_204",                        // Android, ChromeOS
+    "/hotspot-detect.html", "/library/test/success.html", // iOS, macOS
+    "/connecttest.txt", "/ncsi.txt", "/redirect",         // Windows
+    "/canonical.html", "/success.txt",                    // Firefox
+};
+void handleConnectivityCheck(AsyncWebServerRequest *request)
+{
+  portalProbes.inc();
+  AsyncWebServerResponse *res = request->beginResponse(302);
+  res->addHeader("Location", portalUrl);
+  res->addHeader("Cache-Control", "no-store"); // re-probe after the phone leaves the AP
+  request->send(res);
+}
+void handleNotFound(AsyncWebServerRequest *request)
+{
+  TRACE_SCOPE(TP_HTTP_NOT_FOUND);
+  request->redirect(portalUrl);
+}
+
+void startCaptiveDns()
+{
+  if (!dnsUdp.listen(CAPTIVE_DNS_PORT))
+  {
+    LOG_ERROR(PORTAL, "DNS listen FAILED");
+    return;
+  }
+  dnsUdp.onPacket([](AsyncUDPPacket &packet)
+                  {
+                    static uint8_t reply[512]; // only the async_udp task gets here
+                    const uint8_t ip[4] = {apIP[0], apIP[1], apIP[2], apIP[3]};
+                    size_t n = captiveDnsReply(packet.data(), packet.length(), ip, reply, sizeof(reply));
+                    if (n)
+                    {
+                      dnsQueries.inc();
+                      packet.write(reply, n);
+                    } });
+}
+void handleSubmit(AsyncWebServerRequest *request)
+{
+  TRACE_SCOPE(TP_HTTP_SUBMIT);
+  if (!request->hasParam("msg"))
+  {
+    request->send(400, "text/plain", "Missing 'msg' parameter");
+    return;
+  }
+  const String &msg = request->getParam("msg")->value();
+  if (!portalMessageValid(msg.c_str(), msg.length(), USER_MSG_MAX))
+  {
+    request->send(400, "text/plain", "bad 'msg'");
+    return;
+  }
+  MeshMsg m;
+  m.init(EVT_PORTAL_MSG); // forwarded to the app core: outbox + AP shutdown
+  m.a = micros();
+  if (!m.setLongText(msg.c_str(), msg.length()) || !postFromWeb(m))
+  {
+    request->send(503, "text/plain", "busy, try again");
+    return;
+  }
+  LOG_INFO(PORTAL, "Received input: %s", msg.c_str());
+  static FixedString<6 * USER_MSG_MAX + 96> page; // AsyncTCP task only
+  page = "<html><body><h2>Message Received:</h2><p>";
+  appendHtml(page, msg.c_str(), msg.length()); // the text is echoed back: keep it text
+  page.append("</p><a href='/'>Go Back</a></body></html>");
+  request->send(200, "text/html", page.c_str());
+}
+
+// The stored profile as the portal last committed it. Loaded in setup();
+// after that only the portal handlers touch it.
+Profile portalProfile;
+
+// Commits `p` to NVS, then hands the user id to the net core (which owns
+// USERID). Replies with the error and returns false if either step fails.
+bool commitProfile(AsyncWebServerRequest *request, const Profile &p)
+{
+  if (!profileSave(p))
+  {
+    request->send(500, "text/plain", "NVS write failed");
+    return false;
+  }
+  portalProfile = p;
+  MeshMsg m;
+  m.init(CMD_SET_USERID);
+  if (!m.setText(p.userId, strlen(p.userId)) || !postFromWeb(m))
+  {
+    request->send(503, "text/plain", "busy"); // stored; applied at the next boot
+    return false;
+  }
+  return true;
+}
+
+void handleUserIdSetup(AsyncWebServerRequest *request)
+{
+  TRACE_SCOPE(TP_HTTP_USERID);
+  if (!request->hasParam("userid"))
+  {
+    request->send(400, "text/plain", "Missing 'userid' parameter");
+    return;
+  }
+  const String &userid = request->getParam("userid")->value();
+  if (!profileValidUserId(userid.c_str(), userid.length()))
+  {
+    request->send(400, "text/plain", "bad 'userid'");
+    return;
+  }
+  LOG_INFO(PORTAL, "UserId: %s", userid.c_str());
+  Profile p = portalProfile;
+  strlcpy(p.userId, userid.c_str(), sizeof(p.userId));
+  if (!commitProfile(request, p))
+    return;
+  FixedString<USERID_MAX + 40> res;
+  res.appendf("{\"userid\":\"%s\",\"mac\":\"%s\"}", p.userId, macStr);
+  request->send(200, "text/plain", res.c_str());
+}
+
+// GET /config: the running config, secrets as "***"
+void handleConfig(AsyncWebServerRequest *request)
+{
+  TRACE_SCOPE(TP_HTTP_CONFIG);
+  if (request->hasParam("key"))
+  {
+    request->send(405, "text/plain", "POST key and value");
+    return;
+  }
+  static char json[CONFIG_JSON_MAX]; // AsyncTCP task only
+  if (configWriteJson(cfg, json, sizeof(json)))
+    request->send(200, "application/json", json);
   else
-    askWhoIsMaster();
-  if (DEBUG_SERIAL)
-    Serial.printf("[MESH] nodeId=%u role=%s\n", mesh.getNodeId(), IS_MASTER ? "MASTER" : "CHILD");
+    request->send(500, "text/plain", "config too large");
+}
+
+// POST /config with key=..&value=.. in a form body: one live field,
+// checked here and applied (and saved) by the net core. Credentials and
+// pins are not live, so they stay serial-only (!cfg set).
+void handleConfigSet(AsyncWebServerRequest *request)
+{
+  TRACE_SCOPE(TP_HTTP_CONFIG_SET);
+  if (!request->hasParam("key", true) || !request->hasParam("value", true))
+  {
+    request->send(400, "text/plain", "Missing 'key' or 'value'");
+    return;
+  }
+  const ConfigField *f = configFind(request->getParam("key", true)->value().c_str());
+  if (f && (f->flags & CFG_REBOOT))
+    f = nullptr; // as setConfig(.., liveOnly) sees it
+  RuntimeConfig scratch;
+  const char *value = request->getParam("value", true)->value().c_str();
+  ConfigSetResult r = !f ? CFG_SET_UNKNOWN_KEY : configParse(scratch, *f, value) ? CFG_SET_LIVE : CFG_SET_BAD_VALUE;
+  if (r == CFG_SET_LIVE)
+  {
+    FixedString<MESH_MSG_TEXT_MAX> line;
+    line.appendf("%s=%s", f->key, value);
+    MeshMsg m;
+    m.init(CMD_SET_CONFIG);
+    if (!m.setText(line.c_str(), line.length()) || !postFromWeb(m))
+    {
+      request->send(503, "text/plain", "busy");
+      return;
+    }
+  }
+  FixedString<96> res;
+  res.appendf("{\"key\":\"%.24s\",\"result\":\"%s\"}", f ? f->key : "", configResultName(r));
+  request->send(r == CFG_SET_LIVE ? 200 : 400, "application/json", res.c_str());
+}
+
+// POST /provision: the whole profile plus queued messages in one request,
+// JSON or (Content-Type application/octet-stream) TLV; see profile.h.
+// Nothing is applied unless the entire body validates and the NVS commit
+// succeeds. The body arrives in chunks before the request handler runs.
+static char provisionBody[PROVISION_BODY_MAX + 1];
+static AsyncWebServerRequest *provisionOwner; // whose body is in the buffer
+static size_t provisionLen;
+void onProvisionBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+{
+  if (index == 0)
+  {
+    provisionOwner = total <= PROVISION_BODY_MAX ? request : nullptr; // a newer body replaces an abandoned one
+    provisionLen = 0;
+  }
+  if (provisionOwner != request || index != provisionLen)
+    return;
+  memcpy(provisionBody + index, data, len);
+  provisionLen += len;
+}
+void handleProvision(AsyncWebServerRequest *request)
+{
+  TRACE_SCOPE(TP_HTTP_PROVISION);
+  if (provisionOwner != request || provisionLen != request->contentLength())
+  {
+    request->send(request->contentLength() > PROVISION_BODY_MAX ? 413 : 400, "text/plain", "bad body");
+    return;
+  }
+  provisionOwner = nullptr;
+  provisionBody[provisionLen] = 0;
+  static ProvisionRequest req; // AsyncTCP task only
+  const char *err;
+  bool binary = request->contentType() == "application/octet-stream";
+  if (!parseProvision(provisionBody, provisionLen, binary, portalProfile, req, err))
+  {
+    request->send(400, "text/plain", err);
+    return;
+  }
+  if (!commitProfile(request, req.profile))
+    return;
+  uint8_t queued = 0;
+  for (uint8_t i = 0; i < req.messages; i++)
+  {
+    MeshMsg m;
+    m.init(EVT_PORTAL_MSG);
+    m.a = micros();
+    if (m.setText(req.msg[i], req.msgLen[i]) && postFromWeb(m))
+      queued++;
+  }
+  MeshMsg done;
+  done.init(EVT_PORTAL_DONE);
+  postFromWeb(done);
+  LOG_INFO(PORTAL, "Provisioned %s, %u/%u messages queued", req.profile.userId, queued, req.messages);
+  FixedString<USERID_MAX + 64> res;
+  res.appendf("{\"userid\":\"%s\",\"mac\":\"%s\",\"queued\":%u}", req.profile.userId, macStr, queued);
+  request->send(200, "application/json", res.c_str());
+}
+
+void setupMetrics()
+{
+  // A full registry would leave a metric silently missing from /metrics
+  auto add = [](const char *name, const auto &metric) {
+    if (!metrics.add(name, metric))
+      LOG_ERROR(SYS, "metrics full: %s not registered (raise METRICS_CAPACITY)", name);
+  };
+  static const char *const kindNames[MK_COUNT] = {"who", "master", "alert", "ack", "data", "direct", "frag", "zip", "agg"};
+  static char names[2 * MK_COUNT][48];
+  for (int k = 0; k < MK_COUNT; k++)
+  {
+    snprintf(names[k], sizeof(names[k]), "resqme_mesh_rx_total{type=\"%s\"}", kindNames[k]);
+    snprintf(names[MK_COUNT + k], sizeof(names[0]), "resqme_mesh_tx_total{type=\"%s\"}", kindNames[k]);
+    add(names[k], meshRx[k]);
+    add(names[MK_COUNT + k], meshTx[k]);
+  }
+  add("resqme_mesh_send_failures_total", meshSendFailures);
+  add("resqme_dedupe_dropped_total", dedupeDropped);
+  add("resqme_packing_saved_bytes_total", zSavedBytes);
+  add("resqme_packing_refused_total", zRefused);
+  add("resqme_agg_held_total", aggHeld);
+  add("resqme_agg_refused_total", aggRefused);
+  add("resqme_alerts_total{outcome=\"raised\"}", alertOutcomes[ALERT_RAISED]);
+  add("resqme_alerts_total{outcome=\"outside\"}", alertOutcomes[ALERT_OUTSIDE]);
+  add("resqme_alerts_total{outcome=\"repeat\"}", alertOutcomes[ALERT_REPEAT]);
+  add("resqme_alerts_total{outcome=\"expired\"}", alertOutcomes[ALERT_EXPIRED]);
+  add("resqme_dns_queries_total", dnsQueries);
+  add("resqme_portal_probes_total", portalProbes);
+  add("resqme_portal_first_page_ms", portalFirstPageMs);
+  add("resqme_app_loop_us", appLoopUs);
+  add("resqme_mesh_update_us", meshUpdateUs);
+  add("resqme_mesh_nodes", meshNodes);
+  add("resqme_heap_free_bytes", heapFree);
+  add("resqme_heap_min_free_bytes", heapMinFree);
+  add("resqme_heap_largest_block_bytes", heapLargestBlock);
+  add("resqme_heap_min_largest_block_bytes", heapMinLargestBlock);
+  add("resqme_ring_drops_total", ringDrops);
+  add("resqme_msg_pool_high_water", msgPoolHighWater);
+  add("resqme_roster_nodes", rosterNodes);
+}
+
+void handleMetrics(AsyncWebServerRequest *request)
+{
+  TRACE_SCOPE(TP_HTTP_METRICS);
+  AsyncResponseStream *res = request->beginResponseStream("text/plain; version=0.0.4");
+  metrics.writeText([res](const char *line, size_t len)
+                    { res->write((const uint8_t *)line, len); });
+  request->send(res);
+}
+
+// Binary dumps are built in place after the frame header (net core only)
+static uint8_t frameBuf[SERIAL_FRAME_MAX];
+uint8_t *const framePayload = frameBuf + FRAME_HEADER;
+const size_t FRAME_PAYLOAD_MAX = SERIAL_FRAME_MAX - FRAME_OVERHEAD;
+// With Z_PACK_FRAMES, a dump goes out packed if that is shorter
+static uint8_t packedFrameBuf[SERIAL_FRAME_PACKED_MAX + FRAME_OVERHEAD];
+void sendFrame(FrameType type, size_t len)
+{
+  if (cfg.compress & Z_PACK_FRAMES)
+  {
+    uint8_t *p = packedFrameBuf + FRAME_HEADER;
+    size_t max = len < SERIAL_FRAME_PACKED_MAX ? len : SERIAL_FRAME_PACKED_MAX;
+    size_t n = max > 3 ? zEncoder.compress(framePayload, len, p + 2, max - 3) : 0;
+    if (n)
+    {
+      p[0] = (uint8_t)len;
+      p[1] = (uint8_t)(len >> 8);
+      zSavedBytes.inc(len - 2 - n);
+      Serial.write(packedFrameBuf, sealFrame(packedFrameBuf, (FrameType)(type | FRAME_PACKED), 2 + n));
+      return;
+    }
+  }
+  Serial.write(frameBuf, sealFrame(frameBuf, type, len));
+}
+
+#if RESQME_ROLE_MASTER
+static_assert(ROSTER_CAPACITY * (43 + ROSTER_USERID_MAX) + 3 <= FRAME_PAYLOAD_MAX, "SERIAL_FRAME_MAX too small for the roster");
+static_assert(ROSTER_CAPACITY * Roster<ROSTER_CAPACITY>::HEALTH_RECORD + 3 <= FRAME_PAYLOAD_MAX, "SERIAL_FRAME_MAX too small for link health");
+void sendHealth()
+{
+  sendFrame(FRAME_HEALTH, roster.writeHealth(framePayload, FRAME_PAYLOAD_MAX));
+}
+Task taskHealthReport(TASK_SECOND * HEALTH_REPORT_S, TASK_FOREVER, []()
+                      { if (roster.size()) sendHealth(); });
+#endif
+#if TRACE_ENABLED
+static_assert(TRACE_CAPACITY * 10 + 256 <= FRAME_PAYLOAD_MAX, "SERIAL_FRAME_MAX too small for the trace");
+size_t snapshotTrace()
+{
+  return traceRing.writeBinary(framePayload, FRAME_PAYLOAD_MAX, TRACE_NAMES, TP_COUNT);
+}
+// frameBuf belongs to the net core, so the portal snapshots into its own
+// buffer, which stays live while the response drains
+static uint8_t webTraceBuf[TRACE_CAPACITY * 10 + 256];
+void handleTrace(AsyncWebServerRequest *request)
+{
+  size_t n = traceRing.writeBinary(webTraceBuf, sizeof(webTraceBuf), TRACE_NAMES, TP_COUNT);
+  request->send(request->beginResponse_P(200, "application/octet-stream", webTraceBuf, n));
+}
+#endif
+
+// Serial lines starting with '!' are commands for this node, not broadcasts
+void handleSerialCommand(const char *cmd)
+{
+  if (!strcmp(cmd, "metrics"))
+    sendFrame(FRAME_METRICS, metrics.writeBinary(framePayload, FRAME_PAYLOAD_MAX));
+#if RESQME_ROLE_MASTER
+  else if (!strcmp(cmd, "latency"))
+    printLatencyReport();
+  else if (!strcmp(cmd, "roster"))
+    sendFrame(FRAME_ROSTER, roster.writeBinary(framePayload, FRAME_PAYLOAD_MAX, millis()));
+  else if (!strcmp(cmd, "health"))
+    sendHealth();
+#endif
+  else if (!strncmp(cmd, "cfg", 3) && (!cmd[3] || cmd[3] == ' '))
+    handleConfigCommand(cmd + 3);
+#if TRACE_ENABLED
+  else if (!strcmp(cmd, "trace"))
+    sendFrame(FRAME_TRACE, snapshotTrace());
+#endif
+}
+
+// ======== Role tasks ========
+// Added to userScheduler while the mesh runs, next to the shared taskReport
+#if RESQME_ROLE_MASTER
+Task *const ROLE_TASKS[] = {&taskAnnounce, &taskLatencyReport, &taskHealthReport, &taskDirectRetry,
+                            &taskAlertDelivery, &taskFragExpire};
+void startRole()
+{
+  taskAnnounce.enable();
+  taskLatencyReport.enable();
+  taskHealthReport.enable();
+  // taskDirectRetry / taskAlertDelivery / taskFragExpire: enabled while messages await an ACK /
+  // alerts are followed / fragments are reassembled
+  announceMaster();
+}
+#else
+Task *const ROLE_TASKS[] = {&taskQueryMaster, &taskFragSend, &taskAggFlush};
+void startRole()
+{
+  taskQueryMaster.enable();
+  fragOut.seed(esp_random()); // taskFragSend / taskAggFlush: enabled while long reports are out /
+                              // reports are held
+  askWhoIsMaster();
+}
+#endif
+
+void startMesh()
+{
+  LOG_DEBUG(MESH, "init");
+  mesh.setDebugMsgTypes(ERROR | STARTUP | CONNECTION);
+  mesh.init(cfg.meshPrefix, cfg.meshPassword, &userScheduler, cfg.meshPort);
+  mesh.onReceive(&meshReceived);
+  mesh.onNewConnection(&meshNewConnection);
+  mesh.onChangedConnections(&meshChanged);
+
+  userScheduler.addTask(taskReport);
+  taskReport.enable();
+  for (Task *t : ROLE_TASKS)
+    userScheduler.addTask(*t);
+  startRole();
+  // Modem sleep only applies to a station-only interface; the IDF keeps
+  // the radio on while the mesh's softAP side is up, so this is best effort.
+  esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+  LOG_INFO(MESH, "nodeId=%u role=%s", mesh.getNodeId(), IS_MASTER ? "MASTER" : "CHILD");
 }
 void startAP()
 {
-  apHasClient = false;
-  blinkActive = true;
-  ledState = false;
-  nextBlinkAt = millis(); // start blink immediately
   WiFi.mode(WIFI_AP);
   if (!WiFi.softAPConfig(apIP, gateway, subnet))
   {
-    if (DEBUG_SERIAL)
-      Serial.println("[AP] softAPConfig FAILED");
+    LOG_ERROR(PORTAL, "softAPConfig FAILED");
   }
-  WiFi.softAP(AP_SSID, AP_PASS);
+  WiFi.softAP(cfg.apSsid, cfg.apPass);
 
   // WiFi.onEvent(WiFiEvent);
-  if (DEBUG_SERIAL)
-    Serial.println("[AP] Access Point started");
-  if (DEBUG_SERIAL)
-    Serial.print("[AP] SSID: ");
-  if (DEBUG_SERIAL)
-    Serial.println(AP_SSID);
-  if (DEBUG_SERIAL)
-    Serial.print("[AP] URL:  http://");
-  if (DEBUG_SERIAL)
-    Serial.println(WiFi.softAPIP());
-
-  server.on("/", []()
-            {
-    String html = R"rawliteral(
-            <!DOCTYPE html>
-            <html>
-                <head>
-                <title>ResQMe User Control Panel</title>
-                <meta name="viewport" content="width=device-width, initial-scale=1">
-                <style>
-                body { font-family: Arial; text-align:center; margin-top:20%; }
-                input, button { padding:12px; font-size:18px; margin:5px; }
-                </style>
-                </head>
-                <body>
-                  <h2>ResQMe User Control Panel</h2>
-                  <p>Enter a message and send it to the The Resque team</p>
-                  <form action="/submit_sos" method="GET">
-                    <input type="text" name="msg" placeholder="Send a message" required>
-                    <button type="submit">Send</button>
-                  </form>
-                </body>
-            </html>
-                )rawliteral";
-
-    server.send(200, "text/html", html); });
-  server.on("/submit_sos", handleSubmit);
-  server.on("/set_user_id", handleUserIdSetup);
+  LOG_INFO(PORTAL, "Access Point started, SSID: %s, URL: http://%u.%u.%u.%u", cfg.apSsid, apIP[0], apIP[1], apIP[2], apIP[3]);
+
+  snprintf(portalUrl, sizeof(portalUrl), "http://%u.%u.%u.%u/", apIP[0], apIP[1], apIP[2], apIP[3]);
+  startCaptiveDns();
+  for (size_t i = 0; i < WEB_ASSET_COUNT; i++)
+  {
+    const WebAsset &asset = WEB_ASSETS[i];
+    server.on(asset.path, HTTP_GET, [&asset](AsyncWebServerRequest *request)
+              { sendAsset(request, asset); });
+  }
+  server.on("/submit_sos", HTTP_GET, handleSubmit);
+  server.on("/set_user_id", HTTP_GET, handleUserIdSetup);
+  server.on("/provision", HTTP_POST, handleProvision, nullptr, onProvisionBody);
+  server.on("/config", HTTP_GET, handleConfig);
+  server.on("/config", HTTP_POST, handleConfigSet);
+  server.on("/metrics", HTTP_GET, handleMetrics);
+  for (const char *path : CONNECTIVITY_CHECKS)
+    server.on(path, HTTP_GET, handleConnectivityCheck);
+#if TRACE_ENABLED
+  server.on("/trace", HTTP_GET, handleTrace);
+#endif
   server.onNotFound(handleNotFound);
   server.begin();
-  if (DEBUG_SERIAL)
-    Serial.println("[AP] Web server started");
+  LOG_DEBUG(PORTAL, "Web server started");
 }
 void stopAP()
 {
-  if (DEBUG_SERIAL)
-    Serial.println("[AP] Stopping web server & AP...");
-  server.stop();
+  LOG_DEBUG(PORTAL, "Stopping web server & AP...");
+  dnsUdp.close();
+  server.end();
+  server.reset(); // startAP registers the handlers again
   WiFi.softAPdisconnect(true);
   WiFi.mode(WIFI_OFF);
-  // stop blinking and turn LED off
-  blinkActive = false;
   apHasClient = false;
-  setBlue(false);
 }
 void stopMesh()
 {
-  if (DEBUG_SERIAL)
-    Serial.println("[MESH] stop");
+  LOG_DEBUG(MESH, "stop");
   taskReport.disable();
   userScheduler.deleteTask(taskReport);
-  taskAnnounce.disable();
-  userScheduler.deleteTask(taskAnnounce);
-  taskQueryMaster.disable();
-  userScheduler.deleteTask(taskQueryMaster);
-  taskSendToMaster.disable();
-  userScheduler.deleteTask(taskSendToMaster);
+  for (Task *t : ROLE_TASKS)
+  {
+    t->disable();
+    userScheduler.deleteTask(*t);
+  }
 
   mesh.stop();
   WiFi.disconnect(true, true); // full disconnect, erase config
   WiFi.mode(WIFI_OFF);
   masterId = 0;
+  postEvent(EVT_MASTER, 0, 0, "", 0);
 }
 void WiFiEvent(WiFiEvent_t event, WiFiEventInfo_t info)
 {
   switch (event)
   {
   case ARDUINO_EVENT_WIFI_AP_STACONNECTED:
-    apHasClient = true;
-    blinkActive = false; // stop blink on click
-    ledState = LOW;
-    digitalWrite(PIN_LED_BLUE, ledState);
-    if (DEBUG_SERIAL)
+    apHasClient = true; // blink timer turns the LED off on its next tick
     {
-      Serial.printf("[AP] Client connected: %02X:%02X:%02X:%02X:%02X:%02X\n",
-                    info.wifi_ap_staconnected.mac[0], info.wifi_ap_staconnected.mac[1],
-                    info.wifi_ap_staconnected.mac[2], info.wifi_ap_staconnected.mac[3],
-                    info.wifi_ap_staconnected.mac[4], info.wifi_ap_staconnected.mac[5]);
+      uint32_t none = 0;
+      staJoinedMs.compare_exchange_strong(none, millis() | 1, std::memory_order_relaxed);
     }
+    LOG_INFO(PORTAL, "Client connected: %02X:%02X:%02X:%02X:%02X:%02X",
+             info.wifi_ap_staconnected.mac[0], info.wifi_ap_staconnected.mac[1],
+             info.wifi_ap_staconnected.mac[2], info.wifi_ap_staconnected.mac[3],
+             info.wifi_ap_staconnected.mac[4], info.wifi_ap_staconnected.mac[5]);
     break;
 
   case ARDUINO_EVENT_WIFI_AP_STADISCONNECTED:
@@ -637,38 +2194,427 @@ void WiFiEvent(WiFiEvent_t event, WiFiEventInfo_t info)
     if (WiFi.softAPgetStationNum() == 0)
     {
       apHasClient = false;
-      blinkActive = true;
-      nextBlinkAt = millis();
+      staJoinedMs.store(0, std::memory_order_relaxed); // left before loading a page
+    }
+    LOG_INFO(PORTAL, "Client disconnected: %02X:%02X:%02X:%02X:%02X:%02X",
+             info.wifi_ap_stadisconnected.mac[0], info.wifi_ap_stadisconnected.mac[1],
+             info.wifi_ap_stadisconnected.mac[2], info.wifi_ap_stadisconnected.mac[3],
+             info.wifi_ap_stadisconnected.mac[4], info.wifi_ap_stadisconnected.mac[5]);
+    break;
+
+  default:
+    break;
+  }
+}
+
+// ======== Timer callbacks ========
+void onBuzzOff(void *)
+{
+  ledcWriteTone(BUZZER_CHANNEL, 0); // stop tone
+}
+void onEventTextExpired(void *)
+{
+  eventTextActive = false;
+  screenDirty = true;
+}
+void onAPShutdown(void *)
+{
+  // shut down ap after save
+  enterMeshMode();
+  screenDirty = true;
+}
+void onBlink(void *)
+{
+  // blinking only while waiting for first client
+  ledState = apHasClient ? LOW : !ledState;
+  digitalWrite(cfg.pinLedBlue, ledState);
+}
+// Sends the oldest outbox entry once the master is known
+void onSendTick(void *)
+{
+  if (IS_MASTER || !masterKnown || outboxCount == 0)
+    return;
+  outbox[outboxHead].b = micros(); // queued stamp
+  if (!toNet.push(outbox[outboxHead]))
+    return; // ring full, retry next tick (the entry keeps its buffer)
+  xTaskNotifyGive(netTaskHandle);
+  outboxHead = (outboxHead + 1) % OUTBOX_CAPACITY;
+  outboxCount--;
+}
+void sampleHeap()
+{
+  heapFree.set(ESP.getFreeHeap());
+  heapMinFree.set(ESP.getMinFreeHeap());
+  int32_t largest = ESP.getMaxAllocHeap(); // biggest single allocation possible now
+  heapLargestBlock.set(largest);
+  if (heapMinLargestBlock.get() == 0 || largest < heapMinLargestBlock.get())
+    heapMinLargestBlock.set(largest);
+  ringDrops.set(toNet.dropped() + toApp.dropped());
+  msgPoolHighWater.set(msgPool.highWater());
+}
+void onReport(void *)
+{
+  sampleHeap();
+  LOG_DEBUG(SYS, "[HEAP] free %d (min %d) largest %d (min %d) pool %d/%u", heapFree.get(), heapMinFree.get(),
+            heapLargestBlock.get(), heapMinLargestBlock.get(), msgPoolHighWater.get(), MSG_POOL_COUNT);
+  static uint32_t lastGpsBytes = 0;
+  LOG_DEBUG(GPS, "%u B/s @ %u baud", (gpsBytes - lastGpsBytes) / 5, gpsConfig.baud);
+  lastGpsBytes = gpsBytes;
+  uint64_t total = appIdle.idleUs + appIdle.busyUs;
+  if (total)
+    LOG_DEBUG(SYS, "[APP] %.1f%% idle, %u wakeups, %u log records dropped", 100.0 * appIdle.idleUs / total,
+              appIdle.wakeups, logDropped());
+}
+void onDraw(void *)
+{
+  // The I2C push is the expensive part; skip it when nothing visible changed
+  static uint32_t lastNodeCount = 0;
+  uint32_t nodeCount = currentMode == MODE_MESH ? meshNodeCount : 0;
+  if (!screenDirty && nodeCount == lastNodeCount)
+    return;
+  lastNodeCount = nodeCount;
+  screenDirty = false;
+  drawScreen();
+}
+
+void setupTimers()
+{
+  timers.begin(millis());
+  buzzTimer = timers.create(onBuzzOff);
+  eventTimer = timers.create(onEventTextExpired);
+  apShutdownTimer = timers.create(onAPShutdown);
+  blinkTimer = timers.create(onBlink);
+  drawTimer = timers.create(onDraw);
+  btnLongTimer = timers.create(onButtonLong);
+  btnGapTimer = timers.create(onButtonGap);
+  sendTimer = timers.create(onSendTick);
+  reportTimer = timers.create(onReport);
+}
+
+// Time until netTask has anything scheduled to do: the earliest of our
+// userScheduler tasks.
+static uint32_t earlier(uint32_t next, long ms)
+{
+  return ms >= 0 && (uint32_t)ms < next ? ms : next; // < 0: not scheduled
+}
+uint32_t msUntilNetWake()
+{
+  uint32_t next = TimerWheel<TIMER_CAPACITY>::NONE;
+  if (netMode == MODE_MESH)
+  {
+    next = earlier(next, userScheduler.timeUntilNextIteration(taskReport));
+    for (Task *t : ROLE_TASKS)
+      next = earlier(next, userScheduler.timeUntilNextIteration(*t));
+  }
+  return next;
+}
+
+// ======== Event-driven idle ========
+void IRAM_ATTR onButtonEdge()
+{
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(loopTaskHandle, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+void onUartReceive()
+{
+  xTaskNotifyGive(loopTaskHandle);
+}
+void onSerialReceive()
+{
+  xTaskNotifyGive(netTaskHandle);
+}
+
+void setupPowerManagement()
+{
+  attachInterrupt(digitalPinToInterrupt(cfg.pinButton), onButtonEdge, CHANGE);
+  GPS.onReceive(onUartReceive);
+  if (IS_MASTER)
+    Serial.onReceive(onSerialReceive); // serial -> mesh bridge
+#if CONFIG_PM_ENABLE
+  // Scale the clock down when idle, and light-sleep in the idle task when
+  // the IDF was built with tickless idle. Wi-Fi holds a lock while active.
+  esp_pm_config_esp32_t pm = {};
+  pm.max_freq_mhz = CPU_MAX_MHZ;
+  pm.min_freq_mhz = CPU_MIN_MHZ;
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+  pm.light_sleep_enable = true;
+#endif
+  esp_pm_configure(&pm);
+#if TRACE_ENABLED
+  // Trace timestamps are cycle counts; keep the clock fixed and awake
+  static esp_pm_lock_handle_t traceLock;
+  if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "trace", &traceLock) == ESP_OK)
+    esp_pm_lock_acquire(traceLock);
+#endif
+#endif
+}
+
+// Blocks the calling task for up to `wait` ms or until notified.
+void idleWait(IdleStats &stats, uint32_t wait)
+{
+  if (wait == 0)
+    return;
+  TRACE_ANCHOR();
+  uint32_t t0 = micros();
+  if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait)))
+    stats.wakeups++;
+  stats.idleUs += micros() - t0;
+}
+
+// ======== Net core ========
+void handleNetCommand(MeshMsg &m)
+{
+  switch (m.type)
+  {
+  case CMD_SEND:
+    if constexpr (!IS_MASTER)
+      sendToMaster(m);
+    break;
+  case CMD_SET_USERID:
+    USERID = m.text();
+    break;
+  case CMD_SET_CONFIG:
+  {
+    ConfigSetResult r = setConfigLine(m.text(), true);
+    LOG_INFO(PORTAL, "config %s: %s", m.text(), configResultName(r));
+    break;
+  }
+  case CMD_POSITION:
+    netPosition.latE7 = m.a;
+    netPosition.lonE7 = m.b;
+    break;
+  case CMD_ALERT_CONFIRM:
+    if constexpr (!IS_MASTER)
+      confirmAlert(m.a);
+    break;
+  case CMD_ENTER_AP:
+    if (netMode == MODE_AP)
+      break;
+    netMode = MODE_AP;
+    stopMesh();
+    vTaskDelay(150 / portTICK_PERIOD_MS);
+    startAP();
+    break;
+  case CMD_ENTER_MESH:
+    if (netMode == MODE_MESH)
+      break;
+    netMode = MODE_MESH;
+    stopAP();
+    vTaskDelay(150 / portTICK_PERIOD_MS);
+    startMesh();
+    break;
+  case CMD_PING:
+    m.type = EVT_PONG;
+    postToApp(m);
+    return; // text (if any) travels on with the pong
+  default:
+    break;
+  }
+  m.release();
+}
+
+// === MASTER SERIAL -> MESH BRIDGE ===
+#if RESQME_ROLE_MASTER
+// Gateway alerts get their <issued> stamp here; legacy lines go out as-is
+void broadcastAlert(const char *line)
+{
+  Alert alert;
+  if (!alert.parse(line, false))
+  {
+    meshSendBroadcast(line, MK_ALERT);
+    return;
+  }
+  FixedString<SERIAL_LINE_MAX + 16> out;
+  out.append(line, alert.targetStart - line);
+  out.appendf("%u:", mesh.getNodeTime());
+  out.append(alert.targetStart);
+  meshSendBroadcast(out.c_str(), MK_ALERT);
+  trackAlert(alert, out.c_str());
+}
+#endif
+
+void pollSerialBridge()
+{
+  TRACE_SCOPE(TP_SERIAL_BRIDGE);
+  static LineAssembler<SERIAL_LINE_MAX> lines; // printable ASCII; overlong lines are dropped whole
+  while (Serial.available())
+  {
+    if (!lines.push(Serial.read()))
+      continue;
+    const FixedString<SERIAL_LINE_MAX> &line = lines.line();
+    if (line.startsWith("!"))
+      handleSerialCommand(line.c_str() + 1);
+    else if constexpr (IS_MASTER) // clients only take commands
+    {
+      if (line.startsWith("ALERT:"))
+        broadcastAlert(line.c_str());
+      else if (line.startsWith("TO:"))
+        sendDirect(line.c_str());
+      else
+        meshSendBroadcast(line.c_str(), classifyMsg(line.c_str()));
     }
-    if (DEBUG_SERIAL)
+  }
+}
+
+void netLoop()
+{
+  uint32_t busyStart = micros();
+  {
+    TRACE_SCOPE(TP_NET_LOOP);
     {
-      Serial.printf("[AP] Client disconnected: %02X:%02X:%02X:%02X:%02X:%02X\n",
-                    info.wifi_ap_stadisconnected.mac[0], info.wifi_ap_stadisconnected.mac[1],
-                    info.wifi_ap_stadisconnected.mac[2], info.wifi_ap_stadisconnected.mac[3],
-                    info.wifi_ap_stadisconnected.mac[4], info.wifi_ap_stadisconnected.mac[5]);
+      TRACE_SCOPE(TP_NET_COMMANDS);
+      MeshMsg m;
+      while (toNet.pop(m))
+        handleNetCommand(m);
     }
-    break;
+    {
+      TRACE_SCOPE(TP_WEB_EVENTS);
+      MeshMsg m;
+      while (fromWeb.pop(m))
+      {
+        if (m.type == EVT_PORTAL_MSG || m.type == EVT_PORTAL_DONE)
+          postToApp(m);
+        else
+          handleNetCommand(m);
+      }
+    }
+    if (netMode == MODE_MESH)
+    {
+      TRACE_SCOPE(TP_MESH_UPDATE);
+      uint32_t t0 = micros();
+      mesh.update();
+      meshUpdateUs.observe(micros() - t0);
+    }
+    pollSerialBridge(); // the gateway on the master; "!" commands (e.g. !cfg) on any node
+  }
+  netIdle.busyUs += micros() - busyStart;
+  // Mesh RX and the serial bridge are polled, so cap the wait to keep them
+  // responsive; the portal wakes netTask itself through fromWeb
+  uint32_t wait = msUntilNetWake();
+  uint32_t cap = netMode == MODE_MESH || IS_MASTER ? MESH_IDLE_MAX_MS : APP_IDLE_MAX_MS;
+  idleWait(netIdle, wait < cap ? wait : cap);
+}
+
+void netTask(void *)
+{
+  startMesh();
+  for (;;)
+    netLoop();
+}
 
+// ======== App core ========
+void handleNetEvent(MeshMsg &m)
+{
+  switch (m.type)
+  {
+  case EVT_ALERT: // a: severity, b: alert id (0: legacy)
+    showAlertOnScreen(m.text());
+    alertToConfirm = m.b;
+    if (ALERT_BUZZ_MS[m.a & 3])
+      startBuzz(ALERT_BUZZ_MS[m.a & 3]);
+    break;
+  case EVT_MASTER:
+    masterKnown = m.node != 0;
+    break;
+  case EVT_NODES:
+    meshNodeCount = m.a;
+    meshNodes.set(m.a);
+    break;
+  case EVT_PORTAL_MSG: // a: micros() at submit, kept as the creation stamp
+    if (outboxCount == OUTBOX_CAPACITY)
+    {
+      outbox[outboxHead].release(); // drop the oldest
+      outboxHead = (outboxHead + 1) % OUTBOX_CAPACITY;
+      outboxCount--;
+    }
+    m.type = CMD_SEND;
+    outbox[(outboxHead + outboxCount) % OUTBOX_CAPACITY] = m; // keeps the buffer
+    outboxCount++;
+    timers.start(apShutdownTimer, AP_SHUTDOWN_DELAY_MS);
+    return;
+  case EVT_PORTAL_DONE:
+    timers.start(apShutdownTimer, AP_SHUTDOWN_DELAY_MS);
+    break;
+  case EVT_CONFIG:
+    timers.start(sendTimer, cfg.sendPeriodMs, cfg.sendPeriodMs); // other live fields are read where used
+    break;
   default:
     break;
   }
+  m.release();
+}
+
+#if CORE_STRESS_TEST
+// Pushes STRESS_MESSAGES pings through toNet and measures the echo through
+// toApp. Prints throughput and round-trip latency, then returns.
+void runCoreStressTest()
+{
+  uint32_t sent = 0, received = 0, maxRtt = 0;
+  uint64_t sumRtt = 0;
+  uint32_t start = micros();
+  MeshMsg m;
+  m.init(CMD_PING);
+  while (received < STRESS_MESSAGES)
+  {
+    if (sent < STRESS_MESSAGES)
+    {
+      m.a = micros();
+      if (postToNet(m))
+        sent++;
+    }
+    MeshMsg r;
+    while (toApp.pop(r))
+    {
+      r.release();
+      if (r.type != EVT_PONG)
+        continue;
+      uint32_t rtt = micros() - (uint32_t)r.a;
+      sumRtt += rtt;
+      if (rtt > maxRtt)
+        maxRtt = rtt;
+      received++;
+    }
+  }
+  uint32_t elapsed = micros() - start;
+  Serial.printf("[STRESS] %u msgs in %u us: %.0f msg/s, rtt avg %.1f us max %u us\n", received, elapsed,
+                received * 1e6 / elapsed, (double)sumRtt / received, maxRtt);
 }
+#endif
 
 //
 void setup()
 {
+  Serial.setTxBufferSize(SERIAL_TX_BUFFER); // uplink lines and log frames queue instead of blocking
   Serial.begin(115200);
-  if (DEBUG_SERIAL)
-    Serial.println("Starting Connection...");
-  pinMode(PIN_LED_BLUE, OUTPUT);
-  pinMode(PIN_LED_RED, OUTPUT);
+  logBegin();
+  ConfigLoadResult loaded = configLoad(cfg); // before anything reads pins or timings
+  storedCfg = cfg;
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  snprintf(macStr, sizeof(macStr), "%02X:%02X:%02X:%02X:%02X:%02X",
+           mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+  LOG_INFO(SYS, "Starting Connection... (config: %s)", loaded == CFG_LOAD_OK ? "stored" : loaded == CFG_LOAD_UPGRADED ? "stored, upgraded" : "defaults");
+  pinMode(cfg.pinLedBlue, OUTPUT);
+  pinMode(cfg.pinLedRed, OUTPUT);
   ledcSetup(BUZZER_CHANNEL, BUZZER_FREQ, BUZZER_RES);
-  ledcAttachPin(PIN_BUZZER, BUZZER_CHANNEL);
-  pinMode(PIN_BUTTON, INPUT_PULLUP);
-  GPS.begin(9600, SERIAL_8N1, PIN_GPS_RX, PIN_GPS_TX);
-  // Add tasks
-  startMesh();
+  ledcAttachPin(cfg.pinBuzzer, BUZZER_CHANNEL);
+  pinMode(cfg.pinButton, INPUT_PULLUP);
+  setupTimers();
+  setupMetrics();
+  loopTaskHandle = xTaskGetCurrentTaskHandle();
+  gpsConfig = configureGPS(GPS, cfg.pinGpsRx, cfg.pinGpsTx);
+  LOG_INFO(GPS, "chip=%d baud=%u acked=%u/%u hint=%d", gpsConfig.chip, gpsConfig.baud,
+           gpsConfig.acked, gpsConfig.sent, gpsConfig.hintSent);
+  if (profileLoad(portalProfile))
+  {
+    USERID = portalProfile.userId; // before netTask starts: no pairing after a power cycle
+    LOG_INFO(SYS, "profile: userid=%s medical=0x%x", portalProfile.userId, portalProfile.medical);
+  }
+  // Mesh, its tasks and the portal live on the protocol core
   currentMode = MODE_MESH;
+  xTaskCreatePinnedToCore(netTask, "net", NET_TASK_STACK, nullptr, NET_TASK_PRIO, &netTaskHandle, NET_CORE);
+  setupPowerManagement();
   Wire.begin();
   WiFi.onEvent(WiFiEvent);
   if (!display.begin(SSD1306_SWITCHCAPVCC, OLED_ADDR))
@@ -683,63 +2629,44 @@ void setup()
 
   display.clearDisplay();
   display.display();
+  timers.start(drawTimer, DRAW_PERIOD_MS, DRAW_PERIOD_MS);
+  timers.start(sendTimer, cfg.sendPeriodMs, cfg.sendPeriodMs);
+  timers.start(reportTimer, 5000, 5000);
+#if CORE_STRESS_TEST
+  runCoreStressTest();
+#endif
 }
 
 // --- //
+// App core: button, GPS, UI and outbox. The mesh runs in netTask.
 void loop()
 {
-  ButtonEvent ev = pollButton();
-  if (ev != BTN_NONE)
-    reportEvent(ev);
-  pumpGPS();
-  if (millis() - lastSend >= SEND_PERIOD_MS)
-  {
-    lastSend = millis();
-  }
-  if (currentMode == MODE_MESH)
-    mesh.update();
-  else if (currentMode == MODE_AP)
-  {
-    server.handleClient();
-
-    if (blinkActive && !apHasClient && millis() >= nextBlinkAt)
-    {
-      ledState = !ledState;
-      digitalWrite(PIN_LED_BLUE, ledState);
-      nextBlinkAt = millis() + 300;
-    }
-    // shut down ap after save
-    if (wantAPShutdown && millis() >= apShutdownAt)
-    {
-      stopAP();
-      startMesh();
-      currentMode = MODE_MESH;
-      wantAPShutdown = false;
-    }
-  }
-  // === MASTER SERIAL -> MESH BRIDGE ===
-  if (IS_MASTER)
+  uint32_t busyStart = micros();
   {
-    static String buffer = "";
-    while (Serial.available())
+    TRACE_SCOPE(TP_APP_LOOP);
     {
-      char c = Serial.read();
-      if (c == '\n')
-      { // message delimiter
-        if (buffer.length() > 0)
-        {
-          mesh.sendBroadcast(buffer);
-          buffer = "";
-        }
-      }
-      else if (c >= 32 && c <= 126)
-      { // printable only
-        buffer += c;
-      }
+      TRACE_SCOPE(TP_APP_EVENTS);
+      MeshMsg m;
+      while (toApp.pop(m))
+        handleNetEvent(m);
     }
+    ButtonEvent ev = pollButton();
+    if (ev != BTN_NONE)
+      reportEvent(ev);
+    pumpGPS();
+    TRACE_SCOPE(TP_TIMERS); // timer callbacks, drawScreen included
+    timers.advance(millis());
   }
-  serviceBuzz();
-  drawScreen();
+  uint32_t busy = micros() - busyStart;
+  appIdle.busyUs += busy;
+  appLoopUs.observe(busy);
+
+  uint32_t wait = timers.msUntilNext(millis());
+  if (wait > APP_IDLE_MAX_MS)
+    wait = APP_IDLE_MAX_MS;
+  if (millis() - btn.lastChange <= cfg.debounceMs)
+    wait = min(wait, (uint32_t)cfg.debounceMs + 1); // re-read once bounce settles
+  idleWait(appIdle, wait);
 }
 
 void beepLED(int pin, int durationMs, int repeat)
@@ -0,0 +1,124 @@
+#include "role.h"
+#if RESQME_ROLE_MASTER
+#include "master_ingest.h"
+#include "log.h"
+#include "inbound.h"
+#include "compress_dict.h"
+#include <ArduinoJson.h>
+#include <math.h>
+#include <stdio.h>
+
+Roster<ROSTER_CAPACITY> roster;
+DedupeFilter<DEDUPE_LRU, DEDUPE_BLOOM_BITS> dedupe(DEDUPE_FP_PPM);
+LatencyStats latency;
+
+static bool parseMac(const char *s, uint8_t *mac)
+{
+  unsigned v[6];
+  if (!s || sscanf(s, "%2x:%2x:%2x:%2x:%2x:%2x", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]) != 6)
+    return false;
+  for (uint8_t i = 0; i < 6; i++)
+    mac[i] = v[i];
+  return true;
+}
+
+// Latency of one report from its "ts":[created,queued,sent] stamps, in ms
+static uint32_t recordLatency(uint32_t from, uint8_t hops, bool sos, uint32_t created, uint32_t queued, uint32_t sent,
+                              uint32_t arrival)
+{
+  int32_t total = arrival - created; // both on mesh time, within its sync error
+  if (total < 0)
+    total = 0;
+  latency.record(from, hops, sos ? LAT_SOS : LAT_ROUTINE, total / 1000);
+  LOG_DEBUG(MESH, "latency from %u: %d ms (app %d, net core %d, mesh %d)", from, total / 1000,
+            (int32_t)(queued - created) / 1000, (int32_t)(sent - queued) / 1000, (int32_t)(arrival - sent) / 1000);
+  return total / 1000;
+}
+
+RosterEntry &ingestTouch(uint32_t from, uint32_t nowMs, size_t len, uint8_t hops)
+{
+  RosterEntry &node = roster.touch(from, nowMs);
+  node.packets++;
+  node.bytes += len;
+  node.hops = hops;
+  return node;
+}
+
+const char *ingestUnpack(const char *msg, size_t &len)
+{
+  if (len < 2 || memcmp(msg, "Z:", 2))
+    return msg;
+  static char text[MESH_JSON_MAX + 1]; // netTask only
+  ZLine z;
+  size_t n = parseZLine(msg + 2, len - 2, z) ? zUnpackLine(z, text, MESH_JSON_MAX, ZDICT_REPORTS) : Z_BAD;
+  if (n == Z_BAD)
+  {
+    zRefused.inc();
+    return nullptr;
+  }
+  text[n] = 0;
+  len = n;
+  return text;
+}
+
+bool ingestReport(RosterEntry &node, const char *msg, size_t len, uint32_t arrival)
+{
+  StaticJsonDocument<768 + USER_MSG_MAX> doc; // strings are copied: the message once more
+  if (deserializeJson(doc, msg, len))
+    return true; // not JSON: still counted in the link stats
+  // Copies first: a late or relayed copy of an old report must not touch
+  // the roster, or it would move the node back and raise a cleared SOS
+  bool newest = true;
+  if (doc["seq"].is<uint32_t>())
+  {
+    uint32_t boot = doc["boot"] | 0u, seq = doc["seq"];
+    newest = node.seq.observe(boot, seq) == SeqWindow::SEQ_NEW;
+    if (dedupe.seen(dedupe.key(node.nodeId ^ boot, seq)))
+    {
+      dedupeDropped.inc();
+      LOG_DEBUG(MESH, "dropped copy of seq %u from %u", seq, node.nodeId);
+      return false;
+    }
+  }
+  uint8_t mac[6];
+  if (parseMac(doc["device_id"], mac))
+    roster.setMac(node, mac);
+  const char *uid = doc["userid"];
+  if (uid)
+    roster.setUserId(node, uid);
+  bool sos = doc["sos"] | false;
+  // Position and SOS only from the newest report: one that arrives after a
+  // later one still goes up, but is not the node's state any more
+  if (newest)
+  {
+    JsonVariant gps = doc["sensors"]["gps"];
+    double lat = gps["latitude"] | 0.0, lon = gps["longitude"] | 0.0;
+    if ((lat != 0.0 || lon != 0.0) && validLatLng(lat, lon)) // clients report 0,0 until their first fix
+    {
+      node.latE7 = lround(lat * 1e7);
+      node.lonE7 = lround(lon * 1e7);
+      node.flags |= ROSTER_HAS_FIX;
+    }
+    node.flags = sos ? node.flags | ROSTER_SOS : node.flags & ~ROSTER_SOS;
+  }
+  JsonArray ts = doc["ts"];
+  if (ts.size() == 3)
+    node.lastLatencyMs = recordLatency(node.nodeId, node.hops, sos, ts[0], ts[1], ts[2], arrival);
+  return true;
+}
+
+void formatUplink(FixedString<UPLINK_LINE_MAX> &line, uint32_t from, const char *msg, size_t len)
+{
+  line.clear();
+  line.appendf("[MASTER] RX from %u: ", from);
+  size_t start = line.length(), room = UPLINK_LINE_MAX - 2 - start; // the '\n' always fits
+  line.append(msg, len < room ? len : room);
+  // One packet, one line: a '\n' inside it would let a node forge lines
+  // from others
+  char *p = line.data();
+  for (size_t i = start; i < line.length(); i++)
+    if ((uint8_t)p[i] < 32)
+      p[i] = ' ';
+  line.append('\n');
+}
+#endif
@@ -0,0 +1,201 @@
+#include "profile.h"
+#include "serial_frame.h"
+#include <ArduinoJson.h>
+#include <Preferences.h>
+
+static const char *NVS_NS = "profile";
+static const char *NVS_KEY_PROFILE = "p";
+static const uint8_t PROFILE_VERSION = 1;
+
+// NVS layout: version, the struct, CRC16 of both
+struct StoredProfile
+{
+  uint8_t version;
+  Profile profile;
+  uint16_t crc;
+};
+
+enum ProvisionTag : uint8_t
+{
+  TAG_USERID = 1,
+  TAG_CONTACT_NAME = 2,
+  TAG_CONTACT_PHONE = 3,
+  TAG_MEDICAL = 4,
+  TAG_MESSAGE = 5,
+};
+
+static bool fail(const char *&err, const char *why)
+{
+  err = why;
+  return false;
+}
+
+static bool printable(const char *s, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+    if (s[i] < 32 || s[i] > 126)
+      return false;
+  return true;
+}
+
+// ':' separates fields in TO:<id>:<userid> and the uplink lines
+bool profileValidUserId(const char *s, size_t len)
+{
+  return len && len <= PROFILE_USERID_MAX && printable(s, len) && !memchr(s, ':', len);
+}
+static bool validPhone(const char *s, size_t len)
+{
+  if (len > PROFILE_PHONE_MAX)
+    return false;
+  for (size_t i = 0; i < len; i++)
+    if (!isdigit((unsigned char)s[i]) && !strchr("+ -", s[i]))
+      return false;
+  return true;
+}
+
+static void copyField(char *dst, const char *s, size_t len)
+{
+  memcpy(dst, s, len);
+  dst[len] = 0;
+}
+
+static bool setField(ProvisionRequest &out, uint8_t tag, const char *s, size_t len, const char *&err)
+{
+  switch (tag)
+  {
+  case TAG_USERID:
+    if (!profileValidUserId(s, len))
+      return fail(err, "bad userid");
+    copyField(out.profile.userId, s, len);
+    return true;
+  case TAG_CONTACT_NAME:
+    if (len > PROFILE_NAME_MAX || !printable(s, len))
+      return fail(err, "bad contact name");
+    copyField(out.profile.contactName, s, len);
+    return true;
+  case TAG_CONTACT_PHONE:
+    if (!validPhone(s, len))
+      return fail(err, "bad contact phone");
+    copyField(out.profile.contactPhone, s, len);
+    return true;
+  case TAG_MESSAGE:
+    if (out.messages == PROVISION_MSGS_MAX)
+      return fail(err, "too many messages");
+    if (!len || len > PROVISION_MSG_MAX || !printable(s, len))
+      return fail(err, "bad message");
+    out.msg[out.messages] = s;
+    out.msgLen[out.messages++] = len;
+    return true;
+  default:
+    return true; // unknown tags are skipped, for newer apps
+  }
+}
+
+static bool parseBinary(const uint8_t *p, size_t len, ProvisionRequest &out, const char *&err)
+{
+  size_t i = 0;
+  while (i < len)
+  {
+    if (len - i < 2 || len - i - 2 < p[i + 1])
+      return fail(err, "truncated record");
+    uint8_t tag = p[i], n = p[i + 1];
+    const uint8_t *v = p + i + 2;
+    i += 2 + n;
+    if (tag == TAG_MEDICAL)
+    {
+      if (n != 2)
+        return fail(err, "bad medical");
+      out.profile.medical = v[0] | v[1] << 8;
+    }
+    else if (!setField(out, tag, (const char *)v, n, err))
+      return false;
+  }
+  return true;
+}
+
+static bool jsonField(ProvisionRequest &out, uint8_t tag, JsonVariantConst v, const char *&err)
+{
+  if (v.isNull())
+    return true;
+  const char *s = v.as<const char *>();
+  if (!s)
+    return fail(err, "expected a string");
+  return setField(out, tag, s, strlen(s), err);
+}
+
+static bool parseJson(char *body, size_t len, ProvisionRequest &out, const char *&err)
+{
+  // Only the AsyncTCP task parses, so the document can be static.
+  // Mutable input: strings stay in the body instead of being copied.
+  static StaticJsonDocument<512> doc;
+  if (deserializeJson(doc, body, len))
+    return fail(err, "bad json");
+  if (!jsonField(out, TAG_USERID, doc["userid"], err) ||
+      !jsonField(out, TAG_CONTACT_NAME, doc["contact"]["name"], err) ||
+      !jsonField(out, TAG_CONTACT_PHONE, doc["contact"]["phone"], err))
+    return false;
+  JsonVariantConst medical = doc["medical"];
+  if (!medical.isNull())
+  {
+    if (!medical.is<uint16_t>())
+      return fail(err, "bad medical");
+    out.profile.medical = medical.as<uint16_t>();
+  }
+  JsonVariantConst messages = doc["messages"];
+  if (!messages.isNull() && !messages.is<JsonArrayConst>())
+    return fail(err, "messages must be an array");
+  for (JsonVariantConst m : messages.as<JsonArrayConst>())
+    if (!jsonField(out, TAG_MESSAGE, m, err))
+      return false;
+  return true;
+}
+
+bool parseProvision(char *body, size_t len, bool binary, const Profile &base, ProvisionRequest &out, const char *&err)
+{
+  out.profile = base;
+  out.messages = 0;
+  err = "";
+  if (!(binary ? parseBinary((const uint8_t *)body, len, out, err) : parseJson(body, len, out, err)))
+    return false;
+  if (!out.profile.userId[0])
+    return fail(err, "userid required");
+  return true;
+}
+
+static uint16_t profileCrc(const StoredProfile &s)
+{
+  return crc16Ccitt((const uint8_t *)&s, offsetof(StoredProfile, crc));
+}
+
+bool profileLoad(Profile &p)
+{
+  Preferences prefs;
+  if (!prefs.begin(NVS_NS, true))
+    return false;
+  StoredProfile s;
+  bool ok = prefs.getBytes(NVS_KEY_PROFILE, &s, sizeof(s)) == sizeof(s);
+  prefs.end();
+  if (!ok || s.version != PROFILE_VERSION || s.crc != profileCrc(s))
+    return false;
+  s.profile.userId[PROFILE_USERID_MAX] = 0;
+  s.profile.contactName[PROFILE_NAME_MAX] = 0;
+  s.profile.contactPhone[PROFILE_PHONE_MAX] = 0;
+  p = s.profile;
+  return true;
+}
+
+bool profileSave(const Profile &p)
+{
+  StoredProfile s = StoredProfile(); // zeroed first: no stray stack bytes in NVS
+  s.version = PROFILE_VERSION;
+  s.profile = p;
+  s.crc = profileCrc(s);
+  Preferences prefs;
+  if (!prefs.begin(NVS_NS, false))
+    return false;
+  // NVS writes a blob's data before its index entry, so a power cut
+  // mid-write leaves the previous blob in place
+  bool ok = prefs.putBytes(NVS_KEY_PROFILE, &s, sizeof(s)) == sizeof(s);
+  prefs.end();
+  return ok;
+}
@@ -0,0 +1,245 @@
+#include "runtime_config.h"
+#include "serial_frame.h"
+#include "fragment.h"
+#include "compress.h"
+#include "aggregate.h"
+#include <Preferences.h>
+
+static const char *NVS_NS = "config";
+static const char *NVS_KEY_CONFIG = "c";
+static const uint8_t CONFIG_VERSION = 4; // bump when fields are appended
+
+// NVS layout: this header, then the first `len` bytes of RuntimeConfig
+struct StoredConfigHeader
+{
+  uint8_t version;
+  uint8_t reserved;
+  uint16_t len;
+  uint16_t crc; // CRC16 of the config bytes
+};
+
+RuntimeConfig cfg;
+
+// Bytes of RuntimeConfig that hold each version's fields. An older blob may
+// be longer: the struct's tail padding is stored too, and a field appended
+// later can land in it.
+static const uint16_t CONFIG_VERSION_LEN[CONFIG_VERSION + 1] = {0, offsetof(RuntimeConfig, fragMtu),
+                                                                offsetof(RuntimeConfig, compress),
+                                                                offsetof(RuntimeConfig, aggHoldMs),
+                                                                sizeof(RuntimeConfig)};
+
+#define CFG_FIELD(key, type, flags, member, min, max) {key, type, flags, offsetof(RuntimeConfig, member), min, max}
+const ConfigField CONFIG_FIELDS[] = {
+    CFG_FIELD("meshPrefix", CFG_STR, CFG_REBOOT, meshPrefix, 1, 32),
+    CFG_FIELD("meshPassword", CFG_STR, CFG_REBOOT | CFG_SECRET, meshPassword, 8, CFG_STR_MAX),
+    CFG_FIELD("meshPort", CFG_U16, CFG_REBOOT, meshPort, 1, 65535),
+    CFG_FIELD("apSsid", CFG_STR, CFG_REBOOT, apSsid, 1, 32),
+    CFG_FIELD("apPass", CFG_STR, CFG_REBOOT | CFG_SECRET, apPass, 8, CFG_STR_MAX),
+    CFG_FIELD("pinGpsRx", CFG_PIN, CFG_REBOOT, pinGpsRx, 0, 39),
+    CFG_FIELD("pinGpsTx", CFG_PIN, CFG_REBOOT | CFG_OUTPUT, pinGpsTx, 0, 39),
+    CFG_FIELD("pinLedBlue", CFG_PIN, CFG_REBOOT | CFG_OUTPUT, pinLedBlue, 0, 39),
+    CFG_FIELD("pinLedRed", CFG_PIN, CFG_REBOOT | CFG_OUTPUT, pinLedRed, 0, 39),
+    CFG_FIELD("pinButton", CFG_PIN, CFG_REBOOT, pinButton, 0, 39),
+    CFG_FIELD("pinBuzzer", CFG_PIN, CFG_REBOOT | CFG_OUTPUT, pinBuzzer, 0, 39),
+    CFG_FIELD("sendPeriodMs", CFG_U32, 0, sendPeriodMs, 200, 3600000),
+    CFG_FIELD("alertDisplayMs", CFG_U32, 0, alertDisplayMs, 1000, 600000),
+    CFG_FIELD("debounceMs", CFG_U16, 0, debounceMs, 5, 500),
+    CFG_FIELD("multiclickGapMs", CFG_U16, 0, multiclickGapMs, 100, 2000),
+    CFG_FIELD("longpressMs", CFG_U16, 0, longpressMs, 500, 10000),
+    CFG_FIELD("fragMtu", CFG_U16, 0, fragMtu, FRAG_MTU_MIN, FRAG_MTU_MAX),
+    CFG_FIELD("compress", CFG_U16, 0, compress, 0, Z_PACK_REPORTS | Z_PACK_FRAMES),
+    CFG_FIELD("aggHoldMs", CFG_U16, CFG_ZERO_OFF, aggHoldMs, AGG_BUDGET_MIN_MS, AGG_BUDGET_MAX_MS),
+};
+const uint8_t CONFIG_FIELD_COUNT = sizeof(CONFIG_FIELDS) / sizeof(CONFIG_FIELDS[0]);
+
+void configDefaults(RuntimeConfig &c)
+{
+  memset(&c, 0, sizeof(c));
+  strlcpy(c.meshPrefix, CFG_MESH_PREFIX, sizeof(c.meshPrefix));
+  strlcpy(c.meshPassword, CFG_MESH_PASSWORD, sizeof(c.meshPassword));
+  c.meshPort = CFG_MESH_PORT;
+  strlcpy(c.apSsid, CFG_AP_SSID, sizeof(c.apSsid));
+  strlcpy(c.apPass, CFG_AP_PASS, sizeof(c.apPass));
+  c.pinGpsRx = CFG_PIN_GPS_RX;
+  c.pinGpsTx = CFG_PIN_GPS_TX;
+  c.pinLedBlue = CFG_PIN_LED_BLUE;
+  c.pinLedRed = CFG_PIN_LED_RED;
+  c.pinButton = CFG_PIN_BUTTON;
+  c.pinBuzzer = CFG_PIN_BUZZER;
+  c.sendPeriodMs = CFG_SEND_PERIOD_MS;
+  c.alertDisplayMs = CFG_ALERT_DISPLAY_MS;
+  c.debounceMs = CFG_DEBOUNCE_MS;
+  c.multiclickGapMs = CFG_MULTICLICK_GAP_MS;
+  c.longpressMs = CFG_LONGPRESS_MS;
+  c.fragMtu = CFG_FRAG_MTU;
+  c.compress = CFG_COMPRESS;
+  c.aggHoldMs = CFG_AGG_HOLD_MS;
+}
+
+// A stored blob is trusted only if every field it covers is in range
+static bool configValid(const RuntimeConfig &c, size_t len)
+{
+  char text[CFG_STR_MAX + 2];
+  RuntimeConfig scratch;
+  for (uint8_t i = 0; i < CONFIG_FIELD_COUNT; i++)
+  {
+    const ConfigField &f = CONFIG_FIELDS[i];
+    if (f.offset >= len)
+      continue;
+    const uint8_t *p = (const uint8_t *)&c + f.offset;
+    switch (f.type)
+    {
+    case CFG_STR:
+      if (!memchr(p, 0, f.max + 1))
+        return false;
+      strlcpy(text, (const char *)p, sizeof(text));
+      break;
+    case CFG_U16:
+      snprintf(text, sizeof(text), "%u", *(const uint16_t *)p);
+      break;
+    case CFG_U32:
+      snprintf(text, sizeof(text), "%lu", (unsigned long)*(const uint32_t *)p);
+      break;
+    case CFG_PIN:
+      snprintf(text, sizeof(text), "%d", *(const int8_t *)p);
+      break;
+    }
+    if (!configParse(scratch, f, text))
+      return false;
+  }
+  return true;
+}
+
+ConfigLoadResult configLoad(RuntimeConfig &c)
+{
+  configDefaults(c);
+  Preferences prefs;
+  if (!prefs.begin(NVS_NS, true))
+    return CFG_LOAD_DEFAULTS;
+  uint8_t buf[sizeof(StoredConfigHeader) + sizeof(RuntimeConfig)];
+  size_t n = prefs.getBytes(NVS_KEY_CONFIG, buf, sizeof(buf));
+  prefs.end();
+  StoredConfigHeader h;
+  if (n < sizeof(h))
+    return CFG_LOAD_DEFAULTS;
+  memcpy(&h, buf, sizeof(h));
+  // A newer firmware's blob is longer than we read; ignore it rather than
+  // guess which of its fields we know
+  if (h.version > CONFIG_VERSION || h.len != n - sizeof(h) || crc16Ccitt(buf + sizeof(h), h.len) != h.crc)
+    return CFG_LOAD_DEFAULTS;
+  size_t len = h.len < CONFIG_VERSION_LEN[h.version] ? h.len : CONFIG_VERSION_LEN[h.version];
+  RuntimeConfig stored = c;
+  memcpy(&stored, buf + sizeof(h), len);
+  // Hold budgets under AGG_BUDGET_MIN_MS were accepted before it was set;
+  // raise a stored one rather than throw the whole blob away
+  if (stored.aggHoldMs && stored.aggHoldMs < AGG_BUDGET_MIN_MS)
+    stored.aggHoldMs = AGG_BUDGET_MIN_MS;
+  if (!configValid(stored, len))
+    return CFG_LOAD_DEFAULTS;
+  c = stored;
+  return h.version < CONFIG_VERSION ? CFG_LOAD_UPGRADED : CFG_LOAD_OK;
+}
+
+bool configSave(const RuntimeConfig &c)
+{
+  uint8_t buf[sizeof(StoredConfigHeader) + sizeof(RuntimeConfig)];
+  StoredConfigHeader h = {CONFIG_VERSION, 0, sizeof(RuntimeConfig), crc16Ccitt((const uint8_t *)&c, sizeof(c))};
+  memcpy(buf, &h, sizeof(h));
+  memcpy(buf + sizeof(h), &c, sizeof(c));
+  Preferences prefs;
+  if (!prefs.begin(NVS_NS, false))
+    return false;
+  bool ok = prefs.putBytes(NVS_KEY_CONFIG, buf, sizeof(buf)) == sizeof(buf); // one blob: all or nothing
+  prefs.end();
+  return ok;
+}
+
+const ConfigField *configFind(const char *key)
+{
+  for (uint8_t i = 0; i < CONFIG_FIELD_COUNT; i++)
+    if (!strcmp(CONFIG_FIELDS[i].key, key))
+      return &CONFIG_FIELDS[i];
+  return nullptr;
+}
+
+bool configParse(RuntimeConfig &c, const ConfigField &f, const char *value)
+{
+  uint8_t *p = (uint8_t *)&c + f.offset;
+  if (f.type == CFG_STR)
+  {
+    size_t len = strlen(value);
+    if (len < f.min || len > f.max)
+      return false;
+    for (size_t i = 0; i < len; i++)
+      if (value[i] < 32 || value[i] > 126 || value[i] == '"' || value[i] == '\\') // printed as JSON unescaped
+        return false;
+    memcpy(p, value, len + 1);
+    return true;
+  }
+  char *end;
+  long v = strtol(value, &end, 10);
+  if (end == value || *end || (v < (long)f.min && !(v == 0 && (f.flags & CFG_ZERO_OFF))) || v > (long)f.max)
+    return false;
+  switch (f.type)
+  {
+  case CFG_U16:
+    *(uint16_t *)p = v;
+    break;
+  case CFG_U32:
+    *(uint32_t *)p = v;
+    break;
+  case CFG_PIN:
+    if ((f.flags & CFG_OUTPUT) && v >= 34) // GPIO 34-39 are inputs only
+      return false;
+    if (v >= 6 && v <= 11) // SPI flash
+      return false;
+    *(int8_t *)p = v;
+    break;
+  default:
+    return false;
+  }
+  return true;
+}
+
+void configCopyField(RuntimeConfig &dst, const RuntimeConfig &src, const ConfigField &f)
+{
+  static const uint8_t sizes[] = {0, 2, 4, 1};
+  size_t n = f.type == CFG_STR ? f.max + 1 : sizes[f.type];
+  memcpy((uint8_t *)&dst + f.offset, (const uint8_t *)&src + f.offset, n);
+}
+
+size_t configWriteJson(const RuntimeConfig &c, char *out, size_t max)
+{
+  size_t n = 0;
+  for (uint8_t i = 0; i < CONFIG_FIELD_COUNT; i++)
+  {
+    const ConfigField &f = CONFIG_FIELDS[i];
+    const uint8_t *p = (const uint8_t *)&c + f.offset;
+    const char *sep = i ? "," : "{";
+    int w;
+    if (f.flags & CFG_SECRET)
+      w = snprintf(out + n, max - n, "%s\"%s\":\"***\"", sep, f.key);
+    else if (f.type == CFG_STR)
+      w = snprintf(out + n, max - n, "%s\"%s\":\"%s\"", sep, f.key, (const char *)p);
+    else if (f.type == CFG_U16)
+      w = snprintf(out + n, max - n, "%s\"%s\":%u", sep, f.key, *(const uint16_t *)p);
+    else if (f.type == CFG_U32)
+      w = snprintf(out + n, max - n, "%s\"%s\":%lu", sep, f.key, (unsigned long)*(const uint32_t *)p);
+    else
+      w = snprintf(out + n, max - n, "%s\"%s\":%d", sep, f.key, *(const int8_t *)p);
+    if (w < 0 || (size_t)w >= max - n)
+      return 0;
+    n += w;
+  }
+  if (n + 2 > max)
+    return 0;
+  out[n++] = '}';
+  out[n] = 0;
+  return n;
+}
+
+const char *configResultName(ConfigSetResult r)
+{
+  static const char *const names[] = {"applied", "stored, applies after reboot", "unknown key", "bad value", "not saved"};
+  return names[r];
+}
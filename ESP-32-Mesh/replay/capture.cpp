@@ -0,0 +1,192 @@
+#include "capture.h"
+#include "serial_frame.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char RX_PREFIX[] = "[MASTER] RX from ";
+
+bool CaptureReader::open(const char *path)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+  data_.clear();
+  char buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    data_.insert(data_.end(), buf, buf + n);
+  bool ok = !ferror(f);
+  fclose(f);
+  rewind();
+  return ok;
+}
+
+void CaptureReader::assign(const char *data, size_t len)
+{
+  data_.assign(data, data + len);
+  rewind();
+}
+
+void CaptureReader::rewind()
+{
+  pos_ = 0;
+  lastUs_ = 0;
+  haveMeshUs_ = false;
+  stats_ = CaptureStats();
+}
+
+// At a frame's sync bytes: steps over the frame if its CRC checks out,
+// else over the first sync byte only, to resynchronise on what follows
+bool CaptureReader::skipFrame()
+{
+  const uint8_t *p = (const uint8_t *)data_.data() + pos_;
+  size_t left = data_.size() - pos_;
+  if (left < 2 || p[0] != FRAME_SYNC0 || p[1] != FRAME_SYNC1)
+    return false;
+  if (left >= FRAME_OVERHEAD)
+  {
+    uint16_t len = p[3] | p[4] << 8;
+    if (left >= (size_t)FRAME_OVERHEAD + len)
+    {
+      uint16_t crc = p[FRAME_HEADER + len] | p[FRAME_HEADER + len + 1] << 8;
+      if (crc16Ccitt(p + 2, 3 + len) == crc)
+      {
+        if (onFrame)
+          onFrame(p[2], p + FRAME_HEADER, len);
+        pos_ += FRAME_OVERHEAD + len;
+        stats_.frames++;
+        return true;
+      }
+    }
+  }
+  pos_++;
+  stats_.badFrames++;
+  return true;
+}
+
+// Value of a top-level-looking "key": in the packet, without parsing JSON:
+// the reader must cost little next to the ingest it feeds
+static const char *findKey(const char *s, size_t len, const char *key)
+{
+  size_t k = strlen(key);
+  const char *end = s + len;
+  for (const char *p = s; p + k <= end; p++)
+  {
+    p = (const char *)memchr(p, key[0], end - p);
+    if (!p || p + k > end)
+      return nullptr;
+    if (!memcmp(p, key, k))
+      return p + k;
+  }
+  return nullptr;
+}
+
+static int hexDigit(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  c |= 0x20;
+  return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+// painlessMesh's node id is the last four bytes of the station MAC
+static bool macNodeId(const char *s, const char *end, uint32_t &id)
+{
+  if (end - s < 17)
+    return false;
+  id = 0;
+  for (uint8_t i = 0; i < 6; i++)
+  {
+    const char *p = s + i * 3;
+    int hi = hexDigit(p[0]), lo = hexDigit(p[1]);
+    if (hi < 0 || lo < 0 || (i < 5 && p[2] != ':'))
+      return false;
+    id = id << 8 | (hi << 4 | lo); // the first two bytes shift out
+  }
+  return true;
+}
+
+bool CaptureReader::parseLine(const char *line, size_t len, CaptureRecord &r)
+{
+  const char *end = line + len;
+  r.from = 0;
+  if (len > sizeof(RX_PREFIX) - 1 && !memcmp(line, RX_PREFIX, sizeof(RX_PREFIX) - 1))
+  {
+    char *after;
+    r.from = strtoul(line + sizeof(RX_PREFIX) - 1, &after, 10);
+    if (after + 2 > end || after[0] != ':' || after[1] != ' ')
+      return false;
+    r.text = after + 2;
+  }
+  else if (line[0] == '{')
+  {
+    const char *mac = findKey(line, len, "\"device_id\":\"");
+    if (!mac)
+      mac = findKey(line, len, "\"mac\":\"");
+    if (!mac || !macNodeId(mac, end, r.from))
+      return false; // the master's own JSON lines name no sender
+    r.text = line;
+  }
+  else
+    return false;
+  r.len = end - r.text;
+  r.timed = false;
+  const char *ts = findKey(r.text, r.len, "\"ts\":[");
+  if (ts)
+  {
+    // third stamp: sent, in mesh us; 32-bit, so unwrap against the last one
+    for (uint8_t i = 0; i < 2 && ts; i++)
+    {
+      ts = (const char *)memchr(ts, ',', end - ts);
+      ts = ts ? ts + 1 : nullptr;
+    }
+    if (ts)
+    {
+      uint32_t meshUs = strtoul(ts, nullptr, 10);
+      lastUs_ = haveMeshUs_ ? lastUs_ + (int32_t)(meshUs - lastMeshUs_) : meshUs;
+      lastMeshUs_ = meshUs;
+      haveMeshUs_ = true;
+      r.timed = true;
+    }
+  }
+  else if (const char *t = findKey(r.text, r.len, "\"unixTime\":"))
+  {
+    lastUs_ = strtoull(t, nullptr, 10) * 1000000ULL;
+    r.timed = true;
+  }
+  r.timeUs = lastUs_;
+  return true;
+}
+
+bool CaptureReader::next(CaptureRecord &r, uint32_t periodMs)
+{
+  while (pos_ < data_.size())
+  {
+    if (skipFrame())
+      continue;
+    const char *line = data_.data() + pos_;
+    size_t left = data_.size() - pos_;
+    const char *nl = (const char *)memchr(line, '\n', left);
+    size_t len = nl ? nl - line : left;
+    pos_ += nl ? len + 1 : len;
+    while (len && (line[len - 1] == '\r' || line[len - 1] == ' '))
+      len--;
+    if (!len)
+      continue;
+    stats_.lines++;
+    if (!parseLine(line, len, r))
+    {
+      stats_.skipped++;
+      continue;
+    }
+    if (!r.timed)
+    {
+      lastUs_ += (uint64_t)periodMs * 1000;
+      r.timeUs = lastUs_;
+    }
+    stats_.records++;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <vector>
+
+// Reads a capture of the master's serial uplink back into the packets the
+// master received. A capture is what the serial port produced, saved to a
+// file: text lines, possibly with binary frames (serial_frame.h: logs,
+// metrics, roster, ...) between them. Frames are checked and skipped;
+// the lines that carry a client packet become records:
+//   [MASTER] RX from <node id>: <packet>      the master's uplink line
+//   {"device_id":"<mac>",...}                 a bare report, as in
+//   {"mac":"<mac>",...}                       serial_python/data.json
+// A bare report's sender is the node id painlessMesh derives from its MAC.
+// Anything else (log text, the master's own JSON lines) is skipped.
+struct CaptureRecord
+{
+  uint32_t from;    // sender's node id (0 when the report names no MAC)
+  uint64_t timeUs;  // capture clock; see CaptureReader::next
+  bool timed;       // timeUs came from the packet, not from the record index
+  const char *text; // the packet, not terminated
+  size_t len;
+};
+
+struct CaptureStats
+{
+  uint32_t lines = 0;     // text lines read
+  uint32_t records = 0;   // lines that became records
+  uint32_t skipped = 0;   // lines that did not
+  uint32_t frames = 0;    // binary frames skipped
+  uint32_t badFrames = 0; // sync bytes without a valid frame after them
+};
+
+class CaptureReader
+{
+public:
+  // Reads the whole file; false if it cannot be read
+  bool open(const char *path);
+  // For captures already in memory
+  void assign(const char *data, size_t len);
+  // The next record, false at the end. Record times come from the packet's
+  // "ts":[created,queued,sent] (sent, in mesh us, unwrapped past 32 bits),
+  // or a legacy "unixTime" in seconds; otherwise records are periodMs apart.
+  bool next(CaptureRecord &r, uint32_t periodMs);
+  void rewind();
+  const CaptureStats &stats() const { return stats_; }
+  // Called with each valid frame's type and payload as next() steps over it
+  std::function<void(uint8_t type, const uint8_t *payload, size_t len)> onFrame;
+  size_t size() const { return data_.size(); }
+
+private:
+  bool skipFrame();
+  bool parseLine(const char *line, size_t len, CaptureRecord &r);
+
+  std::vector<char> data_;
+  size_t pos_ = 0;
+  uint64_t lastUs_ = 0;
+  uint32_t lastMeshUs_ = 0;
+  bool haveMeshUs_ = false;
+  CaptureStats stats_;
+};
@@ -0,0 +1,186 @@
+// Duplicate suppression benchmark (include/dedupe.h): a replay of report
+// keys as ingestReport builds them, (node id ^ boot id, seq), from many
+// nodes in arrival order. Some reports come again shortly after (a retry
+// whose ACK was lost), a few much later (a relay flushing a stale queue).
+// Every key goes through the filter and through an exact set; the
+// differences are the filter's errors:
+//   false positive  a new report taken for a copy, and dropped
+//   missed          a copy let through
+// A copy is only expected to be caught while its original is within the
+// filter's horizon (capacity(): keys per Bloom generation). The
+// firmware's configuration (master_ingest.h) runs first, then other sizes
+// and error budgets for comparison.
+//
+//   dbench [--messages N] [--nodes N] [--dup P] [--late P] [--seed S]
+//
+// Exit status: 0 ok, 1 a copy within the horizon was missed, or false
+// positives well above the configured rate, 2 bad arguments.
+#include "master_ingest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+struct Options
+{
+  uint32_t messages = 1000000;
+  uint32_t nodes = 40;
+  double dup = 0.05;   // re-delivered within 200 messages
+  double late = 0.002; // re-delivered up to 200k messages later
+  uint32_t seed = 1;
+};
+
+struct Result
+{
+  uint64_t fresh = 0, copies = 0, falsePos = 0, missed = 0, missedInHorizon = 0;
+  uint32_t capacity = 0, rotations = 0;
+  uint8_t hashes = 0;
+  double ns = 0;
+};
+
+// The arrival order: each node's reports in sequence, copies mixed in later
+static std::vector<uint64_t> makeStream(const Options &opt)
+{
+  std::mt19937 rng(opt.seed);
+  std::uniform_real_distribution<double> u(0, 1);
+  std::vector<uint32_t> node(opt.nodes), boot(opt.nodes), seq(opt.nodes);
+  for (uint32_t i = 0; i < opt.nodes; i++)
+  {
+    node[i] = 0x10000000 + rng() % 0x70000000;
+    boot[i] = rng();
+  }
+  std::vector<std::vector<uint64_t>> later(opt.messages + 1);
+  std::vector<uint64_t> out;
+  out.reserve(opt.messages);
+  for (uint32_t t = 0; out.size() < opt.messages; t++)
+  {
+    if (t < later.size())
+    {
+      for (uint64_t k : later[t])
+        if (out.size() < opt.messages)
+          out.push_back(k);
+      std::vector<uint64_t>().swap(later[t]);
+    }
+    if (out.size() >= opt.messages)
+      break;
+    uint32_t i = rng() % opt.nodes;
+    uint64_t k = DedupeFilter<4, 64>::key(node[i] ^ boot[i], ++seq[i]);
+    out.push_back(k);
+    uint32_t again = 0;
+    if (u(rng) < opt.dup)
+      again = 1 + rng() % 200;
+    else if (u(rng) < opt.late)
+      again = 1000 + rng() % 200000;
+    if (again && t + again < later.size())
+      later[t + again].push_back(k);
+  }
+  return out;
+}
+
+template <uint16_t LRU, uint32_t BITS>
+static Result run(const std::vector<uint64_t> &stream, uint32_t fpPpm)
+{
+  static DedupeFilter<LRU, BITS> filter(fpPpm); // static: large at the top sizes
+  filter = DedupeFilter<LRU, BITS>(fpPpm);
+  Result r;
+  r.hashes = filter.hashes();
+  r.capacity = filter.capacity();
+
+  // Timed alone, then again against the exact set
+  auto t0 = std::chrono::steady_clock::now();
+  uint64_t hits = 0;
+  for (uint64_t k : stream)
+    hits += filter.seen(k);
+  r.ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / stream.size();
+  (void)hits;
+
+  filter = DedupeFilter<LRU, BITS>(fpPpm);
+  std::unordered_map<uint64_t, uint64_t> firstAt; // key -> filter inserts when it was first taken in
+  firstAt.reserve(stream.size());
+  uint64_t inserts = 0;
+  for (uint64_t k : stream)
+  {
+    bool seen = filter.seen(k);
+    auto it = firstAt.find(k);
+    if (it == firstAt.end())
+    {
+      r.fresh++;
+      if (seen)
+        r.falsePos++;
+      firstAt.emplace(k, seen ? UINT64_MAX : inserts); // a false positive was never inserted
+      inserts += !seen;
+      continue;
+    }
+    r.copies++;
+    if (seen)
+      continue;
+    r.missed++;
+    inserts++;
+    if (it->second != UINT64_MAX && inserts - it->second <= r.capacity)
+      r.missedInHorizon++;
+  }
+  r.rotations = filter.rotations();
+  return r;
+}
+
+static bool print(const char *name, size_t memory, uint32_t fpPpm, const Result &r)
+{
+  double ppm = r.fresh ? 1e6 * r.falsePos / r.fresh : 0;
+  printf("%-10s %7zu %5u %3u %8u %8.1f %8llu %8llu %9llu %7.1f\n", name, memory, fpPpm, r.hashes, r.capacity, ppm,
+         (unsigned long long)r.copies, (unsigned long long)r.missed, (unsigned long long)r.missedInHorizon, r.ns);
+  // Poisson slack: twice the budget, plus room for a handful at small counts
+  double allowed = 2.0 * fpPpm * r.fresh / 1e6 + 10;
+  return !r.missedInHorizon && r.falsePos <= allowed;
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: dbench [--messages N] [--nodes N] [--dup P] [--late P] [--seed S]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  Options opt;
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    if (i + 1 >= argc)
+      usage();
+    const char *v = argv[++i];
+    if (!strcmp(a, "--messages"))
+      opt.messages = strtoul(v, nullptr, 10);
+    else if (!strcmp(a, "--nodes"))
+      opt.nodes = strtoul(v, nullptr, 10);
+    else if (!strcmp(a, "--dup"))
+      opt.dup = atof(v);
+    else if (!strcmp(a, "--late"))
+      opt.late = atof(v);
+    else if (!strcmp(a, "--seed"))
+      opt.seed = strtoul(v, nullptr, 10);
+    else
+      usage();
+  }
+  if (!opt.messages || !opt.nodes)
+    usage();
+
+  std::vector<uint64_t> stream = makeStream(opt);
+  printf("%zu messages from %u nodes, %.1f%% re-delivered within 200, %.2f%% up to 200k later\n\n",
+         stream.size(), opt.nodes, opt.dup * 100, opt.late * 100);
+  printf("filter      bytes   ppm   k  horizon  fp ppm   copies   missed  in hrzn   ns/msg\n");
+  bool ok = true;
+  ok &= print("firmware", DedupeFilter<DEDUPE_LRU, DEDUPE_BLOOM_BITS>::memoryBytes(), DEDUPE_FP_PPM,
+              run<DEDUPE_LRU, DEDUPE_BLOOM_BITS>(stream, DEDUPE_FP_PPM));
+  ok &= print("8K 10", DedupeFilter<256, 8192>::memoryBytes(), 10, run<256, 8192>(stream, 10));
+  ok &= print("32K 1", DedupeFilter<256, 32768>::memoryBytes(), 1, run<256, 32768>(stream, 1));
+  ok &= print("32K 100", DedupeFilter<256, 32768>::memoryBytes(), 100, run<256, 32768>(stream, 100));
+  ok &= print("128K 10", DedupeFilter<256, 131072>::memoryBytes(), 10, run<256, 131072>(stream, 10));
+  ok &= print("1M 10", DedupeFilter<1024, 1048576>::memoryBytes(), 10, run<1024, 1048576>(stream, 10));
+  printf("\nhorizon: keys per Bloom generation; a copy of anything newer is always caught\n");
+  if (!ok)
+    printf("FAIL: a copy within the horizon got through, or false positives over twice the budget\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+// Master replay: pushes a serial capture through the master's ingest path
+// on the host and reports throughput, per-stage latency and whether the
+// uplink output matches a golden file.
+//
+//   replay <capture> [--speed max|<N>] [--period-ms <ms>] [--passes <n>]
+//          [--golden <file> | --write-golden <file>] [--out <file>]
+//
+// --speed 1 keeps the capture's timing, N runs N times faster, max (the
+// default) runs flat out; --passes repeats a max-speed run for steadier
+// numbers. Exit status: 0 ok, 1 output differs from the golden file,
+// 2 bad arguments or unreadable files.
+#include "replay.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage()
+{
+  fprintf(stderr, "usage: replay <capture> [--speed max|<N>] [--period-ms <ms>] [--passes <n>]\n"
+                  "              [--golden <file> | --write-golden <file>] [--out <file>]\n");
+  exit(2);
+}
+
+static bool readFile(const char *path, std::string &out)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+  char buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    out.append(buf, n);
+  bool ok = !ferror(f);
+  fclose(f);
+  return ok;
+}
+
+static bool writeFile(const char *path, const std::string &data)
+{
+  FILE *f = fopen(path, "wb");
+  if (!f)
+    return false;
+  bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+  return fclose(f) == 0 && ok;
+}
+
+int main(int argc, char **argv)
+{
+  const char *capturePath = nullptr, *golden = nullptr, *writeGolden = nullptr, *out = nullptr;
+  ReplayOptions opt;
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (!strcmp(a, "--speed") && hasValue)
+    {
+      const char *v = argv[++i];
+      opt.speed = strcmp(v, "max") ? atof(v) : 0;
+      if (strcmp(v, "max") && opt.speed <= 0)
+        usage();
+    }
+    else if (!strcmp(a, "--period-ms") && hasValue)
+      opt.periodMs = strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(a, "--passes") && hasValue)
+      opt.passes = strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(a, "--golden") && hasValue)
+      golden = argv[++i];
+    else if (!strcmp(a, "--write-golden") && hasValue)
+      writeGolden = argv[++i];
+    else if (!strcmp(a, "--out") && hasValue)
+      out = argv[++i];
+    else if (a[0] != '-' && !capturePath)
+      capturePath = a;
+    else
+      usage();
+  }
+  if (!capturePath || (golden && writeGolden))
+    usage();
+
+  CaptureReader reader;
+  if (!reader.open(capturePath))
+  {
+    fprintf(stderr, "replay: cannot read %s\n", capturePath);
+    return 2;
+  }
+  std::string uplink;
+  ReplayResult res = replay(reader, opt, uplink);
+
+  const CaptureStats &c = res.capture;
+  printf("capture   %s: %zu bytes, %u lines, %u records, %u skipped, %u frames (%u bad sync)\n", capturePath,
+         reader.size(), c.lines, c.records, c.skipped, c.frames, c.badFrames);
+  printf("ingest    %llu records, %llu forwarded, %llu duplicates\n", (unsigned long long)res.records,
+         (unsigned long long)res.forwarded, (unsigned long long)res.duplicates);
+  if (res.wallS > 0)
+    printf("speed     %s: %.3f s, %.0f records/s, %.2f MB/s\n", opt.speed > 0 ? "paced" : "max", res.wallS,
+           res.records / res.wallS, res.bytes / res.wallS / 1e6);
+  if (opt.speed > 0)
+    printf("lag       max %.3f ms behind the capture's timing\n", res.maxLagUs / 1000.0);
+  printf("stage         mean      p50      p99      max  (ns per record)\n");
+  uint64_t totalNs = 0;
+  for (uint8_t s = 0; s < STAGE_COUNT; s++)
+  {
+    StageTimes &st = res.stages[s];
+    uint64_t mean = st.ns.empty() ? 0 : st.totalNs / st.ns.size();
+    totalNs += mean;
+    printf("%-8s %9llu %8u %8u %8u\n", STAGE_NAMES[s], (unsigned long long)mean, st.percentile(50),
+           st.percentile(99), st.percentile(100));
+  }
+  printf("total    %9llu\n", (unsigned long long)totalNs);
+
+  if (out && !writeFile(out, uplink))
+  {
+    fprintf(stderr, "replay: cannot write %s\n", out);
+    return 2;
+  }
+  if (writeGolden)
+  {
+    if (!writeFile(writeGolden, uplink))
+    {
+      fprintf(stderr, "replay: cannot write %s\n", writeGolden);
+      return 2;
+    }
+    printf("golden    written to %s\n", writeGolden);
+  }
+  if (golden)
+  {
+    std::string expected;
+    if (!readFile(golden, expected))
+    {
+      fprintf(stderr, "replay: cannot read %s\n", golden);
+      return 2;
+    }
+    std::string got, want;
+    size_t line = firstDifference(uplink, expected, &got, &want);
+    if (line)
+    {
+      printf("golden    DIFFERS at line %zu\n  got:  %s\n  want: %s\n", line, got.c_str(), want.c_str());
+      return 1;
+    }
+    printf("golden    matches %s\n", golden);
+  }
+  return 0;
+}
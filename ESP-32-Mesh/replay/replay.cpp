@@ -0,0 +1,138 @@
+#include "replay.h"
+#include "master_ingest.h"
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// Firmware symbols the ingest path links against
+Counter dedupeDropped, zRefused;
+void logCommit(LogRecord &) {} // log levels are compile-time; nothing is sent
+
+const char *const STAGE_NAMES[STAGE_COUNT] = {"decode", "touch", "ingest", "uplink"};
+
+typedef std::chrono::steady_clock Clock;
+
+static uint32_t nsSince(Clock::time_point &t)
+{
+  Clock::time_point now = Clock::now();
+  uint32_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - t).count();
+  t = now;
+  return ns;
+}
+
+uint32_t StageTimes::percentile(double pct)
+{
+  if (ns.empty())
+    return 0;
+  size_t i = (size_t)(pct / 100 * (ns.size() - 1) + 0.5);
+  std::nth_element(ns.begin(), ns.begin() + i, ns.end());
+  return ns[i];
+}
+
+void replayReset()
+{
+  roster.clear();
+  dedupe.clear();
+  latency.clear();
+  dedupeDropped.value = 0;
+  zRefused.value = 0;
+}
+
+ReplayResult replay(CaptureReader &reader, const ReplayOptions &opt, std::string &uplink)
+{
+  ReplayResult res;
+  uint32_t passes = opt.speed > 0 ? 1 : std::max<uint32_t>(opt.passes, 1);
+  static FixedString<UPLINK_LINE_MAX> line;
+  Clock::time_point start = Clock::now();
+  for (uint32_t pass = 0; pass < passes; pass++)
+  {
+    replayReset();
+    reader.rewind();
+    uint64_t firstUs = 0, paceUs = 0;
+    bool first = true;
+    for (;;)
+    {
+      Clock::time_point t = Clock::now();
+      CaptureRecord r;
+      if (!reader.next(r, opt.periodMs))
+        break;
+      uint32_t decodeNs = nsSince(t);
+      if (first)
+      {
+        firstUs = paceUs = r.timeUs;
+        first = false;
+      }
+      if (opt.speed > 0)
+      {
+        // Paced: wait for the record's time in the capture, scaled. The
+        // capture is in arrival order, so a stamp older than the last one
+        // (a retried copy, another node's clock) goes out right after it.
+        paceUs = std::max(paceUs, r.timeUs);
+        Clock::time_point due = start + std::chrono::microseconds((uint64_t)((paceUs - firstUs) / opt.speed));
+        if (due > Clock::now())
+          std::this_thread::sleep_until(due);
+        else
+        {
+          uint64_t lag = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - due).count();
+          res.maxLagUs = std::max(res.maxLagUs, lag);
+        }
+        t = Clock::now();
+      }
+      res.stages[STAGE_DECODE].add(decodeNs);
+      uint32_t arrival = (uint32_t)r.timeUs; // mesh time wraps at 32 bits, as on the master
+      RosterEntry &node = ingestTouch(r.from, (uint32_t)(r.timeUs / 1000), r.len, 0);
+      res.stages[STAGE_TOUCH].add(nsSince(t));
+      size_t len = r.len;
+      const char *text = ingestUnpack(r.text, len);
+      bool forward = text && ingestReport(node, text, len, arrival);
+      res.stages[STAGE_INGEST].add(nsSince(t));
+      if (forward)
+      {
+        formatUplink(line, r.from, text, len);
+        if (pass == 0)
+          uplink.append(line.c_str(), line.length());
+        res.forwarded++;
+      }
+      res.stages[STAGE_UPLINK].add(nsSince(t));
+      res.records++;
+      res.bytes += r.len;
+    }
+    res.duplicates += dedupeDropped.get();
+  }
+  res.wallS = std::chrono::duration<double>(Clock::now() - start).count();
+  res.capture = reader.stats();
+  return res;
+}
+
+static bool nextLine(const std::string &s, size_t &pos, std::string &out)
+{
+  if (pos >= s.size())
+    return false;
+  size_t nl = s.find('\n', pos);
+  size_t end = nl == std::string::npos ? s.size() : nl;
+  out.assign(s, pos, end - pos);
+  pos = nl == std::string::npos ? s.size() : nl + 1;
+  return true;
+}
+
+size_t firstDifference(const std::string &a, const std::string &b, std::string *lineA, std::string *lineB)
+{
+  size_t pa = 0, pb = 0, n = 0;
+  std::string la, lb;
+  for (;;)
+  {
+    bool ha = nextLine(a, pa, la), hb = nextLine(b, pb, lb);
+    n++;
+    if (!ha && !hb)
+      return 0;
+    if (ha != hb || la != lb)
+    {
+      if (lineA)
+        *lineA = ha ? la : "<end>";
+      if (lineB)
+        *lineB = hb ? lb : "<end>";
+      return n;
+    }
+  }
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "capture.h"
+
+// Replays a capture through the master's ingest path, built natively from
+// the firmware's own src/master_ingest.cpp: the same roster, duplicate
+// filter and latency code, and the same uplink line. Only painlessMesh
+// and the UART are missing; the uplink lines are collected instead.
+//
+// Stages, each timed per record:
+//   decode  capture line -> (sender, packet, time)
+//   touch   roster entry for the sender (ingestTouch)
+//   ingest  report parsing, duplicate check, latency (ingestReport)
+//   uplink  the "[MASTER] RX from" line for the gateway (formatUplink)
+enum ReplayStage : uint8_t
+{
+  STAGE_DECODE,
+  STAGE_TOUCH,
+  STAGE_INGEST,
+  STAGE_UPLINK,
+  STAGE_COUNT
+};
+
+struct ReplayOptions
+{
+  double speed = 0;        // 0: as fast as possible; 1: capture timing; N: N times faster
+  uint32_t periodMs = 100; // spacing of records the capture gives no time for
+  uint32_t passes = 1;     // max speed only; the master state is reset between passes
+};
+
+// Per-record stage times in ns
+struct StageTimes
+{
+  std::vector<uint32_t> ns;
+  uint64_t totalNs = 0;
+
+  void add(uint32_t t)
+  {
+    ns.push_back(t);
+    totalNs += t;
+  }
+  // pct in 0..100; sorts the samples
+  uint32_t percentile(double pct);
+};
+
+struct ReplayResult
+{
+  uint64_t records = 0;
+  uint64_t forwarded = 0;  // reached the uplink
+  uint64_t duplicates = 0; // dropped by the duplicate filter
+  uint64_t bytes = 0;      // packet bytes ingested
+  double wallS = 0;
+  uint64_t maxLagUs = 0; // paced runs: furthest behind the capture's timing
+  StageTimes stages[STAGE_COUNT];
+  CaptureStats capture;
+};
+
+extern const char *const STAGE_NAMES[STAGE_COUNT];
+
+// Master ingest state back to boot
+void replayReset();
+// Runs the whole capture; uplink lines are appended to `uplink`
+ReplayResult replay(CaptureReader &reader, const ReplayOptions &opt, std::string &uplink);
+// First line where `a` and `b` differ (1-based), 0 if they are equal
+size_t firstDifference(const std::string &a, const std::string &b, std::string *lineA, std::string *lineB);
@@ -0,0 +1,190 @@
+// Packing benchmark: takes every report in a serial capture and packs it
+// as a client would (include/compress.h), once without and once with the
+// static dictionary, and binary frames as the master would: those in the
+// capture, and the roster and link-health dumps the replayed master holds
+// at its end (replay.h). Prints what would go over the mesh and the
+// serial link, and the time taken per byte (TSC cycles on x86, else ns).
+// Every packed report and frame is unpacked again and compared with the
+// original.
+//
+//   zbench <capture> [--passes <n>]
+//
+// Exit status: 0 ok, 1 something did not unpack to its original, 2 bad
+// arguments or unreadable files.
+#include "replay.h"
+#include "master_ingest.h"
+#include "compress_dict.h"
+#include "mesh_msg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#define SERIAL_FRAME_MAX_HOST 8192 // over main_testing.cpp's SERIAL_FRAME_MAX
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define ZB_UNIT "cyc"
+static uint64_t ticks() { return __rdtsc(); }
+#else
+#define ZB_UNIT "ns"
+static uint64_t ticks()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+#endif
+
+struct Row
+{
+  uint64_t items = 0, packed = 0; // packed: sent packed, because that was shorter
+  uint64_t raw = 0, stream = 0, wire = 0;
+  uint64_t encTicks = 0, decTicks = 0;
+  bool ok = true;
+};
+
+static void usage()
+{
+  fprintf(stderr, "usage: zbench <capture> [--passes <n>]\n");
+  exit(2);
+}
+
+// One Z: line per report, as packReport() and ingestUnpack() handle them
+static Row reports(const std::vector<std::string> &in, const ZDict &dict, uint32_t passes)
+{
+  static ZEncoder enc;
+  static FixedString<MESH_JSON_MAX> line;
+  static char text[MESH_JSON_MAX + 1];
+  Row r;
+  for (uint32_t pass = 0; pass < passes; pass++)
+    for (const std::string &s : in)
+    {
+      uint64_t t0 = ticks();
+      bool packed = zPackLine(enc, s.data(), s.size(), dict, line);
+      uint64_t t1 = ticks();
+      if (pass)
+      {
+        r.encTicks += t1 - t0;
+        continue;
+      }
+      r.items++;
+      r.raw += s.size();
+      r.encTicks += t1 - t0;
+      if (!packed)
+      {
+        r.wire += s.size();
+        continue;
+      }
+      r.packed++;
+      r.wire += line.length();
+      ZLine z = {};
+      t0 = ticks();
+      size_t n = parseZLine(line.c_str() + 2, line.length() - 2, z) ? zUnpackLine(z, text, MESH_JSON_MAX, dict) : Z_BAD;
+      r.decTicks += ticks() - t0;
+      r.stream += z.dataLen * 6 / 8;
+      if (n != s.size() || memcmp(text, s.data(), n))
+        r.ok = false;
+    }
+  return r;
+}
+
+// Frame payloads as sendFrame() packs them: no dictionary
+static Row frames(const std::vector<std::string> &in, uint32_t passes)
+{
+  static ZEncoder enc;
+  std::vector<uint8_t> out, back;
+  Row r;
+  for (uint32_t pass = 0; pass < passes; pass++)
+    for (const std::string &s : in)
+    {
+      out.resize(s.size());
+      back.resize(s.size());
+      uint64_t t0 = ticks();
+      size_t n = s.size() > 3 ? enc.compress((const uint8_t *)s.data(), s.size(), out.data(), s.size() - 3) : 0;
+      uint64_t t1 = ticks();
+      r.encTicks += t1 - t0;
+      if (pass)
+        continue;
+      r.items++;
+      r.raw += s.size();
+      if (!n)
+      {
+        r.wire += s.size();
+        continue;
+      }
+      r.packed++;
+      r.stream += n;
+      r.wire += 2 + n;
+      t0 = ticks();
+      size_t m = zDecompress(out.data(), n, back.data(), back.size());
+      r.decTicks += ticks() - t0;
+      if (m != s.size() || memcmp(back.data(), s.data(), m))
+        r.ok = false;
+    }
+  return r;
+}
+
+static void print(const char *name, const Row &r, uint32_t passes)
+{
+  printf("%-18s %7llu %6.1f%% %10llu %10llu %6.3f %10llu %6.3f %8.1f %8.1f\n", name, (unsigned long long)r.items,
+         r.items ? 100.0 * r.packed / r.items : 0, (unsigned long long)r.raw, (unsigned long long)r.stream,
+         r.raw ? (double)r.stream / r.raw : 0, (unsigned long long)r.wire, r.raw ? (double)r.wire / r.raw : 0,
+         r.raw ? (double)r.encTicks / passes / r.raw : 0, r.raw ? (double)r.decTicks / r.raw : 0);
+}
+
+int main(int argc, char **argv)
+{
+  const char *capturePath = nullptr;
+  uint32_t passes = 3;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--passes") && i + 1 < argc)
+      passes = strtoul(argv[++i], nullptr, 10);
+    else if (argv[i][0] != '-' && !capturePath)
+      capturePath = argv[i];
+    else
+      usage();
+  }
+  if (!capturePath || !passes)
+    usage();
+
+  CaptureReader reader;
+  if (!reader.open(capturePath))
+  {
+    fprintf(stderr, "zbench: cannot read %s\n", capturePath);
+    return 2;
+  }
+  std::vector<std::string> reps, frms;
+  reader.onFrame = [&](uint8_t, const uint8_t *p, size_t len)
+  { frms.emplace_back((const char *)p, len); };
+  CaptureRecord rec;
+  while (reader.next(rec, 1000))
+    if (rec.len <= MESH_JSON_MAX)
+      reps.emplace_back(rec.text, rec.len);
+
+  reader.onFrame = nullptr;
+  std::string uplink;
+  replay(reader, ReplayOptions(), uplink);
+  std::vector<std::string> dumps;
+  static uint8_t dump[SERIAL_FRAME_MAX_HOST];
+  dumps.emplace_back((const char *)dump, roster.writeBinary(dump, sizeof(dump), 0));
+  dumps.emplace_back((const char *)dump, roster.writeHealth(dump, sizeof(dump)));
+
+  printf("capture   %s: %zu reports, %zu frames, %u nodes in the roster\n", capturePath, reps.size(), frms.size(),
+         (unsigned)roster.size());
+  printf("dictionary %u bytes, id %04x\n\n", ZDICT_REPORTS.len, ZDICT_REPORTS.id);
+  printf("%-18s %7s %7s %10s %10s %6s %10s %6s %8s %8s\n", "", "items", "packed", "raw B", "stream B", "ratio",
+         "wire B", "wire", ZB_UNIT "/B enc", ZB_UNIT "/B dec");
+  Row plain = reports(reps, Z_NO_DICT, passes), dict = reports(reps, ZDICT_REPORTS, passes),
+      frame = frames(frms, passes), dumped = frames(dumps, passes);
+  print("reports", plain, passes);
+  print("reports + dict", dict, passes);
+  print("capture frames", frame, passes);
+  print("roster + health", dumped, passes);
+  if (!plain.ok || !dict.ok || !frame.ok || !dumped.ok)
+  {
+    printf("\nFAILED: something did not unpack to its original\n");
+    return 1;
+  }
+  return 0;
+}
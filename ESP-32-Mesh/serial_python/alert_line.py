@@ -0,0 +1,31 @@
+import re
+import zlib
+
+
+def alert_line(row):
+    """ALERT:<id>:<severity>:<ttl s>:<target>:<text> for the master's bridge.
+
+    Built from a sos_alerts row. The target is a circle when the row has
+    latitude/longitude/radius_m, a polygon when it has "polygon"
+    ([[lat, lon], ...], 3 to 8 corners), and everyone otherwise.
+    Coordinates go out in 1e-7 degrees. Both gateways (create_serial.py,
+    read_serial.py) send alerts through this.
+
+    Raises ValueError for a row Alert::parse on the master would reject:
+    that line would go out to everyone as a legacy severity-3 alert.
+    """
+    alert_id = zlib.crc32(str(row["id"]).encode()) or 1
+    severity = 3 if row.get("severity") in (None, "") else int(row["severity"])
+    if not 0 <= severity <= 3:
+        raise ValueError(f"alert {row['id']}: severity {severity} is not 0-3")
+    ttl = min(int(row.get("ttl_s") or 1800), 3600)
+    if row.get("polygon"):
+        if len(row["polygon"]) < 3:
+            raise ValueError(f"alert {row['id']}: polygon has {len(row['polygon'])} corners, needs 3")
+        target = "P" + ",".join(f"{round(lat * 1e7)},{round(lon * 1e7)}" for lat, lon in row["polygon"][:8])
+    elif row.get("latitude") is not None and row.get("radius_m"):
+        target = f"C{round(row['latitude'] * 1e7)},{round(row['longitude'] * 1e7)},{int(row['radius_m'])}"
+    else:
+        target = "*"
+    text = re.sub(r"[^ -~]", "", str(row["message"]))[:150]
+    return f"ALERT:{alert_id:x}:{severity}:{ttl}:{target}:{text}\n"
@@ -1,8 +1,10 @@
 import os
 from supabase import create_client, Client
-import serial, time, re
+import serial, time
 import ast
 
+from alert_line import alert_line
+
 ser = serial.Serial('COM5', 115200, timeout=1)
 time.sleep(2) 
 
@@ -14,12 +16,16 @@ response = (supabase.table("sos_alerts")).select("*").order("created_at", desc=T
 
 last = response.data[0]["id"]
 
+
 while True:
     new_response = (supabase.table("sos_alerts")).select("*").order("created_at", desc=True).execute()
     if last == new_response.data[0]["id"]:
         pass
     else:
-        ser.write(new_response.data[0]["message"])
+        try:
+            ser.write(alert_line(new_response.data[0]).encode())
+        except ValueError as e:
+            print("Alert not sent:", e)
         last = new_response.data[0]["id"]
         
     
@@ -0,0 +1,40 @@
+import struct
+import sys
+import serial
+
+from metrics_dump import PORT, BAUD, read_frame
+
+FRAME_HEALTH = 0x05
+ENTRY = struct.Struct("<IIIIIIIIIIHHHH")
+FIELDS = ("node_id", "boot", "highest_seq", "received", "lost", "pending", "duplicates",
+          "reordered", "stale", "bursts", "max_burst", "open_burst", "restarts", "delivery_bp")
+
+
+def decode_health(payload: bytes):
+    version, count = struct.unpack_from("<BH", payload, 0)
+    if version != 1:
+        raise ValueError(f"unknown health version {version}")
+    return [dict(zip(FIELDS, ENTRY.unpack_from(payload, 3 + i * ENTRY.size))) for i in range(count)]
+
+
+def main():
+    # The master also sends this frame on its own every HEALTH_REPORT_S
+    port = sys.argv[1] if len(sys.argv) > 1 else PORT
+    with serial.Serial(port, BAUD, timeout=0.1) as ser:
+        ser.write(b"!health\n")
+        payload = read_frame(ser, FRAME_HEALTH)
+    if payload is None:
+        print("No health frame received (only the master keeps one)")
+        return
+    nodes = decode_health(payload)
+    print(f"{len(nodes)} nodes")
+    for n in sorted(nodes, key=lambda n: n["delivery_bp"]):
+        mean_burst = n["lost"] / n["bursts"] if n["bursts"] else 0
+        print(f"{n['node_id']:>10} delivery {n['delivery_bp'] / 100:6.2f}% "
+              f"rx={n['received']} lost={n['lost']} pending={n['pending']} dup={n['duplicates']} "
+              f"reord={n['reordered']} stale={n['stale']} bursts={n['bursts']} "
+              f"(mean {mean_burst:.1f}, max {n['max_burst']}) restarts={n['restarts']} seq={n['highest_seq']}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,104 @@
+import json
+import re
+import struct
+import sys
+import serial
+
+from metrics_dump import PORT, BAUD
+from serial_frame import UplinkSplitter
+
+# ------------------ CONFIG ------------------
+# Written by the firmware build (pio/scripts/log_table.py)
+TABLE = "../pio/.pio/build/esp32dev/log_formats.json"
+# --------------------------------------------
+
+FRAME_LOG = 0x03
+SPEC = re.compile(r"%([-+ #0]*)(\d+|\*)?(\.\d+)?(hh|h|ll|l|z|j|t|L)?([diouxXcsfFeEgGaAp%])")
+
+
+def render(fmt, data):
+    """Formats `data` (raw argument bytes) the way printf would format `fmt`."""
+    out, pos, last = [], 0, 0
+    for m in SPEC.finditer(fmt):
+        out.append(fmt[last:m.start()])
+        last = m.end()
+        flags, width, prec, length, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        spec = "%" + flags + (width or "") + (prec or "")
+        try:
+            if conv == "s":
+                n = data[pos]
+                out.append((spec + "s") % data[pos + 1:pos + 1 + n].decode("utf-8", errors="replace"))
+                pos += 1 + n
+            elif conv in "fFeEgGaA":
+                (v,) = struct.unpack_from("<d", data, pos)
+                pos += 8
+                out.append((spec + (conv if conv not in "aA" else "e")) % v)
+            else:
+                size = 8 if length == "ll" else 4
+                (v,) = struct.unpack_from("<q" if size == 8 else "<i", data, pos) if conv in "di" else \
+                    struct.unpack_from("<Q" if size == 8 else "<I", data, pos)
+                pos += size
+                if conv == "p":
+                    out.append("0x%08x" % v)
+                else:
+                    out.append((spec + {"u": "d", "i": "d"}.get(conv, conv)) % v)
+        except (IndexError, struct.error):
+            out.append("<cut>")
+            return "".join(out)
+    out.append(fmt[last:])
+    return "".join(out)
+
+
+def decode_records(payload, table):
+    """Yields text lines for one FRAME_LOG payload."""
+    (lost,) = struct.unpack_from("<I", payload, 0)
+    pos = 4
+    while pos < len(payload):
+        length = payload[pos]
+        if length < 9 or pos + length > len(payload):
+            break
+        fmt_id, ms = struct.unpack_from("<II", payload, pos + 1)
+        args = payload[pos + 9:pos + length]
+        pos += length
+        entry = table.get(f"{fmt_id:08x}")
+        if entry is None:
+            yield f"[{ms / 1000:10.3f}] ? unknown format {fmt_id:08x} ({args.hex()})"
+            continue
+        text = render(entry["fmt"], args).rstrip("\n")
+        yield f"[{ms / 1000:10.3f}] {entry['level']} {entry['module']:<6} {text}"
+    if lost:
+        yield f"({lost} records dropped on the device so far)"
+
+
+def frames(stream):
+    """Yields (type, payload) for every valid frame; text in between is skipped."""
+    split = UplinkSplitter()
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            if not isinstance(stream, serial.Serial):
+                return
+            continue
+        for ftype, payload in split.feed(chunk):
+            if ftype is not None:
+                yield ftype, payload
+
+
+def main():
+    # log_decode.py [PORT | capture.bin] [log_formats.json]
+    src = sys.argv[1] if len(sys.argv) > 1 else PORT
+    with open(sys.argv[2] if len(sys.argv) > 2 else TABLE) as f:
+        table = json.load(f)
+    stream = open(src, "rb") if src.endswith(".bin") else serial.Serial(src, BAUD, timeout=0.1)
+    with stream:
+        for ftype, payload in frames(stream):
+            if ftype == FRAME_LOG:
+                for line in decode_records(payload, table):
+                    print(line)
+
+
+if __name__ == "__main__":
+    main()
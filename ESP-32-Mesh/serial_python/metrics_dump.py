@@ -0,0 +1,68 @@
+import struct
+import sys
+import time
+import serial
+
+from serial_frame import FRAME_METRICS, UplinkSplitter
+
+# ------------------ CONFIG ------------------
+PORT = "COM5"
+BAUD = 115200
+TIMEOUT_S = 3
+# --------------------------------------------
+
+HIST_BUCKETS = 16
+KINDS = {0: "counter", 1: "gauge", 2: "histogram"}
+
+
+def read_frame(ser, want_type):
+    """Skip text lines and other frames until a valid frame of `want_type` arrives."""
+    split = UplinkSplitter()
+    deadline = time.time() + TIMEOUT_S
+    while time.time() < deadline:
+        for ftype, payload in split.feed(ser.read(ser.in_waiting or 1)):
+            if ftype == want_type:
+                return payload
+
+
+def decode_metrics(payload: bytes):
+    version, count = payload[0], payload[1]
+    if version != 1:
+        raise ValueError(f"unknown snapshot version {version}")
+    pos = 2
+    out = []
+    for _ in range(count):
+        kind, name_len = payload[pos], payload[pos + 1]
+        pos += 2
+        name = payload[pos:pos + name_len].decode("ascii", errors="replace")
+        pos += name_len
+        if kind == 2:
+            values = struct.unpack_from(f"<{HIST_BUCKETS + 2}I", payload, pos)
+            pos += 4 * (HIST_BUCKETS + 2)
+            out.append((name, KINDS[kind], {"buckets": values[:HIST_BUCKETS], "sum": values[-2], "count": values[-1]}))
+        else:
+            fmt = "<i" if kind == 1 else "<I"
+            (value,) = struct.unpack_from(fmt, payload, pos)
+            pos += 4
+            out.append((name, KINDS.get(kind, "?"), value))
+    return out
+
+
+def main():
+    port = sys.argv[1] if len(sys.argv) > 1 else PORT
+    with serial.Serial(port, BAUD, timeout=0.1) as ser:
+        ser.write(b"!metrics\n")
+        payload = read_frame(ser, FRAME_METRICS)
+        if payload is None:
+            print("No metrics frame received")
+            return
+        for name, kind, value in decode_metrics(payload):
+            if kind == "histogram":
+                print(f"{name} count={value['count']} sum={value['sum']}")
+                print("   buckets (<2^i):", " ".join(str(c) for c in value["buckets"]))
+            else:
+                print(f"{name} {value}")
+
+
+if __name__ == "__main__":
+    main()
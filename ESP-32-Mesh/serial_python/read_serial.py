@@ -7,6 +7,9 @@ import serial
 from uuid import UUID
 from supabase import create_client, Client
 
+from alert_line import alert_line
+from serial_frame import UplinkSplitter
+
 # ------------------ CONFIG ------------------
 PORT = "COM5"
 BAUD = 115200
@@ -51,57 +54,62 @@ def uuid_or_none(val):
     except Exception:
         return None
 
+def insert_signal(raw: str):
+    parsed = parse_json_line(raw)
+    if not parsed:
+        return
+    # Extract fields safely
+    device_id = parsed.get("device_id")
+    status    = parsed.get("status")
+    user_id   = uuid_or_none(parsed.get("userid") or parsed.get("user_id"))
+    sensors   = (parsed.get("sensors") or {}).get("gps") or {}
+    lat       = sensors.get("latitude")
+    lon       = sensors.get("longitude")
+    message   = parsed.get("message")
+
+    # Build payload; include user_id even if None (NULL in DB)
+    
+    
+
+    payload = {
+        "device_id": device_id,
+        "status": status,
+        "user_id": user_id,
+        "sensors": {
+            "gps": {
+                "latitude":  lat,
+                "longitude": lon,
+            }
+        },
+        "message": message,
+    }
+    if not user_id:
+        resp = False
+    else:
+        # print("nog1")
+        resp = (
+            supabase.table(SIGNALS_TABLE)
+            .insert(payload)
+            .execute()
+        )
+        # print("log")
+
+    if resp and getattr(resp, "data", None):
+        print("Inserted:", resp.data)
+    else:
+        print("Insert attempted.")
+
 def serial_reader_loop():
+    # The master writes binary frames (logs, health, metrics) between its
+    # JSON lines; only the text lines are reports
+    split = UplinkSplitter()
     while True:
         try:
             if ser.in_waiting > 0:
-                raw = ser.readline().decode("utf-8", errors="ignore").strip()
-                if not raw:
-                    continue
-
-                parsed = parse_json_line(raw)
-                if not parsed:
-                    continue
-                # Extract fields safely
-                device_id = parsed.get("device_id")
-                status    = parsed.get("status")
-                user_id   = uuid_or_none(parsed.get("userid") or parsed.get("user_id"))
-                sensors   = (parsed.get("sensors") or {}).get("gps") or {}
-                lat       = sensors.get("latitude")
-                lon       = sensors.get("longitude")
-                message   = parsed.get("message")
-
-                # Build payload; include user_id even if None (NULL in DB)
-                
-                
-
-                payload = {
-                    "device_id": device_id,
-                    "status": status,
-                    "user_id": user_id,
-                    "sensors": {
-                        "gps": {
-                            "latitude":  lat,
-                            "longitude": lon,
-                        }
-                    },
-                    "message": message,
-                }
-                if not user_id:
-                    resp = False
-                else:
-                    # print("nog1")
-                    resp = (
-                        supabase.table(SIGNALS_TABLE)
-                        .insert(payload)
-                        .execute()
-                    )
-                    # print("log")
-
-                if resp and getattr(resp, "data", None):
-                    print("Inserted:", resp.data)
-                else:
-                    print("Insert attempted.")
+                lines = [raw.strip() for ftype, raw in split.feed(ser.read(ser.in_waiting)) if ftype is None]
+                for raw in lines:
+                    if raw:
+                        insert_signal(raw)
 
             time.sleep(0.02)
         except Exception as e:
@@ -112,7 +120,7 @@ def get_latest_alert():
     try:
         resp = (
             supabase.table(ALERTS_TABLE)
-            .select("id,message,created_at")
+            .select("*")
             .order("created_at", desc=True)
             .order("id", desc=True)
             .limit(1)
@@ -133,10 +141,13 @@ def alerts_poller_loop(poll_interval=0.5):
         try:
             latest = get_latest_alert()
             if latest and latest["id"] != last_id:
-                msg = latest.get("message") or ""
-                with ser_lock:
-                    ser.write((str(msg) + "\n").encode("utf-8"))
-                print("Sent to serial:", repr(msg))
+                try:
+                    line = alert_line(latest)
+                    with ser_lock:
+                        ser.write(line.encode("utf-8"))
+                    print("Sent to serial:", repr(line))
+                except ValueError as e:
+                    print("Alert not sent:", e)  # the row will not get better; skip it
                 last_id = latest["id"]
             time.sleep(poll_interval)
         except Exception as e:
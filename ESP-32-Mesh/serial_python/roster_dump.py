@@ -0,0 +1,61 @@
+import struct
+import sys
+import serial
+
+from metrics_dump import PORT, BAUD, read_frame
+
+FRAME_ROSTER = 0x04
+FLAG_HAS_FIX = 1
+FLAG_SOS = 2
+ENTRY = struct.Struct("<I6sBBiiIIIII")
+
+
+def decode_roster(payload: bytes):
+    version, count = struct.unpack_from("<BH", payload, 0)
+    if version != 1:
+        raise ValueError(f"unknown roster version {version}")
+    pos = 3
+    nodes = []
+    for _ in range(count):
+        (node_id, mac, hops, flags, lat, lon, age_ms, seq,
+         packets, nbytes, latency_ms) = ENTRY.unpack_from(payload, pos)
+        pos += ENTRY.size
+        uid_len = payload[pos]
+        user_id = payload[pos + 1:pos + 1 + uid_len].decode("utf-8", errors="replace")
+        pos += 1 + uid_len
+        nodes.append({
+            "node_id": node_id,
+            "mac": ":".join(f"{b:02X}" for b in mac),
+            "hops": hops,
+            "sos": bool(flags & FLAG_SOS),
+            "lat": lat / 1e7 if flags & FLAG_HAS_FIX else None,
+            "lon": lon / 1e7 if flags & FLAG_HAS_FIX else None,
+            "age_s": age_ms / 1000,
+            "seq": seq,
+            "packets": packets,
+            "bytes": nbytes,
+            "latency_ms": latency_ms,
+            "user_id": user_id,
+        })
+    return nodes
+
+
+def main():
+    port = sys.argv[1] if len(sys.argv) > 1 else PORT
+    with serial.Serial(port, BAUD, timeout=0.1) as ser:
+        ser.write(b"!roster\n")
+        payload = read_frame(ser, FRAME_ROSTER)
+    if payload is None:
+        print("No roster frame received (only the master keeps one)")
+        return
+    nodes = decode_roster(payload)
+    print(f"{len(nodes)} nodes")
+    for n in sorted(nodes, key=lambda n: n["age_s"]):
+        where = f"{n['lat']:.5f},{n['lon']:.5f}" if n["lat"] is not None else "no fix"
+        print(f"{n['node_id']:>10} {n['mac']} hops={n['hops']} seen {n['age_s']:.1f}s ago "
+              f"{where} pkts={n['packets']} bytes={n['bytes']} lat={n['latency_ms']}ms "
+              f"{'SOS ' if n['sos'] else ''}{n['user_id']}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,35 @@
+import json
+import random
+import sys
+import time
+import serial
+
+from metrics_dump import PORT, BAUD
+
+TIMEOUT_S = 30  # the master gives up after 3 tries (3 + 6 + 12 s)
+
+
+def main():
+    # send_direct.py <userid> <text> [PORT]
+    if len(sys.argv) < 3:
+        print("usage: send_direct.py <userid> <text> [PORT]")
+        return
+    userid, text = sys.argv[1], sys.argv[2]
+    port = sys.argv[3] if len(sys.argv) > 3 else PORT
+    msg_id = random.randrange(1, 1 << 32)
+    with serial.Serial(port, BAUD, timeout=0.5) as ser:
+        ser.write(f"TO:{msg_id:x}:{userid}:{text}\n".encode())
+        deadline = time.time() + TIMEOUT_S
+        while time.time() < deadline:
+            line = ser.readline().decode("utf-8", errors="ignore").strip()
+            if not line.startswith('{"direct"'):
+                continue
+            status = json.loads(line)["direct"]
+            if status["id"] == f"{msg_id:x}":
+                print(status["status"])
+                return
+    print("no answer from the master")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,115 @@
+import struct
+
+# Binary frames on the master's serial uplink (pio/include/serial_frame.h),
+# written unprompted between the JSON text lines:
+#   0xA5 0x5A | type u8 | length u16 LE | payload | CRC-16/CCITT u16 LE
+SYNC = b"\xa5\x5a"
+FRAME_METRICS = 0x01
+FRAME_TRACE = 0x02
+FRAME_LOG = 0x03
+FRAME_ROSTER = 0x04
+FRAME_HEALTH = 0x05
+FRAME_TYPE_MAX = FRAME_HEALTH  # raise with the FrameType enum
+FRAME_PACKED = 0x80  # type flag: payload packed by the device (include/compress.h)
+FRAME_PAYLOAD_MAX = 5632 - 7  # SERIAL_FRAME_MAX in main_testing.cpp, less the framing
+Z_WINDOW_BITS, Z_LENGTH_BITS, Z_MATCH_MIN = 9, 4, 3
+LINE_MAX = 4096  # longer text without a newline is dropped
+
+
+def crc16_ccitt(data: bytes, crc: int = 0xFFFF) -> int:
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def unpack(payload: bytes) -> bytes:
+    """A FRAME_PACKED payload: u16 LE unpacked length, then bits, MSB first:
+    1 + byte for a literal, 0 + (distance - 1) + (length - Z_MATCH_MIN) for
+    a copy of earlier output."""
+    (length,) = struct.unpack_from("<H", payload, 0)
+    total = 8 * (len(payload) - 2)
+    value = int.from_bytes(payload[2:], "big")
+    pos = 0
+    out = bytearray()
+
+    def get(n):
+        nonlocal pos
+        if pos + n > total:
+            raise ValueError("packed frame cut short")
+        pos += n
+        return (value >> (total - pos)) & ((1 << n) - 1)
+
+    while total - pos >= 8:  # less is padding
+        if get(1):
+            out.append(get(8))
+            continue
+        dist, n = get(Z_WINDOW_BITS) + 1, get(Z_LENGTH_BITS) + Z_MATCH_MIN
+        if dist > len(out):
+            raise ValueError("packed frame refers before its start")
+        for _ in range(n):
+            out.append(out[-dist])
+    if len(out) != length:
+        raise ValueError(f"packed frame unpacks to {len(out)} bytes, not {length}")
+    return bytes(out)
+
+
+class UplinkSplitter:
+    """Splits the uplink byte stream into text lines and binary frames.
+
+    feed() takes bytes as they arrive and yields (None, line) for each
+    complete text line (str, without the newline) and (type, payload) for
+    each valid frame, packed payloads unpacked. A frame's bytes never reach
+    a line, whatever they contain. Sync bytes that do not start a valid
+    frame (0xA5 0x5A inside UTF-8 text) stay in the line."""
+
+    def __init__(self):
+        self.buf = b""
+        self.line = b""
+
+    def _text(self, data):
+        self.line = (self.line + data)[-LINE_MAX:]
+
+    def feed(self, data: bytes):
+        self.buf += data
+        while self.buf:
+            sync = self.buf.find(SYNC)
+            nl = self.buf.find(b"\n")
+            if nl >= 0 and (sync < 0 or nl < sync):
+                self._text(self.buf[:nl])
+                self.buf = self.buf[nl + 1:]
+                line, self.line = self.line, b""
+                yield None, line.decode("utf-8", errors="ignore").rstrip("\r")
+                continue
+            if sync < 0:
+                keep = 1 if self.buf.endswith(SYNC[:1]) else 0  # may be the start of a sync
+                self._text(self.buf[:len(self.buf) - keep])
+                self.buf = self.buf[len(self.buf) - keep:]
+                return
+            self._text(self.buf[:sync])
+            self.buf = self.buf[sync:]
+            if len(self.buf) < 5:
+                return
+            ftype, length = struct.unpack_from("<BH", self.buf, 2)
+            # A known type is a control byte, which JSON text never holds, so
+            # a line is never mistaken for a frame's header and held back
+            if 1 <= ftype & ~FRAME_PACKED <= FRAME_TYPE_MAX and length <= FRAME_PAYLOAD_MAX:
+                end = 5 + length + 2
+                if len(self.buf) < end:
+                    return
+                (crc,) = struct.unpack_from("<H", self.buf, 5 + length)
+                if crc16_ccitt(self.buf[2:5 + length]) == crc:
+                    payload = self.buf[5:5 + length]
+                    self.buf = self.buf[end:]
+                    if ftype & FRAME_PACKED:
+                        try:
+                            payload = unpack(payload)
+                        except ValueError:
+                            continue
+                    yield ftype & ~FRAME_PACKED, payload
+                    continue
+            # Not a frame: the sync byte is text
+            self._text(self.buf[:1])
+            self.buf = self.buf[1:]
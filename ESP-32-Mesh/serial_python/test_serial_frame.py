@@ -0,0 +1,64 @@
+import json
+import re
+import struct
+import unittest
+
+from serial_frame import (FRAME_HEALTH, FRAME_LOG, FRAME_METRICS, FRAME_PACKED, FRAME_PAYLOAD_MAX,
+                          UplinkSplitter, crc16_ccitt)
+
+ORIG_PATTERN = re.compile(r'{"device_id":.*"message".*}')  # read_serial.parse_json_line
+
+
+def frame(ftype, payload):
+    body = struct.pack("<BH", ftype, len(payload)) + payload
+    return b"\xa5\x5a" + body + struct.pack("<H", crc16_ccitt(body))
+
+
+def packed(data):
+    """Literals only: enough for unpack() to rebuild `data`."""
+    bits = "".join("1" + format(b, "08b") for b in data)
+    bits += "0" * (-len(bits) % 8)
+    return struct.pack("<H", len(data)) + int(bits, 2).to_bytes(len(bits) // 8, "big")
+
+
+def report(device, message):
+    return json.dumps({"device_id": device, "status": "ok", "message": message}, ensure_ascii=False).encode() + b"\n"
+
+
+class UplinkSplitterTest(unittest.TestCase):
+    def split(self, stream, chunk):
+        s = UplinkSplitter()
+        out = []
+        for i in range(0, len(stream), chunk):
+            out += s.feed(stream[i:i + chunk])
+        return [line for t, line in out if t is None], [(t, p) for t, p in out if t is not None]
+
+    def test_frames_between_json_lines(self):
+        decoy = report("frame", "inside a log frame")  # JSON, newline and all, as frame bytes
+        health = bytes(range(256)) * 2
+        metrics = b"\x01\x00"
+        stream = (report("a", "one") + frame(FRAME_LOG, b"\x00\x00\x00\x00" + decoy) +
+                  report("b", "two") + frame(FRAME_HEALTH, health) + frame(FRAME_METRICS, metrics) +
+                  b"boot text " + frame(FRAME_LOG | FRAME_PACKED, packed(decoy * 3)) + b"continues\n" +
+                  report("c", "three ¥Z"))  # U+00A5 is C2 A5 in UTF-8: a sync inside text
+        for chunk in (1, 7, 64, len(stream)):
+            lines, frames = self.split(stream, chunk)
+            self.assertEqual(lines, [report("a", "one").decode().strip(), report("b", "two").decode().strip(),
+                                     "boot text continues", report("c", "three ¥Z").decode().strip()])
+            self.assertEqual(frames, [(FRAME_LOG, b"\x00\x00\x00\x00" + decoy), (FRAME_HEALTH, health),
+                                      (FRAME_METRICS, metrics), (FRAME_LOG, decoy * 3)])
+            self.assertEqual([json.loads(l)["device_id"] for l in lines if ORIG_PATTERN.search(l)], ["a", "b", "c"])
+
+    def test_bad_frames_are_text(self):
+        bad = bytearray(frame(FRAME_HEALTH, b"\x01\x02\x03"))
+        bad[-1] ^= 1
+        long = b"\xa5\x5a\x05" + struct.pack("<H", FRAME_PAYLOAD_MAX + 1)
+        stream = bytes(bad) + b"\n" + long + b"\n" + report("d", "after")
+        lines, frames = self.split(stream, 5)
+        self.assertEqual(frames, [])
+        self.assertEqual(lines[-1], report("d", "after").decode().strip())
+        self.assertEqual(len(lines), 3)
+
+
+if __name__ == "__main__":
+    unittest.main()
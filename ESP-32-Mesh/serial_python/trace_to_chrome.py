@@ -0,0 +1,78 @@
+import json
+import struct
+import sys
+import serial
+
+from metrics_dump import PORT, BAUD, read_frame
+
+# ------------------ CONFIG ------------------
+OUT_FILE = "trace.json"
+# --------------------------------------------
+
+FRAME_TRACE = 0x02
+CORE_NAMES = {0: "core 0 (net)", 1: "core 1 (app)"}
+
+
+def decode_trace(payload: bytes):
+    """Returns (names, events) with events as (name, core, ts_us, dur_us)."""
+    version, mhz = struct.unpack_from("<BH", payload, 0)
+    if version != 1:
+        raise ValueError(f"unknown trace version {version}")
+    pos = 3
+    anchors = []
+    for _ in range(2):
+        cycles, us_lo, us_hi = struct.unpack_from("<III", payload, pos)
+        anchors.append((cycles, us_lo | (us_hi << 32)))
+        pos += 12
+    name_count = payload[pos]
+    pos += 1
+    names = []
+    for _ in range(name_count):
+        n = payload[pos]
+        names.append(payload[pos + 1:pos + 1 + n].decode("ascii", errors="replace"))
+        pos += 1 + n
+    (count,) = struct.unpack_from("<H", payload, pos)
+    pos += 2
+    events = []
+    for _ in range(count):
+        start, cycles, tp, core = struct.unpack_from("<IIBB", payload, pos)
+        pos += 10
+        anchor_cycles, anchor_us = anchors[core] if core < len(anchors) else anchors[0]
+        # signed distance to the anchor, so spans on either side of a 32-bit wrap line up
+        delta = (start - anchor_cycles + 0x80000000) % 0x100000000 - 0x80000000
+        name = names[tp] if tp < len(names) else f"tp{tp}"
+        events.append((name, core, anchor_us + delta / mhz, cycles / mhz))
+    return names, events
+
+
+def to_chrome(events):
+    out = [{"name": "thread_name", "ph": "M", "pid": 1, "tid": core, "args": {"name": label}}
+           for core, label in CORE_NAMES.items()]
+    for name, core, ts, dur in events:
+        out.append({"name": name, "ph": "X", "pid": 1, "tid": core, "ts": round(ts, 3), "dur": round(dur, 3)})
+    return {"traceEvents": out, "displayTimeUnit": "ms"}
+
+
+def main():
+    # trace_to_chrome.py [PORT | dump.bin] [out.json]
+    # A .bin argument is a raw /trace download from the portal.
+    src = sys.argv[1] if len(sys.argv) > 1 else PORT
+    out_file = sys.argv[2] if len(sys.argv) > 2 else OUT_FILE
+    if src.endswith(".bin"):
+        with open(src, "rb") as f:
+            payload = f.read()
+    else:
+        with serial.Serial(src, BAUD, timeout=0.1) as ser:
+            ser.write(b"!trace\n")
+            payload = read_frame(ser, FRAME_TRACE)
+        if payload is None:
+            print("No trace frame received (is TRACE_ENABLED set?)")
+            return
+    names, events = decode_trace(payload)
+    with open(out_file, "w") as f:
+        json.dump(to_chrome(events), f)
+    print(f"{len(events)} spans -> {out_file} (open in chrome://tracing or ui.perfetto.dev)")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,286 @@
+// Heap soak of the fixed buffers (include/fixed_buffers.h, mesh_msg.h):
+// three threads play the app core, the net core and the portal, passing
+// MeshMsg descriptors through SpscRings with their text in msgPool and
+// longMsgPool, formatting reports and ACKs in FixedStrings as
+// main_testing.cpp does. Traffic for --hours of uptime is pushed through as
+// fast as the threads go. Every heap allocation is counted (operator new),
+// and every text is checked on arrival. Beside it, the same traffic built
+// with heap strings the way the code was before ("ACK:" + msg, substring,
+// buffer += c), counting its allocations.
+//
+//   bench_buffers [--hours H] [--rate R]
+//
+// --rate is messages per second of simulated uptime in each direction.
+// Exit status 1 if the soak allocated from the heap, corrupted a text, or
+// left a pool buffer in use.
+#include "mesh_msg.h"
+#include "spsc_ring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+#include <thread>
+
+// As in main_testing.cpp
+#define RING_SIZE 32
+#define WEB_RING_SIZE 8
+
+MsgPool msgPool;
+LongMsgPool longMsgPool;
+static SpscRing<MeshMsg, RING_SIZE> toNet, toApp;
+static SpscRing<MeshMsg, WEB_RING_SIZE> fromWeb;
+
+static std::atomic<uint64_t> heapAllocs{0};
+static thread_local bool counting; // set in the traffic's own code, not around std::thread
+
+void *operator new(size_t n)
+{
+  if (counting)
+    heapAllocs.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = malloc(n ? n : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+typedef std::chrono::steady_clock Clock;
+
+struct Result
+{
+  uint64_t messages = 0, poolFull = 0, ringFull = 0, corrupt = 0;
+  uint64_t allocs = 0; // heap allocations during the soak
+  uint8_t highWater = 0, longHighWater = 0, leftInUse = 0;
+  double seconds = 0;
+};
+
+// The report a client sends, numbered so the receiver can check it
+static void formatReport(FixedString<MESH_MSG_TEXT_MAX> &s, uint32_t seq)
+{
+  s.clear();
+  s.appendf("{\"id\":%u,\"lat\":%.6f,\"lng\":%.6f,\"msg\":\"", seq, 42.0 + seq % 1000 * 1e-6, -71.0);
+  for (uint32_t i = 0; i < seq % 64; i++)
+    s.append((char)('a' + (seq + i) % 26));
+  s.append("\"}");
+}
+
+// Hands a descriptor on, releasing its text if the ring is full, as postToNet does
+template <typename Ring>
+static bool post(Ring &ring, MeshMsg &m, std::atomic<uint64_t> &ringFull)
+{
+  if (ring.push(m))
+    return true;
+  m.release();
+  ringFull.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+static Result soak(uint64_t total)
+{
+  Result res;
+  std::atomic<uint64_t> poolFull{0}, ringFull{0}, corrupt{0}, received{0};
+  std::atomic<bool> appDone{false}, webDone{false};
+  uint64_t webTotal = total / 16; // portal messages are rare and long
+  uint64_t allocs0 = heapAllocs.load();
+  auto t0 = Clock::now();
+
+  // Portal: long messages, as handleSubmit posts them
+  std::thread web([&]() {
+    counting = true;
+    char text[USER_MSG_MAX + 1];
+    for (uint64_t k = 0; k < webTotal;)
+    {
+      size_t n = MESH_MSG_TEXT_MAX + k % (USER_MSG_MAX - MESH_MSG_TEXT_MAX);
+      memset(text, 'a' + k % 26, n);
+      MeshMsg m;
+      m.init(CMD_SEND);
+      m.a = (int32_t)k;
+      if (!m.setLongText(text, n))
+      {
+        poolFull.fetch_add(1, std::memory_order_relaxed);
+        std::this_thread::yield();
+        continue;
+      }
+      post(fromWeb, m, ringFull);
+      k++;
+    }
+    webDone = true;
+  });
+
+  // Net core: ACKs what the app and the portal send, posts alerts back
+  std::thread net([&]() {
+    counting = true;
+    FixedString<MESH_MSG_TEXT_MAX + 8> ack;
+    FixedString<MESH_MSG_TEXT_MAX> check;
+    uint32_t alerts = 0;
+    MeshMsg m;
+    for (;;)
+    {
+      bool idle = true;
+      while (toNet.pop(m))
+      {
+        idle = false;
+        formatReport(check, (uint32_t)m.a);
+        if (!m.span().equals(check.c_str()))
+          corrupt.fetch_add(1, std::memory_order_relaxed);
+        ack = "ACK:";
+        ack.append(m.span());
+        m.release();
+        received.fetch_add(1, std::memory_order_relaxed);
+
+        MeshMsg e;
+        e.init(EVT_ALERT);
+        e.b = (int32_t)++alerts;
+        check.clear();
+        check.appendf("ALERT %u", alerts);
+        if (!e.setText(check.c_str(), check.length()))
+          poolFull.fetch_add(1, std::memory_order_relaxed);
+        else
+          post(toApp, e, ringFull);
+      }
+      while (fromWeb.pop(m))
+      {
+        idle = false;
+        const char *t = m.text();
+        char c = 'a' + (uint32_t)m.a % 26;
+        if (m.len < MESH_MSG_TEXT_MAX || t[0] != c || t[m.len - 1] != c || t[m.len])
+          corrupt.fetch_add(1, std::memory_order_relaxed);
+        m.release();
+      }
+      if (idle && appDone && webDone && toNet.empty() && fromWeb.empty())
+        break;
+      if (idle)
+        std::this_thread::yield();
+    }
+  });
+
+  // App core: reports out, alerts in
+  counting = true;
+  FixedString<MESH_MSG_TEXT_MAX> report, check;
+  MeshMsg m;
+  for (uint64_t k = 0; k < total;)
+  {
+    while (toApp.pop(m))
+    {
+      check.clear();
+      check.appendf("ALERT %u", (uint32_t)m.b);
+      if (!m.span().equals(check.c_str()))
+        corrupt.fetch_add(1, std::memory_order_relaxed);
+      m.release();
+    }
+    formatReport(report, (uint32_t)k);
+    m.init(CMD_SEND);
+    m.a = (int32_t)k;
+    if (!m.setText(report.c_str(), report.length()))
+    {
+      poolFull.fetch_add(1, std::memory_order_relaxed);
+      std::this_thread::yield();
+      continue;
+    }
+    post(toNet, m, ringFull);
+    k++;
+  }
+  appDone = true;
+  counting = false;
+  web.join();
+  net.join();
+  while (toApp.pop(m))
+    m.release();
+
+  res.seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+  res.allocs = heapAllocs.load() - allocs0;
+  res.messages = total + webTotal + received.load();
+  res.poolFull = poolFull;
+  res.ringFull = ringFull;
+  res.corrupt = corrupt;
+  res.highWater = msgPool.highWater();
+  res.longHighWater = longMsgPool.highWater();
+  res.leftInUse = msgPool.inUse() + longMsgPool.inUse();
+  return res;
+}
+
+// Before: the serial bridge grew a String a character at a time, reports
+// and ACKs were concatenated, prefixes cut off with substring
+static uint64_t heapStrings(uint64_t total)
+{
+  uint64_t allocs0 = heapAllocs.load();
+  counting = true;
+  FixedString<MESH_MSG_TEXT_MAX> report;
+  size_t keep = 0;
+  for (uint64_t k = 0; k < total; k++)
+  {
+    formatReport(report, (uint32_t)k);
+    std::string msg = report.c_str();
+    std::string ack = std::string("ACK:") + msg;
+    std::string body = ack.substr(4);
+    std::string line;
+    for (size_t i = 0; i < body.size(); i++)
+      line += body[i];
+    std::string alert = "ALERT " + std::to_string(k);
+    keep += line.size() + alert.size();
+  }
+  counting = false;
+  volatile size_t sink = keep;
+  (void)sink;
+  return heapAllocs.load() - allocs0;
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: bench_buffers [--hours H] [--rate R]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t hours = 72;
+  double rate = 10;
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    if (i + 1 >= argc)
+      usage();
+    const char *v = argv[++i];
+    if (!strcmp(a, "--hours"))
+      hours = atoi(v);
+    else if (!strcmp(a, "--rate"))
+      rate = atof(v);
+    else
+      usage();
+  }
+  if (!hours || rate <= 0)
+    usage();
+
+  uint64_t total = (uint64_t)(hours * 3600.0 * rate);
+  printf("%u h of uptime at %.0f messages/s each way: %llu reports, %llu portal messages\n\n", hours, rate,
+         (unsigned long long)total, (unsigned long long)(total / 16));
+  Result r = soak(total);
+  // Heap strings for one hour's traffic, scaled: the pattern is the same every hour
+  uint64_t hour = (uint64_t)(3600 * rate);
+  uint64_t heapHour = heapStrings(hour);
+
+  printf("fixed buffers: %llu messages in %.1f s, %llu heap allocations\n", (unsigned long long)r.messages, r.seconds,
+         (unsigned long long)r.allocs);
+  printf("  msgPool high water %u/%u, longMsgPool %u/%u, %u left in use\n", r.highWater, MSG_POOL_COUNT,
+         r.longHighWater, LONG_MSG_POOL_COUNT, r.leftInUse);
+  printf("  pool full %llu times (retried), ring full %llu times (dropped), %llu corrupt\n",
+         (unsigned long long)r.poolFull, (unsigned long long)r.ringFull, (unsigned long long)r.corrupt);
+  printf("heap strings:  %llu allocations per hour, %llu over %u h\n", (unsigned long long)heapHour,
+         (unsigned long long)(heapHour * hours), hours);
+
+  bool ok = true;
+  if (r.allocs)
+  {
+    printf("FAIL: the soak allocated from the heap\n");
+    ok = false;
+  }
+  if (r.corrupt || r.leftInUse)
+  {
+    printf("FAIL: %llu texts corrupted, %u buffers leaked\n", (unsigned long long)r.corrupt, r.leftInUse);
+    ok = false;
+  }
+  return ok ? 0 : 1;
+}
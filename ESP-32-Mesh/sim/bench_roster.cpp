@@ -0,0 +1,301 @@
+// Roster benchmark (include/roster.h): first random touch, erase, MAC and
+// user id changes checked against std::unordered_map; then 1000 nodes each
+// reporting at 10 Hz, every packet updating its sender's entry the way
+// ingestTouch and ingestReport do (touch, counters, MAC, now and then a
+// user lookup for a direct message). Beside it, the same updates on a
+// plain array searched front to back, and on std::unordered_map.
+//
+//   bench_roster [--nodes N] [--hz H] [--seconds S] [--ops N] [--seed S]
+//
+// Exit status 1 if the roster disagreed with the reference.
+#include "roster.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+typedef Roster<1024> BigRoster;
+static BigRoster roster; // static: about 170 KB
+
+static double nsSince(Clock::time_point t0, uint64_t ops)
+{
+  return ops ? std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / ops : 0;
+}
+
+static void macOf(uint32_t node, uint32_t gen, uint8_t *mac)
+{
+  uint32_t v = node * 2654435761UL + gen;
+  mac[0] = 0x24;
+  mac[1] = 0x6F;
+  mac[2] = v >> 24;
+  mac[3] = v >> 16;
+  mac[4] = v >> 8;
+  mac[5] = v;
+}
+
+// Random operations on at most `live` nodes (under capacity, so nothing is
+// evicted) against three maps; returns the number of disagreements
+static uint64_t check(uint32_t ops, uint32_t live, uint32_t seed)
+{
+  struct Ref
+  {
+    uint64_t mac; // 0: none
+    std::string user;
+    uint32_t seen;
+  };
+  std::mt19937 rng(seed);
+  std::unordered_map<uint32_t, Ref> byId;
+  std::unordered_map<uint64_t, uint32_t> byMac;
+  std::unordered_map<std::string, uint32_t> byUser;
+  roster.clear();
+  uint64_t wrong = 0;
+  auto key = [](const uint8_t *m) {
+    uint64_t k = 0;
+    for (int i = 0; i < 6; i++)
+      k = k << 8 | m[i];
+    return k;
+  };
+
+  for (uint32_t k = 0; k < ops; k++)
+  {
+    uint32_t id = 1 + rng() % (live * 2), op = rng() % 10;
+    if (op >= 5 && op < 9 && byId.count(id) && !roster.find(id))
+    {
+      wrong++; // lost a node the reference still has
+      continue;
+    }
+    if (op < 4 && (byId.count(id) || byId.size() < live))
+    {
+      roster.touch(id, k);
+      Ref &r = byId[id];
+      r.seen = k;
+    }
+    else if (op < 5)
+    {
+      roster.erase(id);
+      auto it = byId.find(id);
+      if (it != byId.end())
+      {
+        if (it->second.mac)
+          byMac.erase(it->second.mac);
+        if (!it->second.user.empty())
+          byUser.erase(it->second.user);
+        byId.erase(it);
+      }
+    }
+    else if (op < 7 && byId.count(id))
+    {
+      // A MAC, sometimes one another node had (reflashed onto new hardware)
+      uint8_t mac[6];
+      macOf(rng() % 4 ? id : 1 + rng() % (live * 2), rng() % 3, mac);
+      roster.setMac(*roster.find(id), mac);
+      uint64_t m = key(mac);
+      Ref &r = byId[id];
+      if (r.mac != m)
+      {
+        if (r.mac)
+          byMac.erase(r.mac);
+        auto old = byMac.find(m);
+        if (old != byMac.end())
+          byId[old->second].mac = 0;
+        byMac[m] = id;
+        r.mac = m;
+      }
+    }
+    else if (op < 9 && byId.count(id))
+    {
+      // A user id, sometimes one re-paired from another node, sometimes cleared
+      char user[ROSTER_USERID_MAX + 1];
+      uint32_t u = rng() % (live * 2);
+      if (rng() % 8)
+        snprintf(user, sizeof(user), "USER_%u", u);
+      else
+        user[0] = 0;
+      roster.setUserId(*roster.find(id), user);
+      Ref &r = byId[id];
+      if (r.user != user)
+      {
+        if (!r.user.empty())
+          byUser.erase(r.user);
+        r.user = user;
+        if (user[0])
+        {
+          auto old = byUser.find(user);
+          if (old != byUser.end())
+            byId[old->second].user.clear();
+          byUser[user] = id;
+        }
+      }
+    }
+
+    // Every lookup agrees for the node just used, and for a random user and MAC
+    RosterEntry *e = roster.find(id);
+    auto it = byId.find(id);
+    if (!e != (it == byId.end()) || (e && (e->lastSeenMs != it->second.seen || it->second.user != e->userId)))
+      wrong++;
+    char user[24];
+    snprintf(user, sizeof(user), "USER_%u", (uint32_t)(rng() % (live * 2)));
+    RosterEntry *u = roster.findByUser(user);
+    auto ut = byUser.find(user);
+    if (!u != (ut == byUser.end()) || (u && u->nodeId != ut->second))
+      wrong++;
+    uint8_t mac[6];
+    macOf(1 + rng() % (live * 2), rng() % 3, mac);
+    RosterEntry *m = roster.findByMac(mac);
+    auto mt = byMac.find(key(mac));
+    if (!m != (mt == byMac.end()) || (m && m->nodeId != mt->second))
+      wrong++;
+  }
+  if (roster.size() != byId.size())
+    wrong++;
+  return wrong;
+}
+
+struct Result
+{
+  uint64_t updates = 0;
+  double rosterNs = 0, arrayNs = 0, mapNs = 0;
+};
+
+// 1000 nodes at 10 Hz: packets in arrival order, a node at a time
+static Result traffic(uint32_t nodes, uint32_t hz, uint32_t seconds, uint32_t seed)
+{
+  std::mt19937 rng(seed);
+  std::vector<uint32_t> ids(nodes);
+  for (uint32_t &id : ids)
+    id = rng() | 1;
+  // Each tick every node sends once, in a different order each time
+  std::vector<uint32_t> order;
+  order.reserve((size_t)nodes * hz * seconds);
+  std::vector<uint32_t> tick(nodes);
+  for (uint32_t i = 0; i < nodes; i++)
+    tick[i] = i;
+  for (uint32_t t = 0; t < hz * seconds; t++)
+  {
+    std::shuffle(tick.begin(), tick.end(), rng);
+    order.insert(order.end(), tick.begin(), tick.end());
+  }
+  Result res;
+  res.updates = order.size();
+  uint32_t msPerTick = 1000 / hz;
+
+  roster.clear();
+  for (uint32_t i = 0; i < nodes; i++)
+  {
+    char user[24];
+    snprintf(user, sizeof(user), "USER_%u", i);
+    roster.setUserId(roster.touch(ids[i], 0), user);
+  }
+  char user[24];
+  uint8_t mac[6];
+  auto t0 = Clock::now();
+  for (size_t p = 0; p < order.size(); p++)
+  {
+    uint32_t i = order[p];
+    RosterEntry &e = roster.touch(ids[i], p / nodes * msPerTick);
+    e.packets++;
+    e.bytes += 120;
+    e.hops = 1 + i % 4;
+    macOf(i, 0, mac);
+    roster.setMac(e, mac);
+    if (p % 100 == 0) // a direct message now and then
+    {
+      snprintf(user, sizeof(user), "USER_%u", i);
+      if (!roster.findByUser(user))
+        abort();
+    }
+  }
+  res.rosterNs = nsSince(t0, order.size());
+
+  // Same updates, a node's slot found by a front-to-back search
+  std::vector<RosterEntry> array(nodes);
+  for (uint32_t i = 0; i < nodes; i++)
+    array[i].nodeId = ids[i];
+  t0 = Clock::now();
+  for (size_t p = 0; p < order.size(); p++)
+  {
+    uint32_t i = order[p], id = ids[i], j = 0;
+    while (array[j].nodeId != id)
+      j++;
+    RosterEntry &e = array[j];
+    e.lastSeenMs = p / nodes * msPerTick;
+    e.packets++;
+    e.bytes += 120;
+    e.hops = 1 + i % 4;
+  }
+  res.arrayNs = nsSince(t0, order.size());
+
+  std::unordered_map<uint32_t, RosterEntry> map;
+  for (uint32_t i = 0; i < nodes; i++)
+    map[ids[i]].nodeId = ids[i];
+  t0 = Clock::now();
+  for (size_t p = 0; p < order.size(); p++)
+  {
+    uint32_t i = order[p];
+    RosterEntry &e = map[ids[i]];
+    e.lastSeenMs = p / nodes * msPerTick;
+    e.packets++;
+    e.bytes += 120;
+    e.hops = 1 + i % 4;
+  }
+  res.mapNs = nsSince(t0, order.size());
+  return res;
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: bench_roster [--nodes N] [--hz H] [--seconds S] [--ops N] [--seed S]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t nodes = 1000, hz = 10, seconds = 60, ops = 200000, seed = 1;
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    if (i + 1 >= argc)
+      usage();
+    const char *v = argv[++i];
+    if (!strcmp(a, "--nodes"))
+      nodes = atoi(v);
+    else if (!strcmp(a, "--hz"))
+      hz = atoi(v);
+    else if (!strcmp(a, "--seconds"))
+      seconds = atoi(v);
+    else if (!strcmp(a, "--ops"))
+      ops = atoi(v);
+    else if (!strcmp(a, "--seed"))
+      seed = atoi(v);
+    else
+      usage();
+  }
+  if (!nodes || nodes > BigRoster::capacity() || !hz || !seconds)
+    usage();
+
+  uint64_t wrong = check(ops, BigRoster::capacity() * 7 / 8, seed);
+  printf("%u random operations against std::unordered_map: %llu disagreements\n\n", ops, (unsigned long long)wrong);
+
+  Result r = traffic(nodes, hz, seconds, seed);
+  double perSecond = (double)nodes * hz;
+  printf("%u nodes at %u Hz for %u s: %llu updates\n", nodes, hz, seconds, (unsigned long long)r.updates);
+  printf("                 ns/update  CPU at %.0f updates/s\n", perSecond);
+  printf("roster           %9.1f  %8.4f%%\n", r.rosterNs, r.rosterNs * perSecond / 1e7);
+  printf("array search     %9.1f  %8.4f%%\n", r.arrayNs, r.arrayNs * perSecond / 1e7);
+  printf("unordered_map    %9.1f  %8.4f%%\n", r.mapNs, r.mapNs * perSecond / 1e7);
+  printf("\nroster: %zu bytes for %u nodes, %zu per node; the firmware's Roster<64>: %zu bytes\n", sizeof(BigRoster),
+         BigRoster::capacity(), sizeof(BigRoster) / BigRoster::capacity(), sizeof(Roster<64>));
+
+  if (wrong)
+  {
+    printf("FAIL: the roster disagreed with the reference\n");
+    return 1;
+  }
+  return 0;
+}
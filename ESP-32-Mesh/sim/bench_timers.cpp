@@ -0,0 +1,181 @@
+// Timer wheel benchmark (include/timer_wheel.h): N timers with random
+// delays from 1 ms to 5 minutes, each re-armed from its own callback,
+// driven the way loop() drives the firmware's wheel: sleep msUntilNext(),
+// then advance(). For 100 to 10000 timers it times start, stop and each
+// expiry (cascades included), and checks every timer fires exactly at
+// its deadline, never late or twice. Beside it, the cost of the ad-hoc
+// millis() checks the wheel replaced: every deadline compared on every
+// loop pass.
+//
+//   bench_timers [--seconds S] [--seed S] [--max-growth X]
+//
+// Exit status 1 if a timer fired off its deadline, or if the ns per start
+// or per expiry at 10000 timers exceeds --max-growth (default 4) times
+// that at 100.
+#include "timer_wheel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double nsSince(Clock::time_point t0, uint64_t ops)
+{
+  return ops ? std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / ops : 0;
+}
+
+struct Result
+{
+  uint64_t fired = 0, wrong = 0; // wrong: fired off its deadline, or never
+  double startNs = 0, stopNs = 0, expiryNs = 0, nextNs = 0, scanNs = 0;
+};
+
+static uint32_t nowMs;
+static std::mt19937 rng;
+static uint32_t randomDelay()
+{
+  // Mostly short (buttons, buzzer, display), some seconds, a few minutes
+  uint32_t r = rng() % 100;
+  return r < 70 ? 1 + rng() % 64 : r < 95 ? 64 + rng() % 4000 : 4096 + rng() % 300000;
+}
+
+template <uint16_t N>
+static Result run(uint32_t seconds, uint32_t seed)
+{
+  struct Slot
+  {
+    TimerWheel<N> *wheel;
+    TimerId id;
+    uint32_t due;
+    Result *res;
+  };
+  static TimerWheel<N> wheel; // static: large at 10000; one run per N
+  static Slot slots[N];
+  Result res;
+  rng.seed(seed);
+  nowMs = 0;
+  wheel.begin(nowMs);
+
+  // Fires, checks its deadline and re-arms, as the firmware's callbacks do
+  TimerCallback fire = [](void *arg) {
+    Slot &s = *(Slot *)arg;
+    s.res->fired++;
+    s.res->wrong += nowMs != s.due; // loop() advances exactly to msUntilNext; a second call misses
+    uint32_t d = randomDelay();
+    s.due = nowMs + d;
+    s.wheel->start(s.id, d);
+  };
+  for (uint16_t i = 0; i < N; i++)
+    slots[i] = {&wheel, wheel.create(fire, &slots[i]), 0, &res};
+
+  // start: every timer armed from idle
+  std::vector<uint32_t> delays(N);
+  for (uint32_t &d : delays)
+    d = randomDelay();
+  auto t0 = Clock::now();
+  for (uint16_t i = 0; i < N; i++)
+    wheel.start(slots[i].id, delays[i]);
+  res.startNs = nsSince(t0, N);
+  // stop, then re-armed for the run
+  t0 = Clock::now();
+  for (uint16_t i = 0; i < N; i++)
+    wheel.stop(slots[i].id);
+  res.stopNs = nsSince(t0, N);
+  for (uint16_t i = 0; i < N; i++)
+  {
+    slots[i].due = nowMs + delays[i];
+    wheel.start(slots[i].id, delays[i]);
+  }
+
+  // The loop: sleep until the next deadline, then advance
+  uint64_t passes = 0;
+  double nextNs = 0;
+  t0 = Clock::now();
+  while (nowMs < seconds * 1000)
+  {
+    auto n0 = Clock::now();
+    uint32_t sleep = wheel.msUntilNext(nowMs);
+    nextNs += std::chrono::duration<double, std::nano>(Clock::now() - n0).count();
+    nowMs += sleep == TimerWheel<N>::NONE ? 1000 : sleep ? sleep : 1;
+    wheel.advance(nowMs);
+    passes++;
+  }
+  res.expiryNs = nsSince(t0, res.fired);
+  res.nextNs = passes ? nextNs / passes : 0;
+  for (uint16_t i = 0; i < N; i++)
+    res.wrong += (int32_t)(slots[i].due - nowMs) <= 0; // due by now but never fired
+
+  // What the wheel replaced: every deadline compared on each loop pass
+  static uint32_t deadlines[N];
+  for (uint16_t i = 0; i < N; i++)
+    deadlines[i] = slots[i].due;
+  volatile uint32_t due = 0;
+  uint32_t rounds = 1000;
+  t0 = Clock::now();
+  for (uint32_t r = 0; r < rounds; r++)
+    for (uint16_t i = 0; i < N; i++)
+      due += (int32_t)(r - deadlines[i]) >= 0;
+  res.scanNs = nsSince(t0, rounds);
+  return res;
+}
+
+static void print(uint16_t n, const Result &r)
+{
+  printf("%6u %8.1f %8.1f %9.1f %8.1f %10llu %7llu %12.1f\n", n, r.startNs, r.stopNs, r.expiryNs, r.nextNs,
+         (unsigned long long)r.fired, (unsigned long long)r.wrong, r.scanNs);
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: bench_timers [--seconds S] [--seed S] [--max-growth X]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t seconds = 600, seed = 1;
+  double maxGrowth = 4;
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    if (i + 1 >= argc)
+      usage();
+    const char *v = argv[++i];
+    if (!strcmp(a, "--seconds"))
+      seconds = atoi(v);
+    else if (!strcmp(a, "--seed"))
+      seed = atoi(v);
+    else if (!strcmp(a, "--max-growth"))
+      maxGrowth = atof(v);
+    else
+      usage();
+  }
+  if (!seconds)
+    usage();
+
+  printf("%u simulated seconds, each timer re-armed 1 ms .. 5 min from its callback\n\n", seconds);
+  printf("timers start ns  stop ns expiry ns  next ns      fired   wrong  scan/pass ns\n");
+  Result small = run<100>(seconds, seed);
+  print(100, small);
+  Result mid = run<1000>(seconds, seed);
+  print(1000, mid);
+  Result large = run<10000>(seconds, seed);
+  print(10000, large);
+  printf("\nwheel: %zu bytes at 1000 timers\n", sizeof(TimerWheel<1000>));
+
+  bool ok = !small.wrong && !mid.wrong && !large.wrong;
+  if (!ok)
+    printf("FAIL: timers fired off their deadline\n");
+  double startGrowth = large.startNs / small.startNs, expiryGrowth = large.expiryNs / small.expiryNs;
+  printf("growth 100 -> 10000 timers: start %.2fx, expiry %.2fx (scan %.0fx)\n", startGrowth, expiryGrowth,
+         large.scanNs / small.scanNs);
+  if (startGrowth > maxGrowth || expiryGrowth > maxGrowth)
+  {
+    printf("FAIL: growth past %.1fx\n", maxGrowth);
+    ok = false;
+  }
+  return ok ? 0 : 1;
+}
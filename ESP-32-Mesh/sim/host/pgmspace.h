@@ -0,0 +1,3 @@
+// Host stand-in for the ESP32 core's pgmspace.h: flash data is plain memory
+#pragma once
+#define PROGMEM
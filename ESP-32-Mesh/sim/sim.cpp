@@ -0,0 +1,114 @@
+#include "sim.h"
+#include <stdio.h>
+#include <algorithm>
+
+Sim::Sim(const SimConfig &cfg) : cfg_(cfg), rng_(cfg.seed)
+{
+  if (cfg_.nodes < 2)
+    cfg_.nodes = 2;
+  if (cfg_.fanout < 1)
+    cfg_.fanout = 1;
+  perNode.resize(cfg_.nodes);
+  radioFree_.resize(cfg_.nodes);
+}
+
+void Sim::at(uint64_t t, std::function<void()> fn)
+{
+  events_.push(Event{t < now_ ? now_ : t, order_++, std::move(fn)});
+}
+
+void Sim::every(uint64_t periodUs, std::function<bool()> fn)
+{
+  at(now_ + periodUs, [this, periodUs, fn]() {
+    if (fn())
+      every(periodUs, fn);
+  });
+}
+
+void Sim::run(uint64_t until)
+{
+  while (!events_.empty() && events_.top().t <= until)
+  {
+    Event e = events_.top();
+    events_.pop();
+    now_ = e.t;
+    e.fn();
+  }
+  if (now_ < until)
+    now_ = until;
+}
+
+uint8_t Sim::depth(uint32_t node) const
+{
+  uint8_t d = 0;
+  for (; node; node = parent(node))
+    d++;
+  return d;
+}
+
+uint32_t Sim::nextHop(uint32_t at, uint32_t to) const
+{
+  // Down if `to` is below `at`, else up
+  for (uint32_t n = to; n; n = parent(n))
+    if (parent(n) == at)
+      return n;
+  return parent(at);
+}
+
+void Sim::send(uint32_t from, uint32_t to, const std::string &packet)
+{
+  if (from == to || from >= cfg_.nodes || to >= cfg_.nodes)
+    return;
+  hop(from, from, to, std::make_shared<const std::string>(packet));
+}
+
+void Sim::hop(uint32_t node, uint32_t from, uint32_t to, std::shared_ptr<const std::string> packet)
+{
+  uint32_t next = nextHop(node, to);
+  uint64_t bytes = packet->size() + cfg_.overheadBytes;
+  uint64_t airUs = bytes * 8 * 1000000 / cfg_.bitrate;
+  uint64_t start = radioFree_[node] > now_ ? radioFree_[node] : now_;
+  radioFree_[node] = start + airUs;
+  bool lost = cfg_.loss > 0 && std::uniform_real_distribution<double>(0, 1)(rng_) < cfg_.loss;
+  for (AirStats *s : {&total, &perNode[node], node == 0 || next == 0 ? &sink : nullptr})
+  {
+    if (!s)
+      continue;
+    s->packets++;
+    s->bytes += bytes;
+    s->airtimeUs += airUs;
+    s->lost += lost;
+  }
+  if (lost)
+    return;
+  at(start + airUs + cfg_.hopLatencyUs, [this, next, from, to, packet]() {
+    if (next != to)
+      hop(next, from, to, packet);
+    else if (onReceive)
+      onReceive(to, from, *packet);
+  });
+}
+
+uint32_t percentile(std::vector<uint32_t> v, double pct)
+{
+  if (v.empty())
+    return 0;
+  size_t i = (size_t)(pct / 100 * (v.size() - 1) + 0.5);
+  std::nth_element(v.begin(), v.begin() + i, v.end());
+  return v[i];
+}
+
+std::string makeReport(uint32_t node, uint32_t seq, uint32_t len, bool sos, std::mt19937 &rng)
+{
+  char head[200];
+  int n = snprintf(head, sizeof(head),
+                   "{\"device_id\":\"04:83:08:59:%02X:%02X\",\"status\":\"active\",\"userid\":\"USER_%03u\","
+                   "\"seq\":%u,%s\"message\":\"",
+                   node >> 8 & 0xFF, node & 0xFF, node, seq, sos ? "\"sos\":true," : "");
+  std::string r(head, n);
+  static const char words[] = "help water north gate injured two people trapped bridge road ";
+  while (r.size() + 2 < len)
+    r += words[rng() % (sizeof(words) - 1)];
+  r += "\"}";
+  return r;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+// Discrete-event model of a painlessMesh network, for host benchmarks of
+// the firmware's mesh-layer code (include/fragment.h, ...). The code under
+// test is compiled natively and driven by simulated time; only the radio
+// is modelled.
+//
+// Node 0 is the master. The others form a tree below it, `fanout` children
+// per node in breadth-first order, so node n's parent is (n - 1) / fanout.
+// A single-send travels the tree hop by hop, as painlessMesh routes it. A
+// hop waits until its sender's radio is free, holds it for the packet's
+// airtime ((len + overhead) * 8 / bitrate), then arrives hopLatencyUs
+// later, or is lost with probability `loss`. Each node sends its packets
+// in order, so a burst from one node delays whatever it queues after.
+struct SimConfig
+{
+  uint32_t nodes = 32; // including the master
+  uint8_t fanout = 4;
+  double bitrate = 1e6;         // bit/s actually achieved on a hop
+  uint32_t overheadBytes = 120; // painlessMesh JSON envelope, TCP/IP and 802.11 headers
+  uint32_t hopLatencyUs = 2000; // per hop, on top of the airtime
+  double loss = 0.0;            // per hop
+  uint32_t seed = 1;
+};
+
+// What went over the air, counted per hop
+struct AirStats
+{
+  uint64_t packets = 0, bytes = 0, airtimeUs = 0, lost = 0;
+};
+
+// Value at `pct` (0..100) of v, 0 if it is empty
+uint32_t percentile(std::vector<uint32_t> v, double pct);
+// A report of about `len` bytes shaped like the client's, its message
+// words drawn from rng
+std::string makeReport(uint32_t node, uint32_t seq, uint32_t len, bool sos, std::mt19937 &rng);
+
+class Sim
+{
+public:
+  typedef std::function<void(uint32_t node, uint32_t from, const std::string &packet)> Receive;
+
+  explicit Sim(const SimConfig &cfg);
+
+  uint64_t now() const { return now_; } // us
+  uint32_t nowMs() const { return now_ / 1000; }
+  std::mt19937 &rng() { return rng_; }
+  const SimConfig &config() const { return cfg_; }
+
+  // Runs fn at time t (us), or now if t has passed
+  void at(uint64_t t, std::function<void()> fn);
+  // Runs fn every periodUs from now + periodUs, while it returns true
+  void every(uint64_t periodUs, std::function<bool()> fn);
+  // Runs events up to time `until`, or until there are none
+  void run(uint64_t until);
+
+  // Single-send from `from` to `to`; onReceive(to, from, packet) on arrival
+  void send(uint32_t from, uint32_t to, const std::string &packet);
+  Receive onReceive;
+
+  uint32_t parent(uint32_t node) const { return (node - 1) / cfg_.fanout; }
+  uint8_t depth(uint32_t node) const;
+  // Next node on the way from `at` to `to`
+  uint32_t nextHop(uint32_t at, uint32_t to) const;
+
+  AirStats total;                 // every hop
+  AirStats sink;                  // hops into or out of the master: its neighbourhood's airtime
+  std::vector<AirStats> perNode;  // by transmitting node
+  uint64_t busyUntil(uint32_t node) const { return radioFree_[node]; }
+
+private:
+  struct Event
+  {
+    uint64_t t, order;
+    std::function<void()> fn;
+    bool operator<(const Event &o) const { return t != o.t ? t > o.t : order > o.order; }
+  };
+
+  SimConfig cfg_;
+  uint64_t now_ = 0, order_ = 0;
+  std::priority_queue<Event> events_;
+  std::vector<uint64_t> radioFree_;
+  std::mt19937 rng_;
+
+  void hop(uint32_t node, uint32_t from, uint32_t to, std::shared_ptr<const std::string> packet);
+};
@@ -0,0 +1,217 @@
+// Aggregation benchmark: every client sends periodic reports to the master
+// over the simulated mesh (sim.h); relays merge the routine ones in their
+// subtree through include/aggregate.h, as main_testing.cpp does, and the
+// master takes the entries apart and echoes an ACK for each report. For
+// each hold time (cfg.aggHoldMs, 0: off) it reports what went over the
+// air around the master, and what the holding cost in latency.
+//
+//   sim_agg [--nodes N] [--fanout F] [--reports R] [--len B] [--period-ms P]
+//           [--sos S] [--acks 0|1] [--loss L] [--bitrate B] [--seed S]
+//
+// --len is the report length in bytes (about 220 plain, 140 packed), --sos
+// the share of reports sent as SOS, which are never held.
+#include "sim.h"
+#include "aggregate.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+
+// As in main_testing.cpp
+#define AGG_TICK_MS 10
+
+struct Options
+{
+  SimConfig sim;
+  uint32_t reports = 30; // per client
+  uint32_t len = 220;
+  uint32_t periodMs = 2000;
+  double sos = 0.02;
+  bool acks = true;
+};
+
+struct Result
+{
+  uint64_t sent = 0, delivered = 0, lines = 0, entries = 0;
+  AirStats sink, total;
+  double simS = 0;
+  std::vector<uint32_t> routineMs, sosMs;
+};
+
+static Result run(const Options &opt, uint16_t holdMs)
+{
+  Sim sim(opt.sim);
+  uint32_t nodes = sim.config().nodes, fanout = sim.config().fanout;
+  std::vector<AggBatch<AGG_LINE_MAX>> batch(nodes);
+  std::map<uint64_t, std::pair<uint64_t, bool>> created; // (node, seq) -> us, sos
+  Result res;
+  auto relay = [&](uint32_t node) { return node && node * fanout + 1 < nodes; };
+  // Relays send towards the master through their parent, which is a relay
+  // too unless it is the master
+  auto flush = [&](uint32_t node) {
+    FixedString<AGG_LINE_MAX + 1> line;
+    batch[node].take(sim.nowMs(), line);
+    sim.send(node, sim.parent(node), line.c_str());
+  };
+  auto hold = [&](uint32_t node, uint32_t from, const char *data, size_t len, uint16_t budgetMs) {
+    uint8_t hops = sim.depth(node);
+    if (!batch[node].add(from, data, len, sim.nowMs(), budgetMs, hops))
+    {
+      flush(node);
+      batch[node].add(from, data, len, sim.nowMs(), budgetMs, hops);
+    }
+    if (batch[node].due(sim.nowMs()))
+      flush(node);
+  };
+  auto deliver = [&](uint32_t from, const char *p, size_t len) {
+    const char *seq = strstr(p, "\"seq\":");
+    auto it = seq ? created.find((uint64_t)from << 32 | atoi(seq + 6)) : created.end();
+    if (it == created.end())
+      return;
+    res.delivered++;
+    (it->second.second ? res.sosMs : res.routineMs).push_back((sim.now() - it->second.first) / 1000);
+    created.erase(it);
+    if (opt.acks)
+      sim.send(0, from, "ACK:" + std::string(p, len));
+  };
+
+  sim.onReceive = [&](uint32_t node, uint32_t from, const std::string &p) {
+    if (strncmp(p.c_str(), "AGG:", 4))
+    {
+      if (node == 0)
+        deliver(from, p.c_str(), p.size());
+      return;
+    }
+    AggReader r;
+    AggEntry e;
+    uint16_t budget;
+    if (!r.begin(p.c_str() + 4, p.size() - 4, budget))
+      return;
+    if (node == 0)
+      res.lines++;
+    while (r.next(e))
+    {
+      if (node == 0)
+      {
+        res.entries++;
+        deliver(e.from, e.data, e.len);
+      }
+      else
+        hold(node, e.from, e.data, e.len, budget);
+    }
+  };
+
+  uint64_t endUs = 0;
+  for (uint32_t node = 1; node < nodes; node++)
+  {
+    uint64_t phase = sim.rng()() % (opt.periodMs * 1000);
+    for (uint32_t k = 0; k < opt.reports; k++)
+    {
+      uint64_t t = phase + (uint64_t)k * opt.periodMs * 1000;
+      endUs = std::max(endUs, t);
+      sim.at(t, [&, node, k]() {
+        bool sos = std::uniform_real_distribution<double>(0, 1)(sim.rng()) < opt.sos;
+        std::string report = makeReport(node, k, opt.len, sos, sim.rng());
+        created[(uint64_t)node << 32 | k] = {sim.now(), sos};
+        res.sent++;
+        if (sos || !holdMs || (sim.parent(node) == 0 && !relay(node)))
+          sim.send(node, 0, report); // never held, or nobody to merge with
+        else if (relay(node))
+          hold(node, node, report.data(), report.size(), holdMs);
+        else
+        {
+          FixedString<AGG_LINE_MAX + 1> line;
+          line.appendf("AGG:%u:%x:%u:", holdMs, node, (unsigned)report.size());
+          line.append(report.data(), report.size());
+          sim.send(node, sim.parent(node), line.c_str());
+        }
+      });
+    }
+    if (relay(node))
+      sim.every(AGG_TICK_MS * 1000, [&, node]() {
+        if (batch[node].due(sim.nowMs()))
+          flush(node);
+        return true;
+      });
+  }
+  sim.run(endUs + 10 * 1000000ULL);
+  res.sink = sim.sink;
+  res.total = sim.total;
+  res.simS = endUs / 1e6 + opt.periodMs / 1e3;
+  return res;
+}
+
+static void print(uint16_t holdMs, const Result &r, const Result &base)
+{
+  printf("%5u %7.1f%% %8llu %9.1f %6.1f%% %6.1f%% %9.1f %6.1f%% %5.2f %6u %6u %6u\n", holdMs,
+         r.sent ? 100.0 * r.delivered / r.sent : 0, (unsigned long long)r.sink.packets, r.sink.bytes / 1e3,
+         100.0 * r.sink.airtimeUs / (r.simS * 1e6),
+         base.sink.airtimeUs ? 100.0 * r.sink.airtimeUs / base.sink.airtimeUs : 0, r.total.airtimeUs / 1e6,
+         base.total.airtimeUs ? 100.0 * r.total.airtimeUs / base.total.airtimeUs : 0,
+         r.lines ? (double)r.entries / r.lines : 0, percentile(r.routineMs, 50), percentile(r.routineMs, 99),
+         percentile(r.sosMs, 99));
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: sim_agg [--nodes N] [--fanout F] [--reports R] [--len B] [--period-ms P]\n"
+                  "               [--sos S] [--acks 0|1] [--loss L] [--bitrate B] [--seed S]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  Options opt;
+  opt.sim.nodes = 64;
+  opt.sim.fanout = 3;
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    if (i + 1 >= argc)
+      usage();
+    const char *v = argv[++i];
+    if (!strcmp(a, "--nodes"))
+      opt.sim.nodes = atoi(v);
+    else if (!strcmp(a, "--fanout"))
+      opt.sim.fanout = atoi(v);
+    else if (!strcmp(a, "--reports"))
+      opt.reports = atoi(v);
+    else if (!strcmp(a, "--len"))
+      opt.len = atoi(v);
+    else if (!strcmp(a, "--period-ms"))
+      opt.periodMs = atoi(v);
+    else if (!strcmp(a, "--sos"))
+      opt.sos = atof(v);
+    else if (!strcmp(a, "--acks"))
+      opt.acks = atoi(v);
+    else if (!strcmp(a, "--loss"))
+      opt.sim.loss = atof(v);
+    else if (!strcmp(a, "--bitrate"))
+      opt.sim.bitrate = atof(v);
+    else if (!strcmp(a, "--seed"))
+      opt.sim.seed = atoi(v);
+    else
+      usage();
+  }
+  if (opt.len < 96 || opt.len > FRAG_MTU_MAX || opt.periodMs < 100 || !opt.reports)
+    usage();
+
+  printf("%u nodes (fanout %u), %u reports of %u bytes each every %u ms, %.0f%% SOS, acks %s, loss %.1f%%\n",
+         opt.sim.nodes, opt.sim.fanout, opt.reports, opt.len, opt.periodMs, opt.sos * 100, opt.acks ? "on" : "off",
+         opt.sim.loss * 100);
+  printf("relay: %zu bytes of batch\n\n", sizeof(AggBatch<AGG_LINE_MAX>));
+  printf(" hold   deliv  sink pkt   sink kB   sink  vs off  air s all vs off  per   r50    r99  sos99\n");
+  static const uint16_t HOLDS[] = {0, 25, 50, 100, 200, 400};
+  Result base;
+  for (uint16_t h : HOLDS)
+  {
+    Result r = run(opt, h);
+    if (!h)
+      base = r;
+    print(h, r, base);
+  }
+  printf("\nholds under %u ms (AGG_BUDGET_MIN_MS) save too little to pay for their ACKs; the config refuses them\n",
+         AGG_BUDGET_MIN_MS);
+  return 0;
+}
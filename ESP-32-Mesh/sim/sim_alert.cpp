@@ -0,0 +1,348 @@
+// Geo-targeted alert benchmark (include/alert.h), in two parts.
+//
+// Geometry: random circles and 8-corner polygons, each tested against
+// random points around it with GeoTarget::contains() (integers only) and
+// with a double-precision reference: the same flat-earth distance for a
+// circle, a crossing number with division for a polygon. It reports the
+// time per point and where the two disagree, as a distance from the
+// reference boundary.
+//
+// Wake-ups: clients at random positions in a square, on the simulated
+// mesh (sim.h). The master stamps each gateway alert with mesh time and
+// floods it, then floods it again as a retry. Every client handles each
+// copy as handleAlert does (parse, recent ids, expiry, target) and counts
+// what it would have buzzed for, against a blind broadcast and against
+// the reference.
+//
+//   sim_alert [--points N] [--clients N] [--alerts N] [--square-km K]
+//             [--no-fix P] [--seed S]
+//
+// Exit status 1 if contains() disagreed with the reference further than
+// 1 m from the boundary, or a client's decision differed from it.
+#include "sim.h"
+#include "alert.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// As in main_testing.cpp
+#define ALERT_RECENT_IDS 16
+
+#define M_PER_E7 (111320 / 1e7) // metres per 1e-7 degree of latitude
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+  SimConfig sim;
+  uint32_t points = 1000000;
+  uint32_t clients = 200;
+  uint32_t alerts = 50;
+  double squareKm = 40;
+  double noFix = 0.05;
+  int32_t lat0 = 423600000, lon0 = -710600000; // south-west corner of the square
+};
+
+// Flat-earth metres east and north of (lat, lon), as parse() scales them
+static void toMetres(double cosLat, int32_t lat, int32_t lon, int32_t pLat, int32_t pLon, double &x, double &y)
+{
+  y = ((double)pLat - lat) * M_PER_E7;
+  x = ((double)pLon - lon) * M_PER_E7 * cosLat;
+}
+
+// Reference answers and distance to the boundary, metres
+static bool refCircle(const GeoTarget &t, double radiusM, int32_t pLat, int32_t pLon, double &edge)
+{
+  double x, y;
+  toMetres(cos(t.lat[0] * (M_PI / 180e7)), t.lat[0], t.lon[0], pLat, pLon, x, y);
+  double d = sqrt(x * x + y * y);
+  edge = fabs(d - radiusM);
+  return d <= radiusM;
+}
+
+static bool refPolygon(const GeoTarget &t, int32_t pLat, int32_t pLon, double &edge)
+{
+  bool inside = false;
+  edge = 1e30;
+  double cosLat = cos(pLat * (M_PI / 180e7));
+  for (uint8_t i = 0, j = t.n - 1; i < t.n; j = i++)
+  {
+    double yi = t.lat[i], xi = t.lon[i], yj = t.lat[j], xj = t.lon[j];
+    if ((yi > pLat) != (yj > pLat) && pLon < (xj - xi) * (pLat - yi) / (yj - yi) + xi)
+      inside = !inside;
+    // Distance to the edge, in metres
+    double ax, ay, bx, by;
+    toMetres(cosLat, t.lat[i], t.lon[i], pLat, pLon, ax, ay);
+    toMetres(cosLat, t.lat[j], t.lon[j], pLat, pLon, bx, by);
+    double ex = bx - ax, ey = by - ay, len2 = ex * ex + ey * ey;
+    double s = len2 > 0 ? std::max(0.0, std::min(1.0, -(ax * ex + ay * ey) / len2)) : 0;
+    edge = std::min(edge, hypot(ax + s * ex, ay + s * ey));
+  }
+  return inside;
+}
+
+static bool parseTarget(const std::string &target, GeoTarget &t)
+{
+  std::string s = target + ":";
+  const char *p = s.c_str();
+  return t.parse(p);
+}
+
+// A star-shaped polygon of n corners around a centre, up to `r` metres out
+static std::string randomPolygon(std::mt19937 &rng, int32_t lat, int32_t lon, double r, uint8_t n)
+{
+  std::uniform_real_distribution<double> u(0, 1);
+  double cosLat = cos(lat * (M_PI / 180e7));
+  std::vector<double> angles(n);
+  for (double &a : angles)
+    a = u(rng) * 2 * M_PI;
+  std::sort(angles.begin(), angles.end());
+  std::string s = "P";
+  for (uint8_t i = 0; i < n; i++)
+  {
+    double d = r * (0.3 + 0.7 * u(rng));
+    char v[40];
+    snprintf(v, sizeof(v), "%s%d,%d", i ? "," : "", lat + (int32_t)(d * sin(angles[i]) / M_PER_E7),
+             lon + (int32_t)(d * cos(angles[i]) / M_PER_E7 / cosLat));
+    s += v;
+  }
+  return s;
+}
+
+struct Geometry
+{
+  uint64_t points = 0, inside = 0, disagree = 0;
+  double worstEdgeM = 0; // furthest from the boundary that a disagreement happened
+  double ns = 0, refNs = 0;
+};
+
+static Geometry geometry(const Options &opt, bool polygon, std::mt19937 &rng)
+{
+  const uint32_t SHAPES = 100;
+  std::uniform_real_distribution<double> u(0, 1);
+  Geometry g;
+  std::vector<int32_t> lat(opt.points / SHAPES), lon(opt.points / SHAPES);
+  std::vector<uint8_t> got(lat.size());
+  for (uint32_t k = 0; k < SHAPES; k++)
+  {
+    // Anywhere from the equator to 70 degrees, 100 m to 50 km across
+    int32_t cLat = (int32_t)((u(rng) * 140 - 70) * 1e7), cLon = (int32_t)((u(rng) * 340 - 170) * 1e7);
+    double r = 100 + u(rng) * 50000;
+    char circle[64];
+    snprintf(circle, sizeof(circle), "C%d,%d,%u", cLat, cLon, (uint32_t)r);
+    GeoTarget t;
+    if (!parseTarget(polygon ? randomPolygon(rng, cLat, cLon, r, ALERT_MAX_VERTICES) : circle, t))
+      abort();
+    double cosLat = cos(cLat * (M_PI / 180e7));
+    for (size_t i = 0; i < lat.size(); i++)
+    {
+      lat[i] = cLat + (int32_t)((u(rng) * 2.4 - 1.2) * r / M_PER_E7);
+      lon[i] = cLon + (int32_t)((u(rng) * 2.4 - 1.2) * r / M_PER_E7 / cosLat);
+    }
+
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < lat.size(); i++)
+      got[i] = t.contains(lat[i], lon[i]);
+    g.ns += std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+
+    t0 = Clock::now();
+    double edge;
+    for (size_t i = 0; i < lat.size(); i++)
+    {
+      bool ref = polygon ? refPolygon(t, lat[i], lon[i], edge) : refCircle(t, (uint32_t)r, lat[i], lon[i], edge);
+      g.inside += ref;
+      if (ref != got[i])
+      {
+        g.disagree++;
+        g.worstEdgeM = std::max(g.worstEdgeM, edge);
+      }
+    }
+    g.refNs += std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+    g.points += lat.size();
+  }
+  g.ns /= g.points;
+  g.refNs /= g.points; // includes the distance to the boundary
+  return g;
+}
+
+struct Wakeups
+{
+  uint64_t copies = 0, raised = 0, outside = 0, repeats = 0, expired = 0;
+  uint64_t reference = 0, wrong = 0;
+};
+
+static Wakeups wakeups(const Options &opt)
+{
+  Options o = opt;
+  o.sim.nodes = opt.clients + 1;
+  Sim sim(o.sim);
+  std::uniform_real_distribution<double> u(0, 1);
+  double cosLat = cos(opt.lat0 * (M_PI / 180e7)), side = opt.squareKm * 1000;
+  struct Client
+  {
+    int32_t lat = 0, lon = 0; // 0, 0: no fix
+    RecentIds<ALERT_RECENT_IDS> recent{};
+    std::vector<uint8_t> buzzed; // by alert id - 1
+  };
+  std::vector<Client> clients(sim.config().nodes);
+  for (Client &cl : clients)
+    cl.buzzed.assign(opt.alerts, 0);
+  for (uint32_t n = 1; n < clients.size(); n++)
+    if (u(sim.rng()) >= opt.noFix)
+    {
+      clients[n].lat = opt.lat0 + (int32_t)(u(sim.rng()) * side / M_PER_E7);
+      clients[n].lon = opt.lon0 + (int32_t)(u(sim.rng()) * side / M_PER_E7 / cosLat);
+    }
+  struct Sent
+  {
+    GeoTarget target;
+    uint32_t radiusM;
+  };
+  std::vector<Sent> sent;
+  Wakeups w;
+  uint32_t fanout = sim.config().fanout, nodes = sim.config().nodes;
+
+  // A client's handleAlert: decide, then relay the broadcast on to its children
+  sim.onReceive = [&](uint32_t node, uint32_t, const std::string &line) {
+    for (uint32_t c = node * fanout + 1; c <= node * fanout + fanout && c < nodes; c++)
+      sim.send(node, c, line);
+    Client &cl = clients[node];
+    Alert alert;
+    w.copies++;
+    if (!alert.parse(line.c_str(), true))
+      abort();
+    if (cl.recent.find(alert.id) >= 0)
+    {
+      w.repeats++;
+      return;
+    }
+    cl.recent.add(alert.id);
+    bool hasFix = cl.lat != 0 || cl.lon != 0;
+    if (alert.expired((uint32_t)sim.now()))
+      w.expired++;
+    else if (hasFix && !alert.target.contains(cl.lat, cl.lon))
+      w.outside++;
+    else
+    {
+      w.raised++;
+      cl.buzzed[alert.id - 1] = 1;
+    }
+  };
+
+  for (uint32_t k = 0; k < opt.alerts; k++)
+  {
+    // 1-5 km circles anywhere in the square, one a minute
+    int32_t lat = opt.lat0 + (int32_t)(u(sim.rng()) * side / M_PER_E7);
+    int32_t lon = opt.lon0 + (int32_t)(u(sim.rng()) * side / M_PER_E7 / cosLat);
+    uint32_t radius = 1000 + sim.rng()() % 4000;
+    char target[64];
+    snprintf(target, sizeof(target), "C%d,%d,%u", lat, lon, radius);
+    Sent s;
+    if (!parseTarget(target, s.target))
+      abort();
+    s.radiusM = radius;
+    sent.push_back(s);
+    uint64_t at = (uint64_t)k * 60000000;
+    uint32_t id = k + 1;
+    std::string tgt = target;
+    sim.at(at, [&, id, tgt]() {
+      // The master's bridge splices its mesh time in as <issued>
+      char line[160];
+      snprintf(line, sizeof(line), "ALERT:%x:%u:%u:%u:%s:Evacuate the river bank", id, 1 + id % 3, 1800,
+               (uint32_t)sim.now(), tgt.c_str());
+      std::string l = line;
+      for (uint32_t c = 1; c <= fanout && c < nodes; c++)
+        sim.send(0, c, l);
+      sim.at(sim.now() + 5000000, [&, l]() { // the retry round
+        for (uint32_t c = 1; c <= fanout && c < nodes; c++)
+          sim.send(0, c, l);
+      });
+    });
+  }
+  sim.run((uint64_t)opt.alerts * 60000000 + 60000000);
+
+  // Who should have buzzed, by the reference
+  for (uint32_t k = 0; k < sent.size(); k++)
+    for (uint32_t n = 1; n < clients.size(); n++)
+    {
+      double edge;
+      bool hasFix = clients[n].lat != 0 || clients[n].lon != 0;
+      bool ref = !hasFix || refCircle(sent[k].target, sent[k].radiusM, clients[n].lat, clients[n].lon, edge);
+      w.reference += ref;
+      w.wrong += ref != clients[n].buzzed[k];
+    }
+  return w;
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: sim_alert [--points N] [--clients N] [--alerts N] [--square-km K]\n"
+                  "                 [--no-fix P] [--seed S]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  Options opt;
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    if (i + 1 >= argc)
+      usage();
+    const char *v = argv[++i];
+    if (!strcmp(a, "--points"))
+      opt.points = atoi(v);
+    else if (!strcmp(a, "--clients"))
+      opt.clients = atoi(v);
+    else if (!strcmp(a, "--alerts"))
+      opt.alerts = atoi(v);
+    else if (!strcmp(a, "--square-km"))
+      opt.squareKm = atof(v);
+    else if (!strcmp(a, "--no-fix"))
+      opt.noFix = atof(v);
+    else if (!strcmp(a, "--seed"))
+      opt.sim.seed = atoi(v);
+    else
+      usage();
+  }
+  if (opt.points < 100 || !opt.clients || !opt.alerts || opt.alerts > 60 || opt.squareKm <= 0)
+    usage();
+
+  std::mt19937 rng(opt.sim.seed);
+  printf("%u random points around 100 shapes of each kind, 100 m to 50 km across\n\n", opt.points);
+  printf("target     ns/point  ref ns   inside  disagree  worst m\n");
+  Geometry c = geometry(opt, false, rng), p = geometry(opt, true, rng);
+  printf("circle     %8.1f %7.1f %7.1f%% %9llu %8.3f\n", c.ns, c.refNs, 100.0 * c.inside / c.points,
+         (unsigned long long)c.disagree, c.worstEdgeM);
+  printf("polygon    %8.1f %7.1f %7.1f%% %9llu %8.3f\n", p.ns, p.refNs, 100.0 * p.inside / p.points,
+         (unsigned long long)p.disagree, p.worstEdgeM);
+  printf("worst m: furthest from the reference boundary that the two disagreed\n\n");
+
+  Wakeups w = wakeups(opt);
+  uint64_t blind = (uint64_t)opt.clients * opt.alerts;
+  printf("%u clients in a %.0f km square (%.0f%% without a fix), %u alerts on 1-5 km circles\n", opt.clients,
+         opt.squareKm, opt.noFix * 100, opt.alerts);
+  printf("copies received %llu: raised %llu, outside %llu, expired %llu, repeats ignored %llu\n",
+         (unsigned long long)w.copies, (unsigned long long)w.raised, (unsigned long long)w.outside,
+         (unsigned long long)w.expired, (unsigned long long)w.repeats);
+  printf("buzzes %llu against %llu for a blind broadcast (%.1f%% fewer); reference %llu\n",
+         (unsigned long long)w.raised, (unsigned long long)blind, 100.0 - 100.0 * w.raised / blind,
+         (unsigned long long)w.reference);
+
+  bool ok = true;
+  if (c.worstEdgeM > 1 || p.worstEdgeM > 1)
+  {
+    printf("FAIL: contains() disagreed with the reference more than 1 m from the boundary\n");
+    ok = false;
+  }
+  if (w.wrong)
+  {
+    printf("FAIL: %llu client decisions differ from the reference\n", (unsigned long long)w.wrong);
+    ok = false;
+  }
+  return ok ? 0 : 1;
+}
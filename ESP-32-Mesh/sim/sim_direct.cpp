@@ -0,0 +1,200 @@
+// Direct message benchmark: the gateway addresses messages to users at
+// random; the master finds each user's node through the roster's user
+// index (include/roster.h) and sends "MSG:<id>:<text>" to that node
+// alone, resending after DIRECT_ACK_MS, doubled per try, until the client
+// answers "MACK:<id>", as main_testing.cpp does. The baseline floods the
+// same message to every node, as an alert would go. For each tree size it
+// reports what went over the air and the delivery latency.
+//
+//   sim_direct [--fanout F] [--messages M] [--len B] [--period-ms P]
+//              [--loss L] [--bitrate B] [--seed S]
+//
+// --len is the text length in bytes.
+#include "sim.h"
+#include "roster.h"
+#include "inbound.h"
+#include "mesh_msg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+
+// As in main_testing.cpp
+#define DIRECT_ACK_MS 3000
+#define DIRECT_TRIES 3
+
+struct Options
+{
+  SimConfig sim;
+  uint32_t messages = 200;
+  uint32_t len = 60;
+  uint32_t periodMs = 500;
+};
+
+struct Result
+{
+  uint64_t sent = 0, delivered = 0, timeouts = 0, tries = 0;
+  AirStats total;
+  std::vector<uint32_t> latencyMs;
+};
+
+static void userOf(uint32_t node, char *userId, size_t max) { snprintf(userId, max, "USER_%03u", node); }
+
+static Result run(const Options &opt, bool targeted)
+{
+  struct Pending
+  {
+    uint32_t node;
+    uint8_t tries;
+    uint64_t startUs;
+    std::string msg;
+  };
+  Sim sim(opt.sim);
+  uint32_t nodes = sim.config().nodes, fanout = sim.config().fanout;
+  static Roster<1024> roster; // static: the pool is large
+  roster.clear();
+  char userId[ROSTER_USERID_MAX + 1];
+  for (uint32_t node = 1; node < nodes; node++)
+  {
+    userOf(node, userId, sizeof(userId));
+    roster.setUserId(roster.touch(node, 0), userId);
+  }
+  std::map<uint32_t, Pending> pending; // by message id
+  Result res;
+
+  // Flood: each node passes it on to its children
+  auto flood = [&](uint32_t node, const std::string &p) {
+    for (uint32_t c = node * fanout + 1; c <= node * fanout + fanout && c < nodes; c++)
+      sim.send(node, c, p);
+  };
+  // Master: send (again), looking the user up as directTry does
+  std::function<void(uint32_t)> attempt = [&](uint32_t id) {
+    Pending &p = pending[id];
+    if (p.tries >= DIRECT_TRIES)
+    {
+      res.timeouts++;
+      pending.erase(id);
+      return;
+    }
+    userOf(p.node, userId, sizeof(userId));
+    RosterEntry *e = roster.findByUser(userId);
+    if (!e)
+      return;
+    p.tries++;
+    res.tries++;
+    sim.send(0, e->nodeId, p.msg);
+    sim.at(sim.now() + (uint64_t)(DIRECT_ACK_MS << (p.tries - 1)) * 1000, [&, id]() {
+      if (pending.count(id))
+        attempt(id);
+    });
+  };
+
+  sim.onReceive = [&](uint32_t node, uint32_t from, const std::string &p) {
+    uint32_t id;
+    const char *text;
+    if (node == 0)
+    {
+      auto it = !strncmp(p.c_str(), "MACK:", 5) && parseDirectAck(p.c_str() + 5, id) ? pending.find(id)
+                                                                                       : pending.end();
+      if (it == pending.end() || it->second.node != from)
+        return;
+      res.delivered++;
+      res.latencyMs.push_back((sim.now() - it->second.startUs) / 1000);
+      pending.erase(it);
+      return;
+    }
+    if (!parseDirect(p.c_str(), id, text))
+      return;
+    if (!targeted)
+    {
+      flood(node, p);
+      auto it = pending.find(id);
+      if (it != pending.end() && it->second.node == node)
+      {
+        res.delivered++;
+        res.latencyMs.push_back((sim.now() - it->second.startUs) / 1000);
+        pending.erase(it);
+      }
+      return;
+    }
+    char ack[16];
+    snprintf(ack, sizeof(ack), "MACK:%x", id);
+    sim.send(node, 0, ack); // every copy: the last ACK may be what got lost
+  };
+
+  std::string text(opt.len, 'x');
+  for (uint32_t k = 0; k < opt.messages; k++)
+    sim.at((uint64_t)k * opt.periodMs * 1000, [&, k]() {
+      uint32_t id = k + 1, node = 1 + sim.rng()() % (nodes - 1);
+      char head[16];
+      snprintf(head, sizeof(head), "MSG:%x:", id);
+      pending[id] = Pending{node, 0, sim.now(), head + text};
+      res.sent++;
+      if (targeted)
+        attempt(id);
+      else
+        flood(0, pending[id].msg);
+    });
+  sim.run((uint64_t)opt.messages * opt.periodMs * 1000 + 4ULL * DIRECT_ACK_MS * 1000 * DIRECT_TRIES);
+  res.total = sim.total;
+  return res;
+}
+
+static void print(uint32_t nodes, const char *mode, const Result &r, const Result &base)
+{
+  printf("%5u %-9s %6.1f%% %8llu %9.1f %8.2f %6.1f%% %5.2f %6u %6u\n", nodes, mode,
+         r.sent ? 100.0 * r.delivered / r.sent : 0, (unsigned long long)r.total.packets, r.total.bytes / 1e3,
+         r.total.airtimeUs / 1e6, base.total.airtimeUs ? 100.0 * r.total.airtimeUs / base.total.airtimeUs : 0,
+         r.sent ? (double)r.tries / r.sent : 0, percentile(r.latencyMs, 50), percentile(r.latencyMs, 99));
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: sim_direct [--fanout F] [--messages M] [--len B] [--period-ms P]\n"
+                  "                  [--loss L] [--bitrate B] [--seed S]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  Options opt;
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    if (i + 1 >= argc)
+      usage();
+    const char *v = argv[++i];
+    if (!strcmp(a, "--fanout"))
+      opt.sim.fanout = atoi(v);
+    else if (!strcmp(a, "--messages"))
+      opt.messages = atoi(v);
+    else if (!strcmp(a, "--len"))
+      opt.len = atoi(v);
+    else if (!strcmp(a, "--period-ms"))
+      opt.periodMs = atoi(v);
+    else if (!strcmp(a, "--loss"))
+      opt.sim.loss = atof(v);
+    else if (!strcmp(a, "--bitrate"))
+      opt.sim.bitrate = atof(v);
+    else if (!strcmp(a, "--seed"))
+      opt.sim.seed = atoi(v);
+    else
+      usage();
+  }
+  if (!opt.messages || !opt.len || opt.len > MESH_MSG_TEXT_MAX)
+    usage();
+
+  printf("%u messages of %u bytes, one every %u ms, fanout %u, loss %.1f%%\n\n", opt.messages, opt.len, opt.periodMs,
+         opt.sim.fanout, opt.sim.loss * 100);
+  printf("nodes mode        deliv  packets    air kB    air s  vs bc  tries   p50    p99\n");
+  static const uint32_t NODES[] = {10, 30, 100, 300};
+  for (uint32_t n : NODES)
+  {
+    opt.sim.nodes = n;
+    Result base = run(opt, false);
+    print(n, "broadcast", base, base);
+    print(n, "targeted", run(opt, true), base);
+  }
+  return 0;
+}
@@ -0,0 +1,261 @@
+// Fragmentation benchmark: every client sends long reports to the master
+// through include/fragment.h over the simulated mesh (sim.h), and short
+// priority packets (alert ACKs) in between. For each number of reassembly
+// slots on the master it reports delivery, goodput, retransmissions,
+// latency and the memory the slots take.
+//
+//   sim_frag [--nodes N] [--fanout F] [--reports R] [--len B] [--mtu M]
+//            [--period-ms P] [--pace-ms P] [--loss L] [--bitrate B] [--seed S]
+//
+// --len is the report length in bytes, --mtu the client's cfg.fragMtu.
+// --pace-ms 0 sends a report's fragments back to back instead of one per
+// tick, to show what pacing does to the ACKs queued behind them.
+#include "sim.h"
+#include "fragment.h"
+#include "mesh_msg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <set>
+
+// As in main_testing.cpp
+#define FRAG_TX_SLOTS 2
+#define FRAG_PACE_MS 20
+
+struct Options
+{
+  SimConfig sim;
+  uint32_t reports = 20; // per client
+  uint32_t len = 700;
+  uint16_t mtu = 256;
+  uint32_t periodMs = 2000;
+  uint32_t paceMs = FRAG_PACE_MS;
+};
+
+struct Result
+{
+  uint64_t sent = 0, delivered = 0, copies = 0, whole = 0, bytes = 0;
+  uint64_t fragments = 0, resent = 0, txFailed = 0, txBusy = 0;
+  uint64_t naks = 0, rxBusy = 0, rxDropped = 0;
+  uint8_t peakSlots = 0;
+  double simS = 0, pushNs = 0;
+  std::vector<uint32_t> reportMs, ackMs;
+};
+
+template <uint8_t RX_SLOTS>
+static Result run(const Options &opt)
+{
+  typedef FragSender<FRAG_TX_SLOTS, MESH_JSON_MAX> Sender;
+  typedef FragReassembler<RX_SLOTS, MESH_JSON_MAX> Reassembler;
+  Sim sim(opt.sim);
+  uint32_t nodes = sim.config().nodes;
+  std::vector<Sender> tx(nodes);
+  static Reassembler rx; // static: the slots are large
+  rx = Reassembler();
+  Result res;
+  std::map<uint64_t, uint64_t> started; // (node, xfer) -> us
+  std::set<uint64_t> seen;              // (node, seq) of the reports delivered
+  // A report at the master: new, or a copy the duplicate filter would drop
+  auto delivered = [&](uint32_t from, const char *p, size_t len) {
+    const char *seq = strstr(p, "\"seq\":");
+    if (!seq || !seen.insert((uint64_t)from << 32 | atoi(seq + 6)).second)
+    {
+      res.copies++;
+      return false;
+    }
+    res.delivered++;
+    res.bytes += len;
+    return true;
+  };
+  uint64_t pushNs = 0;
+  typedef std::chrono::steady_clock Clock;
+
+  auto pump = [&](uint32_t node) {
+    FixedString<FRAG_MTU_MAX + 1> line;
+    uint32_t to;
+    // Paced: one fragment per tick. Unpaced: everything due, back to back.
+    while (tx[node].next(sim.nowMs(), to, line))
+    {
+      sim.send(node, to, line.c_str());
+      if (opt.paceMs)
+        break;
+    }
+  };
+
+  sim.onReceive = [&](uint32_t node, uint32_t from, const std::string &p) {
+    if (node != 0)
+    {
+      uint32_t xfer, missing;
+      if (!strncmp(p.c_str(), "FACK:", 5) && parseFragAck(p.c_str() + 5, xfer))
+        tx[node].acked(from, xfer);
+      else if (!strncmp(p.c_str(), "FNAK:", 5) && parseFragNak(p.c_str() + 5, xfer, missing))
+      {
+        tx[node].nacked(from, xfer, missing);
+        if (!opt.paceMs)
+          pump(node);
+      }
+      return;
+    }
+    if (!strncmp(p.c_str(), "AACK:", 5))
+    {
+      res.ackMs.push_back((sim.now() - strtoull(p.c_str() + 5, nullptr, 10)) / 1000);
+      return;
+    }
+    if (strncmp(p.c_str(), "FRG:", 4))
+    {
+      delivered(from, p.c_str(), p.size());
+      return;
+    }
+    FixedString<32> line;
+    Clock::time_point t0 = Clock::now();
+    typename Reassembler::Result r = rx.push(from, p.c_str() + 4, p.size() - 4, sim.nowMs());
+    pushNs += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+    res.peakSlots = std::max(res.peakSlots, rx.inUse());
+    if (r == Reassembler::FRAG_COMPLETE && delivered(from, rx.payload(), rx.payloadLength()))
+    {
+      FragHeader h;
+      parseFragment(p.c_str() + 4, h);
+      auto it = started.find((uint64_t)from << 32 | h.xfer);
+      if (it != started.end())
+        res.reportMs.push_back((sim.now() - it->second) / 1000);
+    }
+    if (r == Reassembler::FRAG_COMPLETE || r == Reassembler::FRAG_DUPLICATE)
+    {
+      rx.ack(line);
+      sim.send(0, from, line.c_str());
+    }
+    else if (r == Reassembler::FRAG_NAK)
+    {
+      uint32_t to = rx.nak(line);
+      sim.send(0, to, line.c_str());
+    }
+  };
+
+  sim.every(FRAG_GAP_MS / 4 * 1000, [&]() {
+    FixedString<32> line;
+    while (rx.poll(sim.nowMs()))
+    {
+      uint32_t to = rx.nak(line);
+      sim.send(0, to, line.c_str());
+    }
+    return true;
+  });
+
+  uint64_t endUs = 0;
+  for (uint32_t node = 1; node < nodes; node++)
+  {
+    tx[node].seed(sim.rng()());
+    uint64_t phase = sim.rng()() % (opt.periodMs * 1000);
+    for (uint32_t k = 0; k < opt.reports; k++)
+    {
+      uint64_t t = phase + (uint64_t)k * opt.periodMs * 1000;
+      endUs = std::max(endUs, t);
+      sim.at(t, [&, node, k]() {
+        std::string report = makeReport(node, k, opt.len, false, sim.rng());
+        res.sent++;
+        uint32_t xfer = report.size() > opt.mtu ? tx[node].send(0, report.data(), report.size(), opt.mtu, false) : 0;
+        if (!xfer) // short, or every slot busy: whole, as the firmware does
+        {
+          res.whole++;
+          sim.send(node, 0, report);
+          return;
+        }
+        started[(uint64_t)node << 32 | xfer] = sim.now();
+        if (!opt.paceMs)
+          pump(node);
+      });
+      // An alert ACK halfway to the next report
+      sim.at(t + opt.periodMs * 500, [&, node]() {
+        char ack[32];
+        snprintf(ack, sizeof(ack), "AACK:%llu", (unsigned long long)sim.now());
+        sim.send(node, 0, ack);
+      });
+    }
+    sim.every((opt.paceMs ? opt.paceMs : FRAG_PACE_MS) * 1000, [&, node]() {
+      pump(node);
+      return true;
+    });
+  }
+  sim.run(endUs + 60 * 1000000ULL); // time for the last retries
+
+  for (uint32_t node = 1; node < nodes; node++)
+  {
+    res.fragments += tx[node].stats.fragments;
+    res.resent += tx[node].stats.resent;
+    res.txFailed += tx[node].stats.failed;
+    res.txBusy += tx[node].stats.busy;
+  }
+  res.naks = rx.stats.naks;
+  res.rxBusy = rx.stats.busy;
+  res.rxDropped = rx.stats.dropped;
+  res.simS = endUs / 1e6 + opt.periodMs / 1e3;
+  res.pushNs = rx.stats.fragments ? (double)pushNs / rx.stats.fragments : 0;
+  return res;
+}
+
+static void print(uint8_t slots, size_t bytes, const Result &r)
+{
+  printf("%5u %9zu %7.1f%% %6llu %8.2f %7llu %6llu %5llu %5llu %5llu %5u %6u %6u %6u %7.0f\n", slots, bytes,
+         r.sent ? 100.0 * r.delivered / r.sent : 0, (unsigned long long)r.copies, r.bytes / r.simS / 1e3,
+         (unsigned long long)r.fragments,
+         (unsigned long long)r.resent, (unsigned long long)r.naks, (unsigned long long)r.rxBusy,
+         (unsigned long long)r.whole, r.peakSlots, percentile(r.reportMs, 50), percentile(r.reportMs, 99),
+         percentile(r.ackMs, 99), r.pushNs);
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: sim_frag [--nodes N] [--fanout F] [--reports R] [--len B] [--mtu M]\n"
+                  "                [--period-ms P] [--pace-ms P] [--loss L] [--bitrate B] [--seed S]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  Options opt;
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    if (i + 1 >= argc)
+      usage();
+    const char *v = argv[++i];
+    if (!strcmp(a, "--nodes"))
+      opt.sim.nodes = atoi(v);
+    else if (!strcmp(a, "--fanout"))
+      opt.sim.fanout = atoi(v);
+    else if (!strcmp(a, "--reports"))
+      opt.reports = atoi(v);
+    else if (!strcmp(a, "--len"))
+      opt.len = atoi(v);
+    else if (!strcmp(a, "--mtu"))
+      opt.mtu = atoi(v);
+    else if (!strcmp(a, "--period-ms"))
+      opt.periodMs = atoi(v);
+    else if (!strcmp(a, "--pace-ms"))
+      opt.paceMs = atoi(v);
+    else if (!strcmp(a, "--loss"))
+      opt.sim.loss = atof(v);
+    else if (!strcmp(a, "--bitrate"))
+      opt.sim.bitrate = atof(v);
+    else if (!strcmp(a, "--seed"))
+      opt.sim.seed = atoi(v);
+    else
+      usage();
+  }
+  if (opt.len < 64 || opt.len > MESH_JSON_MAX || opt.mtu < FRAG_MTU_MIN || opt.mtu > FRAG_MTU_MAX ||
+      opt.periodMs < 100 || !opt.reports)
+    usage();
+
+  printf("%u nodes (fanout %u), %u reports of %u bytes each every %u ms, mtu %u, pace %u ms, loss %.1f%%\n",
+         opt.sim.nodes, opt.sim.fanout, opt.reports, opt.len, opt.periodMs, opt.mtu, opt.paceMs, opt.sim.loss * 100);
+  printf("client: %zu bytes for %u transfers\n\n", sizeof(FragSender<FRAG_TX_SLOTS, MESH_JSON_MAX>), FRAG_TX_SLOTS);
+  printf("slots     bytes  deliv copies    kB/s   frags resent fnaks  busy whole  peak  rep50  rep99  ack99 ns/frag\n");
+  print(2, sizeof(FragReassembler<2, MESH_JSON_MAX>), run<2>(opt));
+  print(4, sizeof(FragReassembler<4, MESH_JSON_MAX>), run<4>(opt));
+  print(8, sizeof(FragReassembler<8, MESH_JSON_MAX>), run<8>(opt));
+  print(16, sizeof(FragReassembler<16, MESH_JSON_MAX>), run<16>(opt));
+  return 0;
+}
@@ -0,0 +1,289 @@
+// Duty-cycle and energy model of the event-driven loops (main_testing.cpp)
+// against the loop() that spun before them. Each core runs its loop over
+// simulated time: the app core sleeps until the firmware's own timer
+// wheel (include/timer_wheel.h, with the timers setup() arms) or a GPS
+// UART wake-up, the net core until the next mesh poll (MESH_IDLE_MAX_MS)
+// or a command from the app core. Passes cost the CPU time in COSTS; the
+// clock runs at CPU_MAX_MHZ while either core is busy and drops to
+// CPU_MIN_MHZ when both idle, as the IDF's power management does. Current
+// is summed from CURRENTS. Both tables are rough figures for an ESP32 at
+// 240 MHz, not measurements: change them to match a board.
+//
+//   sim_idle [--seconds S] [--gps-hz H] [--rx-per-s R] [--send-ms P]
+//            [--battery-mah C] [--seed S]
+//
+// The radio listens all the time in every mode (the mesh softAP keeps
+// it awake), so it bounds what the CPU side can save.
+#include "timer_wheel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// As in main_testing.cpp
+#define DRAW_PERIOD_MS 200
+#define BLINK_PERIOD_MS 300
+#define MESH_IDLE_MAX_MS 20
+#define APP_IDLE_MAX_MS 1000
+#define TIMER_CAPACITY 16
+#define GPS_FAST_BAUD 38400
+
+// CPU time per piece of work at 240 MHz, us
+struct Costs
+{
+  uint32_t appPass = 40;     // rings, button, timer wheel
+  uint32_t gpsByte = 2;      // TinyGPSPlus encode, per byte
+  uint32_t draw = 3000;      // OLED frame over I2C, only when it changed
+  uint32_t send = 600;       // report serialized and posted to the net core
+  uint32_t netPass = 150;    // mesh.update() with nothing to do
+  uint32_t meshRx = 400;     // one packet handled
+  uint32_t spinPass = 200;   // one pass of the old loop(), mesh.update() included
+};
+static const Costs COSTS;
+
+// Supply current, mA
+struct Currents
+{
+  double base = 10;        // flash, RTC, peripherals
+  double radio = 100;      // receiver listening
+  double coreBusy = 20;    // per core running at 240 MHz
+  double coreIdleMax = 8;  // per core waiting at 240 MHz
+  double coreIdleMin = 4;  // per core waiting at 80 MHz
+};
+static const Currents CURRENTS;
+
+struct Options
+{
+  uint32_t seconds = 3600;
+  uint32_t gpsHz = 2;          // after configureGPS (GPS_RATE_MS)
+  uint32_t gpsBytesPerFix = 148; // GGA + RMC, as test_gps measures
+  double rxPerS = 4;           // mesh packets a node handles
+  uint32_t sendMs = 2000;      // cfg.sendPeriodMs
+  double drawChanged = 0.2;    // share of refreshes whose frame changed
+  double batteryMah = 2000;
+  uint32_t seed = 1;
+};
+
+struct Interval
+{
+  uint64_t start, end; // us
+};
+
+struct Core
+{
+  std::vector<Interval> busy;
+  uint64_t passes = 0;
+  uint64_t busyUs() const
+  {
+    uint64_t n = 0;
+    for (const Interval &i : busy)
+      n += i.end - i.start;
+    return n;
+  }
+};
+
+struct Result
+{
+  Core app, net;
+  uint64_t maxUs = 0; // time with at least one core busy
+  double cpuMa = 0, totalMa = 0;
+};
+
+// The app core's loop(): pass, then idleWait(min(msUntilNext, APP_IDLE_MAX_MS))
+// or until the GPS UART (FIFO threshold or rx timeout) notifies it
+static Core runApp(const Options &opt, bool ap, std::vector<uint64_t> &sends, std::mt19937 &rng)
+{
+  static TimerWheel<TIMER_CAPACITY> timers;
+  timers = TimerWheel<TIMER_CAPACITY>();
+  static uint32_t draws, sendTicks;
+  draws = sendTicks = 0;
+  timers.begin(0);
+  TimerId draw = timers.create([](void *) { draws++; });
+  TimerId send = timers.create([](void *) { sendTicks++; });
+  TimerId report = timers.create([](void *) {});
+  TimerId blink = timers.create([](void *) {});
+  timers.start(draw, DRAW_PERIOD_MS, DRAW_PERIOD_MS);
+  timers.start(report, 5000, 5000);
+  if (ap)
+    timers.start(blink, 1, BLINK_PERIOD_MS);
+  else
+    timers.start(send, opt.sendMs, opt.sendMs);
+
+  // GPS bursts: bytes arrive at the UART's rate; it notifies at 120 bytes
+  // (FIFO threshold) and when the line goes quiet
+  std::vector<uint64_t> notify;
+  std::vector<std::pair<uint64_t, uint32_t>> arrived; // (us, bytes by then)
+  uint64_t endUs = (uint64_t)opt.seconds * 1000000;
+  uint64_t byteUs = 10 * 1000000 / GPS_FAST_BAUD;
+  uint32_t total = 0;
+  if (opt.gpsHz)
+    for (uint64_t t = 0; t < endUs; t += 1000000 / opt.gpsHz)
+    {
+      for (uint32_t b = 120; b < opt.gpsBytesPerFix; b += 120)
+        notify.push_back(t + b * byteUs);
+      notify.push_back(t + (opt.gpsBytesPerFix + 2) * byteUs);
+      total += opt.gpsBytesPerFix;
+      arrived.push_back({t + opt.gpsBytesPerFix * byteUs, total});
+    }
+
+  Core core;
+  uint64_t t = 0;
+  uint32_t pumped = 0;
+  size_t nextNotify = 0, nextArrived = 0;
+  std::bernoulli_distribution drawChanged(opt.drawChanged);
+  while (t < endUs)
+  {
+    // A pass: what has arrived, what the wheel fires
+    uint32_t before = draws, sendsBefore = sendTicks;
+    timers.advance(t / 1000);
+    while (nextArrived < arrived.size() && arrived[nextArrived].first <= t)
+      nextArrived++;
+    uint32_t have = nextArrived ? arrived[nextArrived - 1].second : 0;
+    uint64_t cost = COSTS.appPass + (uint64_t)(have - pumped) * COSTS.gpsByte;
+    pumped = have;
+    for (uint32_t d = before; d < draws; d++)
+      if (drawChanged(rng))
+        cost += COSTS.draw;
+    for (uint32_t s = sendsBefore; s < sendTicks; s++)
+    {
+      cost += COSTS.send;
+      sends.push_back(t);
+    }
+    core.busy.push_back({t, t + cost});
+    core.passes++;
+    t += cost;
+
+    uint32_t wait = timers.msUntilNext(t / 1000);
+    if (wait > APP_IDLE_MAX_MS)
+      wait = APP_IDLE_MAX_MS;
+    uint64_t wake = (t / 1000 + (wait ? wait : 1)) * 1000;
+    while (nextNotify < notify.size() && notify[nextNotify] <= t)
+      nextNotify++;
+    if (nextNotify < notify.size() && notify[nextNotify] < wake)
+      wake = notify[nextNotify];
+    t = wake;
+  }
+  return core;
+}
+
+// netLoop(): pass, then idleWait(min(msUntilNetWake, cap)), woken early
+// by the app core's commands; mesh packets wait for the next poll
+static Core runNet(const Options &opt, bool ap, const std::vector<uint64_t> &sends, std::mt19937 &rng)
+{
+  Core core;
+  uint64_t endUs = (uint64_t)opt.seconds * 1000000, t = 0, nextRx = 0;
+  std::exponential_distribution<double> gap(opt.rxPerS > 0 ? opt.rxPerS / 1e6 : 1);
+  bool rx = !ap && opt.rxPerS > 0;
+  if (rx)
+    nextRx = gap(rng);
+  size_t nextSend = 0;
+  uint32_t cap = ap ? APP_IDLE_MAX_MS : MESH_IDLE_MAX_MS;
+  while (t < endUs)
+  {
+    uint64_t cost = ap ? COSTS.appPass : COSTS.netPass;
+    while (rx && nextRx <= t)
+    {
+      cost += COSTS.meshRx;
+      nextRx += gap(rng);
+    }
+    core.busy.push_back({t, t + cost});
+    core.passes++;
+    t += cost;
+    uint64_t wake = t + (uint64_t)cap * 1000;
+    while (nextSend < sends.size() && sends[nextSend] <= t)
+      nextSend++;
+    if (nextSend < sends.size() && sends[nextSend] < wake)
+      wake = sends[nextSend];
+    t = wake;
+  }
+  return core;
+}
+
+// Time with at least one of the two cores busy: the clock at CPU_MAX_MHZ
+static uint64_t unionUs(std::vector<Interval> a, const std::vector<Interval> &b)
+{
+  a.insert(a.end(), b.begin(), b.end());
+  std::sort(a.begin(), a.end(), [](const Interval &x, const Interval &y) { return x.start < y.start; });
+  uint64_t n = 0, end = 0;
+  for (const Interval &i : a)
+  {
+    if (i.end <= end)
+      continue;
+    n += i.end - std::max(i.start, end);
+    end = i.end;
+  }
+  return n;
+}
+
+static Result run(const Options &opt, bool ap)
+{
+  std::mt19937 rng(opt.seed);
+  Result r;
+  std::vector<uint64_t> sends;
+  r.app = runApp(opt, ap, sends, rng);
+  r.net = runNet(opt, ap, sends, rng);
+  uint64_t endUs = (uint64_t)opt.seconds * 1000000;
+  r.maxUs = std::min(unionUs(r.app.busy, r.net.busy), endUs);
+  double busy = (double)(r.app.busyUs() + r.net.busyUs()) / endUs; // core-seconds per second
+  double idleMax = 2.0 * r.maxUs / endUs - busy, idleMin = 2.0 * (endUs - r.maxUs) / endUs;
+  r.cpuMa = CURRENTS.base + busy * CURRENTS.coreBusy + idleMax * CURRENTS.coreIdleMax + idleMin * CURRENTS.coreIdleMin;
+  r.totalMa = r.cpuMa + CURRENTS.radio;
+  return r;
+}
+
+static void print(const char *name, const Options &opt, const Result &r, double spinMa)
+{
+  double s = opt.seconds, us = s * 1e6;
+  printf("%-12s %7.1f %6.2f%% %7.1f %6.2f%% %7.2f%% %7.1f %8.1f %6.1f%% %7.1f\n", name,
+         r.app.passes / s, 100.0 * r.app.busyUs() / us, r.net.passes / s, 100.0 * r.net.busyUs() / us,
+         100.0 * r.maxUs / us, r.cpuMa, r.totalMa, 100.0 * r.totalMa / spinMa, opt.batteryMah / r.totalMa);
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: sim_idle [--seconds S] [--gps-hz H] [--rx-per-s R] [--send-ms P]\n"
+                  "                [--battery-mah C] [--seed S]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  Options opt;
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    if (i + 1 >= argc)
+      usage();
+    const char *v = argv[++i];
+    if (!strcmp(a, "--seconds"))
+      opt.seconds = atoi(v);
+    else if (!strcmp(a, "--gps-hz"))
+      opt.gpsHz = atoi(v);
+    else if (!strcmp(a, "--rx-per-s"))
+      opt.rxPerS = atof(v);
+    else if (!strcmp(a, "--send-ms"))
+      opt.sendMs = atoi(v);
+    else if (!strcmp(a, "--battery-mah"))
+      opt.batteryMah = atof(v);
+    else if (!strcmp(a, "--seed"))
+      opt.seed = atoi(v);
+    else
+      usage();
+  }
+  if (!opt.seconds || !opt.sendMs || opt.gpsHz > 10)
+    usage();
+
+  // The old loop(): the app core never waits, the other core idles at full clock
+  double spinMa = CURRENTS.base + CURRENTS.coreBusy + CURRENTS.coreIdleMax + CURRENTS.radio;
+  printf("%u s simulated, GPS %u Hz (%u bytes per fix), %.1f mesh packets/s, a report every %u ms\n\n",
+         opt.seconds, opt.gpsHz, opt.gpsBytesPerFix, opt.rxPerS, opt.sendMs);
+  printf("mode         app p/s  app busy net p/s net busy at 240  cpu mA total mA vs spin  hours\n");
+  printf("%-12s %7.0f %6.2f%% %7s %7s %7.2f%% %7.1f %8.1f %6.1f%% %7.1f\n", "spinning", 1e6 / COSTS.spinPass,
+         100.0, "-", "-", 100.0, spinMa - CURRENTS.radio, spinMa, 100.0, opt.batteryMah / spinMa);
+  print("mesh", opt, run(opt, false), spinMa);
+  print("AP pairing", opt, run(opt, true), spinMa);
+  printf("\nradio %.0f mA of every total; CPU side alone: %.1f mA spinning\n", CURRENTS.radio, spinMa - CURRENTS.radio);
+  return 0;
+}
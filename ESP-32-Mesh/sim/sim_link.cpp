@@ -0,0 +1,249 @@
+// Delivery accounting check (include/link_health.h): every client sends a
+// numbered report with its per-boot id every --period-ms over the
+// simulated mesh (sim.h), and the master feeds each arrival to the node's
+// SeqWindow, as ingestReport does. On the way each report can be lost
+// (independently, or in Gilbert-Elliott bursts), sent twice (a retry whose
+// ACK was lost), held back behind later ones, and the client can reboot
+// and start again at 1 under a new boot id. For each fault mix the window's
+// figures are compared with what actually happened. The master learns of a
+// boot from its first arrival: nothing sent before it counts, and a number
+// below it that arrives later counts as a duplicate, as the window cannot
+// tell it from one.
+//
+//   sim_link [--nodes N] [--fanout F] [--reports R] [--period-ms P]
+//            [--tolerance PP] [--seed S]
+//
+// Exit status 1 if a node's measured delivery ratio is off the true one by
+// more than --tolerance percentage points (default 1), or a window's count
+// of received reports, duplicates or restarts differs from what happened.
+#include "sim.h"
+#include "link_health.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <map>
+#include <set>
+
+struct Faults
+{
+  const char *name;
+  double loss;          // independent, per report
+  double toBad, toGood; // Gilbert-Elliott: chance per report of entering / leaving the bad state
+  double badLoss;       // loss while bad
+  double dup;           // sent twice
+  double late;          // held back 1 .. 3 periods
+  double reboots;       // per node over the run
+};
+
+static const Faults FAULTS[] = {
+    {"clean", 0, 0, 0, 0, 0, 0, 0},
+    {"loss 5%", 0.05, 0, 0, 0, 0, 0, 0},
+    {"bursts", 0, 0.01, 0.2, 0.9, 0, 0, 0},
+    {"dup 5%", 0, 0, 0, 0, 0.05, 0, 0},
+    {"late 10%", 0, 0, 0, 0, 0, 0.1, 0},
+    {"reboots", 0, 0, 0, 0, 0, 0, 2},
+    {"all", 0.02, 0.01, 0.2, 0.9, 0.05, 0.1, 2},
+};
+
+struct Options
+{
+  SimConfig sim;
+  uint32_t reports = 1800; // per client, an hour at the default period
+  uint32_t periodMs = 2000;
+  double tolerance = 1.0;
+};
+
+// What happened to one node, and what its window made of it
+struct Truth
+{
+  uint32_t boot = 0, seq = 0, sent = 0, dupArrivals = 0, maxBurst = 0;
+  bool bad = false;
+  uint64_t downUntilUs = 0;
+  std::set<uint64_t> delivered; // boot << 32 | seq
+  std::map<uint32_t, uint32_t> first; // boot id -> number that arrived first
+  std::vector<std::pair<uint32_t, uint32_t>> boots; // (boot id, last seq sent)
+};
+
+struct Result
+{
+  uint64_t sent = 0, counted = 0, delivered = 0, received = 0, expected = 0; // counted: sent from a boot's first arrival on
+  uint64_t dupTrue = 0, dupCounted = 0, reordered = 0, stale = 0;
+  uint32_t restartsTrue = 0, restartsCounted = 0, maxBurstTrue = 0, maxBurstCounted = 0;
+  double worstPp = 0; // largest per-node gap between measured and true delivery, percentage points
+};
+
+static Result run(const Options &opt, const Faults &f)
+{
+  Sim sim(opt.sim);
+  uint32_t nodes = sim.config().nodes;
+  std::vector<Truth> truth(nodes);
+  std::vector<SeqWindow> window(nodes);
+  Result res;
+  std::uniform_real_distribution<double> u(0, 1);
+  auto chance = [&](double p) { return p > 0 && u(sim.rng()) < p; };
+  uint64_t periodUs = (uint64_t)opt.periodMs * 1000, endUs = opt.reports * periodUs;
+
+  sim.onReceive = [&](uint32_t node, uint32_t from, const std::string &p) {
+    if (node != 0)
+      return;
+    uint32_t boot, seq;
+    if (sscanf(p.c_str(), "%x:%u:", &boot, &seq) != 2)
+      return;
+    Truth &t = truth[from];
+    auto first = t.first.emplace(boot, seq).first;
+    if (seq < first->second || !t.delivered.insert((uint64_t)boot << 32 | seq).second)
+      t.dupArrivals++;
+    window[from].observe(boot, seq);
+  };
+
+  for (uint32_t node = 1; node < nodes; node++)
+  {
+    Truth &t = truth[node];
+    t.boot = sim.rng()();
+    t.boots.push_back({t.boot, 0});
+    // Reboots at random times; the node is off for 10 s, longer than any hold-back
+    uint32_t reboots = (uint32_t)f.reboots;
+    for (uint32_t r = 0; r < reboots; r++)
+    {
+      uint64_t at = (uint64_t)(u(sim.rng()) * endUs);
+      sim.at(at, [&, node]() {
+        Truth &t = truth[node];
+        t.boot = sim.rng()();
+        t.seq = 0;
+        t.boots.push_back({t.boot, 0});
+        t.downUntilUs = sim.now() + 10000000;
+      });
+    }
+    uint64_t phase = sim.rng()() % periodUs;
+    sim.every(periodUs, [&, node, phase]() {
+      Truth &t = truth[node];
+      if (sim.now() >= endUs)
+        return false;
+      if (sim.now() < t.downUntilUs)
+        return true;
+      // Gilbert-Elliott: the state moves once per report
+      t.bad = t.bad ? !chance(f.toGood) : chance(f.toBad);
+      uint32_t seq = ++t.seq;
+      t.boots.back().second = seq;
+      t.sent++;
+      bool lost = chance(f.loss) || (t.bad && chance(f.badLoss));
+      char p[200];
+      int n = snprintf(p, sizeof(p), "%x:%u:", t.boot, seq);
+      std::string packet(p, n);
+      packet.resize(200, 'x'); // about a report's length
+      uint64_t delay = phase + (chance(f.late) ? (1 + sim.rng()() % 3) * periodUs : 0);
+      if (!lost)
+        sim.at(sim.now() + delay, [&, node, packet]() { sim.send(node, 0, packet); });
+      if (chance(f.dup))
+        sim.at(sim.now() + delay + periodUs / 4, [&, node, packet]() { sim.send(node, 0, packet); });
+      return true;
+    });
+  }
+  sim.run(endUs + 10 * periodUs);
+
+  for (uint32_t node = 1; node < nodes; node++)
+  {
+    Truth &t = truth[node];
+    SeqWindow &w = window[node];
+    // True delivery: distinct numbers that arrived, against those sent
+    // from each boot's first arrival on
+    uint32_t sent = 0, got = 0;
+    for (auto &b : t.boots)
+    {
+      auto first = t.first.find(b.first);
+      if (first == t.first.end())
+        continue; // nothing from this boot arrived: the master never saw it
+      uint32_t run = 0;
+      for (uint32_t s = first->second; s <= b.second; s++)
+      {
+        bool in = t.delivered.count((uint64_t)b.first << 32 | s);
+        sent++;
+        got += in;
+        run = in ? 0 : run + 1;
+        t.maxBurst = std::max(t.maxBurst, run);
+      }
+    }
+    res.sent += t.sent;
+    res.counted += sent;
+    res.delivered += got;
+    res.received += w.received;
+    res.expected += w.expected();
+    res.dupTrue += t.dupArrivals;
+    res.dupCounted += w.duplicates;
+    res.reordered += w.reordered;
+    res.stale += w.stale;
+    res.restartsTrue += t.first.empty() ? 0 : t.first.size() - 1;
+    res.restartsCounted += w.restarts;
+    res.maxBurstTrue = std::max(res.maxBurstTrue, t.maxBurst);
+    res.maxBurstCounted = std::max<uint32_t>(res.maxBurstCounted, std::max(w.maxBurst, w.curBurst));
+    double truePct = sent ? 100.0 * got / sent : 100, measured = w.deliveryBp() / 100.0;
+    res.worstPp = std::max(res.worstPp, fabs(truePct - measured));
+  }
+  return res;
+}
+
+static void print(const char *name, const Result &r)
+{
+  printf("%-9s %8llu %7.2f%% %7.2f%% %6.2f %6llu/%-6llu %6llu %5llu %4u/%-4u %4u/%-4u\n", name,
+         (unsigned long long)r.sent, r.counted ? 100.0 * r.delivered / r.counted : 0,
+         r.expected ? 100.0 * r.received / r.expected : 0, r.worstPp, (unsigned long long)r.dupCounted,
+         (unsigned long long)r.dupTrue, (unsigned long long)r.reordered, (unsigned long long)r.stale,
+         r.restartsCounted, r.restartsTrue, r.maxBurstCounted, r.maxBurstTrue);
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: sim_link [--nodes N] [--fanout F] [--reports R] [--period-ms P]\n"
+                  "                [--tolerance PP] [--seed S]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  Options opt;
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    if (i + 1 >= argc)
+      usage();
+    const char *v = argv[++i];
+    if (!strcmp(a, "--nodes"))
+      opt.sim.nodes = atoi(v);
+    else if (!strcmp(a, "--fanout"))
+      opt.sim.fanout = atoi(v);
+    else if (!strcmp(a, "--reports"))
+      opt.reports = atoi(v);
+    else if (!strcmp(a, "--period-ms"))
+      opt.periodMs = atoi(v);
+    else if (!strcmp(a, "--tolerance"))
+      opt.tolerance = atof(v);
+    else if (!strcmp(a, "--seed"))
+      opt.sim.seed = atoi(v);
+    else
+      usage();
+  }
+  if (opt.sim.nodes < 2 || !opt.sim.fanout || !opt.reports || !opt.periodMs)
+    usage();
+
+  printf("%u clients, %u reports each, one every %u ms\n\n", opt.sim.nodes - 1, opt.reports, opt.periodMs);
+  printf("faults        sent   true    window  worst  dups cnt/true   late stale restarts bursts\n");
+  bool ok = true;
+  for (const Faults &f : FAULTS)
+  {
+    Result r = run(opt, f);
+    print(f.name, r);
+    if (r.worstPp > opt.tolerance || r.received != r.delivered || r.restartsCounted != r.restartsTrue ||
+        r.dupCounted != r.dupTrue)
+      ok = false;
+  }
+  printf("\ntrue: distinct reports that arrived / reports sent since the boot's first arrival\n"
+         "window: received / expected, as the master computes it\n"
+         "worst: largest per-node gap between the two, percentage points\n");
+  if (!ok)
+    printf("FAIL: a window's delivery ratio is off by more than %.1f points, or its received, duplicate or\n"
+           "      restart counts disagree with what happened\n",
+           opt.tolerance);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,513 @@
+// Portal benchmark: phones on the AP fetch the page, revalidate it, send
+// connectivity probes and submit messages, through a mocked socket layer
+// on the simulated radio (sim.h). Requests go up as raw HTTP bytes; the AP
+// parses them, runs the handler and sends the response bytes back, which
+// the phone parses and checks. The handlers are main_testing.cpp's:
+//   polled  the synchronous WebServer as it was: one connection per
+//           netLoop pass (AP_IDLE_MAX_MS), blocking until the response
+//           is on the air; the page copied out of a raw literal each time
+//   async   ESPAsyncWebServer: a request is handled as soon as it arrives
+//           on the one AsyncTCP task; the gzipped page straight from
+//           include/web_assets.h, 304 for a matching ETag; messages go to
+//           the net core through the fromWeb ring, 503 when it is full
+//   nocache async, but phones never send If-None-Match
+// Handler time is measured on the host and multiplied by --cpu-scale to
+// stand for the ESP32's; the per-request TCP round trip is --rtt-us.
+//
+//   sim_portal [--phones N,N,..] [--seconds S] [--think-ms T] [--bitrate B]
+//              [--rtt-us U] [--cpu-scale K] [--seed S]
+//
+// --think-ms 0 (the default) re-requests as soon as a response lands; the
+// second table always uses 2 s, a phone being browsed.
+// Exit status 1 if a response was malformed, a 304 came for a page the
+// phone did not have, or a message was answered 200 and then lost.
+#include "sim.h"
+#include "inbound.h"
+#include "mesh_msg.h"
+#include "spsc_ring.h"
+#include "web_assets.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+
+// As in main_testing.cpp
+#define WEB_RING_SIZE 8
+#define AP_IDLE_MAX_MS 10 // the polled server's netLoop pass, before the async portal
+
+MsgPool msgPool;
+LongMsgPool longMsgPool;
+static SpscRing<MeshMsg, WEB_RING_SIZE> fromWeb;
+
+typedef std::chrono::steady_clock Clock;
+
+// The page before web/ and embed_web.py, as the polled server sent it
+static const char PORTAL_HTML[] = R"rawliteral(
+            <!DOCTYPE html>
+            <html>
+                <head>
+                <title>ResQMe User Control Panel</title>
+                <meta name="viewport" content="width=device-width, initial-scale=1">
+                <style>
+                body { font-family: Arial; text-align:center; margin-top:20%; }
+                input, button { padding:12px; font-size:18px; margin:5px; }
+                </style>
+                </head>
+                <body>
+                  <h2>ResQMe User Control Panel</h2>
+                  <p>Enter a message and send it to the The Resque team</p>
+                  <form action="/submit_sos" method="GET">
+                    <input type="text" name="msg" placeholder="Send a message" required>
+                    <button type="submit">Send</button>
+                  </form>
+                </body>
+            </html>
+                )rawliteral";
+
+enum Mode : uint8_t
+{
+  MODE_POLLED,
+  MODE_ASYNC,
+  MODE_NOCACHE
+};
+static const char *const MODE_NAMES[] = {"polled", "async", "nocache"};
+
+struct Options
+{
+  SimConfig sim;
+  std::vector<uint32_t> phones = {1, 4, 8, 16};
+  uint32_t seconds = 30;
+  uint32_t thinkMs = 0;
+  double cpuScale = 20; // ESP32 at 240 MHz against a desktop core
+  double submit = 0.1, probe = 0.2; // share of requests after the first page
+};
+
+// ======== Mocked socket layer ========
+// A request as ESPAsyncWebServer hands it over: path, query, one header
+struct MockRequest
+{
+  std::string path, msg, ifNoneMatch;
+  bool hasMsg = false;
+};
+
+struct MockResponse
+{
+  int code = 0;
+  std::string headers, body;
+
+  void header(const char *name, const std::string &value) { headers += std::string(name) + ": " + value + "\r\n"; }
+  // What goes on the wire
+  std::string bytes() const
+  {
+    char status[64];
+    snprintf(status, sizeof(status), "HTTP/1.1 %d\r\nContent-Length: %zu\r\nConnection: close\r\n", code, body.size());
+    return status + headers + "\r\n" + body;
+  }
+};
+
+static std::string percentDecode(const std::string &s)
+{
+  std::string out;
+  for (size_t i = 0; i < s.size(); i++)
+    if (s[i] == '%' && i + 2 < s.size())
+    {
+      out += (char)strtol(s.substr(i + 1, 2).c_str(), nullptr, 16);
+      i += 2;
+    }
+    else
+      out += s[i] == '+' ? ' ' : s[i];
+  return out;
+}
+
+static std::string percentEncode(const std::string &s)
+{
+  std::string out;
+  for (unsigned char c : s)
+  {
+    char v[4];
+    snprintf(v, sizeof(v), "%%%02X", c);
+    out += isalnum(c) ? std::string(1, (char)c) : c == ' ' ? std::string("+") : std::string(v);
+  }
+  return out;
+}
+
+static bool parseRequest(const std::string &raw, MockRequest &r)
+{
+  if (raw.compare(0, 4, "GET "))
+    return false;
+  size_t end = raw.find(' ', 4);
+  if (end == std::string::npos)
+    return false;
+  std::string target = raw.substr(4, end - 4);
+  size_t q = target.find('?');
+  r.path = target.substr(0, q);
+  if (q != std::string::npos && !target.compare(q + 1, 4, "msg="))
+  {
+    r.hasMsg = true;
+    r.msg = percentDecode(target.substr(q + 5));
+  }
+  size_t h = raw.find("\r\nIf-None-Match: ");
+  if (h != std::string::npos)
+    r.ifNoneMatch = raw.substr(h + 17, raw.find("\r\n", h + 17) - h - 17);
+  return raw.size() >= 4 && !raw.compare(raw.size() - 4, 4, "\r\n\r\n");
+}
+
+// ======== Handlers ========
+// main_testing.cpp's sendAsset, handleSubmit and handleConnectivityCheck
+static void sendAsset(const MockRequest &req, const WebAsset &asset, MockResponse &res)
+{
+  if (!req.ifNoneMatch.empty() && req.ifNoneMatch == asset.etag)
+    res.code = 304;
+  else
+  {
+    res.code = 200;
+    res.header("Content-Type", asset.type);
+    res.header("Content-Encoding", "gzip");
+    res.body.assign((const char *)asset.gz, asset.len);
+  }
+  res.header("ETag", asset.etag);
+  res.header("Cache-Control", "no-cache");
+}
+
+static void handleSubmit(const MockRequest &req, MockResponse &res)
+{
+  if (!req.hasMsg || !portalMessageValid(req.msg.c_str(), req.msg.length(), USER_MSG_MAX))
+  {
+    res.code = 400;
+    return;
+  }
+  MeshMsg m;
+  m.init(EVT_PORTAL_MSG);
+  if (!m.setLongText(req.msg.c_str(), req.msg.length()) || !fromWeb.push(m))
+  {
+    if (m.buf != MsgPool::NONE)
+      m.release();
+    res.code = 503;
+    res.body = "busy, try again";
+    return;
+  }
+  static FixedString<6 * USER_MSG_MAX + 96> page;
+  page = "<html><body><h2>Message Received:</h2><p>";
+  appendHtml(page, req.msg.c_str(), req.msg.length());
+  page.append("</p><a href='/'>Go Back</a></body></html>");
+  res.code = 200;
+  res.header("Content-Type", "text/html");
+  res.body.assign(page.c_str(), page.length());
+}
+
+static void handleProbe(MockResponse &res)
+{
+  res.code = 302;
+  res.header("Location", "http://192.168.4.1/");
+  res.header("Cache-Control", "no-store");
+}
+
+// The polled server's handlers, before the async portal: the page and the
+// echo built in heap strings, the message posted to the app core
+static void handlePolled(const MockRequest &req, MockResponse &res)
+{
+  if (req.path == "/")
+  {
+    std::string page = PORTAL_HTML; // String(PORTAL_HTML) from PROGMEM
+    res.code = 200;
+    res.header("Content-Type", "text/html");
+    res.body = page;
+  }
+  else if (req.path == "/submit_sos" && req.hasMsg)
+  {
+    MeshMsg m;
+    m.init(EVT_PORTAL_MSG);
+    if (m.setLongText(req.msg.c_str(), req.msg.length()) && !fromWeb.push(m))
+      m.release(); // the old postEvent dropped it silently
+    res.code = 200;
+    res.header("Content-Type", "text/html");
+    res.body = "<html><body><h2>Message Received:</h2><p>" + req.msg + "</p><a href='/'>Go Back</a></body></html>";
+  }
+  else
+  {
+    res.code = 302;
+    res.header("Location", "http://192.168.4.1");
+  }
+}
+
+static void handleAsync(const MockRequest &req, MockResponse &res)
+{
+  for (size_t i = 0; i < WEB_ASSET_COUNT; i++)
+    if (req.path == WEB_ASSETS[i].path)
+    {
+      sendAsset(req, WEB_ASSETS[i], res);
+      return;
+    }
+  if (req.path == "/submit_sos")
+    handleSubmit(req, res);
+  else
+    handleProbe(res);
+}
+
+// ======== Phones ========
+enum Kind : uint8_t
+{
+  REQ_PAGE,
+  REQ_SUBMIT,
+  REQ_PROBE,
+  REQ_KINDS
+};
+
+struct Result
+{
+  uint64_t requests = 0, bytesDown = 0, codes[6] = {}; // 2xx .. 5xx by code / 100
+  uint64_t submitted = 0, accepted = 0, drained = 0, busy = 0, bad = 0;
+  std::vector<uint32_t> latencyUs[REQ_KINDS], handlerNs;
+  double airPct = 0;
+};
+
+static Result run(const Options &opt, Mode mode, uint32_t phones, uint32_t thinkMs)
+{
+  SimConfig sc = opt.sim;
+  sc.nodes = phones + 1;
+  sc.fanout = phones; // every phone one hop from the AP (node 0)
+  Sim sim(sc);
+  Result res;
+  std::uniform_real_distribution<double> u(0, 1);
+  uint64_t endUs = (uint64_t)opt.seconds * 1000000;
+
+  struct Phone
+  {
+    std::string etag, lastMsg;
+    Kind kind = REQ_PAGE;
+    uint64_t sentUs = 0;
+  };
+  std::vector<Phone> phone(phones + 1);
+  std::map<uint32_t, std::string> pending; // phone -> request bytes waiting for the polled server
+  std::deque<uint32_t> queue;
+  uint64_t serverFree = 0; // AsyncTCP task, or the polled loop, busy until
+  uint32_t msgCounter = 0;
+
+  auto request = [&](uint32_t p) {
+    Phone &ph = phone[p];
+    if (sim.now() >= endUs)
+      return;
+    double r = u(sim.rng());
+    ph.kind = ph.etag.empty()              ? REQ_PAGE
+              : r < opt.submit             ? REQ_SUBMIT
+              : r < opt.submit + opt.probe ? REQ_PROBE
+                                           : REQ_PAGE;
+    std::string raw;
+    if (ph.kind == REQ_SUBMIT)
+    {
+      char msg[64];
+      snprintf(msg, sizeof(msg), "need water <%u> at the north gate & bridge", ++msgCounter);
+      ph.lastMsg = msg;
+      raw = "GET /submit_sos?msg=" + percentEncode(msg) + " HTTP/1.1\r\n";
+      res.submitted++;
+    }
+    else
+      raw = ph.kind == REQ_PROBE ? "GET /generate_204 HTTP/1.1\r\n" : "GET / HTTP/1.1\r\n";
+    raw += "Host: 192.168.4.1\r\nUser-Agent: Mozilla/5.0 (Linux; Android 14)\r\nAccept: */*\r\n";
+    if (ph.kind == REQ_PAGE && !ph.etag.empty() && mode == MODE_ASYNC)
+      raw += "If-None-Match: " + ph.etag + "\r\n";
+    raw += "\r\n";
+    ph.sentUs = sim.now();
+    sim.send(p, 0, raw);
+  };
+
+  // Parses, runs the handler, and sends the response when the handler is done
+  auto serve = [&](uint32_t p, const std::string &raw, uint64_t start) {
+    MockRequest req;
+    MockResponse resp;
+    if (!parseRequest(raw, req))
+    {
+      res.bad++;
+      return start;
+    }
+    auto t0 = Clock::now();
+    if (mode == MODE_POLLED)
+      handlePolled(req, resp);
+    else
+      handleAsync(req, resp);
+    std::string bytes = resp.bytes();
+    uint32_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+    res.handlerNs.push_back(ns);
+    uint64_t done = start + (uint64_t)(ns * opt.cpuScale / 1000);
+    sim.at(done, [&, p, bytes]() {
+      sim.send(0, p, bytes);
+      if (mode == MODE_POLLED)
+        serverFree = sim.busyUntil(0); // handleClient writes until the response is out
+    });
+    // The net core, woken by the push, takes the messages off fromWeb
+    sim.at(done + 200, [&]() {
+      MeshMsg m;
+      while (fromWeb.pop(m))
+      {
+        res.drained++;
+        m.release();
+      }
+    });
+    return done;
+  };
+
+  sim.onReceive = [&](uint32_t node, uint32_t from, const std::string &raw) {
+    if (node == 0)
+    {
+      if (mode == MODE_POLLED)
+      {
+        pending[from] = raw;
+        queue.push_back(from);
+      }
+      else
+        serverFree = serve(from, raw, std::max(sim.now(), serverFree));
+      return;
+    }
+    // A phone: check the response, then the next request after thinking
+    Phone &ph = phone[node];
+    res.requests++;
+    res.bytesDown += raw.size();
+    res.latencyUs[ph.kind].push_back(sim.now() - ph.sentUs);
+    int code = atoi(raw.c_str() + 9);
+    size_t bodyAt = raw.find("\r\n\r\n");
+    std::string body = bodyAt == std::string::npos ? "" : raw.substr(bodyAt + 4);
+    res.codes[std::min(code / 100, 5)]++;
+    size_t lenAt = raw.find("\r\nContent-Length: ");
+    bool ok = bodyAt != std::string::npos && lenAt < bodyAt && strtoul(raw.c_str() + lenAt + 18, nullptr, 10) == body.size();
+    if (ph.kind == REQ_PAGE && mode != MODE_POLLED)
+    {
+      size_t e = raw.find("\r\nETag: ");
+      std::string etag = e == std::string::npos ? "" : raw.substr(e + 8, raw.find("\r\n", e + 8) - e - 8);
+      if (code == 200)
+        ok &= body.size() == WEB_ASSETS[0].len && !memcmp(body.data(), WEB_ASSETS[0].gz, body.size()) &&
+              raw.find("Content-Encoding: gzip") != std::string::npos;
+      else
+        ok &= code == 304 && body.empty() && mode == MODE_ASYNC && etag == ph.etag;
+      ph.etag = etag;
+    }
+    else if (ph.kind == REQ_PAGE)
+    {
+      ok &= code == 200 && body.find("ResQMe User Control Panel") != std::string::npos;
+      ph.etag = "-"; // has the page
+    }
+    else if (ph.kind == REQ_SUBMIT)
+    {
+      res.accepted += code == 200;
+      res.busy += code == 503;
+      ok &= code == 200 || (code == 503 && mode != MODE_POLLED);
+      // The echo is text: the message's markup comes back escaped (async)
+      if (code == 200 && mode != MODE_POLLED)
+        ok &= body.find("&lt;") != std::string::npos && body.find(ph.lastMsg) == std::string::npos;
+    }
+    else
+      ok &= code == 302;
+    res.bad += !ok;
+    sim.at(sim.now() + (uint64_t)thinkMs * 1000 * (thinkMs ? 0.5 + u(sim.rng()) : 1),
+           [&, node]() { request(node); });
+  };
+
+  // The polled server: one connection per netLoop pass, none while a
+  // response is still going out
+  if (mode == MODE_POLLED)
+    sim.every(AP_IDLE_MAX_MS * 1000, [&]() {
+      if (queue.empty() || sim.now() < serverFree)
+        return sim.now() < endUs + 10000000;
+      uint32_t p = queue.front();
+      queue.pop_front();
+      serverFree = UINT64_MAX; // until the response has been written
+      serve(p, pending[p], sim.now());
+      return true;
+    });
+
+  for (uint32_t p = 1; p <= phones; p++)
+    sim.at(sim.rng()() % 100000, [&, p]() { request(p); });
+  sim.run(endUs + 10000000);
+  res.airPct = 100.0 * sim.perNode[0].airtimeUs / std::max(endUs, sim.busyUntil(0));
+  return res;
+}
+
+static void print(uint32_t phones, Mode mode, Result &r, uint32_t seconds)
+{
+  std::vector<uint32_t> all;
+  for (auto &v : r.latencyUs)
+    all.insert(all.end(), v.begin(), v.end());
+  printf("%6u %-8s %8.1f %7.1f %7.1f %7.1f %7.1f %8u %8u %6.1f%% %6llu %5llu\n", phones, MODE_NAMES[mode],
+         (double)r.requests / seconds, percentile(all, 50) / 1e3, percentile(all, 99) / 1e3,
+         percentile(r.latencyUs[REQ_PAGE], 99) / 1e3, percentile(r.latencyUs[REQ_SUBMIT], 99) / 1e3,
+         percentile(r.handlerNs, 50), percentile(r.handlerNs, 99), r.airPct, (unsigned long long)r.busy,
+         (unsigned long long)r.bad);
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: sim_portal [--phones N,N,..] [--seconds S] [--think-ms T] [--bitrate B]\n"
+                  "                  [--rtt-us U] [--cpu-scale K] [--seed S]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  Options opt;
+  opt.sim.bitrate = 2e6;         // shared AP airtime a few phones actually get
+  opt.sim.hopLatencyUs = 750;    // each way: 1.5 ms round trip per request (connect, AsyncTCP dispatch)
+  opt.sim.overheadBytes = 80;    // TCP/IP and 802.11 headers
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    if (i + 1 >= argc)
+      usage();
+    const char *v = argv[++i];
+    if (!strcmp(a, "--phones"))
+    {
+      opt.phones.clear();
+      for (const char *s = v; *s; s += *s == ',')
+        opt.phones.push_back(strtoul(s, (char **)&s, 10));
+    }
+    else if (!strcmp(a, "--seconds"))
+      opt.seconds = atoi(v);
+    else if (!strcmp(a, "--think-ms"))
+      opt.thinkMs = atoi(v);
+    else if (!strcmp(a, "--bitrate"))
+      opt.sim.bitrate = atof(v);
+    else if (!strcmp(a, "--rtt-us"))
+      opt.sim.hopLatencyUs = atoi(v) / 2;
+    else if (!strcmp(a, "--cpu-scale"))
+      opt.cpuScale = atof(v);
+    else if (!strcmp(a, "--seed"))
+      opt.sim.seed = atoi(v);
+    else
+      usage();
+  }
+  if (!opt.seconds || opt.phones.empty() || opt.sim.bitrate <= 0)
+    usage();
+  for (uint32_t p : opt.phones)
+    if (!p || p > 64)
+      usage();
+
+  printf("page: %zu bytes raw (polled), %zu gzipped (async); %.1f Mbit/s, %u us round trip, handler time x%.0f\n",
+         strlen(PORTAL_HTML), WEB_ASSETS[0].len, opt.sim.bitrate / 1e6, opt.sim.hopLatencyUs * 2, opt.cpuScale);
+  printf("requests: first the page, then %.0f%% messages, %.0f%% connectivity probes, the rest page reloads\n",
+         opt.submit * 100, opt.probe * 100);
+  bool ok = true;
+  for (uint32_t think : {opt.thinkMs, 2000u})
+  {
+    printf("\nthink %u ms\nphones mode        req/s   p50ms   p99ms  page99   msg99  hdl50ns  hdl99ns    air    503   bad\n",
+           think);
+    for (uint32_t phones : opt.phones)
+      for (Mode mode : {MODE_POLLED, MODE_ASYNC, MODE_NOCACHE})
+      {
+        Result r = run(opt, mode, phones, think);
+        print(phones, mode, r, opt.seconds);
+        // Every message answered 200 reached the net core; async never
+        // answers 200 for one it dropped
+        ok &= !r.bad && (mode == MODE_POLLED || r.drained == r.accepted);
+      }
+    if (think == 2000 && opt.thinkMs == 2000)
+      break;
+  }
+  ok &= !msgPool.inUse() && !longMsgPool.inUse();
+  printf("\nlatency: request sent to response received on the phone; hdl: handler on this host, not scaled\n");
+  if (!ok)
+    printf("FAIL: a malformed response, a 304 for a page the phone did not have, a message lost after a 200,\n"
+           "      or a pool buffer left in use\n");
+  return ok ? 0 : 1;
+}